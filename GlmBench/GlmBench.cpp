@@ -0,0 +1,359 @@
+/**	GLM hot function microbenchmarks with a regression check
+ *
+ *	Times the GLM calls the engine leans on (mat4 multiply, inverse, transpose,
+ *	perspective, rotate, translate, lookAt, quaternion ops, packing and noise) and
+ *	sums the magnitude of every result, then compares both against a stored
+ *	baseline:
+ *
+ *		GlmBenchAVX2 [--baseline file] [--out file] [--update-baseline] [--passes 3]
+ *		             [--time-tolerance 0.15] [--value-tolerance 1e-5]
+ *
+ *	A call fails when its checksum moved by more than the value tolerance
+ *	(relative), which is what a broken code path looks like, or when it got slower
+ *	than the baseline by more than the time tolerance (a fraction) in every one of
+ *	the passes over the whole suite. One slow pass is noise (another process, a
+ *	clock change) and only shows in the report. Calls the baseline doesn't know
+ *	are reported as new and pass. The process exits with 1 on any failure, and
+ *	with 2 when there is no baseline to compare against, so a build script can
+ *	gate on it.
+ *
+ *	Each build measures one GLM configuration, chosen by the project's GlmConfig
+ *	property (msbuild GlmBench.vcxproj /p:GlmConfig=AVX2):
+ *		Pure		GLM_FORCE_PURE, no intrinsics
+ *		SSE2		GLM_FORCE_SSE2
+ *		AVX2		GLM_FORCE_AVX2, compiled with /arch:AVX2
+ *		Aligned		GLM_FORCE_SSE2 with GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+ *	They can't share an executable: the inline GLM functions of different
+ *	configurations have the same names and the linker would keep only one of them.
+ *
+ *	The results go to glmbench_<config>.json, the baseline is read from
+ *	baseline_<config>.json. Timings only mean something on the machine that
+ *	recorded them, so record a baseline with --update-baseline on the machine that
+ *	runs the check.
+ */
+
+#if defined(GLMBENCH_SSE2)
+#	define GLM_FORCE_SSE2
+#	define GLMBENCH_CONFIG "sse2"
+#elif defined(GLMBENCH_AVX2)
+#	define GLM_FORCE_AVX2
+#	define GLMBENCH_CONFIG "avx2"
+#elif defined(GLMBENCH_ALIGNED)
+#	define GLM_FORCE_SSE2
+#	define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#	define GLMBENCH_CONFIG "aligned"
+#else
+#	define GLM_FORCE_PURE
+#	define GLMBENCH_CONFIG "pure"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/noise.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Benchmark.h"
+
+namespace
+{
+	const size_t COUNT = 1 << 16;
+
+	struct Result
+	{
+		std::string name;
+		double ns;					// Per call, fastest of the repeats
+		double checksum;			// Sum of |component| over every output
+		bool hasBaseline;
+		double baselineNs, baselineChecksum;
+		const char* status;			// pass, new, slower or mismatch
+	};
+
+	float Random(unsigned& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.f / 16777216.f) * 2.f - 1.f;
+	}
+
+	double Magnitude(float value) { return std::fabs(value); }
+	double Magnitude(glm::uint32 value) { return (double)value; }
+	double Magnitude(glm::uint64 value) { return (double)value; }
+	double Magnitude(const glm::vec3& v) { return std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z); }
+	double Magnitude(const glm::vec4& v) { return std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z) + std::fabs(v.w); }
+	double Magnitude(const glm::quat& q) { return std::fabs(q.x) + std::fabs(q.y) + std::fabs(q.z) + std::fabs(q.w); }
+	double Magnitude(const glm::mat4& m) { return Magnitude(m[0]) + Magnitude(m[1]) + Magnitude(m[2]) + Magnitude(m[3]); }
+
+	// Times COUNT calls of body(i) into out, keeps the time per call and the checksum
+	template <typename T, typename Body>
+	void Run(std::vector<Result>& results, const char* name, std::vector<T>& out, Body body)
+	{
+		double seconds = Benchmark::Measure([&] {
+			for (size_t i = 0; i < COUNT; ++i)
+				out[i] = body(i);
+		}, 15);
+		Benchmark::Consume(out[COUNT / 2]);
+		Benchmark::Report(name, seconds, (double)COUNT, "M calls/s");
+
+		Result result;
+		result.name = name;
+		result.ns = seconds * 1e9 / COUNT;
+		result.checksum = 0.0;
+		for (size_t i = 0; i < COUNT; ++i)
+			result.checksum += Magnitude(out[i]);
+		result.hasBaseline = false;
+		result.baselineNs = result.baselineChecksum = 0.0;
+		result.status = "new";
+		results.push_back(result);
+	}
+
+	std::vector<Result> RunAll()
+	{
+		unsigned state = 7;
+		std::vector<glm::mat4> matricesA(COUNT), matricesB(COUNT), matrices(COUNT);
+		std::vector<glm::quat> quatsA(COUNT), quatsB(COUNT), quats(COUNT);
+		std::vector<glm::vec4> vectors4(COUNT), unitVectors4(COUNT), outVectors4(COUNT);
+		std::vector<glm::vec3> vectors3(COUNT), smallFloats3(COUNT), eyes(COUNT), outVectors3(COUNT);
+		std::vector<float> scalars(COUNT), angles(COUNT), outScalars(COUNT);
+		std::vector<glm::uint32> words(COUNT);
+		std::vector<glm::uint64> halves(COUNT);
+
+		// Well conditioned transforms, so the inverse checksum is stable across configurations
+		for (size_t i = 0; i < COUNT; ++i)
+		{
+			glm::vec3 t(Random(state) * 10.f, Random(state) * 10.f, Random(state) * 10.f);
+			glm::vec3 axis = glm::normalize(glm::vec3(Random(state), Random(state), Random(state) + 2.f));
+			glm::vec3 s(1.f + Random(state) * 0.5f, 1.f + Random(state) * 0.5f, 1.f + Random(state) * 0.5f);
+			angles[i] = Random(state) * 3.f;
+			matricesA[i] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), t), angles[i], axis), s);
+			matricesB[i] = glm::rotate(glm::translate(glm::mat4(1.f), s), -angles[i], axis);
+			quatsA[i] = glm::angleAxis(angles[i], axis);
+			quatsB[i] = glm::angleAxis(Random(state) * 3.f, glm::normalize(glm::vec3(Random(state) + 2.f, Random(state), Random(state))));
+			vectors3[i] = t;
+			vectors4[i] = glm::vec4(t, 1.f);
+			unitVectors4[i] = glm::vec4(Random(state), Random(state), Random(state), Random(state));
+			smallFloats3[i] = glm::vec3(Random(state) + 1.f, (Random(state) + 1.f) * 100.f, (Random(state) + 1.f) * 0.01f);
+			eyes[i] = t + glm::vec3(0.f, 0.f, 5.f);
+			scalars[i] = 0.5f + (Random(state) + 1.f);
+		}
+		const glm::vec3 up(0.f, 1.f, 0.f), yAxis(0.f, 1.f, 0.f);
+
+		std::vector<Result> results;
+		printf("GLM %d.%d.%d, configuration %s (SIMD %s, aligned gentypes %s), %u calls each\n",
+			GLM_VERSION_MAJOR, GLM_VERSION_MINOR, GLM_VERSION_PATCH, GLMBENCH_CONFIG,
+			GLM_CONFIG_SIMD == GLM_ENABLE ? "on" : "off", GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE ? "on" : "off", (unsigned)COUNT);
+
+		Run(results, "mat4 multiply", matrices, [&](size_t i) { return matricesA[i] * matricesB[i]; });
+		Run(results, "mat4 inverse", matrices, [&](size_t i) { return glm::inverse(matricesA[i]); });
+		Run(results, "mat4 transpose", matrices, [&](size_t i) { return glm::transpose(matricesA[i]); });
+		Run(results, "mat4 * vec4", outVectors4, [&](size_t i) { return matricesA[i] * vectors4[i]; });
+		Run(results, "perspective", matrices, [&](size_t i) { return glm::perspective(scalars[i], 1.5f, 0.1f, 100.f); });
+		Run(results, "rotate", matrices, [&](size_t i) { return glm::rotate(matricesB[i], angles[i], yAxis); });
+		Run(results, "translate", matrices, [&](size_t i) { return glm::translate(matricesA[i], vectors3[i]); });
+		Run(results, "lookAt", matrices, [&](size_t i) { return glm::lookAt(eyes[i], vectors3[i], up); });
+
+		Run(results, "quat multiply", quats, [&](size_t i) { return quatsA[i] * quatsB[i]; });
+		Run(results, "quat slerp", quats, [&](size_t i) { return glm::slerp(quatsA[i], quatsB[i], 0.3f); });
+		Run(results, "quat * vec3", outVectors3, [&](size_t i) { return quatsA[i] * vectors3[i]; });
+		Run(results, "mat4_cast", matrices, [&](size_t i) { return glm::mat4_cast(quatsA[i]); });
+
+		// The unpacks read what the pack before them wrote
+		Run(results, "packHalf4x16", halves, [&](size_t i) { return glm::packHalf4x16(unitVectors4[i]); });
+		Run(results, "unpackHalf4x16", outVectors4, [&](size_t i) { return glm::unpackHalf4x16(halves[i]); });
+		Run(results, "packSnorm4x8", words, [&](size_t i) { return glm::packSnorm4x8(unitVectors4[i]); });
+		Run(results, "packF2x11_1x10", words, [&](size_t i) { return glm::packF2x11_1x10(smallFloats3[i]); });
+		Run(results, "unpackF2x11_1x10", outVectors3, [&](size_t i) { return glm::unpackF2x11_1x10(words[i]); });
+
+		Run(results, "perlin vec3", outScalars, [&](size_t i) { return glm::perlin(vectors3[i] * 0.37f); });
+		Run(results, "simplex vec3", outScalars, [&](size_t i) { return glm::simplex(vectors3[i] * 0.37f); });
+		return results;
+	}
+
+	// Reads back what WriteJson wrote. Only looks for the keys it needs
+	bool ReadBaseline(const char* path, std::string& config, std::vector<Result>& entries)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+
+		std::string text;
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			text.append(buffer, read);
+		fclose(file);
+
+		size_t at = text.find("\"config\": \"");
+		if (at != std::string::npos)
+		{
+			at += 11;
+			config = text.substr(at, text.find('"', at) - at);
+		}
+
+		for (at = text.find("\"name\": \""); at != std::string::npos; at = text.find("\"name\": \"", at))
+		{
+			at += 9;
+			size_t end = text.find('"', at), close = text.find('}', at);
+			size_t ns = text.find("\"ns\":", at), checksum = text.find("\"checksum\":", at);
+			if (end == std::string::npos || close == std::string::npos || ns > close || checksum > close)
+			{
+				printf("Baseline %s: malformed entry at byte %u\n", path, (unsigned)at);
+				return false;
+			}
+
+			Result entry;
+			entry.name = text.substr(at, end - at);
+			entry.ns = strtod(text.c_str() + ns + 5, nullptr);
+			entry.checksum = strtod(text.c_str() + checksum + 11, nullptr);
+			entries.push_back(entry);
+		}
+		return true;
+	}
+
+	// Returns whether every result passed
+	bool Compare(std::vector<Result>& results, const std::vector<Result>& baseline, double timeTolerance, double valueTolerance)
+	{
+		bool passed = true;
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			Result& result = results[i];
+			for (size_t j = 0; j < baseline.size(); ++j)
+			{
+				if (baseline[j].name != result.name)
+					continue;
+
+				result.hasBaseline = true;
+				result.baselineNs = baseline[j].ns;
+				result.baselineChecksum = baseline[j].checksum;
+				if (std::fabs(result.checksum - result.baselineChecksum) > valueTolerance * std::fmax(1.0, std::fabs(result.baselineChecksum)))
+					result.status = "mismatch";
+				else if (result.ns > result.baselineNs * (1.0 + timeTolerance))
+					result.status = "slower";
+				else
+					result.status = "pass";
+				break;
+			}
+			passed = passed && (strcmp(result.status, "pass") == 0 || strcmp(result.status, "new") == 0);
+		}
+		return passed;
+	}
+
+	bool WriteJson(const char* path, const std::vector<Result>& results, bool compared, double timeTolerance, double valueTolerance, bool passed)
+	{
+		FILE* file = fopen(path, "wb");
+		if (!file)
+		{
+			printf("Could not write %s\n", path);
+			return false;
+		}
+
+		fprintf(file, "{\n\t\"config\": \"%s\",\n\t\"glmVersion\": %d,\n\t\"simd\": %s,\n\t\"alignedGentypes\": %s,\n",
+			GLMBENCH_CONFIG, GLM_VERSION, GLM_CONFIG_SIMD == GLM_ENABLE ? "true" : "false",
+			GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE ? "true" : "false");
+		if (compared)
+			fprintf(file, "\t\"timeTolerance\": %g,\n\t\"valueTolerance\": %g,\n\t\"passed\": %s,\n", timeTolerance, valueTolerance, passed ? "true" : "false");
+		fprintf(file, "\t\"results\": [\n");
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const Result& result = results[i];
+			fprintf(file, "\t\t{ \"name\": \"%s\", \"ns\": %.4f, \"checksum\": %.17g", result.name.c_str(), result.ns, result.checksum);
+			if (compared && result.hasBaseline)
+				fprintf(file, ", \"baselineNs\": %.4f, \"baselineChecksum\": %.17g", result.baselineNs, result.baselineChecksum);
+			if (compared)
+				fprintf(file, ", \"status\": \"%s\"", result.status);
+			fprintf(file, " }%s\n", i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+		fclose(file);
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string baselinePath = "baseline_" GLMBENCH_CONFIG ".json";
+	std::string outPath = "glmbench_" GLMBENCH_CONFIG ".json";
+	bool updateBaseline = false;
+	int passes = 3;
+	double timeTolerance = 0.15, valueTolerance = 1e-5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--out") == 0 && hasValue)
+			outPath = argv[++i];
+		else if (strcmp(argv[i], "--time-tolerance") == 0 && hasValue)
+			timeTolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--value-tolerance") == 0 && hasValue)
+			valueTolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--passes") == 0 && hasValue)
+			passes = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--update-baseline") == 0)
+			updateBaseline = true;
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			printf("Usage: %s [--baseline file] [--out file] [--update-baseline] [--passes count] [--time-tolerance fraction] [--value-tolerance fraction]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	// A call is only as slow as its fastest pass, so a timing failure needs every pass to be slow
+	std::vector<Result> results = RunAll();
+	for (int pass = 1; pass < passes; ++pass)
+	{
+		printf("\nPass %d of %d\n", pass + 1, passes);
+		std::vector<Result> again = RunAll();
+		for (size_t i = 0; i < results.size(); ++i)
+			results[i].ns = std::min(results[i].ns, again[i].ns);
+	}
+
+	if (updateBaseline)
+	{
+		if (!WriteJson(baselinePath.c_str(), results, false, timeTolerance, valueTolerance, true))
+			return 2;
+		printf("Wrote baseline %s\n", baselinePath.c_str());
+		return 0;
+	}
+
+	std::string baselineConfig;
+	std::vector<Result> baseline;
+	if (!ReadBaseline(baselinePath.c_str(), baselineConfig, baseline))
+	{
+		printf("\nNo baseline at %s, record one with --update-baseline\n", baselinePath.c_str());
+		return 2;
+	}
+	if (baselineConfig != GLMBENCH_CONFIG)
+	{
+		printf("Baseline %s was recorded for configuration %s, not %s\n", baselinePath.c_str(), baselineConfig.c_str(), GLMBENCH_CONFIG);
+		return 2;
+	}
+
+	bool passed = Compare(results, baseline, timeTolerance, valueTolerance);
+	printf("\nAgainst %s (time tolerance %.0f%% over %d passes, value tolerance %g)\n", baselinePath.c_str(),
+		timeTolerance * 100.0, passes, valueTolerance);
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& result = results[i];
+		if (result.hasBaseline)
+			printf("  %-36s %8.3f ns vs %8.3f ns  %+6.1f%%  %s\n", result.name.c_str(), result.ns, result.baselineNs,
+				(result.ns / result.baselineNs - 1.0) * 100.0, result.status);
+		else
+			printf("  %-36s %8.3f ns  %s\n", result.name.c_str(), result.ns, result.status);
+	}
+	printf("%s\n", passed ? "PASSED" : "FAILED");
+
+	if (!WriteJson(outPath.c_str(), results, true, timeTolerance, valueTolerance, passed))
+		return 2;
+	printf("Wrote %s\n", outPath.c_str());
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,1011 @@
+#include "BatchMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/noise.hpp>
+#include <glm/gtc/packing.hpp>
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "BatchMath expects packed glm::vec3");
+static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "BatchMath expects packed glm::vec4");
+static_assert(sizeof(glm::quat) == 4 * sizeof(float), "BatchMath expects glm::quat as x, y, z, w");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "BatchMath expects packed glm::mat4");
+static_assert(sizeof(glm::mat3) == 9 * sizeof(float), "BatchMath expects packed glm::mat3");
+static_assert(sizeof(Affine3x4) == 12 * sizeof(float), "BatchMath expects packed Affine3x4");
+static_assert(sizeof(glm::dualquat) == 8 * sizeof(float), "BatchMath expects glm::dualquat as real, dual");
+static_assert(sizeof(SkinnedVertex) == 11 * sizeof(float), "BatchMath expects packed SkinnedVertex");
+
+namespace BatchMath
+{
+	// Scalar reference, written out per component so it never goes through GLM's SIMD paths
+
+	void TransformPointsScalar(const glm::mat4& m, const glm::vec3* in, glm::vec3* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float x = in[i].x, y = in[i].y, z = in[i].z;
+			out[i].x = m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0];
+			out[i].y = m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1];
+			out[i].z = m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2];
+		}
+	}
+
+	void TransformVectorsScalar(const glm::mat4& m, const glm::vec4* in, glm::vec4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float x = in[i].x, y = in[i].y, z = in[i].z, w = in[i].w;
+			for (int r = 0; r < 4; ++r)
+				out[i][r] = m[0][r] * x + m[1][r] * y + m[2][r] * z + m[3][r] * w;
+		}
+	}
+
+	void TransformPointsSoAScalar(const glm::mat4& m, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float px = x[i], py = y[i], pz = z[i];
+			outX[i] = m[0][0] * px + m[1][0] * py + m[2][0] * pz + m[3][0];
+			outY[i] = m[0][1] * px + m[1][1] * py + m[2][1] * pz + m[3][1];
+			outZ[i] = m[0][2] * px + m[1][2] * py + m[2][2] * pz + m[3][2];
+		}
+	}
+
+	void TransformVectorsSoAScalar(const glm::mat4& m, const float* x, const float* y, const float* z, const float* w,
+		float* outX, float* outY, float* outZ, float* outW, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float px = x[i], py = y[i], pz = z[i], pw = w[i];
+			outX[i] = m[0][0] * px + m[1][0] * py + m[2][0] * pz + m[3][0] * pw;
+			outY[i] = m[0][1] * px + m[1][1] * py + m[2][1] * pz + m[3][1] * pw;
+			outZ[i] = m[0][2] * px + m[1][2] * py + m[2][2] * pz + m[3][2] * pw;
+			outW[i] = m[0][3] * px + m[1][3] * py + m[2][3] * pz + m[3][3] * pw;
+		}
+	}
+
+	void MultiplyMatricesScalar(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::mat4 result;
+			for (int c = 0; c < 4; ++c)
+				for (int r = 0; r < 4; ++r)
+					result[c][r] = a[i][0][r] * b[i][c][0] + a[i][1][r] * b[i][c][1] + a[i][2][r] * b[i][c][2] + a[i][3][r] * b[i][c][3];
+			out[i] = result;
+		}
+	}
+
+	void ComposeTRSScalar(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, glm::mat4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float qx = r[i].x, qy = r[i].y, qz = r[i].z, qw = r[i].w;
+			float xx = qx * qx, yy = qy * qy, zz = qz * qz;
+			float xy = qx * qy, xz = qx * qz, yz = qy * qz;
+			float wx = qw * qx, wy = qw * qy, wz = qw * qz;
+
+			glm::mat4& m = out[i];
+			m[0][0] = (1.f - 2.f * (yy + zz)) * s[i].x;
+			m[0][1] = 2.f * (xy + wz) * s[i].x;
+			m[0][2] = 2.f * (xz - wy) * s[i].x;
+			m[0][3] = 0.f;
+			m[1][0] = 2.f * (xy - wz) * s[i].y;
+			m[1][1] = (1.f - 2.f * (xx + zz)) * s[i].y;
+			m[1][2] = 2.f * (yz + wx) * s[i].y;
+			m[1][3] = 0.f;
+			m[2][0] = 2.f * (xz + wy) * s[i].z;
+			m[2][1] = 2.f * (yz - wx) * s[i].z;
+			m[2][2] = (1.f - 2.f * (xx + yy)) * s[i].z;
+			m[2][3] = 0.f;
+			m[3][0] = t[i].x;
+			m[3][1] = t[i].y;
+			m[3][2] = t[i].z;
+			m[3][3] = 1.f;
+		}
+	}
+
+	void InvertMatricesScalar(const glm::mat4* in, glm::mat4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const glm::mat4& a = in[i];
+
+			// 2x2 determinants of the first two and last two columns
+			float s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+			float s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+			float s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+			float s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+			float s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+			float s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+			float c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+			float c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+			float c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+			float c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+			float c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+			float c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+
+			float invDet = 1.f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+			glm::mat4 b;
+			b[0][0] = ( a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * invDet;
+			b[0][1] = (-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3) * invDet;
+			b[0][2] = ( a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * invDet;
+			b[0][3] = (-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3) * invDet;
+			b[1][0] = (-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1) * invDet;
+			b[1][1] = ( a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * invDet;
+			b[1][2] = (-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1) * invDet;
+			b[1][3] = ( a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * invDet;
+			b[2][0] = ( a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * invDet;
+			b[2][1] = (-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0) * invDet;
+			b[2][2] = ( a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * invDet;
+			b[2][3] = (-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0) * invDet;
+			b[3][0] = (-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0) * invDet;
+			b[3][1] = ( a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * invDet;
+			b[3][2] = (-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0) * invDet;
+			b[3][3] = ( a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * invDet;
+			out[i] = b;
+		}
+	}
+
+	void ComposeAffineScalar(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, Affine3x4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::ComposeAffine(t[i], r[i], s[i]);
+	}
+
+	void MultiplyAffineScalar(const Affine3x4* a, const Affine3x4* b, Affine3x4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::Multiply(a[i], b[i]);
+	}
+
+	void InvertAffineScalar(const Affine3x4* in, Affine3x4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::InverseAffine(in[i]);
+	}
+
+	void InvertRigidScalar(const Affine3x4* in, Affine3x4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::InverseRigid(in[i]);
+	}
+
+	void NormalMatricesScalar(const glm::mat4* models, glm::mat3* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::NormalMatrix(models[i]);
+	}
+
+	void SinCosScalar(const float* angles, float* s, float* c, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			FastTrig::SinCos(angles[i], s[i], c[i]);
+	}
+
+	void Atan2Scalar(const float* y, const float* x, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = FastTrig::Atan2(y[i], x[i]);
+	}
+
+	void AcosScalar(const float* x, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = FastTrig::Acos(x[i]);
+	}
+
+	void LogScalar(const float* x, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = FastTrig::Log(x[i]);
+	}
+
+	void AxisAngleToQuatScalar(const glm::vec3* axes, const float* angles, glm::quat* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::AxisAngle(axes[i], angles[i]);
+	}
+
+	static void NormaliseQuat(float& x, float& y, float& z, float& w)
+	{
+		float invLength = 1.f / std::sqrt(x * x + y * y + z * z + w * w);
+		x *= invLength;
+		y *= invLength;
+		z *= invLength;
+		w *= invLength;
+	}
+
+	void NlerpQuatsScalar(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float sign = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i] + a.w[i] * b.w[i] < 0.f ? -1.f : 1.f;
+			float x = a.x[i] + t[i] * (b.x[i] * sign - a.x[i]);
+			float y = a.y[i] + t[i] * (b.y[i] * sign - a.y[i]);
+			float z = a.z[i] + t[i] * (b.z[i] * sign - a.z[i]);
+			float w = a.w[i] + t[i] * (b.w[i] * sign - a.w[i]);
+			NormaliseQuat(x, y, z, w);
+			out.x[i] = x;
+			out.y[i] = y;
+			out.z[i] = z;
+			out.w[i] = w;
+		}
+	}
+
+	void SlerpQuatsScalar(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float d = a.x[i] * b.x[i] + a.y[i] * b.y[i] + a.z[i] * b.z[i] + a.w[i] * b.w[i];
+			float sign = d < 0.f ? -1.f : 1.f;
+			float ct = Transform::SlerpCorrection(std::fabs(d), t[i]);
+			float x = a.x[i] + ct * (b.x[i] * sign - a.x[i]);
+			float y = a.y[i] + ct * (b.y[i] * sign - a.y[i]);
+			float z = a.z[i] + ct * (b.z[i] * sign - a.z[i]);
+			float w = a.w[i] + ct * (b.w[i] * sign - a.w[i]);
+			NormaliseQuat(x, y, z, w);
+			out.x[i] = x;
+			out.y[i] = y;
+			out.z[i] = z;
+			out.w[i] = w;
+		}
+	}
+
+	void BlendQuatsRange(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t first, size_t count)
+	{
+		const QuatSoA& reference = poses[0];
+		for (size_t i = first; i < count; ++i)
+		{
+			float x = 0.f, y = 0.f, z = 0.f, w = 0.f;
+			for (int p = 0; p < poseCount; ++p)
+			{
+				// Every pose is flipped into the first one's hemisphere
+				const QuatSoA& q = poses[p];
+				float d = reference.x[i] * q.x[i] + reference.y[i] * q.y[i] + reference.z[i] * q.z[i] + reference.w[i] * q.w[i];
+				float weight = d < 0.f ? -weights[p] : weights[p];
+				x += weight * q.x[i];
+				y += weight * q.y[i];
+				z += weight * q.z[i];
+				w += weight * q.w[i];
+			}
+			NormaliseQuat(x, y, z, w);
+			out.x[i] = x;
+			out.y[i] = y;
+			out.z[i] = z;
+			out.w[i] = w;
+		}
+	}
+
+	void BlendQuatsScalar(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t count)
+	{
+		BlendQuatsRange(poses, weights, poseCount, out, 0, count);
+	}
+
+	void QuatsToMatricesScalar(const QuatSoA& q, glm::mat4* out, size_t count)
+	{
+		const glm::vec3 zero(0.f), one(1.f);
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::ComposeTRS(zero, glm::quat(q.w[i], q.x[i], q.y[i], q.z[i]), one);
+	}
+
+	void ComposeAffineSoAScalar(const glm::vec3* t, const QuatSoA& r, const glm::vec3* s, Affine3x4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Transform::ComposeAffine(t[i], glm::quat(r.w[i], r.x[i], r.y[i], r.z[i]), s[i]);
+	}
+
+	void SkinLinearScalar(const Affine3x4* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Skinning::SkinLinear(palette, in[i]);
+	}
+
+	void SkinDualQuatScalar(const glm::dualquat* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Skinning::SkinDualQuat(palette, in[i]);
+	}
+
+	void UnpackQuatsScalar(const uint16_t* a, const uint16_t* b, const uint16_t* c, const QuatSoA& out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::quat q = Quantize::UnpackQuat48(a[i], b[i], c[i]);
+			out.x[i] = q.x;
+			out.y[i] = q.y;
+			out.z[i] = q.z;
+			out.w[i] = q.w;
+		}
+	}
+
+	void BlendQuantizedScalar(const uint16_t* const* keys, const float* weights, const float* offset, const float* scale,
+		float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float sum = weights[0] * keys[0][i] + weights[1] * keys[1][i] + weights[2] * keys[2][i] + weights[3] * keys[3][i];
+			out[i] = offset[i] + scale[i] * sum;
+		}
+	}
+
+	void Perlin2Scalar(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float sum = 0.f, frequency = fbm.frequency, amplitude = 1.f;
+			for (int o = 0; o < fbm.octaves; ++o)
+			{
+				sum += amplitude * glm::perlin(glm::vec2(x[i] * frequency, y[i] * frequency));
+				frequency *= fbm.lacunarity;
+				amplitude *= fbm.gain;
+			}
+			out[i] = sum;
+		}
+	}
+
+	void Perlin3Scalar(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float sum = 0.f, frequency = fbm.frequency, amplitude = 1.f;
+			for (int o = 0; o < fbm.octaves; ++o)
+			{
+				sum += amplitude * glm::perlin(glm::vec3(x[i] * frequency, y[i] * frequency, z[i] * frequency));
+				frequency *= fbm.lacunarity;
+				amplitude *= fbm.gain;
+			}
+			out[i] = sum;
+		}
+	}
+
+	void Simplex2Scalar(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float sum = 0.f, frequency = fbm.frequency, amplitude = 1.f;
+			for (int o = 0; o < fbm.octaves; ++o)
+			{
+				sum += amplitude * glm::simplex(glm::vec2(x[i] * frequency, y[i] * frequency));
+				frequency *= fbm.lacunarity;
+				amplitude *= fbm.gain;
+			}
+			out[i] = sum;
+		}
+	}
+
+	void Simplex3Scalar(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			float sum = 0.f, frequency = fbm.frequency, amplitude = 1.f;
+			for (int o = 0; o < fbm.octaves; ++o)
+			{
+				sum += amplitude * glm::simplex(glm::vec3(x[i] * frequency, y[i] * frequency, z[i] * frequency));
+				frequency *= fbm.lacunarity;
+				amplitude *= fbm.gain;
+			}
+			out[i] = sum;
+		}
+	}
+
+	// Moller-Trumbore as in glm::intersectRayTriangle, +inf unless the hit is within [0, tMax]
+	static void IntersectTriangle(const glm::vec3& origin, const glm::vec3& direction, float tMax,
+		const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t, float& u, float& v)
+	{
+		glm::vec3 edge1 = v1 - v0, edge2 = v2 - v0;
+		glm::vec3 p = glm::cross(direction, edge2);
+		float det = glm::dot(edge1, p);
+		float invDet = 1.f / det;
+
+		glm::vec3 dist = origin - v0;
+		glm::vec3 q = glm::cross(dist, edge1);
+		u = glm::dot(dist, p) * invDet;
+		v = glm::dot(direction, q) * invDet;
+		t = glm::dot(edge2, q) * invDet;
+
+		bool hit = u >= 0.f && v >= 0.f && u + v <= 1.f && t >= 0.f && t <= tMax &&
+			std::fabs(det) >= std::numeric_limits<float>::epsilon();
+		if (!hit)
+			t = std::numeric_limits<float>::infinity();
+	}
+
+	// Slab test, entry distance clamped to 0 or +inf on a miss
+	static float IntersectBox(const glm::vec3& origin, const glm::vec3& invDirection, float tMax,
+		const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		float enter = 0.f, exit = tMax;
+		for (int a = 0; a < 3; ++a)
+		{
+			float t0 = (boxMin[a] - origin[a]) * invDirection[a];
+			float t1 = (boxMax[a] - origin[a]) * invDirection[a];
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+		}
+		return exit < enter ? std::numeric_limits<float>::infinity() : enter;
+	}
+
+	void IntersectRayTrianglesScalar(const glm::vec3& origin, const glm::vec3& direction, float tMax, const TriangleSoA& triangles,
+		float* t, float* u, float* v, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			IntersectTriangle(origin, direction, tMax,
+				glm::vec3(triangles.x0[i], triangles.y0[i], triangles.z0[i]),
+				glm::vec3(triangles.x1[i], triangles.y1[i], triangles.z1[i]),
+				glm::vec3(triangles.x2[i], triangles.y2[i], triangles.z2[i]), t[i], u[i], v[i]);
+		}
+	}
+
+	void IntersectRaysTriangleScalar(const RaySoA& rays, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+		float* t, float* u, float* v, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			IntersectTriangle(glm::vec3(rays.ox[i], rays.oy[i], rays.oz[i]), glm::vec3(rays.dx[i], rays.dy[i], rays.dz[i]),
+				rays.tMax[i], v0, v1, v2, t[i], u[i], v[i]);
+		}
+	}
+
+	void IntersectRayBoxesScalar(const glm::vec3& origin, const glm::vec3& invDirection, float tMax, const BoxSoA& boxes,
+		float* tNear, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			tNear[i] = IntersectBox(origin, invDirection, tMax,
+				glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+		}
+	}
+
+	void IntersectRaysBoxScalar(const RaySoA& rays, const glm::vec3& boxMin, const glm::vec3& boxMax, float* tNear, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			tNear[i] = IntersectBox(glm::vec3(rays.ox[i], rays.oy[i], rays.oz[i]),
+				glm::vec3(rays.invDx[i], rays.invDy[i], rays.invDz[i]), rays.tMax[i], boxMin, boxMax);
+		}
+	}
+
+	// Packing goes straight through gtc/packing, which is scalar code; the kernels have to match it bit for bit
+
+	void PackHalfScalar(const float* in, uint16_t* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::packHalf1x16(in[i]);
+	}
+
+	void UnpackHalfScalar(const uint16_t* in, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::unpackHalf1x16(in[i]);
+	}
+
+	void PackSnorm16Scalar(const float* in, uint16_t* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::packSnorm1x16(in[i]);
+	}
+
+	void UnpackSnorm16Scalar(const uint16_t* in, float* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::unpackSnorm1x16(in[i]);
+	}
+
+	void PackSnorm3x10_1x2Scalar(const glm::vec4* in, uint32_t* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::packSnorm3x10_1x2(in[i]);
+	}
+
+	void UnpackSnorm3x10_1x2Scalar(const uint32_t* in, glm::vec4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::unpackSnorm3x10_1x2(in[i]);
+	}
+
+	void PackF2x11_1x10Scalar(const glm::vec3* in, uint32_t* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::packF2x11_1x10(in[i]);
+	}
+
+	void UnpackF2x11_1x10Scalar(const uint32_t* in, glm::vec3* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::unpackF2x11_1x10(in[i]);
+	}
+
+	// lowbias32, the emitters' random numbers
+	static uint32_t HashBits(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		return x ^ (x >> 16);
+	}
+
+	// Top 24 bits of the hash as a float in [-1, 1)
+	static float HashSigned(uint32_t key)
+	{
+		return (float)(HashBits(key) >> 8) * (1.f / 8388608.f) - 1.f;
+	}
+
+	void EmitParticlesScalar(const ParticleEmitter& emitter, uint32_t sequence, const ParticleSoA& out, size_t count)
+	{
+		float lifeRange = emitter.life * emitter.lifeVariation;
+		for (size_t i = 0; i < count; ++i)
+		{
+			// Eight keys per particle, one per random component
+			uint32_t key = (sequence + (uint32_t)i) << 3;
+			out.x[i] = HashSigned(key) * emitter.extent.x + emitter.position.x;
+			out.y[i] = HashSigned(key + 1) * emitter.extent.y + emitter.position.y;
+			out.z[i] = HashSigned(key + 2) * emitter.extent.z + emitter.position.z;
+			out.vx[i] = HashSigned(key + 3) * emitter.spread.x + emitter.velocity.x;
+			out.vy[i] = HashSigned(key + 4) * emitter.spread.y + emitter.velocity.y;
+			out.vz[i] = HashSigned(key + 5) * emitter.spread.z + emitter.velocity.z;
+			out.age[i] = 0.f;
+			out.life[i] = HashSigned(key + 6) * lifeRange + emitter.life;
+		}
+	}
+
+	size_t IntegrateParticlesScalar(const ParticleStep& step, const ParticleSoA& particles, size_t count)
+	{
+		glm::vec3 gravity = step.gravity * step.dt;
+		float damping = step.Damping();
+
+		size_t dead = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float vx = (particles.vx[i] + gravity.x) * damping;
+			float vy = (particles.vy[i] + gravity.y) * damping;
+			float vz = (particles.vz[i] + gravity.z) * damping;
+			particles.vx[i] = vx;
+			particles.vy[i] = vy;
+			particles.vz[i] = vz;
+			particles.x[i] += vx * step.dt;
+			particles.y[i] += vy * step.dt;
+			particles.z[i] += vz * step.dt;
+
+			float age = particles.age[i] + step.dt;
+			particles.age[i] = age;
+			dead += !(age < particles.life[i]);
+		}
+		return dead;
+	}
+
+	void PackParticlesScalar(const ParticleSoA& particles, glm::vec4* out, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::vec4(particles.x[i], particles.y[i], particles.z[i], particles.age[i] / particles.life[i]);
+	}
+
+	// One xoshiro128** step of every lane
+	static void RandomStep(RandomState& state, uint32_t* out)
+	{
+		for (int j = 0; j < RANDOM_LANES; ++j)
+		{
+			uint32_t s0 = state.s[0][j], s1 = state.s[1][j], s2 = state.s[2][j], s3 = state.s[3][j];
+			uint32_t x = s1 * 5;
+			out[j] = ((x << 7) | (x >> 25)) * 9;
+
+			uint32_t t = s1 << 9;
+			s2 ^= s0;
+			s3 ^= s1;
+			s1 ^= s2;
+			s0 ^= s3;
+			s2 ^= t;
+			state.s[0][j] = s0;
+			state.s[1][j] = s1;
+			state.s[2][j] = s2;
+			state.s[3][j] = (s3 << 11) | (s3 >> 21);
+		}
+	}
+
+	// Top 24 bits as a float in [0, 1)
+	static float RandomUnit(uint32_t bits)
+	{
+		return (float)(bits >> 8) * (1.f / 16777216.f);
+	}
+
+	void RandomBitsScalar(RandomState& state, uint32_t* out, size_t count)
+	{
+		uint32_t bits[RANDOM_LANES];
+		for (size_t i = 0; i < count; i += RANDOM_LANES)
+		{
+			RandomStep(state, bits);
+			std::copy(bits, bits + std::min(count - i, (size_t)RANDOM_LANES), out + i);
+		}
+	}
+
+	void RandomUniformScalar(RandomState& state, float low, float high, float* out, size_t count)
+	{
+		uint32_t bits[RANDOM_LANES];
+		float range = high - low;
+		for (size_t i = 0; i < count; i += RANDOM_LANES)
+		{
+			RandomStep(state, bits);
+			for (size_t j = 0, n = std::min(count - i, (size_t)RANDOM_LANES); j < n; ++j)
+				out[i + j] = RandomUnit(bits[j]) * range + low;
+		}
+	}
+
+	void RandomGaussianScalar(RandomState& state, float mean, float deviation, float* out, size_t count)
+	{
+		// Box-Muller, two steps give RANDOM_LANES pairs: the cosines, then the sines
+		uint32_t u[RANDOM_LANES], v[RANDOM_LANES];
+		float pairs[2 * RANDOM_LANES];
+		for (size_t i = 0; i < count; i += 2 * RANDOM_LANES)
+		{
+			RandomStep(state, u);
+			RandomStep(state, v);
+			for (int j = 0; j < RANDOM_LANES; ++j)
+			{
+				// u in (0, 1] keeps the log finite
+				float r = std::sqrt(-2.f * FastTrig::Log((float)((u[j] >> 8) + 1) * (1.f / 16777216.f))) * deviation;
+				float s, c;
+				FastTrig::SinCos(RandomUnit(v[j]) * FastTrig::TWO_PI, s, c);
+				pairs[j] = r * c + mean;
+				pairs[RANDOM_LANES + j] = r * s + mean;
+			}
+			std::copy(pairs, pairs + std::min(count - i, (size_t)(2 * RANDOM_LANES)), out + i);
+		}
+	}
+
+	void RandomSphereScalar(RandomState& state, float radius, float* x, float* y, float* z, size_t count)
+	{
+		uint32_t u[RANDOM_LANES], v[RANDOM_LANES];
+		for (size_t i = 0; i < count; i += RANDOM_LANES)
+		{
+			RandomStep(state, u);
+			RandomStep(state, v);
+			for (size_t j = 0, n = std::min(count - i, (size_t)RANDOM_LANES); j < n; ++j)
+			{
+				// z uniform in [-1, 1] and a uniform angle around it cover the sphere evenly
+				float height = 1.f - 2.f * RandomUnit(u[j]);
+				float ring = std::sqrt(std::max(0.f, 1.f - height * height)) * radius;
+				float s, c;
+				FastTrig::SinCos(RandomUnit(v[j]) * FastTrig::TWO_PI, s, c);
+				x[i + j] = ring * c;
+				y[i + j] = ring * s;
+				z[i + j] = height * radius;
+			}
+		}
+	}
+
+	void RandomDiskScalar(RandomState& state, float radius, float* x, float* y, size_t count)
+	{
+		uint32_t u[RANDOM_LANES], v[RANDOM_LANES];
+		for (size_t i = 0; i < count; i += RANDOM_LANES)
+		{
+			RandomStep(state, u);
+			RandomStep(state, v);
+			for (size_t j = 0, n = std::min(count - i, (size_t)RANDOM_LANES); j < n; ++j)
+			{
+				float r = std::sqrt(RandomUnit(u[j])) * radius;
+				float s, c;
+				FastTrig::SinCos(RandomUnit(v[j]) * FastTrig::TWO_PI, s, c);
+				x[i + j] = r * c;
+				y[i + j] = r * s;
+			}
+		}
+	}
+
+	// Indexed by SimdLevel
+	#define BATCH_MATH_KERNELS(LEVEL, SUFFIX) { LEVEL, TransformPoints##SUFFIX, TransformVectors##SUFFIX, TransformPointsSoA##SUFFIX, \
+		TransformVectorsSoA##SUFFIX, MultiplyMatrices##SUFFIX, ComposeTRS##SUFFIX, InvertMatrices##SUFFIX, \
+		ComposeAffine##SUFFIX, MultiplyAffine##SUFFIX, InvertAffine##SUFFIX, InvertRigid##SUFFIX, NormalMatrices##SUFFIX, \
+		SinCos##SUFFIX, Atan2##SUFFIX, Acos##SUFFIX, Log##SUFFIX, AxisAngleToQuat##SUFFIX, \
+		NlerpQuats##SUFFIX, SlerpQuats##SUFFIX, BlendQuats##SUFFIX, QuatsToMatrices##SUFFIX, \
+		ComposeAffineSoA##SUFFIX, SkinLinear##SUFFIX, SkinDualQuat##SUFFIX, UnpackQuats##SUFFIX, BlendQuantized##SUFFIX, \
+		Perlin2##SUFFIX, Perlin3##SUFFIX, Simplex2##SUFFIX, Simplex3##SUFFIX, \
+		IntersectRayTriangles##SUFFIX, IntersectRaysTriangle##SUFFIX, IntersectRayBoxes##SUFFIX, IntersectRaysBox##SUFFIX, \
+		PackHalf##SUFFIX, UnpackHalf##SUFFIX, PackSnorm16##SUFFIX, UnpackSnorm16##SUFFIX, \
+		PackSnorm3x10_1x2##SUFFIX, UnpackSnorm3x10_1x2##SUFFIX, PackF2x11_1x10##SUFFIX, UnpackF2x11_1x10##SUFFIX, \
+		EmitParticles##SUFFIX, IntegrateParticles##SUFFIX, PackParticles##SUFFIX, \
+		RandomBits##SUFFIX, RandomUniform##SUFFIX, RandomGaussian##SUFFIX, RandomSphere##SUFFIX, RandomDisk##SUFFIX }
+
+	static const Kernels kernelTable[] =
+	{
+		BATCH_MATH_KERNELS(SIMD_SCALAR, Scalar),
+#if SIMD_X86
+		BATCH_MATH_KERNELS(SIMD_SSE4, SSE4),
+		BATCH_MATH_KERNELS(SIMD_AVX2, AVX2),
+		BATCH_MATH_KERNELS(SIMD_AVX512, AVX512),
+#endif
+	};
+
+	#undef BATCH_MATH_KERNELS
+
+	static const int kernelTableSize = (int)(sizeof(kernelTable) / sizeof(kernelTable[0]));
+
+	// Constant-initialised, so calls made from other static constructors still work
+	static const Kernels* active = &kernelTable[SIMD_SCALAR];
+
+	static struct ResolveAtStartup
+	{
+		ResolveAtStartup() { SelectLevel(SIMD_AVX512); }
+	} resolveAtStartup;
+
+	const Kernels* GetKernels(SimdLevel level)
+	{
+		return level >= 0 && level < kernelTableSize ? &kernelTable[level] : nullptr;
+	}
+
+	SimdLevel GetActiveLevel()
+	{
+		return active->level;
+	}
+
+	SimdLevel SelectLevel(SimdLevel maxLevel)
+	{
+		int level = GetCpuFeatures().BestLevel();
+		if (level > maxLevel)
+			level = maxLevel;
+		if (level >= kernelTableSize)
+			level = kernelTableSize - 1;
+
+		active = &kernelTable[level];
+		return active->level;
+	}
+
+	void TransformPoints(const glm::mat4& m, const glm::vec3* in, glm::vec3* out, size_t count)
+	{
+		active->transformPoints(m, in, out, count);
+	}
+
+	void TransformVectors(const glm::mat4& m, const glm::vec4* in, glm::vec4* out, size_t count)
+	{
+		active->transformVectors(m, in, out, count);
+	}
+
+	void TransformPointsSoA(const glm::mat4& m, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count)
+	{
+		active->transformPointsSoA(m, x, y, z, outX, outY, outZ, count);
+	}
+
+	void TransformVectorsSoA(const glm::mat4& m, const float* x, const float* y, const float* z, const float* w,
+		float* outX, float* outY, float* outZ, float* outW, size_t count)
+	{
+		active->transformVectorsSoA(m, x, y, z, w, outX, outY, outZ, outW, count);
+	}
+
+	void MultiplyMatrices(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+	{
+		active->multiplyMatrices(a, b, out, count);
+	}
+
+	void ComposeTRS(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, glm::mat4* out, size_t count)
+	{
+		active->composeTRS(t, r, s, out, count);
+	}
+
+	void InvertMatrices(const glm::mat4* in, glm::mat4* out, size_t count)
+	{
+		active->invertMatrices(in, out, count);
+	}
+
+	void ComposeAffine(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, Affine3x4* out, size_t count)
+	{
+		active->composeAffine(t, r, s, out, count);
+	}
+
+	void MultiplyAffine(const Affine3x4* a, const Affine3x4* b, Affine3x4* out, size_t count)
+	{
+		active->multiplyAffine(a, b, out, count);
+	}
+
+	void InvertAffine(const Affine3x4* in, Affine3x4* out, size_t count)
+	{
+		active->invertAffine(in, out, count);
+	}
+
+	void InvertRigid(const Affine3x4* in, Affine3x4* out, size_t count)
+	{
+		active->invertRigid(in, out, count);
+	}
+
+	void NormalMatrices(const glm::mat4* models, glm::mat3* out, size_t count)
+	{
+		active->normalMatrices(models, out, count);
+	}
+
+	void SinCos(const float* angles, float* s, float* c, size_t count)
+	{
+		active->sinCos(angles, s, c, count);
+	}
+
+	void Atan2(const float* y, const float* x, float* out, size_t count)
+	{
+		active->atan2(y, x, out, count);
+	}
+
+	void Acos(const float* x, float* out, size_t count)
+	{
+		active->acos(x, out, count);
+	}
+
+	void Log(const float* x, float* out, size_t count)
+	{
+		active->log(x, out, count);
+	}
+
+	void AxisAngleToQuat(const glm::vec3* axes, const float* angles, glm::quat* out, size_t count)
+	{
+		active->axisAngleToQuat(axes, angles, out, count);
+	}
+
+	void NlerpQuats(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count)
+	{
+		active->nlerpQuats(a, b, t, out, count);
+	}
+
+	void SlerpQuats(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count)
+	{
+		active->slerpQuats(a, b, t, out, count);
+	}
+
+	void BlendQuats(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t count)
+	{
+		active->blendQuats(poses, weights, poseCount, out, count);
+	}
+
+	void QuatsToMatrices(const QuatSoA& q, glm::mat4* out, size_t count)
+	{
+		active->quatsToMatrices(q, out, count);
+	}
+
+	void ComposeAffineSoA(const glm::vec3* t, const QuatSoA& r, const glm::vec3* s, Affine3x4* out, size_t count)
+	{
+		active->composeAffineSoA(t, r, s, out, count);
+	}
+
+	void SkinLinear(const Affine3x4* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count)
+	{
+		active->skinLinear(palette, in, out, count);
+	}
+
+	void SkinDualQuat(const glm::dualquat* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count)
+	{
+		active->skinDualQuat(palette, in, out, count);
+	}
+
+	void UnpackQuats(const uint16_t* a, const uint16_t* b, const uint16_t* c, const QuatSoA& out, size_t count)
+	{
+		active->unpackQuats(a, b, c, out, count);
+	}
+
+	void BlendQuantized(const uint16_t* const* keys, const float* weights, const float* offset, const float* scale,
+		float* out, size_t count)
+	{
+		active->blendQuantized(keys, weights, offset, scale, out, count);
+	}
+
+	void Perlin2(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count)
+	{
+		active->perlin2(x, y, fbm, out, count);
+	}
+
+	void Perlin3(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count)
+	{
+		active->perlin3(x, y, z, fbm, out, count);
+	}
+
+	void Simplex2(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count)
+	{
+		active->simplex2(x, y, fbm, out, count);
+	}
+
+	void Simplex3(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count)
+	{
+		active->simplex3(x, y, z, fbm, out, count);
+	}
+
+	void IntersectRayTriangles(const glm::vec3& origin, const glm::vec3& direction, float tMax, const TriangleSoA& triangles,
+		float* t, float* u, float* v, size_t count)
+	{
+		active->intersectRayTriangles(origin, direction, tMax, triangles, t, u, v, count);
+	}
+
+	void IntersectRaysTriangle(const RaySoA& rays, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+		float* t, float* u, float* v, size_t count)
+	{
+		active->intersectRaysTriangle(rays, v0, v1, v2, t, u, v, count);
+	}
+
+	void IntersectRayBoxes(const glm::vec3& origin, const glm::vec3& invDirection, float tMax, const BoxSoA& boxes,
+		float* tNear, size_t count)
+	{
+		active->intersectRayBoxes(origin, invDirection, tMax, boxes, tNear, count);
+	}
+
+	void IntersectRaysBox(const RaySoA& rays, const glm::vec3& boxMin, const glm::vec3& boxMax, float* tNear, size_t count)
+	{
+		active->intersectRaysBox(rays, boxMin, boxMax, tNear, count);
+	}
+
+	void PackHalf(const float* in, uint16_t* out, size_t count)
+	{
+		active->packHalf(in, out, count);
+	}
+
+	void UnpackHalf(const uint16_t* in, float* out, size_t count)
+	{
+		active->unpackHalf(in, out, count);
+	}
+
+	void PackSnorm16(const float* in, uint16_t* out, size_t count)
+	{
+		active->packSnorm16(in, out, count);
+	}
+
+	void UnpackSnorm16(const uint16_t* in, float* out, size_t count)
+	{
+		active->unpackSnorm16(in, out, count);
+	}
+
+	void PackSnorm3x10_1x2(const glm::vec4* in, uint32_t* out, size_t count)
+	{
+		active->packSnorm3x10_1x2(in, out, count);
+	}
+
+	void UnpackSnorm3x10_1x2(const uint32_t* in, glm::vec4* out, size_t count)
+	{
+		active->unpackSnorm3x10_1x2(in, out, count);
+	}
+
+	void PackF2x11_1x10(const glm::vec3* in, uint32_t* out, size_t count)
+	{
+		active->packF2x11_1x10(in, out, count);
+	}
+
+	void UnpackF2x11_1x10(const uint32_t* in, glm::vec3* out, size_t count)
+	{
+		active->unpackF2x11_1x10(in, out, count);
+	}
+
+	void EmitParticles(const ParticleEmitter& emitter, uint32_t sequence, const ParticleSoA& out, size_t count)
+	{
+		active->emitParticles(emitter, sequence, out, count);
+	}
+
+	size_t IntegrateParticles(const ParticleStep& step, const ParticleSoA& particles, size_t count)
+	{
+		return active->integrateParticles(step, particles, count);
+	}
+
+	void PackParticles(const ParticleSoA& particles, glm::vec4* out, size_t count)
+	{
+		active->packParticles(particles, out, count);
+	}
+
+	void RandomBits(RandomState& state, uint32_t* out, size_t count)
+	{
+		active->randomBits(state, out, count);
+	}
+
+	void RandomUniform(RandomState& state, float low, float high, float* out, size_t count)
+	{
+		active->randomUniform(state, low, high, out, count);
+	}
+
+	void RandomGaussian(RandomState& state, float mean, float deviation, float* out, size_t count)
+	{
+		active->randomGaussian(state, mean, deviation, out, count);
+	}
+
+	void RandomSphere(RandomState& state, float radius, float* x, float* y, float* z, size_t count)
+	{
+		active->randomSphere(state, radius, x, y, z, count);
+	}
+
+	void RandomDisk(RandomState& state, float radius, float* x, float* y, size_t count)
+	{
+		active->randomDisk(state, radius, x, y, count);
+	}
+}
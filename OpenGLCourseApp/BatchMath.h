@@ -0,0 +1,440 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "FastTrig.h"
+#include "Quantize.h"
+#include "Simd.h"
+#include "Skinning.h"
+#include "Transform.h"
+
+/**	Batch transform kernels
+ *
+ *	GLM's SIMD layer works on one matrix or vector per call. These functions run a
+ *	whole array through a single call so the loads, broadcasts and stores stream.
+ *
+ *	Two layouts are supported:
+ *		AoS streaming - plain glm arrays (vec3 is 12 bytes, 4/8/16 of them are
+ *						transposed in registers per iteration)
+ *		SoA			  - one float array per component, the fastest form
+ *
+ *	Points are transformed as m * vec4(p, 1) without the perspective divide, like
+ *	glm::vec3(m * glm::vec4(p, 1.f)). Input and output may be the same array.
+ *	ComposeTRS builds translate(t) * mat4_cast(r) * scale(s); r must be unit length.
+ *	ComposeAffine builds the same transform as an Affine3x4, and MultiplyAffine is
+ *	a * b on those (27 multiplies instead of 64). InvertAffine, InvertRigid and
+ *	NormalMatrices match the Transform versions of the same name.
+ *
+ *	SinCos, Atan2, Acos and Log evaluate the FastTrig polynomials (error bounds there)
+ *	on whole registers. AxisAngleToQuat builds rotations from unit axes through them.
+ *
+ *	ComposeAffineSoA is ComposeAffine with the rotations in a QuatSoA, the form the
+ *	quaternion blends below produce.
+ *
+ *	SkinLinear and SkinDualQuat match the Skinning versions of the same name; the
+ *	dual quaternion palette comes from Skinning::ToDualQuat.
+ *
+ *	The quaternion blends work on QuatSoA streams and take the shortest path. Nlerp
+ *	and Blend renormalise the result; Slerp corrects t before an nlerp, which keeps
+ *	the rotation within 8e-4 rad (0.045 degrees) of an exact slerp, twice the
+ *	error on the quaternion arc. Blend weights are per pose and need not sum to
+ *	one. None of them allocate.
+ *
+ *	UnpackQuats decodes Quantize's 48-bit smallest three quaternions from three
+ *	word arrays. BlendQuantized dequantises four arrays of 16-bit ranged values
+ *	and blends them in one pass: out = offset + scale * sum(weights[k] * keys[k]),
+ *	with scale = Quantize::RangeScale(extent); weights that sum to one (lerp or
+ *	spline basis weights) blend the decoded values.
+ *
+ *	Perlin2/3 and Simplex2/3 are glm::perlin and glm::simplex summed over fBm
+ *	octaves in one pass: out = sum over o of gain^o * noise(p * frequency * lacunarity^o).
+ *	They follow GLM's arithmetic step for step: SSE4.1 matches it exactly, the FMA
+ *	levels stay within 1e-4.
+ *	Noise.h fills grids and point arrays with them across job threads.
+ *
+ *	The intersection tests run either one ray against an SoA array of triangles
+ *	or boxes, or an SoA array of rays (a packet of KERNEL_WIDTH per iteration)
+ *	against one triangle or box. Triangles use Moller-Trumbore like
+ *	glm::intersectRayTriangle, with the same determinant epsilon, but only hits
+ *	with t in [0, tMax] count. Boxes use slab tests on the reciprocal direction and
+ *	report where the ray enters, clamped to 0 when it starts inside. Misses are
+ *	+inf in t / tNear; u and v are the barycentrics of corners 1 and 2 and only
+ *	mean anything on a hit.
+ *
+ *	The packing functions convert whole arrays to and from the gtc/packing.hpp
+ *	formats and match GLM bit for bit, one call of it per element: PackHalf /
+ *	UnpackHalf are packHalf1x16 / unpackHalf1x16 (an array of vec4 read as floats
+ *	comes out as packHalf4x16), PackSnorm16 / UnpackSnorm16 the same for
+ *	packSnorm1x16, and the 10-10-10-2 and 11-11-10 forms take a vec4 / vec3 per
+ *	word. That includes GLM's rounding, which takes half-float ties away from zero
+ *	rather than to even (the F16C kernels adjust ties before converting), and the
+ *	quirks of unpackF2x11_1x10: 0, Inf and NaN are only recognised in a field when
+ *	every field above it is 0, and Inf and NaN decode as -1. Snorm results for NaN
+ *	inputs are unspecified; GLM's own float to int conversion of them is undefined.
+ *
+ *	InvertMatrices is a general cofactor inverse; singular input gives inf/NaN like
+ *	glm::inverse.
+ *
+ *	The particle kernels work on a ParticleSoA. EmitParticles fills new particles
+ *	from an emitter, its random numbers hashed from sequence + index, so a range
+ *	gives the same particles (to FMA rounding) however it is split into calls.
+ *	IntegrateParticles is one explicit Euler step with gravity and linear drag that
+ *	also ages the particles and returns how many have outlived their life
+ *	(age >= life). PackParticles writes vec4(x, y, z, age / life) per particle for
+ *	instanced drawing.
+ *
+ *	The random fills advance a RandomState: RANDOM_LANES xoshiro128** generators
+ *	side by side, one per 32-bit lane, so one step gives RANDOM_LANES numbers at
+ *	every level (4 steps of SSE registers, 2 of AVX2, 1 of AVX-512) and every level
+ *	returns the same sequence, to FMA rounding. A call consumes whole steps and
+ *	drops what it doesn't use of the last one. RandomUniform is in [low, high),
+ *	RandomGaussian is Box-Muller (FastTrig's log, sin and cos), RandomSphere is on
+ *	the sphere like glm::sphericalRand and RandomDisk inside the disk like
+ *	glm::diskRand. Random.h seeds the state and splits it into streams.
+ *
+ *	Every function exists as a scalar reference and SSE4.1 / AVX2 / AVX-512 kernels.
+ *	The unsuffixed entry points call through a kernel table that is picked once at
+ *	startup from the host's CPU features, so a baseline (SSE2) build still runs the
+ *	widest kernels the machine has.
+ */
+
+namespace BatchMath
+{
+	// Quaternion i is (x[i], y[i], z[i], w[i]). Inputs are only read through these.
+	struct QuatSoA
+	{
+		float* x;
+		float* y;
+		float* z;
+		float* w;
+
+		QuatSoA Offset(size_t i) const
+		{
+			QuatSoA result = { x + i, y + i, z + i, w + i };
+			return result;
+		}
+	};
+
+	// Ray i is (ox, oy, oz)[i] + t * (dx, dy, dz)[i], t in [0, tMax[i]]. invDx..invDz hold
+	// 1 / direction for the box tests; triangle tests never read them, box tests never read dx..dz
+	struct RaySoA
+	{
+		float* ox;
+		float* oy;
+		float* oz;
+		float* dx;
+		float* dy;
+		float* dz;
+		float* invDx;
+		float* invDy;
+		float* invDz;
+		float* tMax;
+
+		RaySoA Offset(size_t i) const
+		{
+			RaySoA result = { ox + i, oy + i, oz + i, dx + i, dy + i, dz + i, invDx + i, invDy + i, invDz + i, tMax + i };
+			return result;
+		}
+	};
+
+	// Triangle i has corners (x0, y0, z0)[i], (x1, y1, z1)[i] and (x2, y2, z2)[i]
+	struct TriangleSoA
+	{
+		float* x0;
+		float* y0;
+		float* z0;
+		float* x1;
+		float* y1;
+		float* z1;
+		float* x2;
+		float* y2;
+		float* z2;
+
+		TriangleSoA Offset(size_t i) const
+		{
+			TriangleSoA result = { x0 + i, y0 + i, z0 + i, x1 + i, y1 + i, z1 + i, x2 + i, y2 + i, z2 + i };
+			return result;
+		}
+	};
+
+	// Box i spans (minX, minY, minZ)[i] to (maxX, maxY, maxZ)[i]
+	struct BoxSoA
+	{
+		float* minX;
+		float* minY;
+		float* minZ;
+		float* maxX;
+		float* maxY;
+		float* maxZ;
+
+		BoxSoA Offset(size_t i) const
+		{
+			BoxSoA result = { minX + i, minY + i, minZ + i, maxX + i, maxY + i, maxZ + i };
+			return result;
+		}
+	};
+
+	// xoshiro128** generator j is (s[0][j], s[1][j], s[2][j], s[3][j])
+	const int RANDOM_LANES = 16;
+	struct RandomState
+	{
+		uint32_t s[4][RANDOM_LANES];
+	};
+
+	// Particle i is at (x, y, z)[i], moving at (vx, vy, vz)[i], age[i] seconds into a life of life[i] seconds
+	struct ParticleSoA
+	{
+		float* x;
+		float* y;
+		float* z;
+		float* vx;
+		float* vy;
+		float* vz;
+		float* age;
+		float* life;
+
+		ParticleSoA Offset(size_t i) const
+		{
+			ParticleSoA result = { x + i, y + i, z + i, vx + i, vy + i, vz + i, age + i, life + i };
+			return result;
+		}
+	};
+
+	// New particles start uniformly inside position +- extent with velocity +- spread per
+	// axis, living life * (1 +- lifeVariation) seconds
+	struct ParticleEmitter
+	{
+		glm::vec3 position;
+		glm::vec3 extent;
+		glm::vec3 velocity;
+		glm::vec3 spread;
+		float life;
+		float lifeVariation;
+	};
+
+	// v = (v + gravity * dt) * Damping(), then p += v * dt
+	struct ParticleStep
+	{
+		glm::vec3 gravity;
+		float drag;				// Fraction of the velocity lost per second
+		float dt;
+
+		float Damping() const { return drag * dt < 1.f ? 1.f - drag * dt : 0.f; }
+	};
+
+	// Fractal sum of noise octaves; octaves = 1, frequency = 1 is the plain noise
+	struct FbmSettings
+	{
+		int octaves;
+		float frequency;
+		float lacunarity;		// Frequency multiplier per octave
+		float gain;				// Amplitude multiplier per octave, the first is 1
+	};
+
+	// Entry points
+	void TransformPoints(const glm::mat4& m, const glm::vec3* in, glm::vec3* out, size_t count);
+	void TransformVectors(const glm::mat4& m, const glm::vec4* in, glm::vec4* out, size_t count);
+	void TransformPointsSoA(const glm::mat4& m, const float* x, const float* y, const float* z,
+		float* outX, float* outY, float* outZ, size_t count);
+	void TransformVectorsSoA(const glm::mat4& m, const float* x, const float* y, const float* z, const float* w,
+		float* outX, float* outY, float* outZ, float* outW, size_t count);
+	void MultiplyMatrices(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count);
+	void ComposeTRS(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, glm::mat4* out, size_t count);
+	void InvertMatrices(const glm::mat4* in, glm::mat4* out, size_t count);
+	void ComposeAffine(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, Affine3x4* out, size_t count);
+	void MultiplyAffine(const Affine3x4* a, const Affine3x4* b, Affine3x4* out, size_t count);
+	void InvertAffine(const Affine3x4* in, Affine3x4* out, size_t count);
+	void InvertRigid(const Affine3x4* in, Affine3x4* out, size_t count);
+	void NormalMatrices(const glm::mat4* models, glm::mat3* out, size_t count);
+	void SinCos(const float* angles, float* s, float* c, size_t count);
+	void Atan2(const float* y, const float* x, float* out, size_t count);
+	void Acos(const float* x, float* out, size_t count);
+	void Log(const float* x, float* out, size_t count);
+	void AxisAngleToQuat(const glm::vec3* axes, const float* angles, glm::quat* out, size_t count);
+	void NlerpQuats(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count);
+	void SlerpQuats(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count);
+	void BlendQuats(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t count);
+	void QuatsToMatrices(const QuatSoA& q, glm::mat4* out, size_t count);
+	void ComposeAffineSoA(const glm::vec3* t, const QuatSoA& r, const glm::vec3* s, Affine3x4* out, size_t count);
+	void SkinLinear(const Affine3x4* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count);
+	void SkinDualQuat(const glm::dualquat* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count);
+	void UnpackQuats(const uint16_t* a, const uint16_t* b, const uint16_t* c, const QuatSoA& out, size_t count);
+	void BlendQuantized(const uint16_t* const* keys, const float* weights, const float* offset, const float* scale,
+		float* out, size_t count);
+	void Perlin2(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count);
+	void Perlin3(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count);
+	void Simplex2(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count);
+	void Simplex3(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count);
+	void IntersectRayTriangles(const glm::vec3& origin, const glm::vec3& direction, float tMax, const TriangleSoA& triangles,
+		float* t, float* u, float* v, size_t count);
+	void IntersectRaysTriangle(const RaySoA& rays, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+		float* t, float* u, float* v, size_t count);
+	void IntersectRayBoxes(const glm::vec3& origin, const glm::vec3& invDirection, float tMax, const BoxSoA& boxes,
+		float* tNear, size_t count);
+	void IntersectRaysBox(const RaySoA& rays, const glm::vec3& boxMin, const glm::vec3& boxMax, float* tNear, size_t count);
+	void PackHalf(const float* in, uint16_t* out, size_t count);
+	void UnpackHalf(const uint16_t* in, float* out, size_t count);
+	void PackSnorm16(const float* in, uint16_t* out, size_t count);
+	void UnpackSnorm16(const uint16_t* in, float* out, size_t count);
+	void PackSnorm3x10_1x2(const glm::vec4* in, uint32_t* out, size_t count);
+	void UnpackSnorm3x10_1x2(const uint32_t* in, glm::vec4* out, size_t count);
+	void PackF2x11_1x10(const glm::vec3* in, uint32_t* out, size_t count);
+	void UnpackF2x11_1x10(const uint32_t* in, glm::vec3* out, size_t count);
+	void EmitParticles(const ParticleEmitter& emitter, uint32_t sequence, const ParticleSoA& out, size_t count);
+	size_t IntegrateParticles(const ParticleStep& step, const ParticleSoA& particles, size_t count);
+	void PackParticles(const ParticleSoA& particles, glm::vec4* out, size_t count);
+	void RandomBits(RandomState& state, uint32_t* out, size_t count);
+	void RandomUniform(RandomState& state, float low, float high, float* out, size_t count);
+	void RandomGaussian(RandomState& state, float mean, float deviation, float* out, size_t count);
+	void RandomSphere(RandomState& state, float radius, float* x, float* y, float* z, size_t count);
+	void RandomDisk(RandomState& state, float radius, float* x, float* y, size_t count);
+
+	// One instruction set's kernels
+	struct Kernels
+	{
+		SimdLevel level;
+		void (*transformPoints)(const glm::mat4& m, const glm::vec3* in, glm::vec3* out, size_t count);
+		void (*transformVectors)(const glm::mat4& m, const glm::vec4* in, glm::vec4* out, size_t count);
+		void (*transformPointsSoA)(const glm::mat4& m, const float* x, const float* y, const float* z,
+			float* outX, float* outY, float* outZ, size_t count);
+		void (*transformVectorsSoA)(const glm::mat4& m, const float* x, const float* y, const float* z, const float* w,
+			float* outX, float* outY, float* outZ, float* outW, size_t count);
+		void (*multiplyMatrices)(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count);
+		void (*composeTRS)(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, glm::mat4* out, size_t count);
+		void (*invertMatrices)(const glm::mat4* in, glm::mat4* out, size_t count);
+		void (*composeAffine)(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, Affine3x4* out, size_t count);
+		void (*multiplyAffine)(const Affine3x4* a, const Affine3x4* b, Affine3x4* out, size_t count);
+		void (*invertAffine)(const Affine3x4* in, Affine3x4* out, size_t count);
+		void (*invertRigid)(const Affine3x4* in, Affine3x4* out, size_t count);
+		void (*normalMatrices)(const glm::mat4* models, glm::mat3* out, size_t count);
+		void (*sinCos)(const float* angles, float* s, float* c, size_t count);
+		void (*atan2)(const float* y, const float* x, float* out, size_t count);
+		void (*acos)(const float* x, float* out, size_t count);
+		void (*log)(const float* x, float* out, size_t count);
+		void (*axisAngleToQuat)(const glm::vec3* axes, const float* angles, glm::quat* out, size_t count);
+		void (*nlerpQuats)(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count);
+		void (*slerpQuats)(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count);
+		void (*blendQuats)(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t count);
+		void (*quatsToMatrices)(const QuatSoA& q, glm::mat4* out, size_t count);
+		void (*composeAffineSoA)(const glm::vec3* t, const QuatSoA& r, const glm::vec3* s, Affine3x4* out, size_t count);
+		void (*skinLinear)(const Affine3x4* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count);
+		void (*skinDualQuat)(const glm::dualquat* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count);
+		void (*unpackQuats)(const uint16_t* a, const uint16_t* b, const uint16_t* c, const QuatSoA& out, size_t count);
+		void (*blendQuantized)(const uint16_t* const* keys, const float* weights, const float* offset, const float* scale,
+			float* out, size_t count);
+		void (*perlin2)(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count);
+		void (*perlin3)(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count);
+		void (*simplex2)(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count);
+		void (*simplex3)(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count);
+		void (*intersectRayTriangles)(const glm::vec3& origin, const glm::vec3& direction, float tMax, const TriangleSoA& triangles,
+			float* t, float* u, float* v, size_t count);
+		void (*intersectRaysTriangle)(const RaySoA& rays, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+			float* t, float* u, float* v, size_t count);
+		void (*intersectRayBoxes)(const glm::vec3& origin, const glm::vec3& invDirection, float tMax, const BoxSoA& boxes,
+			float* tNear, size_t count);
+		void (*intersectRaysBox)(const RaySoA& rays, const glm::vec3& boxMin, const glm::vec3& boxMax, float* tNear, size_t count);
+		void (*packHalf)(const float* in, uint16_t* out, size_t count);
+		void (*unpackHalf)(const uint16_t* in, float* out, size_t count);
+		void (*packSnorm16)(const float* in, uint16_t* out, size_t count);
+		void (*unpackSnorm16)(const uint16_t* in, float* out, size_t count);
+		void (*packSnorm3x10_1x2)(const glm::vec4* in, uint32_t* out, size_t count);
+		void (*unpackSnorm3x10_1x2)(const uint32_t* in, glm::vec4* out, size_t count);
+		void (*packF2x11_1x10)(const glm::vec3* in, uint32_t* out, size_t count);
+		void (*unpackF2x11_1x10)(const uint32_t* in, glm::vec3* out, size_t count);
+		void (*emitParticles)(const ParticleEmitter& emitter, uint32_t sequence, const ParticleSoA& out, size_t count);
+		size_t (*integrateParticles)(const ParticleStep& step, const ParticleSoA& particles, size_t count);
+		void (*packParticles)(const ParticleSoA& particles, glm::vec4* out, size_t count);
+		void (*randomBits)(RandomState& state, uint32_t* out, size_t count);
+		void (*randomUniform)(RandomState& state, float low, float high, float* out, size_t count);
+		void (*randomGaussian)(RandomState& state, float mean, float deviation, float* out, size_t count);
+		void (*randomSphere)(RandomState& state, float radius, float* x, float* y, float* z, size_t count);
+		void (*randomDisk)(RandomState& state, float radius, float* x, float* y, size_t count);
+	};
+
+	// nullptr if the level is not compiled in; it may still be unsupported by the host
+	const Kernels* GetKernels(SimdLevel level);
+
+	// Level the entry points currently use
+	SimdLevel GetActiveLevel();
+
+	// Runs at startup with the widest level. Call again, before any worker threads
+	// use BatchMath, only to force a narrower level. Returns the level applied.
+	SimdLevel SelectLevel(SimdLevel maxLevel);
+
+	// Per-level kernels, only call the ones the CPU supports
+	#define BATCH_MATH_DECLARE_KERNELS(SUFFIX) \
+		void TransformPoints##SUFFIX(const glm::mat4& m, const glm::vec3* in, glm::vec3* out, size_t count); \
+		void TransformVectors##SUFFIX(const glm::mat4& m, const glm::vec4* in, glm::vec4* out, size_t count); \
+		void TransformPointsSoA##SUFFIX(const glm::mat4& m, const float* x, const float* y, const float* z, \
+			float* outX, float* outY, float* outZ, size_t count); \
+		void TransformVectorsSoA##SUFFIX(const glm::mat4& m, const float* x, const float* y, const float* z, const float* w, \
+			float* outX, float* outY, float* outZ, float* outW, size_t count); \
+		void MultiplyMatrices##SUFFIX(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count); \
+		void ComposeTRS##SUFFIX(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, glm::mat4* out, size_t count); \
+		void InvertMatrices##SUFFIX(const glm::mat4* in, glm::mat4* out, size_t count); \
+		void ComposeAffine##SUFFIX(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, Affine3x4* out, size_t count); \
+		void MultiplyAffine##SUFFIX(const Affine3x4* a, const Affine3x4* b, Affine3x4* out, size_t count); \
+		void InvertAffine##SUFFIX(const Affine3x4* in, Affine3x4* out, size_t count); \
+		void InvertRigid##SUFFIX(const Affine3x4* in, Affine3x4* out, size_t count); \
+		void NormalMatrices##SUFFIX(const glm::mat4* models, glm::mat3* out, size_t count); \
+		void SinCos##SUFFIX(const float* angles, float* s, float* c, size_t count); \
+		void Atan2##SUFFIX(const float* y, const float* x, float* out, size_t count); \
+		void Acos##SUFFIX(const float* x, float* out, size_t count); \
+		void Log##SUFFIX(const float* x, float* out, size_t count); \
+		void AxisAngleToQuat##SUFFIX(const glm::vec3* axes, const float* angles, glm::quat* out, size_t count); \
+		void NlerpQuats##SUFFIX(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count); \
+		void SlerpQuats##SUFFIX(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count); \
+		void BlendQuats##SUFFIX(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t count); \
+		void QuatsToMatrices##SUFFIX(const QuatSoA& q, glm::mat4* out, size_t count); \
+		void ComposeAffineSoA##SUFFIX(const glm::vec3* t, const QuatSoA& r, const glm::vec3* s, Affine3x4* out, size_t count); \
+		void SkinLinear##SUFFIX(const Affine3x4* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count); \
+		void SkinDualQuat##SUFFIX(const glm::dualquat* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count); \
+		void UnpackQuats##SUFFIX(const uint16_t* a, const uint16_t* b, const uint16_t* c, const QuatSoA& out, size_t count); \
+		void BlendQuantized##SUFFIX(const uint16_t* const* keys, const float* weights, const float* offset, const float* scale, \
+			float* out, size_t count); \
+		void Perlin2##SUFFIX(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count); \
+		void Perlin3##SUFFIX(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count); \
+		void Simplex2##SUFFIX(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count); \
+		void Simplex3##SUFFIX(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count); \
+		void IntersectRayTriangles##SUFFIX(const glm::vec3& origin, const glm::vec3& direction, float tMax, \
+			const TriangleSoA& triangles, float* t, float* u, float* v, size_t count); \
+		void IntersectRaysTriangle##SUFFIX(const RaySoA& rays, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, \
+			float* t, float* u, float* v, size_t count); \
+		void IntersectRayBoxes##SUFFIX(const glm::vec3& origin, const glm::vec3& invDirection, float tMax, const BoxSoA& boxes, \
+			float* tNear, size_t count); \
+		void IntersectRaysBox##SUFFIX(const RaySoA& rays, const glm::vec3& boxMin, const glm::vec3& boxMax, float* tNear, \
+			size_t count); \
+		void PackHalf##SUFFIX(const float* in, uint16_t* out, size_t count); \
+		void UnpackHalf##SUFFIX(const uint16_t* in, float* out, size_t count); \
+		void PackSnorm16##SUFFIX(const float* in, uint16_t* out, size_t count); \
+		void UnpackSnorm16##SUFFIX(const uint16_t* in, float* out, size_t count); \
+		void PackSnorm3x10_1x2##SUFFIX(const glm::vec4* in, uint32_t* out, size_t count); \
+		void UnpackSnorm3x10_1x2##SUFFIX(const uint32_t* in, glm::vec4* out, size_t count); \
+		void PackF2x11_1x10##SUFFIX(const glm::vec3* in, uint32_t* out, size_t count); \
+		void UnpackF2x11_1x10##SUFFIX(const uint32_t* in, glm::vec3* out, size_t count); \
+		void EmitParticles##SUFFIX(const ParticleEmitter& emitter, uint32_t sequence, const ParticleSoA& out, size_t count); \
+		size_t IntegrateParticles##SUFFIX(const ParticleStep& step, const ParticleSoA& particles, size_t count); \
+		void PackParticles##SUFFIX(const ParticleSoA& particles, glm::vec4* out, size_t count); \
+		void RandomBits##SUFFIX(RandomState& state, uint32_t* out, size_t count); \
+		void RandomUniform##SUFFIX(RandomState& state, float low, float high, float* out, size_t count); \
+		void RandomGaussian##SUFFIX(RandomState& state, float mean, float deviation, float* out, size_t count); \
+		void RandomSphere##SUFFIX(RandomState& state, float radius, float* x, float* y, float* z, size_t count); \
+		void RandomDisk##SUFFIX(RandomState& state, float radius, float* x, float* y, size_t count);
+
+	BATCH_MATH_DECLARE_KERNELS(Scalar)
+
+	// Scalar blend of items first..count-1, the SIMD kernels' tail
+	void BlendQuatsRange(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t first, size_t count);
+
+#if SIMD_X86
+	BATCH_MATH_DECLARE_KERNELS(SSE4)
+	BATCH_MATH_DECLARE_KERNELS(AVX2)
+	BATCH_MATH_DECLARE_KERNELS(AVX512)
+#endif
+
+	#undef BATCH_MATH_DECLARE_KERNELS
+}
@@ -0,0 +1,1851 @@
+/**	Batch math kernel bodies, included once per instruction set by BatchMathX86.cpp
+ *
+ *	Expects:
+ *		KERNEL_SUFFIX, KERNEL_TARGET, KERNEL_LANES (128-bit lanes per register)
+ *		V and the V_* operations used below, all of which stay inside 128-bit lanes
+ *		VI_LOADU16, which widens KERNEL_WIDTH consecutive words in order, and
+ *		VI_STOREU16, which narrows them back
+ *		KERNEL_F16C, and with it V_LOADHALF / V_STOREHALF for KERNEL_WIDTH halves
+ *
+ *	Lane k of a register always holds items 4k..4k+3 of the current block, so the
+ *	SSE shuffles work unchanged on the wider registers.
+ */
+
+#define KERNEL_NAME3(name, suffix) name##suffix
+#define KERNEL_NAME2(name, suffix) KERNEL_NAME3(name, suffix)
+#define KERNEL_NAME(name) KERNEL_NAME2(name, KERNEL_SUFFIX)
+#define KERNEL_WIDTH (4 * KERNEL_LANES)
+
+// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3  ->  x0..x3 | y0..y3 | z0..z3
+static inline KERNEL_TARGET void KERNEL_NAME(Deinterleave3)(V a0, V a1, V a2, V& x, V& y, V& z)
+{
+	x = V_PERMUTE(V_BLEND(V_BLEND(a0, a1, 0x4), a2, 0x2), _MM_SHUFFLE(1, 2, 3, 0));
+	y = V_PERMUTE(V_BLEND(V_BLEND(a0, a1, 0x9), a2, 0x4), _MM_SHUFFLE(2, 3, 0, 1));
+	z = V_PERMUTE(V_BLEND(V_BLEND(a0, a1, 0x2), a2, 0x9), _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(Interleave3)(V x, V y, V z, V& a0, V& a1, V& a2)
+{
+	x = V_PERMUTE(x, _MM_SHUFFLE(1, 2, 3, 0));
+	y = V_PERMUTE(y, _MM_SHUFFLE(2, 3, 0, 1));
+	z = V_PERMUTE(z, _MM_SHUFFLE(3, 0, 1, 2));
+	a0 = V_BLEND(V_BLEND(x, y, 0x2), z, 0x4);
+	a1 = V_BLEND(V_BLEND(y, z, 0x2), x, 0x4);
+	a2 = V_BLEND(V_BLEND(z, x, 0x2), y, 0x4);
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(Transpose4)(V& r0, V& r1, V& r2, V& r3)
+{
+	V t0 = V_UNPACKLO(r0, r1);
+	V t1 = V_UNPACKLO(r2, r3);
+	V t2 = V_UNPACKHI(r0, r1);
+	V t3 = V_UNPACKHI(r2, r3);
+	r0 = V_SHUFFLE(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	r1 = V_SHUFFLE(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	r2 = V_SHUFFLE(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	r3 = V_SHUFFLE(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// KERNEL_WIDTH matrices to one register per element, e[c][row]; lane k holds matrices 4k..4k+3
+static inline KERNEL_TARGET void KERNEL_NAME(LoadMatrices)(const glm::mat4* in, V e[4][4])
+{
+	for (int c = 0; c < 4; ++c)
+	{
+		for (int m = 0; m < 4; ++m)
+			e[c][m] = V_LOADLANES(&in[m][c][0], 64);
+		KERNEL_NAME(Transpose4)(e[c][0], e[c][1], e[c][2], e[c][3]);
+	}
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(StoreMatrices)(V e[4][4], glm::mat4* out)
+{
+	for (int c = 0; c < 4; ++c)
+	{
+		KERNEL_NAME(Transpose4)(e[c][0], e[c][1], e[c][2], e[c][3]);
+		for (int m = 0; m < 4; ++m)
+			V_STORELANES(&out[m][c][0], 64, e[c][m]);
+	}
+}
+
+// Same for Affine3x4, e[row][column]
+static inline KERNEL_TARGET void KERNEL_NAME(LoadAffines)(const Affine3x4* in, V e[3][4])
+{
+	for (int r = 0; r < 3; ++r)
+	{
+		for (int m = 0; m < 4; ++m)
+			e[r][m] = V_LOADLANES(&in[m].rows[r].x, 48);
+		KERNEL_NAME(Transpose4)(e[r][0], e[r][1], e[r][2], e[r][3]);
+	}
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(StoreAffines)(V e[3][4], Affine3x4* out)
+{
+	for (int r = 0; r < 3; ++r)
+	{
+		KERNEL_NAME(Transpose4)(e[r][0], e[r][1], e[r][2], e[r][3]);
+		for (int m = 0; m < 4; ++m)
+			V_STORELANES(&out[m].rows[r].x, 48, e[r][m]);
+	}
+}
+
+// c0 * v.xxxx + c1 * v.yyyy + c2 * v.zzzz + c3 * v.wwww per lane
+static inline KERNEL_TARGET V KERNEL_NAME(MulColumns)(V c0, V c1, V c2, V c3, V v)
+{
+	V r = V_MUL(c0, V_PERMUTE(v, 0x00));
+	r = V_MADD(c1, V_PERMUTE(v, 0x55), r);
+	r = V_MADD(c2, V_PERMUTE(v, 0xAA), r);
+	return V_MADD(c3, V_PERMUTE(v, 0xFF), r);
+}
+
+KERNEL_TARGET void KERNEL_NAME(TransformVectors)(const glm::mat4& m, const glm::vec4* in, glm::vec4* out, size_t count)
+{
+	V c0 = V_BROADCAST4(&m[0][0]);
+	V c1 = V_BROADCAST4(&m[1][0]);
+	V c2 = V_BROADCAST4(&m[2][0]);
+	V c3 = V_BROADCAST4(&m[3][0]);
+
+	size_t i = 0;
+	for (; i + KERNEL_LANES <= count; i += KERNEL_LANES)
+		V_STOREU(&out[i].x, KERNEL_NAME(MulColumns)(c0, c1, c2, c3, V_LOADU(&in[i].x)));
+
+	TransformVectorsScalar(m, in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(MultiplyMatrices)(const glm::mat4* a, const glm::mat4* b, glm::mat4* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		V a0 = V_BROADCAST4(&a[i][0][0]);
+		V a1 = V_BROADCAST4(&a[i][1][0]);
+		V a2 = V_BROADCAST4(&a[i][2][0]);
+		V a3 = V_BROADCAST4(&a[i][3][0]);
+
+		// KERNEL_LANES columns of b per step
+		for (int c = 0; c < 4; c += KERNEL_LANES)
+			V_STOREU(&out[i][c][0], KERNEL_NAME(MulColumns)(a0, a1, a2, a3, V_LOADU(&b[i][c][0])));
+	}
+}
+
+KERNEL_TARGET void KERNEL_NAME(TransformPointsSoA)(const glm::mat4& m, const float* x, const float* y, const float* z,
+	float* outX, float* outY, float* outZ, size_t count)
+{
+	V m00 = V_SET1(m[0][0]), m01 = V_SET1(m[0][1]), m02 = V_SET1(m[0][2]);
+	V m10 = V_SET1(m[1][0]), m11 = V_SET1(m[1][1]), m12 = V_SET1(m[1][2]);
+	V m20 = V_SET1(m[2][0]), m21 = V_SET1(m[2][1]), m22 = V_SET1(m[2][2]);
+	V m30 = V_SET1(m[3][0]), m31 = V_SET1(m[3][1]), m32 = V_SET1(m[3][2]);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V px = V_LOADU(x + i), py = V_LOADU(y + i), pz = V_LOADU(z + i);
+		V_STOREU(outX + i, V_MADD(m00, px, V_MADD(m10, py, V_MADD(m20, pz, m30))));
+		V_STOREU(outY + i, V_MADD(m01, px, V_MADD(m11, py, V_MADD(m21, pz, m31))));
+		V_STOREU(outZ + i, V_MADD(m02, px, V_MADD(m12, py, V_MADD(m22, pz, m32))));
+	}
+
+	TransformPointsSoAScalar(m, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(TransformVectorsSoA)(const glm::mat4& m, const float* x, const float* y, const float* z, const float* w,
+	float* outX, float* outY, float* outZ, float* outW, size_t count)
+{
+	V e[4][4];
+	for (int c = 0; c < 4; ++c)
+		for (int r = 0; r < 4; ++r)
+			e[c][r] = V_SET1(m[c][r]);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V px = V_LOADU(x + i), py = V_LOADU(y + i), pz = V_LOADU(z + i), pw = V_LOADU(w + i);
+		V_STOREU(outX + i, V_MADD(e[0][0], px, V_MADD(e[1][0], py, V_MADD(e[2][0], pz, V_MUL(e[3][0], pw)))));
+		V_STOREU(outY + i, V_MADD(e[0][1], px, V_MADD(e[1][1], py, V_MADD(e[2][1], pz, V_MUL(e[3][1], pw)))));
+		V_STOREU(outZ + i, V_MADD(e[0][2], px, V_MADD(e[1][2], py, V_MADD(e[2][2], pz, V_MUL(e[3][2], pw)))));
+		V_STOREU(outW + i, V_MADD(e[0][3], px, V_MADD(e[1][3], py, V_MADD(e[2][3], pz, V_MUL(e[3][3], pw)))));
+	}
+
+	TransformVectorsSoAScalar(m, x + i, y + i, z + i, w + i, outX + i, outY + i, outZ + i, outW + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(TransformPoints)(const glm::mat4& m, const glm::vec3* in, glm::vec3* out, size_t count)
+{
+	V m00 = V_SET1(m[0][0]), m01 = V_SET1(m[0][1]), m02 = V_SET1(m[0][2]);
+	V m10 = V_SET1(m[1][0]), m11 = V_SET1(m[1][1]), m12 = V_SET1(m[1][2]);
+	V m20 = V_SET1(m[2][0]), m21 = V_SET1(m[2][1]), m22 = V_SET1(m[2][2]);
+	V m30 = V_SET1(m[3][0]), m31 = V_SET1(m[3][1]), m32 = V_SET1(m[3][2]);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		// Lane k takes points 4k..4k+3, twelve floats apart
+		const float* src = &in[i].x;
+		V px, py, pz;
+		KERNEL_NAME(Deinterleave3)(V_LOADLANES(src, 12), V_LOADLANES(src + 4, 12), V_LOADLANES(src + 8, 12), px, py, pz);
+
+		V rx = V_MADD(m00, px, V_MADD(m10, py, V_MADD(m20, pz, m30)));
+		V ry = V_MADD(m01, px, V_MADD(m11, py, V_MADD(m21, pz, m31)));
+		V rz = V_MADD(m02, px, V_MADD(m12, py, V_MADD(m22, pz, m32)));
+
+		V a0, a1, a2;
+		KERNEL_NAME(Interleave3)(rx, ry, rz, a0, a1, a2);
+		float* dst = &out[i].x;
+		V_STORELANES(dst, 12, a0);
+		V_STORELANES(dst + 4, 12, a1);
+		V_STORELANES(dst + 8, 12, a2);
+	}
+
+	TransformPointsScalar(m, in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(ComposeTRS)(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, glm::mat4* out, size_t count)
+{
+	V one = V_SET1(1.f), two = V_SET1(2.f), zero = V_SET1(0.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		const float* q = &r[i].x;
+		V qx = V_LOADLANES(q, 16), qy = V_LOADLANES(q + 4, 16), qz = V_LOADLANES(q + 8, 16), qw = V_LOADLANES(q + 12, 16);
+		KERNEL_NAME(Transpose4)(qx, qy, qz, qw);
+
+		V tx, ty, tz, sx, sy, sz;
+		const float* pt = &t[i].x;
+		const float* ps = &s[i].x;
+		KERNEL_NAME(Deinterleave3)(V_LOADLANES(pt, 12), V_LOADLANES(pt + 4, 12), V_LOADLANES(pt + 8, 12), tx, ty, tz);
+		KERNEL_NAME(Deinterleave3)(V_LOADLANES(ps, 12), V_LOADLANES(ps + 4, 12), V_LOADLANES(ps + 8, 12), sx, sy, sz);
+
+		V xx = V_MUL(qx, qx), yy = V_MUL(qy, qy), zz = V_MUL(qz, qz);
+		V xy = V_MUL(qx, qy), xz = V_MUL(qx, qz), yz = V_MUL(qy, qz);
+		V wx = V_MUL(qw, qx), wy = V_MUL(qw, qy), wz = V_MUL(qw, qz);
+
+		// cols[c][row], one register per matrix element
+		V cols[4][4];
+		cols[0][0] = V_MUL(V_SUB(one, V_MUL(two, V_ADD(yy, zz))), sx);
+		cols[0][1] = V_MUL(V_MUL(two, V_ADD(xy, wz)), sx);
+		cols[0][2] = V_MUL(V_MUL(two, V_SUB(xz, wy)), sx);
+		cols[0][3] = zero;
+		cols[1][0] = V_MUL(V_MUL(two, V_SUB(xy, wz)), sy);
+		cols[1][1] = V_MUL(V_SUB(one, V_MUL(two, V_ADD(xx, zz))), sy);
+		cols[1][2] = V_MUL(V_MUL(two, V_ADD(yz, wx)), sy);
+		cols[1][3] = zero;
+		cols[2][0] = V_MUL(V_MUL(two, V_ADD(xz, wy)), sz);
+		cols[2][1] = V_MUL(V_MUL(two, V_SUB(yz, wx)), sz);
+		cols[2][2] = V_MUL(V_SUB(one, V_MUL(two, V_ADD(xx, yy))), sz);
+		cols[2][3] = zero;
+		cols[3][0] = tx;
+		cols[3][1] = ty;
+		cols[3][2] = tz;
+		cols[3][3] = one;
+
+		KERNEL_NAME(StoreMatrices)(cols, out + i);
+	}
+
+	ComposeTRSScalar(t + i, r + i, s + i, out + i, count - i);
+}
+
+// Same cofactor expansion as InvertMatricesScalar, KERNEL_WIDTH matrices at a time
+KERNEL_TARGET void KERNEL_NAME(InvertMatrices)(const glm::mat4* in, glm::mat4* out, size_t count)
+{
+	V one = V_SET1(1.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V a[4][4];
+		KERNEL_NAME(LoadMatrices)(in + i, a);
+
+		V s0 = V_SUB(V_MUL(a[0][0], a[1][1]), V_MUL(a[1][0], a[0][1]));
+		V s1 = V_SUB(V_MUL(a[0][0], a[1][2]), V_MUL(a[1][0], a[0][2]));
+		V s2 = V_SUB(V_MUL(a[0][0], a[1][3]), V_MUL(a[1][0], a[0][3]));
+		V s3 = V_SUB(V_MUL(a[0][1], a[1][2]), V_MUL(a[1][1], a[0][2]));
+		V s4 = V_SUB(V_MUL(a[0][1], a[1][3]), V_MUL(a[1][1], a[0][3]));
+		V s5 = V_SUB(V_MUL(a[0][2], a[1][3]), V_MUL(a[1][2], a[0][3]));
+		V c0 = V_SUB(V_MUL(a[2][0], a[3][1]), V_MUL(a[3][0], a[2][1]));
+		V c1 = V_SUB(V_MUL(a[2][0], a[3][2]), V_MUL(a[3][0], a[2][2]));
+		V c2 = V_SUB(V_MUL(a[2][0], a[3][3]), V_MUL(a[3][0], a[2][3]));
+		V c3 = V_SUB(V_MUL(a[2][1], a[3][2]), V_MUL(a[3][1], a[2][2]));
+		V c4 = V_SUB(V_MUL(a[2][1], a[3][3]), V_MUL(a[3][1], a[2][3]));
+		V c5 = V_SUB(V_MUL(a[2][2], a[3][3]), V_MUL(a[3][2], a[2][3]));
+
+		V det = V_ADD(V_SUB(V_MUL(s0, c5), V_MUL(s1, c4)), V_MUL(s2, c3));
+		det = V_ADD(V_SUB(V_ADD(det, V_MUL(s3, c2)), V_MUL(s4, c1)), V_MUL(s5, c0));
+		V invDet = V_DIV(one, det);
+
+		V negInvDet = V_SUB(V_SET1(0.f), invDet);
+
+		// (x*p - y*q + z*r) * scale, the sign alternates across the output
+		#define COFACTOR(x, p, y, q, z, r, scale) V_MUL(V_ADD(V_SUB(V_MUL(x, p), V_MUL(y, q)), V_MUL(z, r)), scale)
+
+		V b[4][4];
+		b[0][0] = COFACTOR(a[1][1], c5, a[1][2], c4, a[1][3], c3, invDet);
+		b[0][1] = COFACTOR(a[0][1], c5, a[0][2], c4, a[0][3], c3, negInvDet);
+		b[0][2] = COFACTOR(a[3][1], s5, a[3][2], s4, a[3][3], s3, invDet);
+		b[0][3] = COFACTOR(a[2][1], s5, a[2][2], s4, a[2][3], s3, negInvDet);
+		b[1][0] = COFACTOR(a[1][0], c5, a[1][2], c2, a[1][3], c1, negInvDet);
+		b[1][1] = COFACTOR(a[0][0], c5, a[0][2], c2, a[0][3], c1, invDet);
+		b[1][2] = COFACTOR(a[3][0], s5, a[3][2], s2, a[3][3], s1, negInvDet);
+		b[1][3] = COFACTOR(a[2][0], s5, a[2][2], s2, a[2][3], s1, invDet);
+		b[2][0] = COFACTOR(a[1][0], c4, a[1][1], c2, a[1][3], c0, invDet);
+		b[2][1] = COFACTOR(a[0][0], c4, a[0][1], c2, a[0][3], c0, negInvDet);
+		b[2][2] = COFACTOR(a[3][0], s4, a[3][1], s2, a[3][3], s0, invDet);
+		b[2][3] = COFACTOR(a[2][0], s4, a[2][1], s2, a[2][3], s0, negInvDet);
+		b[3][0] = COFACTOR(a[1][0], c3, a[1][1], c1, a[1][2], c0, negInvDet);
+		b[3][1] = COFACTOR(a[0][0], c3, a[0][1], c1, a[0][2], c0, invDet);
+		b[3][2] = COFACTOR(a[3][0], s3, a[3][1], s1, a[3][2], s0, negInvDet);
+		b[3][3] = COFACTOR(a[2][0], s3, a[2][1], s1, a[2][2], s0, invDet);
+
+		#undef COFACTOR
+
+		KERNEL_NAME(StoreMatrices)(b, out + i);
+	}
+
+	InvertMatricesScalar(in + i, out + i, count - i);
+}
+
+// Rotation-scale terms and translation of KERNEL_WIDTH transforms, the quaternions already one register per component
+static inline KERNEL_TARGET void KERNEL_NAME(ComposeAffineBlock)(V qx, V qy, V qz, V qw, const glm::vec3* t, const glm::vec3* s,
+	Affine3x4* out)
+{
+	V one = V_SET1(1.f), two = V_SET1(2.f);
+
+	V tx, ty, tz, sx, sy, sz;
+	const float* pt = &t[0].x;
+	const float* ps = &s[0].x;
+	KERNEL_NAME(Deinterleave3)(V_LOADLANES(pt, 12), V_LOADLANES(pt + 4, 12), V_LOADLANES(pt + 8, 12), tx, ty, tz);
+	KERNEL_NAME(Deinterleave3)(V_LOADLANES(ps, 12), V_LOADLANES(ps + 4, 12), V_LOADLANES(ps + 8, 12), sx, sy, sz);
+
+	V xx = V_MUL(qx, qx), yy = V_MUL(qy, qy), zz = V_MUL(qz, qz);
+	V xy = V_MUL(qx, qy), xz = V_MUL(qx, qz), yz = V_MUL(qy, qz);
+	V wx = V_MUL(qw, qx), wy = V_MUL(qw, qy), wz = V_MUL(qw, qz);
+
+	V rows[3][4];
+	rows[0][0] = V_MUL(V_SUB(one, V_MUL(two, V_ADD(yy, zz))), sx);
+	rows[0][1] = V_MUL(V_MUL(two, V_SUB(xy, wz)), sy);
+	rows[0][2] = V_MUL(V_MUL(two, V_ADD(xz, wy)), sz);
+	rows[0][3] = tx;
+	rows[1][0] = V_MUL(V_MUL(two, V_ADD(xy, wz)), sx);
+	rows[1][1] = V_MUL(V_SUB(one, V_MUL(two, V_ADD(xx, zz))), sy);
+	rows[1][2] = V_MUL(V_MUL(two, V_SUB(yz, wx)), sz);
+	rows[1][3] = ty;
+	rows[2][0] = V_MUL(V_MUL(two, V_SUB(xz, wy)), sx);
+	rows[2][1] = V_MUL(V_MUL(two, V_ADD(yz, wx)), sy);
+	rows[2][2] = V_MUL(V_SUB(one, V_MUL(two, V_ADD(xx, yy))), sz);
+	rows[2][3] = tz;
+
+	KERNEL_NAME(StoreAffines)(rows, out);
+}
+
+KERNEL_TARGET void KERNEL_NAME(ComposeAffine)(const glm::vec3* t, const glm::quat* r, const glm::vec3* s, Affine3x4* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		const float* q = &r[i].x;
+		V qx = V_LOADLANES(q, 16), qy = V_LOADLANES(q + 4, 16), qz = V_LOADLANES(q + 8, 16), qw = V_LOADLANES(q + 12, 16);
+		KERNEL_NAME(Transpose4)(qx, qy, qz, qw);
+		KERNEL_NAME(ComposeAffineBlock)(qx, qy, qz, qw, t + i, s + i, out + i);
+	}
+
+	ComposeAffineScalar(t + i, r + i, s + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(ComposeAffineSoA)(const glm::vec3* t, const QuatSoA& r, const glm::vec3* s, Affine3x4* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		KERNEL_NAME(ComposeAffineBlock)(V_LOADU(r.x + i), V_LOADU(r.y + i), V_LOADU(r.z + i), V_LOADU(r.w + i),
+			t + i, s + i, out + i);
+	}
+
+	ComposeAffineSoAScalar(t + i, r.Offset(i), s + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(MultiplyAffine)(const Affine3x4* a, const Affine3x4* b, Affine3x4* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V ea[3][4], eb[3][4], result[3][4];
+		KERNEL_NAME(LoadAffines)(a + i, ea);
+		KERNEL_NAME(LoadAffines)(b + i, eb);
+
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+				result[r][c] = V_MADD(ea[r][0], eb[0][c], V_MADD(ea[r][1], eb[1][c], V_MUL(ea[r][2], eb[2][c])));
+			result[r][3] = V_ADD(result[r][3], ea[r][3]);
+		}
+
+		KERNEL_NAME(StoreAffines)(result, out + i);
+	}
+
+	MultiplyAffineScalar(a + i, b + i, out + i, count - i);
+}
+
+// r = cross(a, b) on one register per component
+#define KERNEL_CROSS(ax, ay, az, bx, by, bz, rx, ry, rz) \
+	V rx = V_SUB(V_MUL(ay, bz), V_MUL(az, by)); \
+	V ry = V_SUB(V_MUL(az, bx), V_MUL(ax, bz)); \
+	V rz = V_SUB(V_MUL(ax, by), V_MUL(ay, bx));
+
+// -(x * tx + y * ty + z * tz)
+static inline KERNEL_TARGET V KERNEL_NAME(NegDot3)(V x, V y, V z, V tx, V ty, V tz)
+{
+	return V_SUB(V_SET1(0.f), V_MADD(x, tx, V_MADD(y, ty, V_MUL(z, tz))));
+}
+
+KERNEL_TARGET void KERNEL_NAME(InvertAffine)(const Affine3x4* in, Affine3x4* out, size_t count)
+{
+	V one = V_SET1(1.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V a[3][4];
+		KERNEL_NAME(LoadAffines)(in + i, a);
+
+		// Columns are (a[0][c], a[1][c], a[2][c]), the inverse's rows their cross products
+		KERNEL_CROSS(a[0][1], a[1][1], a[2][1], a[0][2], a[1][2], a[2][2], r00, r01, r02)
+		KERNEL_CROSS(a[0][2], a[1][2], a[2][2], a[0][0], a[1][0], a[2][0], r10, r11, r12)
+		KERNEL_CROSS(a[0][0], a[1][0], a[2][0], a[0][1], a[1][1], a[2][1], r20, r21, r22)
+		V invDet = V_DIV(one, V_MADD(a[0][0], r00, V_MADD(a[1][0], r01, V_MUL(a[2][0], r02))));
+
+		V b[3][4];
+		b[0][0] = V_MUL(r00, invDet); b[0][1] = V_MUL(r01, invDet); b[0][2] = V_MUL(r02, invDet);
+		b[1][0] = V_MUL(r10, invDet); b[1][1] = V_MUL(r11, invDet); b[1][2] = V_MUL(r12, invDet);
+		b[2][0] = V_MUL(r20, invDet); b[2][1] = V_MUL(r21, invDet); b[2][2] = V_MUL(r22, invDet);
+		for (int r = 0; r < 3; ++r)
+			b[r][3] = KERNEL_NAME(NegDot3)(b[r][0], b[r][1], b[r][2], a[0][3], a[1][3], a[2][3]);
+
+		KERNEL_NAME(StoreAffines)(b, out + i);
+	}
+
+	InvertAffineScalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(InvertRigid)(const Affine3x4* in, Affine3x4* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V a[3][4];
+		KERNEL_NAME(LoadAffines)(in + i, a);
+
+		V b[3][4];
+		for (int r = 0; r < 3; ++r)
+		{
+			b[r][0] = a[0][r];
+			b[r][1] = a[1][r];
+			b[r][2] = a[2][r];
+			b[r][3] = KERNEL_NAME(NegDot3)(a[0][r], a[1][r], a[2][r], a[0][3], a[1][3], a[2][3]);
+		}
+
+		KERNEL_NAME(StoreAffines)(b, out + i);
+	}
+
+	InvertRigidScalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(NormalMatrices)(const glm::mat4* models, glm::mat3* out, size_t count)
+{
+	V one = V_SET1(1.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V m[4][4];
+		KERNEL_NAME(LoadMatrices)(models + i, m);
+
+		KERNEL_CROSS(m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2], n00, n01, n02)
+		KERNEL_CROSS(m[2][0], m[2][1], m[2][2], m[0][0], m[0][1], m[0][2], n10, n11, n12)
+		KERNEL_CROSS(m[0][0], m[0][1], m[0][2], m[1][0], m[1][1], m[1][2], n20, n21, n22)
+		V invDet = V_DIV(one, V_MADD(m[0][0], n00, V_MADD(m[0][1], n01, V_MUL(m[0][2], n02))));
+
+		// A mat3 is nine floats: elements 0-3 and 4-7 go out as one transposed
+		// register each, the last one per matrix through a small buffer
+		V e0 = V_MUL(n00, invDet), e1 = V_MUL(n01, invDet), e2 = V_MUL(n02, invDet), e3 = V_MUL(n10, invDet);
+		V e4 = V_MUL(n11, invDet), e5 = V_MUL(n12, invDet), e6 = V_MUL(n20, invDet), e7 = V_MUL(n21, invDet);
+		KERNEL_NAME(Transpose4)(e0, e1, e2, e3);
+		KERNEL_NAME(Transpose4)(e4, e5, e6, e7);
+		float last[KERNEL_WIDTH];
+		V_STOREU(last, V_MUL(n22, invDet));
+
+		glm::mat3* dst = out + i;
+		V_STORELANES(&dst[0][0][0], 36, e0);
+		V_STORELANES(&dst[0][1][1], 36, e4);
+		V_STORELANES(&dst[1][0][0], 36, e1);
+		V_STORELANES(&dst[1][1][1], 36, e5);
+		V_STORELANES(&dst[2][0][0], 36, e2);
+		V_STORELANES(&dst[2][1][1], 36, e6);
+		V_STORELANES(&dst[3][0][0], 36, e3);
+		V_STORELANES(&dst[3][1][1], 36, e7);
+		for (int k = 0; k < KERNEL_WIDTH; ++k)
+			dst[k][2][2] = last[k];
+	}
+
+	NormalMatricesScalar(models + i, out + i, count - i);
+}
+
+// FastTrig's polynomials on whole registers, see FastTrig.h for the error bounds
+
+static inline KERNEL_TARGET V KERNEL_NAME(Abs)(V v)
+{
+	return V_AND(v, V_FROMBITS(VI_SET1(0x7FFFFFFF)));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(SignBit)(V v)
+{
+	return V_AND(v, V_FROMBITS(VI_SET1((int)0x80000000)));
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(SinCosV)(V x, V& s, V& c)
+{
+	V j = V_ROUND(V_MUL(x, V_SET1(FastTrig::TWO_OVER_PI)));
+	VI quadrant = V_TOINT(j);
+	V r = V_MADD(j, V_SET1(-FastTrig::PIO2_HI), x);
+	r = V_MADD(j, V_SET1(-FastTrig::PIO2_MID), r);
+	r = V_MADD(j, V_SET1(-FastTrig::PIO2_LO), r);
+	V z = V_MUL(r, r);
+
+	V sinPoly = V_MADD(V_MADD(V_SET1(FastTrig::SIN_3), z, V_SET1(FastTrig::SIN_2)), z, V_SET1(FastTrig::SIN_1));
+	V cosPoly = V_MADD(V_MADD(V_SET1(FastTrig::COS_3), z, V_SET1(FastTrig::COS_2)), z, V_SET1(FastTrig::COS_1));
+	V sinR = V_MADD(V_MUL(sinPoly, z), r, r);
+	V cosR = V_MADD(V_MUL(cosPoly, z), z, V_MADD(V_SET1(-0.5f), z, V_SET1(1.f)));
+
+	// Odd quadrants swap sin and cos, bit 1 of the quadrant becomes the sign bit
+	M swap = VI_TEST(quadrant, 1);
+	s = V_SELECT(swap, sinR, cosR);
+	c = V_SELECT(swap, cosR, sinR);
+	s = V_XOR(s, V_FROMBITS(VI_SLLI(VI_AND(quadrant, VI_SET1(2)), 30)));
+	c = V_XOR(c, V_FROMBITS(VI_SLLI(VI_AND(VI_ADD(quadrant, VI_SET1(1)), VI_SET1(2)), 30)));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Atan2V)(V y, V x)
+{
+	V zero = V_SET1(0.f), one = V_SET1(1.f);
+	V ax = KERNEL_NAME(Abs)(x), ay = KERNEL_NAME(Abs)(y);
+	V hi = V_MAX(ax, ay), lo = V_MIN(ax, ay);
+	V a = V_SELECT(V_CMPLT(zero, hi), zero, V_DIV(lo, hi));
+
+	M upper = V_CMPLT(V_SET1(FastTrig::TAN_PI_8), a);
+	V offset = V_SELECT(upper, zero, V_SET1(FastTrig::QUARTER_PI));
+	a = V_SELECT(upper, a, V_DIV(V_SUB(a, one), V_ADD(a, one)));
+
+	V z = V_MUL(a, a);
+	V poly = V_MADD(V_MADD(V_MADD(V_SET1(FastTrig::ATAN_4), z, V_SET1(FastTrig::ATAN_3)), z, V_SET1(FastTrig::ATAN_2)), z, V_SET1(FastTrig::ATAN_1));
+	V r = V_ADD(V_MADD(V_MUL(poly, z), a, a), offset);
+
+	r = V_SELECT(V_CMPLT(ax, ay), r, V_SUB(V_SET1(FastTrig::HALF_PI), r));
+	r = V_SELECT(V_CMPLT(x, zero), r, V_SUB(V_SET1(FastTrig::PI), r));
+	return V_XOR(r, KERNEL_NAME(SignBit)(y));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(AcosV)(V x)
+{
+	V half = V_SET1(0.5f);
+	V ax = KERNEL_NAME(Abs)(x);
+	M outer = V_CMPLT(half, ax);
+
+	V z = V_SELECT(outer, V_MUL(x, x), V_MUL(half, V_SUB(V_SET1(1.f), ax)));
+	V a = V_SELECT(outer, x, V_SQRT(z));
+	V poly = V_MADD(V_MADD(V_SET1(FastTrig::ASIN_5), z, V_SET1(FastTrig::ASIN_4)), z, V_SET1(FastTrig::ASIN_3));
+	poly = V_MADD(V_MADD(poly, z, V_SET1(FastTrig::ASIN_2)), z, V_SET1(FastTrig::ASIN_1));
+	V asinA = V_MADD(V_MUL(poly, z), a, a);
+
+	V twice = V_ADD(asinA, asinA);
+	V outerR = V_SELECT(V_CMPLT(x, V_SET1(0.f)), twice, V_SUB(V_SET1(FastTrig::PI), twice));
+	return V_SELECT(outer, V_SUB(V_SET1(FastTrig::HALF_PI), asinA), outerR);
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(LogV)(V x)
+{
+	VI bits = V_TOBITS(x);
+	V fe = V_FROMINT(VI_SUB(VI_SRLI(bits, 23), VI_SET1(126)));
+	V f = V_FROMBITS(VI_OR(VI_AND(bits, VI_SET1(0x7FFFFF)), VI_SET1(0x3F000000)));
+
+	M low = V_CMPLT(f, V_SET1(FastTrig::SQRT_HALF));
+	fe = V_SELECT(low, fe, V_SUB(fe, V_SET1(1.f)));
+	f = V_SELECT(low, f, V_ADD(f, f));
+	V m = V_SUB(f, V_SET1(1.f));
+	V z = V_MUL(m, m);
+
+	V poly = V_MADD(V_MADD(V_MADD(V_SET1(FastTrig::LOG_9), m, V_SET1(FastTrig::LOG_8)), m, V_SET1(FastTrig::LOG_7)), m, V_SET1(FastTrig::LOG_6));
+	poly = V_MADD(V_MADD(V_MADD(poly, m, V_SET1(FastTrig::LOG_5)), m, V_SET1(FastTrig::LOG_4)), m, V_SET1(FastTrig::LOG_3));
+	poly = V_MADD(V_MADD(poly, m, V_SET1(FastTrig::LOG_2)), m, V_SET1(FastTrig::LOG_1));
+	V y = V_MADD(V_MUL(poly, m), z, V_MUL(fe, V_SET1(FastTrig::LN2_LO)));
+	y = V_MADD(V_SET1(-0.5f), z, y);
+	return V_MADD(fe, V_SET1(FastTrig::LN2_HI), V_ADD(m, y));
+}
+
+KERNEL_TARGET void KERNEL_NAME(SinCos)(const float* angles, float* s, float* c, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V sinX, cosX;
+		KERNEL_NAME(SinCosV)(V_LOADU(angles + i), sinX, cosX);
+		V_STOREU(s + i, sinX);
+		V_STOREU(c + i, cosX);
+	}
+
+	SinCosScalar(angles + i, s + i, c + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(Atan2)(const float* y, const float* x, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+		V_STOREU(out + i, KERNEL_NAME(Atan2V)(V_LOADU(y + i), V_LOADU(x + i)));
+
+	Atan2Scalar(y + i, x + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(Acos)(const float* x, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+		V_STOREU(out + i, KERNEL_NAME(AcosV)(V_LOADU(x + i)));
+
+	AcosScalar(x + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(Log)(const float* x, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+		V_STOREU(out + i, KERNEL_NAME(LogV)(V_LOADU(x + i)));
+
+	LogScalar(x + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(AxisAngleToQuat)(const glm::vec3* axes, const float* angles, glm::quat* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V ax, ay, az;
+		const float* src = &axes[i].x;
+		KERNEL_NAME(Deinterleave3)(V_LOADLANES(src, 12), V_LOADLANES(src + 4, 12), V_LOADLANES(src + 8, 12), ax, ay, az);
+
+		// Lane k of the angles is items 4k..4k+3 already, V_LOADU keeps that order
+		V s, c;
+		KERNEL_NAME(SinCosV)(V_MUL(V_LOADU(angles + i), V_SET1(0.5f)), s, c);
+
+		V qx = V_MUL(ax, s), qy = V_MUL(ay, s), qz = V_MUL(az, s), qw = c;
+		KERNEL_NAME(Transpose4)(qx, qy, qz, qw);
+		float* dst = &out[i].x;
+		V_STORELANES(dst, 16, qx);
+		V_STORELANES(dst + 4, 16, qy);
+		V_STORELANES(dst + 8, 16, qz);
+		V_STORELANES(dst + 12, 16, qw);
+	}
+
+	AxisAngleToQuatScalar(axes + i, angles + i, out + i, count - i);
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(NormaliseQuatV)(V& x, V& y, V& z, V& w)
+{
+	V invLength = V_DIV(V_SET1(1.f), V_SQRT(V_MADD(x, x, V_MADD(y, y, V_MADD(z, z, V_MUL(w, w))))));
+	x = V_MUL(x, invLength);
+	y = V_MUL(y, invLength);
+	z = V_MUL(z, invLength);
+	w = V_MUL(w, invLength);
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(DotQuatV)(V ax, V ay, V az, V aw, V bx, V by, V bz, V bw)
+{
+	return V_MADD(ax, bx, V_MADD(ay, by, V_MADD(az, bz, V_MUL(aw, bw))));
+}
+
+// a + t * (b * sign(dot) - a), normalised, for KERNEL_WIDTH quaternions at offset i.
+// With correct set, t is first bent towards the slerp curve.
+static inline KERNEL_TARGET void KERNEL_NAME(NlerpBlock)(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out,
+	size_t i, bool correct)
+{
+	V ax = V_LOADU(a.x + i), ay = V_LOADU(a.y + i), az = V_LOADU(a.z + i), aw = V_LOADU(a.w + i);
+	V bx = V_LOADU(b.x + i), by = V_LOADU(b.y + i), bz = V_LOADU(b.z + i), bw = V_LOADU(b.w + i);
+	V d = KERNEL_NAME(DotQuatV)(ax, ay, az, aw, bx, by, bz, bw);
+	V sign = KERNEL_NAME(SignBit)(d);
+	V ti = V_LOADU(t + i);
+
+	if (correct)
+	{
+		V absCos = V_XOR(d, sign);
+		V ka = V_MADD(V_MADD(V_MADD(V_SET1(Transform::SLERP_A3), absCos, V_SET1(Transform::SLERP_A2)), absCos,
+			V_SET1(Transform::SLERP_A1)), absCos, V_SET1(Transform::SLERP_A0));
+		V kb = V_MADD(V_MADD(V_SET1(Transform::SLERP_B2), absCos, V_SET1(Transform::SLERP_B1)), absCos, V_SET1(Transform::SLERP_B0));
+		V centred = V_SUB(ti, V_SET1(0.5f));
+		V k = V_MADD(V_MUL(ka, centred), centred, kb);
+		ti = V_MADD(V_MUL(V_MUL(ti, centred), V_SUB(ti, V_SET1(1.f))), k, ti);
+	}
+
+	V x = V_MADD(ti, V_SUB(V_XOR(bx, sign), ax), ax);
+	V y = V_MADD(ti, V_SUB(V_XOR(by, sign), ay), ay);
+	V z = V_MADD(ti, V_SUB(V_XOR(bz, sign), az), az);
+	V w = V_MADD(ti, V_SUB(V_XOR(bw, sign), aw), aw);
+	KERNEL_NAME(NormaliseQuatV)(x, y, z, w);
+	V_STOREU(out.x + i, x);
+	V_STOREU(out.y + i, y);
+	V_STOREU(out.z + i, z);
+	V_STOREU(out.w + i, w);
+}
+
+KERNEL_TARGET void KERNEL_NAME(NlerpQuats)(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+		KERNEL_NAME(NlerpBlock)(a, b, t, out, i, false);
+
+	NlerpQuatsScalar(a.Offset(i), b.Offset(i), t + i, out.Offset(i), count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(SlerpQuats)(const QuatSoA& a, const QuatSoA& b, const float* t, const QuatSoA& out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+		KERNEL_NAME(NlerpBlock)(a, b, t, out, i, true);
+
+	SlerpQuatsScalar(a.Offset(i), b.Offset(i), t + i, out.Offset(i), count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(BlendQuats)(const QuatSoA* poses, const float* weights, int poseCount, const QuatSoA& out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		const QuatSoA& reference = poses[0];
+		V rx = V_LOADU(reference.x + i), ry = V_LOADU(reference.y + i), rz = V_LOADU(reference.z + i), rw = V_LOADU(reference.w + i);
+
+		V x = V_SET1(0.f), y = V_SET1(0.f), z = V_SET1(0.f), w = V_SET1(0.f);
+		for (int p = 0; p < poseCount; ++p)
+		{
+			const QuatSoA& q = poses[p];
+			V qx = V_LOADU(q.x + i), qy = V_LOADU(q.y + i), qz = V_LOADU(q.z + i), qw = V_LOADU(q.w + i);
+			V weight = V_XOR(V_SET1(weights[p]), KERNEL_NAME(SignBit)(KERNEL_NAME(DotQuatV)(rx, ry, rz, rw, qx, qy, qz, qw)));
+			x = V_MADD(weight, qx, x);
+			y = V_MADD(weight, qy, y);
+			z = V_MADD(weight, qz, z);
+			w = V_MADD(weight, qw, w);
+		}
+
+		KERNEL_NAME(NormaliseQuatV)(x, y, z, w);
+		V_STOREU(out.x + i, x);
+		V_STOREU(out.y + i, y);
+		V_STOREU(out.z + i, z);
+		V_STOREU(out.w + i, w);
+	}
+
+	BlendQuatsRange(poses, weights, poseCount, out, i, count);
+}
+
+KERNEL_TARGET void KERNEL_NAME(QuatsToMatrices)(const QuatSoA& q, glm::mat4* out, size_t count)
+{
+	V one = V_SET1(1.f), two = V_SET1(2.f), zero = V_SET1(0.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V qx = V_LOADU(q.x + i), qy = V_LOADU(q.y + i), qz = V_LOADU(q.z + i), qw = V_LOADU(q.w + i);
+		V xx = V_MUL(qx, qx), yy = V_MUL(qy, qy), zz = V_MUL(qz, qz);
+		V xy = V_MUL(qx, qy), xz = V_MUL(qx, qz), yz = V_MUL(qy, qz);
+		V wx = V_MUL(qw, qx), wy = V_MUL(qw, qy), wz = V_MUL(qw, qz);
+
+		V cols[4][4];
+		cols[0][0] = V_SUB(one, V_MUL(two, V_ADD(yy, zz)));
+		cols[0][1] = V_MUL(two, V_ADD(xy, wz));
+		cols[0][2] = V_MUL(two, V_SUB(xz, wy));
+		cols[0][3] = zero;
+		cols[1][0] = V_MUL(two, V_SUB(xy, wz));
+		cols[1][1] = V_SUB(one, V_MUL(two, V_ADD(xx, zz)));
+		cols[1][2] = V_MUL(two, V_ADD(yz, wx));
+		cols[1][3] = zero;
+		cols[2][0] = V_MUL(two, V_ADD(xz, wy));
+		cols[2][1] = V_MUL(two, V_SUB(yz, wx));
+		cols[2][2] = V_SUB(one, V_MUL(two, V_ADD(xx, yy)));
+		cols[2][3] = zero;
+		cols[3][0] = zero;
+		cols[3][1] = zero;
+		cols[3][2] = zero;
+		cols[3][3] = one;
+
+		KERNEL_NAME(StoreMatrices)(cols, out + i);
+	}
+
+	QuatsToMatricesScalar(q.Offset(i), out + i, count - i);
+}
+
+// The skinning kernels run one vertex per 128-bit lane, KERNEL_LANES vertices per
+// step. Each lane gathers the palette entries of its own vertex, blends them and
+// transforms its position and normal with in-lane shuffles only.
+
+// Lane k = the row at offset floats into palette[joints[k]], for each of the KERNEL_LANES
+// vertices; stride is the palette entry size in floats. The addresses go to the load as
+// separate arguments (an array of them would round-trip through the stack), and the
+// narrower levels drop the ones past their lane count unevaluated.
+static inline KERNEL_TARGET V KERNEL_NAME(GatherRow)(const SkinnedVertex* v, int influence, const float* palette, int stride,
+	int offset)
+{
+	#define KERNEL_ROW(k) (palette + v[k].joints[influence] * stride + offset)
+	return V_LOADLANESP(KERNEL_ROW(0), KERNEL_ROW(1), KERNEL_ROW(2), KERNEL_ROW(3));
+	#undef KERNEL_ROW
+}
+
+// rows += w * palette[joints[influence]]. Called once per influence rather than from
+// a loop, which keeps the accumulators in registers.
+static inline KERNEL_TARGET void KERNEL_NAME(AddInfluence)(const SkinnedVertex* v, int influence, const float* palette, V w,
+	V& r0, V& r1, V& r2)
+{
+	r0 = V_MADD(w, KERNEL_NAME(GatherRow)(v, influence, palette, 12, 0), r0);
+	r1 = V_MADD(w, KERNEL_NAME(GatherRow)(v, influence, palette, 12, 4), r1);
+	r2 = V_MADD(w, KERNEL_NAME(GatherRow)(v, influence, palette, 12, 8), r2);
+}
+
+KERNEL_TARGET void KERNEL_NAME(SkinLinear)(const Affine3x4* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count)
+{
+	const float* base = &palette[0].rows[0].x;
+	V zero = V_SET1(0.f), one = V_SET1(1.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_LANES <= count; i += KERNEL_LANES)
+	{
+		const SkinnedVertex* v = in + i;
+		V weights = V_LOADLANES(&v[0].weights.x, 11);
+
+		// Weighted sum of the palette rows
+		V c0 = zero, c1 = zero, c2 = zero, c3 = zero;
+		KERNEL_NAME(AddInfluence)(v, 0, base, V_PERMUTE(weights, 0x00), c0, c1, c2);
+		KERNEL_NAME(AddInfluence)(v, 1, base, V_PERMUTE(weights, 0x55), c0, c1, c2);
+		KERNEL_NAME(AddInfluence)(v, 2, base, V_PERMUTE(weights, 0xAA), c0, c1, c2);
+		KERNEL_NAME(AddInfluence)(v, 3, base, V_PERMUTE(weights, 0xFF), c0, c1, c2);
+
+		// Rows to columns, then position = c0 x + c1 y + c2 z + c3
+		KERNEL_NAME(Transpose4)(c0, c1, c2, c3);
+
+		// The loads also pick up normal.x and the joint bytes in w; the joint bytes read
+		// as a denormal and would stall any arithmetic they reach, so only xyz are used
+		V p = V_BLEND(V_LOADLANES(&v[0].position.x, 11), one, 0x8);
+		V n = V_LOADLANES(&v[0].normal.x, 11);
+		V position = KERNEL_NAME(MulColumns)(c0, c1, c2, c3, p);
+		V normal = V_MADD(c0, V_PERMUTE(n, 0x00), V_MADD(c1, V_PERMUTE(n, 0x55), V_MUL(c2, V_PERMUTE(n, 0xAA))));
+
+		V_STORELANES(&out[i].position.x, 8, V_BLEND(position, one, 0x8));
+		V_STORELANES(&out[i].normal.x, 8, V_BLEND(normal, zero, 0x8));
+	}
+
+	SkinLinearScalar(palette, in + i, out + i, count - i);
+}
+
+// dot(a, b) of whole lanes, broadcast across the lane
+static inline KERNEL_TARGET V KERNEL_NAME(DotLanes)(V a, V b)
+{
+	V d = V_MUL(a, b);
+	d = V_ADD(d, V_PERMUTE(d, _MM_SHUFFLE(2, 3, 0, 1)));
+	return V_ADD(d, V_PERMUTE(d, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+// cross(a.xyz, b.xyz) per lane, w is garbage
+static inline KERNEL_TARGET V KERNEL_NAME(CrossLanes)(V a, V b)
+{
+	V aYZX = V_PERMUTE(a, _MM_SHUFFLE(3, 0, 2, 1)), bYZX = V_PERMUTE(b, _MM_SHUFFLE(3, 0, 2, 1));
+	return V_PERMUTE(V_SUB(V_MUL(a, bYZX), V_MUL(aYZX, b)), _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+// real, dual += w * palette[joints[influence]], flipped into the hemisphere of firstReal
+static inline KERNEL_TARGET void KERNEL_NAME(AddDualQuat)(const SkinnedVertex* v, int influence, const float* palette, V w,
+	V firstReal, V& real, V& dual)
+{
+	V qr = KERNEL_NAME(GatherRow)(v, influence, palette, 8, 0);
+	V qd = KERNEL_NAME(GatherRow)(v, influence, palette, 8, 4);
+	w = V_XOR(w, KERNEL_NAME(SignBit)(KERNEL_NAME(DotLanes)(firstReal, qr)));
+	real = V_MADD(w, qr, real);
+	dual = V_MADD(w, qd, dual);
+}
+
+KERNEL_TARGET void KERNEL_NAME(SkinDualQuat)(const glm::dualquat* palette, const SkinnedVertex* in, SkinnedPoint* out, size_t count)
+{
+	const float* base = &palette[0].real.x;
+	V zero = V_SET1(0.f), one = V_SET1(1.f), two = V_SET1(2.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_LANES <= count; i += KERNEL_LANES)
+	{
+		const SkinnedVertex* v = in + i;
+		V weights = V_LOADLANES(&v[0].weights.x, 11);
+		V firstReal = KERNEL_NAME(GatherRow)(v, 0, base, 8, 0);
+
+		V real = zero, dual = zero;
+		KERNEL_NAME(AddDualQuat)(v, 0, base, V_PERMUTE(weights, 0x00), firstReal, real, dual);
+		KERNEL_NAME(AddDualQuat)(v, 1, base, V_PERMUTE(weights, 0x55), firstReal, real, dual);
+		KERNEL_NAME(AddDualQuat)(v, 2, base, V_PERMUTE(weights, 0xAA), firstReal, real, dual);
+		KERNEL_NAME(AddDualQuat)(v, 3, base, V_PERMUTE(weights, 0xFF), firstReal, real, dual);
+
+		V invLength = V_DIV(one, V_SQRT(KERNEL_NAME(DotLanes)(real, real)));
+		real = V_MUL(real, invLength);
+		dual = V_MUL(dual, invLength);
+		V realW = V_PERMUTE(real, 0xFF), dualW = V_PERMUTE(dual, 0xFF);
+
+		// p + 2 cross(r, cross(r, p) + r.w p) + 2 (r.w d - d.w r + cross(r, d)). The
+		// cross products carry w along, so the stray normal.x and joint bytes are cleared first.
+		V p = V_BLEND(V_LOADLANES(&v[0].position.x, 11), zero, 0x8);
+		V n = V_BLEND(V_LOADLANES(&v[0].normal.x, 11), zero, 0x8);
+		V rotatedP = V_MADD(two, KERNEL_NAME(CrossLanes)(real, V_MADD(realW, p, KERNEL_NAME(CrossLanes)(real, p))), p);
+		V rotatedN = V_MADD(two, KERNEL_NAME(CrossLanes)(real, V_MADD(realW, n, KERNEL_NAME(CrossLanes)(real, n))), n);
+		V translation = V_ADD(V_SUB(V_MUL(realW, dual), V_MUL(dualW, real)), KERNEL_NAME(CrossLanes)(real, dual));
+		V position = V_MADD(two, translation, rotatedP);
+
+		V_STORELANES(&out[i].position.x, 8, V_BLEND(position, one, 0x8));
+		V_STORELANES(&out[i].normal.x, 8, V_BLEND(rotatedN, zero, 0x8));
+	}
+
+	SkinDualQuatScalar(palette, in + i, out + i, count - i);
+}
+
+// Smallest three: the index of the rebuilt component is (bit 15 of b, bit 15 of a)
+KERNEL_TARGET void KERNEL_NAME(UnpackQuats)(const uint16_t* a, const uint16_t* b, const uint16_t* c, const QuatSoA& out, size_t count)
+{
+	V step = V_SET1(Quantize::QUAT48_STEP), range = V_SET1(-Quantize::QUAT48_RANGE);
+	V zero = V_SET1(0.f), one = V_SET1(1.f);
+	VI low15 = VI_SET1(0x7FFF);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		VI ia = VI_LOADU16(a + i), ib = VI_LOADU16(b + i);
+		M indexLow = VI_TEST(ia, 0x8000), indexHigh = VI_TEST(ib, 0x8000);
+		V x0 = V_MADD(V_FROMINT(VI_AND(ia, low15)), step, range);
+		V x1 = V_MADD(V_FROMINT(VI_AND(ib, low15)), step, range);
+		V x2 = V_MADD(V_FROMINT(VI_LOADU16(c + i)), step, range);
+		V largest = V_SQRT(V_MAX(V_SUB(one, V_MADD(x0, x0, V_MADD(x1, x1, V_MUL(x2, x2)))), zero));
+
+		V_STOREU(out.x + i, V_SELECT(indexLow, V_SELECT(indexHigh, largest, x0), x0));
+		V_STOREU(out.y + i, V_SELECT(indexHigh, V_SELECT(indexLow, x0, largest), x1));
+		V_STOREU(out.z + i, V_SELECT(indexHigh, x1, V_SELECT(indexLow, largest, x2)));
+		V_STOREU(out.w + i, V_SELECT(indexLow, x2, V_SELECT(indexHigh, x2, largest)));
+	}
+
+	UnpackQuatsScalar(a + i, b + i, c + i, out.Offset(i), count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(BlendQuantized)(const uint16_t* const* keys, const float* weights, const float* offset, const float* scale,
+	float* out, size_t count)
+{
+	V w0 = V_SET1(weights[0]), w1 = V_SET1(weights[1]), w2 = V_SET1(weights[2]), w3 = V_SET1(weights[3]);
+	const uint16_t* k0 = keys[0];
+	const uint16_t* k1 = keys[1];
+	const uint16_t* k2 = keys[2];
+	const uint16_t* k3 = keys[3];
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V sum = V_MUL(w0, V_FROMINT(VI_LOADU16(k0 + i)));
+		sum = V_MADD(w1, V_FROMINT(VI_LOADU16(k1 + i)), sum);
+		sum = V_MADD(w2, V_FROMINT(VI_LOADU16(k2 + i)), sum);
+		sum = V_MADD(w3, V_FROMINT(VI_LOADU16(k3 + i)), sum);
+		V_STOREU(out + i, V_MADD(sum, V_LOADU(scale + i), V_LOADU(offset + i)));
+	}
+
+	const uint16_t* tail[4] = { k0 + i, k1 + i, k2 + i, k3 + i };
+	BlendQuantizedScalar(tail, weights, offset + i, scale + i, out + i, count - i);
+}
+
+// Noise: glm::perlin / glm::simplex (gtc/noise.inl) with every vector component of
+// theirs in its own register, one point per float. Same operations in the same order.
+
+static inline KERNEL_TARGET V KERNEL_NAME(Fract)(V v)
+{
+	return V_SUB(v, V_FLOOR(v));
+}
+
+// glm::mix, x * (1 - a) + y * a
+static inline KERNEL_TARGET V KERNEL_NAME(Mix)(V x, V y, V a)
+{
+	return V_ADD(V_MUL(x, V_SUB(V_SET1(1.f), a)), V_MUL(y, a));
+}
+
+// glm::step, x < edge ? 0 : 1
+static inline KERNEL_TARGET V KERNEL_NAME(Step)(V edge, V x)
+{
+	return V_SELECT(V_CMPLT(x, edge), V_SET1(1.f), V_SET1(0.f));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Mod289)(V x)
+{
+	return V_SUB(x, V_MUL(V_FLOOR(V_MUL(x, V_SET1(1.f / 289.f))), V_SET1(289.f)));
+}
+
+// glm::mod(x, 289), which divides where detail::mod289 multiplies
+static inline KERNEL_TARGET V KERNEL_NAME(ModDivide289)(V x)
+{
+	return V_SUB(x, V_MUL(V_SET1(289.f), V_FLOOR(V_DIV(x, V_SET1(289.f)))));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Permute)(V x)
+{
+	return KERNEL_NAME(Mod289)(V_MUL(V_ADD(V_MUL(x, V_SET1(34.f)), V_SET1(1.f)), x));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(TaylorInvSqrt)(V r)
+{
+	return V_SUB(V_SET1(1.79284291400159f), V_MUL(V_SET1(0.85373472095314f), r));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Fade)(V t)
+{
+	return V_MUL(V_MUL(V_MUL(t, t), t), V_ADD(V_MUL(t, V_SUB(V_MUL(t, V_SET1(6.f)), V_SET1(15.f))), V_SET1(10.f)));
+}
+
+// Gradient of one corner from its hash, dotted with the offset to it
+static inline KERNEL_TARGET V KERNEL_NAME(PerlinCorner2)(V hash, V fx, V fy)
+{
+	V gx = V_SUB(V_MUL(V_SET1(2.f), KERNEL_NAME(Fract)(V_DIV(hash, V_SET1(41.f)))), V_SET1(1.f));
+	V gy = V_SUB(KERNEL_NAME(Abs)(gx), V_SET1(0.5f));
+	gx = V_SUB(gx, V_FLOOR(V_ADD(gx, V_SET1(0.5f))));
+	V norm = KERNEL_NAME(TaylorInvSqrt)(V_ADD(V_MUL(gx, gx), V_MUL(gy, gy)));
+	return V_ADD(V_MUL(V_MUL(gx, norm), fx), V_MUL(V_MUL(gy, norm), fy));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Perlin2V)(V px, V py)
+{
+	V one = V_SET1(1.f);
+	V x0 = V_FLOOR(px), y0 = V_FLOOR(py);
+	V fx0 = KERNEL_NAME(Fract)(px), fy0 = KERNEL_NAME(Fract)(py);
+	V fx1 = V_SUB(fx0, one), fy1 = V_SUB(fy0, one);
+	V x1 = KERNEL_NAME(ModDivide289)(V_ADD(x0, one)), y1 = KERNEL_NAME(ModDivide289)(V_ADD(y0, one));
+	x0 = KERNEL_NAME(ModDivide289)(x0);
+	y0 = KERNEL_NAME(ModDivide289)(y0);
+
+	V hx0 = KERNEL_NAME(Permute)(x0), hx1 = KERNEL_NAME(Permute)(x1);
+	V n00 = KERNEL_NAME(PerlinCorner2)(KERNEL_NAME(Permute)(V_ADD(hx0, y0)), fx0, fy0);
+	V n10 = KERNEL_NAME(PerlinCorner2)(KERNEL_NAME(Permute)(V_ADD(hx1, y0)), fx1, fy0);
+	V n01 = KERNEL_NAME(PerlinCorner2)(KERNEL_NAME(Permute)(V_ADD(hx0, y1)), fx0, fy1);
+	V n11 = KERNEL_NAME(PerlinCorner2)(KERNEL_NAME(Permute)(V_ADD(hx1, y1)), fx1, fy1);
+
+	V fadeX = KERNEL_NAME(Fade)(fx0), fadeY = KERNEL_NAME(Fade)(fy0);
+	V n = KERNEL_NAME(Mix)(KERNEL_NAME(Mix)(n00, n10, fadeX), KERNEL_NAME(Mix)(n01, n11, fadeX), fadeY);
+	return V_MUL(V_SET1(2.3f), n);
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(PerlinCorner3)(V hash, V fx, V fy, V fz)
+{
+	V zero = V_SET1(0.f), half = V_SET1(0.5f);
+	V gx = V_MUL(hash, V_SET1((float)(1.0 / 7.0)));
+	V gy = V_SUB(KERNEL_NAME(Fract)(V_MUL(V_FLOOR(gx), V_SET1((float)(1.0 / 7.0)))), half);
+	gx = KERNEL_NAME(Fract)(gx);
+	V gz = V_SUB(V_SUB(half, KERNEL_NAME(Abs)(gx)), KERNEL_NAME(Abs)(gy));
+	V sz = KERNEL_NAME(Step)(gz, zero);
+	gx = V_SUB(gx, V_MUL(sz, V_SUB(KERNEL_NAME(Step)(zero, gx), half)));
+	gy = V_SUB(gy, V_MUL(sz, V_SUB(KERNEL_NAME(Step)(zero, gy), half)));
+	V norm = KERNEL_NAME(TaylorInvSqrt)(V_ADD(V_ADD(V_MUL(gx, gx), V_MUL(gy, gy)), V_MUL(gz, gz)));
+	return V_ADD(V_ADD(V_MUL(V_MUL(gx, norm), fx), V_MUL(V_MUL(gy, norm), fy)), V_MUL(V_MUL(gz, norm), fz));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Perlin3V)(V px, V py, V pz)
+{
+	V one = V_SET1(1.f);
+	V x0 = V_FLOOR(px), y0 = V_FLOOR(py), z0 = V_FLOOR(pz);
+	V x1 = KERNEL_NAME(Mod289)(V_ADD(x0, one)), y1 = KERNEL_NAME(Mod289)(V_ADD(y0, one)), z1 = KERNEL_NAME(Mod289)(V_ADD(z0, one));
+	x0 = KERNEL_NAME(Mod289)(x0);
+	y0 = KERNEL_NAME(Mod289)(y0);
+	z0 = KERNEL_NAME(Mod289)(z0);
+	V fx0 = KERNEL_NAME(Fract)(px), fy0 = KERNEL_NAME(Fract)(py), fz0 = KERNEL_NAME(Fract)(pz);
+	V fx1 = V_SUB(fx0, one), fy1 = V_SUB(fy0, one), fz1 = V_SUB(fz0, one);
+
+	V hx0 = KERNEL_NAME(Permute)(x0), hx1 = KERNEL_NAME(Permute)(x1);
+	V h00 = KERNEL_NAME(Permute)(V_ADD(hx0, y0)), h10 = KERNEL_NAME(Permute)(V_ADD(hx1, y0));
+	V h01 = KERNEL_NAME(Permute)(V_ADD(hx0, y1)), h11 = KERNEL_NAME(Permute)(V_ADD(hx1, y1));
+
+	V fadeX = KERNEL_NAME(Fade)(fx0), fadeY = KERNEL_NAME(Fade)(fy0), fadeZ = KERNEL_NAME(Fade)(fz0);
+	V n00 = KERNEL_NAME(Mix)(KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h00, z0)), fx0, fy0, fz0),
+		KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h00, z1)), fx0, fy0, fz1), fadeZ);
+	V n10 = KERNEL_NAME(Mix)(KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h10, z0)), fx1, fy0, fz0),
+		KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h10, z1)), fx1, fy0, fz1), fadeZ);
+	V n01 = KERNEL_NAME(Mix)(KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h01, z0)), fx0, fy1, fz0),
+		KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h01, z1)), fx0, fy1, fz1), fadeZ);
+	V n11 = KERNEL_NAME(Mix)(KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h11, z0)), fx1, fy1, fz0),
+		KERNEL_NAME(PerlinCorner3)(KERNEL_NAME(Permute)(V_ADD(h11, z1)), fx1, fy1, fz1), fadeZ);
+
+	V n = KERNEL_NAME(Mix)(KERNEL_NAME(Mix)(n00, n01, fadeY), KERNEL_NAME(Mix)(n10, n11, fadeY), fadeX);
+	return V_MUL(V_SET1(2.2f), n);
+}
+
+// Falloff-weighted gradient of one simplex corner
+static inline KERNEL_TARGET V KERNEL_NAME(SimplexCorner2)(V hash, V x, V y)
+{
+	V m = V_MAX(V_SUB(V_SET1(0.5f), V_ADD(V_MUL(x, x), V_MUL(y, y))), V_SET1(0.f));
+	m = V_MUL(m, m);
+	m = V_MUL(m, m);
+
+	V gx = V_SUB(V_MUL(V_SET1(2.f), KERNEL_NAME(Fract)(V_MUL(hash, V_SET1(0.024390243902439f)))), V_SET1(1.f));
+	V h = V_SUB(KERNEL_NAME(Abs)(gx), V_SET1(0.5f));
+	V a0 = V_SUB(gx, V_FLOOR(V_ADD(gx, V_SET1(0.5f))));
+	m = V_MUL(m, KERNEL_NAME(TaylorInvSqrt)(V_ADD(V_MUL(a0, a0), V_MUL(h, h))));
+	return V_MUL(m, V_ADD(V_MUL(a0, x), V_MUL(h, y)));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Simplex2V)(V vx, V vy)
+{
+	V c0 = V_SET1(0.211324865405187f), c1 = V_SET1(0.366025403784439f), c2 = V_SET1(-0.577350269189626f);
+	V zero = V_SET1(0.f), one = V_SET1(1.f);
+
+	V s = V_ADD(V_MUL(vx, c1), V_MUL(vy, c1));
+	V ix = V_FLOOR(V_ADD(vx, s)), iy = V_FLOOR(V_ADD(vy, s));
+	V t = V_ADD(V_MUL(ix, c0), V_MUL(iy, c0));
+	V x0 = V_ADD(V_SUB(vx, ix), t), y0 = V_ADD(V_SUB(vy, iy), t);
+
+	// x0 > y0 ? (1, 0) : (0, 1)
+	V i1x = V_SELECT(V_CMPLT(y0, x0), zero, one);
+	V i1y = V_SUB(one, i1x);
+	V x1 = V_SUB(V_ADD(x0, c0), i1x), y1 = V_SUB(V_ADD(y0, c0), i1y);
+	V x2 = V_ADD(x0, c2), y2 = V_ADD(y0, c2);
+
+	ix = KERNEL_NAME(ModDivide289)(ix);
+	iy = KERNEL_NAME(ModDivide289)(iy);
+	V p0 = KERNEL_NAME(Permute)(V_ADD(KERNEL_NAME(Permute)(iy), ix));
+	V p1 = KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(iy, i1y)), ix), i1x));
+	V p2 = KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(iy, one)), ix), one));
+
+	V n = V_ADD(V_ADD(KERNEL_NAME(SimplexCorner2)(p0, x0, y0), KERNEL_NAME(SimplexCorner2)(p1, x1, y1)),
+		KERNEL_NAME(SimplexCorner2)(p2, x2, y2));
+	return V_MUL(V_SET1(130.f), n);
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(SimplexCorner3)(V hash, V x, V y, V z)
+{
+	// ns = (2/7, 0.5/7 - 1, 1/7), computed like GLM
+	const float n = 0.142857142857f;
+	V nsx = V_SET1(n * 2.f), nsy = V_SET1(n * 0.5f - 1.f), nsz = V_SET1(n);
+
+	V j = V_SUB(hash, V_MUL(V_SET1(49.f), V_FLOOR(V_MUL(V_MUL(hash, nsz), nsz))));
+	V gridX = V_FLOOR(V_MUL(j, nsz));
+	V gridY = V_FLOOR(V_SUB(j, V_MUL(V_SET1(7.f), gridX)));
+	V gx = V_ADD(V_MUL(gridX, nsx), nsy);
+	V gy = V_ADD(V_MUL(gridY, nsx), nsy);
+	V gz = V_SUB(V_SUB(V_SET1(1.f), KERNEL_NAME(Abs)(gx)), KERNEL_NAME(Abs)(gy));
+
+	// Fold the corners of the octahedron: s = floor(b) * 2 + 1, sh = -step(h, 0)
+	V sh = V_SUB(V_SET1(0.f), KERNEL_NAME(Step)(gz, V_SET1(0.f)));
+	gx = V_ADD(gx, V_MUL(V_ADD(V_MUL(V_FLOOR(gx), V_SET1(2.f)), V_SET1(1.f)), sh));
+	gy = V_ADD(gy, V_MUL(V_ADD(V_MUL(V_FLOOR(gy), V_SET1(2.f)), V_SET1(1.f)), sh));
+
+	V norm = KERNEL_NAME(TaylorInvSqrt)(V_ADD(V_ADD(V_MUL(gx, gx), V_MUL(gy, gy)), V_MUL(gz, gz)));
+	V m = V_MAX(V_SUB(V_SET1(0.6f), V_ADD(V_ADD(V_MUL(x, x), V_MUL(y, y)), V_MUL(z, z))), V_SET1(0.f));
+	m = V_MUL(m, m);
+	V dot = V_ADD(V_ADD(V_MUL(V_MUL(gx, norm), x), V_MUL(V_MUL(gy, norm), y)), V_MUL(V_MUL(gz, norm), z));
+	return V_MUL(V_MUL(m, m), dot);
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(Simplex3V)(V vx, V vy, V vz)
+{
+	V third = V_SET1(1.f / 3.f), sixth = V_SET1(1.f / 6.f), half = V_SET1(0.5f);
+	V one = V_SET1(1.f);
+
+	V s = V_ADD(V_ADD(V_MUL(vx, third), V_MUL(vy, third)), V_MUL(vz, third));
+	V ix = V_FLOOR(V_ADD(vx, s)), iy = V_FLOOR(V_ADD(vy, s)), iz = V_FLOOR(V_ADD(vz, s));
+	V t = V_ADD(V_ADD(V_MUL(ix, sixth), V_MUL(iy, sixth)), V_MUL(iz, sixth));
+	V x0 = V_ADD(V_SUB(vx, ix), t), y0 = V_ADD(V_SUB(vy, iy), t), z0 = V_ADD(V_SUB(vz, iz), t);
+
+	// Which simplex: g = step(x0.yzx, x0), i1 = min(g, 1 - g.zxy), i2 = max(g, 1 - g.zxy)
+	V gx = KERNEL_NAME(Step)(y0, x0), gy = KERNEL_NAME(Step)(z0, y0), gz = KERNEL_NAME(Step)(x0, z0);
+	V lx = V_SUB(one, gx), ly = V_SUB(one, gy), lz = V_SUB(one, gz);
+	V i1x = V_MIN(gx, lz), i1y = V_MIN(gy, lx), i1z = V_MIN(gz, ly);
+	V i2x = V_MAX(gx, lz), i2y = V_MAX(gy, lx), i2z = V_MAX(gz, ly);
+
+	ix = KERNEL_NAME(Mod289)(ix);
+	iy = KERNEL_NAME(Mod289)(iy);
+	iz = KERNEL_NAME(Mod289)(iz);
+	V p0 = KERNEL_NAME(Permute)(V_ADD(KERNEL_NAME(Permute)(V_ADD(KERNEL_NAME(Permute)(iz), iy)), ix));
+	V p1 = KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(iz, i1z)), iy), i1y)), ix), i1x));
+	V p2 = KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(iz, i2z)), iy), i2y)), ix), i2x));
+	V p3 = KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(V_ADD(KERNEL_NAME(Permute)(V_ADD(iz, one)), iy), one)), ix), one));
+
+	V n = KERNEL_NAME(SimplexCorner3)(p0, x0, y0, z0);
+	n = V_ADD(n, KERNEL_NAME(SimplexCorner3)(p1, V_ADD(V_SUB(x0, i1x), sixth), V_ADD(V_SUB(y0, i1y), sixth), V_ADD(V_SUB(z0, i1z), sixth)));
+	n = V_ADD(n, KERNEL_NAME(SimplexCorner3)(p2, V_ADD(V_SUB(x0, i2x), third), V_ADD(V_SUB(y0, i2y), third), V_ADD(V_SUB(z0, i2z), third)));
+	n = V_ADD(n, KERNEL_NAME(SimplexCorner3)(p3, V_SUB(x0, half), V_SUB(y0, half), V_SUB(z0, half)));
+	return V_MUL(V_SET1(42.f), n);
+}
+
+#define KERNEL_FBM(noise) \
+	V sum = V_SET1(0.f); \
+	float frequency = fbm.frequency, amplitude = 1.f; \
+	for (int o = 0; o < fbm.octaves; ++o) \
+	{ \
+		V f = V_SET1(frequency); \
+		sum = V_ADD(sum, V_MUL(V_SET1(amplitude), noise)); \
+		frequency *= fbm.lacunarity; \
+		amplitude *= fbm.gain; \
+	}
+
+KERNEL_TARGET void KERNEL_NAME(Perlin2)(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V px = V_LOADU(x + i), py = V_LOADU(y + i);
+		KERNEL_FBM(KERNEL_NAME(Perlin2V)(V_MUL(px, f), V_MUL(py, f)))
+		V_STOREU(out + i, sum);
+	}
+
+	Perlin2Scalar(x + i, y + i, fbm, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(Perlin3)(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V px = V_LOADU(x + i), py = V_LOADU(y + i), pz = V_LOADU(z + i);
+		KERNEL_FBM(KERNEL_NAME(Perlin3V)(V_MUL(px, f), V_MUL(py, f), V_MUL(pz, f)))
+		V_STOREU(out + i, sum);
+	}
+
+	Perlin3Scalar(x + i, y + i, z + i, fbm, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(Simplex2)(const float* x, const float* y, const FbmSettings& fbm, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V px = V_LOADU(x + i), py = V_LOADU(y + i);
+		KERNEL_FBM(KERNEL_NAME(Simplex2V)(V_MUL(px, f), V_MUL(py, f)))
+		V_STOREU(out + i, sum);
+	}
+
+	Simplex2Scalar(x + i, y + i, fbm, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(Simplex3)(const float* x, const float* y, const float* z, const FbmSettings& fbm, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V px = V_LOADU(x + i), py = V_LOADU(y + i), pz = V_LOADU(z + i);
+		KERNEL_FBM(KERNEL_NAME(Simplex3V)(V_MUL(px, f), V_MUL(py, f), V_MUL(pz, f)))
+		V_STOREU(out + i, sum);
+	}
+
+	Simplex3Scalar(x + i, y + i, z + i, fbm, out + i, count - i);
+}
+
+#undef KERNEL_FBM
+
+// Intersections: one register per component, +inf where the ray misses
+
+// Moller-Trumbore, the steps of IntersectTriangle in BatchMath.cpp
+static inline KERNEL_TARGET void KERNEL_NAME(RayTriangle)(V ox, V oy, V oz, V dx, V dy, V dz, V tMax,
+	V x0, V y0, V z0, V x1, V y1, V z1, V x2, V y2, V z2, V& t, V& u, V& v)
+{
+	V e1x = V_SUB(x1, x0), e1y = V_SUB(y1, y0), e1z = V_SUB(z1, z0);
+	V e2x = V_SUB(x2, x0), e2y = V_SUB(y2, y0), e2z = V_SUB(z2, z0);
+	KERNEL_CROSS(dx, dy, dz, e2x, e2y, e2z, px, py, pz)
+	V det = V_MADD(e1x, px, V_MADD(e1y, py, V_MUL(e1z, pz)));
+	V invDet = V_DIV(V_SET1(1.f), det);
+
+	V sx = V_SUB(ox, x0), sy = V_SUB(oy, y0), sz = V_SUB(oz, z0);
+	KERNEL_CROSS(sx, sy, sz, e1x, e1y, e1z, qx, qy, qz)
+	u = V_MUL(V_MADD(sx, px, V_MADD(sy, py, V_MUL(sz, pz))), invDet);
+	v = V_MUL(V_MADD(dx, qx, V_MADD(dy, qy, V_MUL(dz, qz))), invDet);
+	V hit = V_MUL(V_MADD(e2x, qx, V_MADD(e2y, qy, V_MUL(e2z, qz))), invDet);
+
+	// Every bound as one value that is negative when any of them fails
+	V margin = V_MIN(V_MIN(u, v), V_MIN(V_SUB(V_SET1(1.f), V_ADD(u, v)), V_MIN(hit, V_SUB(tMax, hit))));
+	V miss = V_SET1(std::numeric_limits<float>::infinity());
+	hit = V_SELECT(V_CMPLT(margin, V_SET1(0.f)), hit, miss);
+	t = V_SELECT(V_CMPLT(KERNEL_NAME(Abs)(det), V_SET1(std::numeric_limits<float>::epsilon())), hit, miss);
+}
+
+// Slab test on the reciprocal direction, entry clamped to 0
+static inline KERNEL_TARGET V KERNEL_NAME(RayBox)(V ox, V oy, V oz, V ix, V iy, V iz, V tMax,
+	V minX, V minY, V minZ, V maxX, V maxY, V maxZ)
+{
+	V tx0 = V_MUL(V_SUB(minX, ox), ix), tx1 = V_MUL(V_SUB(maxX, ox), ix);
+	V ty0 = V_MUL(V_SUB(minY, oy), iy), ty1 = V_MUL(V_SUB(maxY, oy), iy);
+	V tz0 = V_MUL(V_SUB(minZ, oz), iz), tz1 = V_MUL(V_SUB(maxZ, oz), iz);
+
+	V enter = V_MAX(V_MAX(V_MIN(tx0, tx1), V_MIN(ty0, ty1)), V_MAX(V_MIN(tz0, tz1), V_SET1(0.f)));
+	V exit = V_MIN(V_MIN(V_MAX(tx0, tx1), V_MAX(ty0, ty1)), V_MIN(V_MAX(tz0, tz1), tMax));
+	return V_SELECT(V_CMPLT(exit, enter), enter, V_SET1(std::numeric_limits<float>::infinity()));
+}
+
+KERNEL_TARGET void KERNEL_NAME(IntersectRayTriangles)(const glm::vec3& origin, const glm::vec3& direction, float tMax,
+	const TriangleSoA& triangles, float* t, float* u, float* v, size_t count)
+{
+	V ox = V_SET1(origin.x), oy = V_SET1(origin.y), oz = V_SET1(origin.z);
+	V dx = V_SET1(direction.x), dy = V_SET1(direction.y), dz = V_SET1(direction.z);
+	V limit = V_SET1(tMax);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V hit, hitU, hitV;
+		KERNEL_NAME(RayTriangle)(ox, oy, oz, dx, dy, dz, limit,
+			V_LOADU(triangles.x0 + i), V_LOADU(triangles.y0 + i), V_LOADU(triangles.z0 + i),
+			V_LOADU(triangles.x1 + i), V_LOADU(triangles.y1 + i), V_LOADU(triangles.z1 + i),
+			V_LOADU(triangles.x2 + i), V_LOADU(triangles.y2 + i), V_LOADU(triangles.z2 + i), hit, hitU, hitV);
+		V_STOREU(t + i, hit);
+		V_STOREU(u + i, hitU);
+		V_STOREU(v + i, hitV);
+	}
+
+	IntersectRayTrianglesScalar(origin, direction, tMax, triangles.Offset(i), t + i, u + i, v + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(IntersectRaysTriangle)(const RaySoA& rays, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+	float* t, float* u, float* v, size_t count)
+{
+	V x0 = V_SET1(v0.x), y0 = V_SET1(v0.y), z0 = V_SET1(v0.z);
+	V x1 = V_SET1(v1.x), y1 = V_SET1(v1.y), z1 = V_SET1(v1.z);
+	V x2 = V_SET1(v2.x), y2 = V_SET1(v2.y), z2 = V_SET1(v2.z);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V hit, hitU, hitV;
+		KERNEL_NAME(RayTriangle)(V_LOADU(rays.ox + i), V_LOADU(rays.oy + i), V_LOADU(rays.oz + i),
+			V_LOADU(rays.dx + i), V_LOADU(rays.dy + i), V_LOADU(rays.dz + i), V_LOADU(rays.tMax + i),
+			x0, y0, z0, x1, y1, z1, x2, y2, z2, hit, hitU, hitV);
+		V_STOREU(t + i, hit);
+		V_STOREU(u + i, hitU);
+		V_STOREU(v + i, hitV);
+	}
+
+	IntersectRaysTriangleScalar(rays.Offset(i), v0, v1, v2, t + i, u + i, v + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(IntersectRayBoxes)(const glm::vec3& origin, const glm::vec3& invDirection, float tMax,
+	const BoxSoA& boxes, float* tNear, size_t count)
+{
+	V ox = V_SET1(origin.x), oy = V_SET1(origin.y), oz = V_SET1(origin.z);
+	V ix = V_SET1(invDirection.x), iy = V_SET1(invDirection.y), iz = V_SET1(invDirection.z);
+	V limit = V_SET1(tMax);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V_STOREU(tNear + i, KERNEL_NAME(RayBox)(ox, oy, oz, ix, iy, iz, limit,
+			V_LOADU(boxes.minX + i), V_LOADU(boxes.minY + i), V_LOADU(boxes.minZ + i),
+			V_LOADU(boxes.maxX + i), V_LOADU(boxes.maxY + i), V_LOADU(boxes.maxZ + i)));
+	}
+
+	IntersectRayBoxesScalar(origin, invDirection, tMax, boxes.Offset(i), tNear + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(IntersectRaysBox)(const RaySoA& rays, const glm::vec3& boxMin, const glm::vec3& boxMax,
+	float* tNear, size_t count)
+{
+	V minX = V_SET1(boxMin.x), minY = V_SET1(boxMin.y), minZ = V_SET1(boxMin.z);
+	V maxX = V_SET1(boxMax.x), maxY = V_SET1(boxMax.y), maxZ = V_SET1(boxMax.z);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V_STOREU(tNear + i, KERNEL_NAME(RayBox)(V_LOADU(rays.ox + i), V_LOADU(rays.oy + i), V_LOADU(rays.oz + i),
+			V_LOADU(rays.invDx + i), V_LOADU(rays.invDy + i), V_LOADU(rays.invDz + i), V_LOADU(rays.tMax + i),
+			minX, minY, minZ, maxX, maxY, maxZ));
+	}
+
+	IntersectRaysBoxScalar(rays.Offset(i), boxMin, boxMax, tNear + i, count - i);
+}
+
+// Packing, the gtc/packing.inl conversions step for step
+
+// std::round, halfway cases away from zero, for values well inside int range
+static inline KERNEL_TARGET V KERNEL_NAME(RoundAway)(V x)
+{
+	V whole = V_TRUNC(x);
+	V fraction = V_SUB(x, whole);
+	return V_ADD(whole, V_TRUNC(V_ADD(fraction, fraction)));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(ClampSigned)(V x)
+{
+	return V_MIN(V_MAX(x, V_SET1(-1.f)), V_SET1(1.f));
+}
+
+// detail::toFloat16, one half per 32-bit lane
+static inline KERNEL_TARGET VI KERNEL_NAME(FloatToHalfBits)(V f)
+{
+	VI bits = V_TOBITS(f);
+	VI abs = VI_AND(bits, VI_SET1(0x7FFFFFFF));
+
+	// Normal halves: rebias and add half an ulp, the carry runs into the exponent and past 65504 into Inf
+	VI h = VI_MIN(VI_SRLI(VI_SUB(abs, VI_SET1(0x37FFF000)), 13), VI_SET1(0x7C00));
+
+	// Subnormal halves count steps of 2^-24, rounded half up; under half a step is zero
+	VI steps = V_TOINT(V_FLOOR(V_ADD(V_MUL(V_FROMBITS(abs), V_SET1(16777216.f)), V_SET1(0.5f))));
+	h = VI_SELECT(VI_CMPGT(VI_SET1(0x38800000), abs), h, steps);
+	h = VI_SELECT(VI_CMPGT(VI_SET1(0x33000000), abs), h, VI_SET1(0));
+
+	// Inf, or NaN keeping the top ten payload bits with at least one of them set
+	VI payload = VI_AND(VI_SRLI(abs, 13), VI_SET1(0x3FF));
+	VI special = VI_OR(VI_SET1(0x7C00), payload);
+	VI nan = VI_OR(special, VI_SELECT(VI_CMPEQ(payload, VI_SET1(0)), VI_SET1(0), VI_SET1(1)));
+	special = VI_SELECT(VI_CMPGT(abs, VI_SET1(0x7F800000)), special, nan);
+	h = VI_SELECT(VI_CMPGT(abs, VI_SET1(0x7F7FFFFF)), h, special);
+
+	return VI_OR(h, VI_AND(VI_SRLI(bits, 16), VI_SET1(0x8000)));
+}
+
+// detail::toFloat32, one half per 32-bit lane
+static inline KERNEL_TARGET V KERNEL_NAME(HalfBitsToFloat)(VI h)
+{
+	VI magnitude = VI_AND(h, VI_SET1(0x7FFF));
+
+	// Rebias the exponent; Inf and NaN go from 31 to 255 with the payload as it is
+	VI bits = VI_ADD(VI_SLLI(magnitude, 13), VI_SET1(0x38000000));
+	bits = VI_SELECT(VI_CMPGT(magnitude, VI_SET1(0x7BFF)), bits, VI_ADD(bits, VI_SET1(0x38000000)));
+
+	// Subnormals are a count of 2^-24 steps, exact as a float
+	V f = V_SELECT(VI_CMPGT(VI_SET1(0x400), magnitude), V_FROMBITS(bits), V_MUL(V_FROMINT(magnitude), V_SET1(1.f / 16777216.f)));
+	return V_FROMBITS(VI_OR(V_TOBITS(f), VI_SLLI(VI_AND(h, VI_SET1(0x8000)), 16)));
+}
+
+KERNEL_TARGET void KERNEL_NAME(PackHalf)(const float* in, uint16_t* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V f = V_LOADU(in + i);
+#if KERNEL_F16C
+		// F16C rounds ties to even. Setting the lowest bit of every finite input lifts exact ties just past
+		// the midpoint, so they round away from zero as in GLM, while nothing below a midpoint reaches it
+		VI bits = V_TOBITS(f), abs = VI_AND(bits, VI_SET1(0x7FFFFFFF));
+		V_STOREHALF(out + i, V_FROMBITS(VI_SELECT(VI_CMPGT(VI_SET1(0x7F800000), abs), bits, VI_OR(bits, VI_SET1(1)))));
+
+		// It also quiets signalling NaNs, which GLM passes through
+		if (!M_ANY(VI_CMPGT(abs, VI_SET1(0x7F800000))))
+			continue;
+#endif
+		VI_STOREU16(out + i, KERNEL_NAME(FloatToHalfBits)(f));
+	}
+
+	PackHalfScalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(UnpackHalf)(const uint16_t* in, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		VI h = VI_LOADU16(in + i);
+#if KERNEL_F16C
+		// Exact apart from quieting signalling NaNs
+		if (!M_ANY(VI_CMPGT(VI_AND(h, VI_SET1(0x7FFF)), VI_SET1(0x7C00))))
+		{
+			V_STOREU(out + i, V_LOADHALF(in + i));
+			continue;
+		}
+#endif
+		V_STOREU(out + i, KERNEL_NAME(HalfBitsToFloat)(h));
+	}
+
+	UnpackHalfScalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(PackSnorm16)(const float* in, uint16_t* out, size_t count)
+{
+	V scale = V_SET1(32767.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V q = KERNEL_NAME(RoundAway)(V_MUL(KERNEL_NAME(ClampSigned)(V_LOADU(in + i)), scale));
+		VI_STOREU16(out + i, VI_AND(V_TOINT(q), VI_SET1(0xFFFF)));
+	}
+
+	PackSnorm16Scalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(UnpackSnorm16)(const uint16_t* in, float* out, size_t count)
+{
+	V scale = V_SET1(3.0518509475997192297128208258309e-5f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		VI q = VI_SRAI(VI_SLLI(VI_LOADU16(in + i), 16), 16);
+		V_STOREU(out + i, KERNEL_NAME(ClampSigned)(V_MUL(V_FROMINT(q), scale)));
+	}
+
+	UnpackSnorm16Scalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(PackSnorm3x10_1x2)(const glm::vec4* in, uint32_t* out, size_t count)
+{
+	V scale = V_SET1(511.f);
+	VI low10 = VI_SET1(0x3FF);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		// Lane k takes vectors 4k..4k+3, sixteen floats apart
+		V x = V_LOADLANES(&in[i].x, 16), y = V_LOADLANES(&in[i + 1].x, 16);
+		V z = V_LOADLANES(&in[i + 2].x, 16), w = V_LOADLANES(&in[i + 3].x, 16);
+		KERNEL_NAME(Transpose4)(x, y, z, w);
+
+		VI qx = V_TOINT(KERNEL_NAME(RoundAway)(V_MUL(KERNEL_NAME(ClampSigned)(x), scale)));
+		VI qy = V_TOINT(KERNEL_NAME(RoundAway)(V_MUL(KERNEL_NAME(ClampSigned)(y), scale)));
+		VI qz = V_TOINT(KERNEL_NAME(RoundAway)(V_MUL(KERNEL_NAME(ClampSigned)(z), scale)));
+		VI qw = V_TOINT(KERNEL_NAME(RoundAway)(KERNEL_NAME(ClampSigned)(w)));
+		VI_STOREU(out + i, VI_OR(VI_OR(VI_AND(qx, low10), VI_SLLI(VI_AND(qy, low10), 10)),
+			VI_OR(VI_SLLI(VI_AND(qz, low10), 20), VI_SLLI(qw, 30))));
+	}
+
+	PackSnorm3x10_1x2Scalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(UnpackSnorm3x10_1x2)(const uint32_t* in, glm::vec4* out, size_t count)
+{
+	V scale = V_SET1(1.f / 511.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		// Shifting each field to the top and back sign extends it
+		VI packed = VI_LOADU(in + i);
+		V x = KERNEL_NAME(ClampSigned)(V_MUL(V_FROMINT(VI_SRAI(VI_SLLI(packed, 22), 22)), scale));
+		V y = KERNEL_NAME(ClampSigned)(V_MUL(V_FROMINT(VI_SRAI(VI_SLLI(packed, 12), 22)), scale));
+		V z = KERNEL_NAME(ClampSigned)(V_MUL(V_FROMINT(VI_SRAI(VI_SLLI(packed, 2), 22)), scale));
+		V w = KERNEL_NAME(ClampSigned)(V_FROMINT(VI_SRAI(packed, 30)));
+
+		KERNEL_NAME(Transpose4)(x, y, z, w);
+		V_STORELANES(&out[i].x, 16, x);
+		V_STORELANES(&out[i + 1].x, 16, y);
+		V_STORELANES(&out[i + 2].x, 16, z);
+		V_STORELANES(&out[i + 3].x, 16, w);
+	}
+
+	UnpackSnorm3x10_1x2Scalar(in + i, out + i, count - i);
+}
+
+// detail::floatTo11bit / floatTo10bit: exponent and top mantissa bits moved down without rounding or
+// looking at the sign; 0 and -0 give 0, Inf the Inf pattern and NaN all ones
+static inline KERNEL_TARGET VI KERNEL_NAME(FloatToSmallFloat)(V f, int mantissaBits)
+{
+	int shift = 23 - mantissaBits;
+	VI bits = V_TOBITS(f), abs = VI_AND(bits, VI_SET1(0x7FFFFFFF));
+	VI exponent = VI_AND(VI_SRLI(VI_SUB(VI_AND(bits, VI_SET1(0x7F800000)), VI_SET1(0x38000000)), shift), VI_SET1(0x1F << mantissaBits));
+	VI packed = VI_OR(exponent, VI_AND(VI_SRLI(bits, shift), VI_SET1((1 << mantissaBits) - 1)));
+
+	packed = VI_SELECT(VI_CMPEQ(abs, VI_SET1(0)), packed, VI_SET1(0));
+	packed = VI_SELECT(VI_CMPEQ(abs, VI_SET1(0x7F800000)), packed, VI_SET1(0x1F << mantissaBits));
+	return VI_SELECT(VI_CMPGT(abs, VI_SET1(0x7F800000)), packed, VI_SET1((1 << (mantissaBits + 5)) - 1));
+}
+
+// detail::packed11bitToFloat / packed10bitToFloat of a word shifted down to the field. The special
+// patterns are compared against all of it, and Inf and NaN come back as ~0, which is -1.f
+static inline KERNEL_TARGET V KERNEL_NAME(SmallFloatToFloat)(VI p, int mantissaBits)
+{
+	int shift = 23 - mantissaBits;
+	VI exponent = VI_AND(VI_ADD(VI_SLLI(VI_AND(p, VI_SET1(0x1F << mantissaBits)), shift), VI_SET1(0x38000000)), VI_SET1(0x7F800000));
+	V f = V_FROMBITS(VI_OR(exponent, VI_SLLI(VI_AND(p, VI_SET1((1 << mantissaBits) - 1)), shift)));
+
+	f = V_SELECT(VI_CMPEQ(p, VI_SET1(0)), f, V_SET1(0.f));
+	f = V_SELECT(VI_CMPEQ(p, VI_SET1(0x1F << mantissaBits)), f, V_SET1(-1.f));
+	return V_SELECT(VI_CMPEQ(p, VI_SET1((1 << (mantissaBits + 5)) - 1)), f, V_SET1(-1.f));
+}
+
+KERNEL_TARGET void KERNEL_NAME(PackF2x11_1x10)(const glm::vec3* in, uint32_t* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		const float* src = &in[i].x;
+		V x, y, z;
+		KERNEL_NAME(Deinterleave3)(V_LOADLANES(src, 12), V_LOADLANES(src + 4, 12), V_LOADLANES(src + 8, 12), x, y, z);
+
+		VI_STOREU(out + i, VI_OR(VI_OR(KERNEL_NAME(FloatToSmallFloat)(x, 6), VI_SLLI(KERNEL_NAME(FloatToSmallFloat)(y, 6), 11)),
+			VI_SLLI(KERNEL_NAME(FloatToSmallFloat)(z, 5), 22)));
+	}
+
+	PackF2x11_1x10Scalar(in + i, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(UnpackF2x11_1x10)(const uint32_t* in, glm::vec3* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		VI packed = VI_LOADU(in + i);
+		V x = KERNEL_NAME(SmallFloatToFloat)(packed, 6);
+		V y = KERNEL_NAME(SmallFloatToFloat)(VI_SRLI(packed, 11), 6);
+		V z = KERNEL_NAME(SmallFloatToFloat)(VI_SRLI(packed, 22), 5);
+
+		V a0, a1, a2;
+		KERNEL_NAME(Interleave3)(x, y, z, a0, a1, a2);
+		float* dst = &out[i].x;
+		V_STORELANES(dst, 12, a0);
+		V_STORELANES(dst + 4, 12, a1);
+		V_STORELANES(dst + 8, 12, a2);
+	}
+
+	UnpackF2x11_1x10Scalar(in + i, out + i, count - i);
+}
+
+// Particles
+
+// lowbias32 on every lane, as HashBits in BatchMath.cpp
+static inline KERNEL_TARGET VI KERNEL_NAME(HashBits)(VI x)
+{
+	x = VI_XOR(x, VI_SRLI(x, 16));
+	x = VI_MULLO(x, VI_SET1(0x7FEB352D));
+	x = VI_XOR(x, VI_SRLI(x, 15));
+	x = VI_MULLO(x, VI_SET1((int)0x846CA68Bu));
+	return VI_XOR(x, VI_SRLI(x, 16));
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(HashSigned)(VI key)
+{
+	V top = V_FROMINT(VI_SRLI(KERNEL_NAME(HashBits)(key), 8));
+	return V_SUB(V_MUL(top, V_SET1(1.f / 8388608.f)), V_SET1(1.f));
+}
+
+KERNEL_TARGET void KERNEL_NAME(EmitParticles)(const ParticleEmitter& emitter, uint32_t sequence, const ParticleSoA& out, size_t count)
+{
+	static const int laneIndex[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+	VI lanes = VI_LOADU(laneIndex);
+
+	V px = V_SET1(emitter.position.x), py = V_SET1(emitter.position.y), pz = V_SET1(emitter.position.z);
+	V ex = V_SET1(emitter.extent.x), ey = V_SET1(emitter.extent.y), ez = V_SET1(emitter.extent.z);
+	V vx = V_SET1(emitter.velocity.x), vy = V_SET1(emitter.velocity.y), vz = V_SET1(emitter.velocity.z);
+	V sx = V_SET1(emitter.spread.x), sy = V_SET1(emitter.spread.y), sz = V_SET1(emitter.spread.z);
+	V life = V_SET1(emitter.life), lifeRange = V_SET1(emitter.life * emitter.lifeVariation), zero = V_SET1(0.f);
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		VI key = VI_SLLI(VI_ADD(VI_SET1((int)(sequence + (uint32_t)i)), lanes), 3);
+		V_STOREU(out.x + i, V_MADD(KERNEL_NAME(HashSigned)(key), ex, px));
+		V_STOREU(out.y + i, V_MADD(KERNEL_NAME(HashSigned)(VI_ADD(key, VI_SET1(1))), ey, py));
+		V_STOREU(out.z + i, V_MADD(KERNEL_NAME(HashSigned)(VI_ADD(key, VI_SET1(2))), ez, pz));
+		V_STOREU(out.vx + i, V_MADD(KERNEL_NAME(HashSigned)(VI_ADD(key, VI_SET1(3))), sx, vx));
+		V_STOREU(out.vy + i, V_MADD(KERNEL_NAME(HashSigned)(VI_ADD(key, VI_SET1(4))), sy, vy));
+		V_STOREU(out.vz + i, V_MADD(KERNEL_NAME(HashSigned)(VI_ADD(key, VI_SET1(5))), sz, vz));
+		V_STOREU(out.age + i, zero);
+		V_STOREU(out.life + i, V_MADD(KERNEL_NAME(HashSigned)(VI_ADD(key, VI_SET1(6))), lifeRange, life));
+	}
+
+	EmitParticlesScalar(emitter, sequence + (uint32_t)i, out.Offset(i), count - i);
+}
+
+KERNEL_TARGET size_t KERNEL_NAME(IntegrateParticles)(const ParticleStep& step, const ParticleSoA& particles, size_t count)
+{
+	V gx = V_SET1(step.gravity.x * step.dt), gy = V_SET1(step.gravity.y * step.dt), gz = V_SET1(step.gravity.z * step.dt);
+	V damping = V_SET1(step.Damping()), dt = V_SET1(step.dt);
+	V one = V_SET1(1.f), zero = V_SET1(0.f), dead = zero;
+
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V vx = V_MUL(V_ADD(V_LOADU(particles.vx + i), gx), damping);
+		V vy = V_MUL(V_ADD(V_LOADU(particles.vy + i), gy), damping);
+		V vz = V_MUL(V_ADD(V_LOADU(particles.vz + i), gz), damping);
+		V_STOREU(particles.vx + i, vx);
+		V_STOREU(particles.vy + i, vy);
+		V_STOREU(particles.vz + i, vz);
+		V_STOREU(particles.x + i, V_MADD(vx, dt, V_LOADU(particles.x + i)));
+		V_STOREU(particles.y + i, V_MADD(vy, dt, V_LOADU(particles.y + i)));
+		V_STOREU(particles.z + i, V_MADD(vz, dt, V_LOADU(particles.z + i)));
+
+		// Counted per lane as floats, exact up to 2^24 blocks
+		V age = V_ADD(V_LOADU(particles.age + i), dt);
+		V_STOREU(particles.age + i, age);
+		dead = V_ADD(dead, V_SELECT(V_CMPLT(age, V_LOADU(particles.life + i)), one, zero));
+	}
+
+	float lanes[KERNEL_WIDTH];
+	V_STOREU(lanes, dead);
+	size_t total = 0;
+	for (int k = 0; k < KERNEL_WIDTH; ++k)
+		total += (size_t)lanes[k];
+
+	return total + IntegrateParticlesScalar(step, particles.Offset(i), count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(PackParticles)(const ParticleSoA& particles, glm::vec4* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + KERNEL_WIDTH <= count; i += KERNEL_WIDTH)
+	{
+		V x = V_LOADU(particles.x + i), y = V_LOADU(particles.y + i), z = V_LOADU(particles.z + i);
+		V t = V_DIV(V_LOADU(particles.age + i), V_LOADU(particles.life + i));
+		KERNEL_NAME(Transpose4)(x, y, z, t);
+
+		float* dst = &out[i].x;
+		V_STORELANES(dst, 16, x);
+		V_STORELANES(dst + 4, 16, y);
+		V_STORELANES(dst + 8, 16, z);
+		V_STORELANES(dst + 12, 16, t);
+	}
+
+	PackParticlesScalar(particles.Offset(i), out + i, count - i);
+}
+
+// Random numbers: the RANDOM_LANES generators take KERNEL_RANDOM_REGS registers per state word
+
+#define KERNEL_RANDOM_REGS (RANDOM_LANES / KERNEL_WIDTH)
+
+static inline KERNEL_TARGET void KERNEL_NAME(LoadRandom)(const RandomState& state, VI s[KERNEL_RANDOM_REGS][4])
+{
+	for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+		for (int w = 0; w < 4; ++w)
+			s[r][w] = VI_LOADU(state.s[w] + r * KERNEL_WIDTH);
+}
+
+static inline KERNEL_TARGET void KERNEL_NAME(StoreRandom)(VI s[KERNEL_RANDOM_REGS][4], RandomState& state)
+{
+	for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+		for (int w = 0; w < 4; ++w)
+			VI_STOREU(state.s[w] + r * KERNEL_WIDTH, s[r][w]);
+}
+
+// xoshiro128**, as RandomStep in BatchMath.cpp. The multiplies by 5 and 9 are shifts and adds
+static inline KERNEL_TARGET VI KERNEL_NAME(RandomNext)(VI s[4])
+{
+	VI s1 = s[1];
+	VI x = VI_ADD(s1, VI_SLLI(s1, 2));
+	x = VI_OR(VI_SLLI(x, 7), VI_SRLI(x, 25));
+	VI result = VI_ADD(x, VI_SLLI(x, 3));
+
+	VI t = VI_SLLI(s1, 9);
+	s[2] = VI_XOR(s[2], s[0]);
+	s[3] = VI_XOR(s[3], s1);
+	s[1] = VI_XOR(s1, s[2]);
+	s[0] = VI_XOR(s[0], s[3]);
+	s[2] = VI_XOR(s[2], t);
+	s[3] = VI_OR(VI_SLLI(s[3], 11), VI_SRLI(s[3], 21));
+	return result;
+}
+
+static inline KERNEL_TARGET V KERNEL_NAME(RandomUnit)(VI bits)
+{
+	return V_MUL(V_FROMINT(VI_SRLI(bits, 8)), V_SET1(1.f / 16777216.f));
+}
+
+// Angle in [0, 2 pi)
+static inline KERNEL_TARGET void KERNEL_NAME(RandomSinCos)(VI bits, V& s, V& c)
+{
+	KERNEL_NAME(SinCosV)(V_MUL(KERNEL_NAME(RandomUnit)(bits), V_SET1(FastTrig::TWO_PI)), s, c);
+}
+
+KERNEL_TARGET void KERNEL_NAME(RandomBits)(RandomState& state, uint32_t* out, size_t count)
+{
+	VI s[KERNEL_RANDOM_REGS][4];
+	KERNEL_NAME(LoadRandom)(state, s);
+
+	size_t i = 0;
+	for (; i + RANDOM_LANES <= count; i += RANDOM_LANES)
+		for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+			VI_STOREU(out + i + r * KERNEL_WIDTH, KERNEL_NAME(RandomNext)(s[r]));
+
+	KERNEL_NAME(StoreRandom)(s, state);
+	RandomBitsScalar(state, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(RandomUniform)(RandomState& state, float low, float high, float* out, size_t count)
+{
+	VI s[KERNEL_RANDOM_REGS][4];
+	KERNEL_NAME(LoadRandom)(state, s);
+	V base = V_SET1(low), range = V_SET1(high - low);
+
+	size_t i = 0;
+	for (; i + RANDOM_LANES <= count; i += RANDOM_LANES)
+		for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+			V_STOREU(out + i + r * KERNEL_WIDTH, V_MADD(KERNEL_NAME(RandomUnit)(KERNEL_NAME(RandomNext)(s[r])), range, base));
+
+	KERNEL_NAME(StoreRandom)(s, state);
+	RandomUniformScalar(state, low, high, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(RandomGaussian)(RandomState& state, float mean, float deviation, float* out, size_t count)
+{
+	VI s[KERNEL_RANDOM_REGS][4];
+	KERNEL_NAME(LoadRandom)(state, s);
+	V mu = V_SET1(mean), sigma = V_SET1(deviation);
+
+	size_t i = 0;
+	for (; i + 2 * RANDOM_LANES <= count; i += 2 * RANDOM_LANES)
+	{
+		for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+		{
+			VI u = KERNEL_NAME(RandomNext)(s[r]);
+			VI v = KERNEL_NAME(RandomNext)(s[r]);
+
+			V unit = V_MUL(V_FROMINT(VI_ADD(VI_SRLI(u, 8), VI_SET1(1))), V_SET1(1.f / 16777216.f));
+			V radius = V_MUL(V_SQRT(V_MUL(V_SET1(-2.f), KERNEL_NAME(LogV)(unit))), sigma);
+			V sinA, cosA;
+			KERNEL_NAME(RandomSinCos)(v, sinA, cosA);
+			V_STOREU(out + i + r * KERNEL_WIDTH, V_MADD(radius, cosA, mu));
+			V_STOREU(out + i + RANDOM_LANES + r * KERNEL_WIDTH, V_MADD(radius, sinA, mu));
+		}
+	}
+
+	KERNEL_NAME(StoreRandom)(s, state);
+	RandomGaussianScalar(state, mean, deviation, out + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(RandomSphere)(RandomState& state, float radius, float* x, float* y, float* z, size_t count)
+{
+	VI s[KERNEL_RANDOM_REGS][4];
+	KERNEL_NAME(LoadRandom)(state, s);
+	V scale = V_SET1(radius), one = V_SET1(1.f), zero = V_SET1(0.f);
+
+	size_t i = 0;
+	for (; i + RANDOM_LANES <= count; i += RANDOM_LANES)
+	{
+		for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+		{
+			VI u = KERNEL_NAME(RandomNext)(s[r]);
+			VI v = KERNEL_NAME(RandomNext)(s[r]);
+
+			V height = V_MADD(V_SET1(-2.f), KERNEL_NAME(RandomUnit)(u), one);
+			V ring = V_MUL(V_SQRT(V_MAX(zero, V_SUB(one, V_MUL(height, height)))), scale);
+			V sinA, cosA;
+			KERNEL_NAME(RandomSinCos)(v, sinA, cosA);
+			size_t at = i + r * KERNEL_WIDTH;
+			V_STOREU(x + at, V_MUL(ring, cosA));
+			V_STOREU(y + at, V_MUL(ring, sinA));
+			V_STOREU(z + at, V_MUL(height, scale));
+		}
+	}
+
+	KERNEL_NAME(StoreRandom)(s, state);
+	RandomSphereScalar(state, radius, x + i, y + i, z + i, count - i);
+}
+
+KERNEL_TARGET void KERNEL_NAME(RandomDisk)(RandomState& state, float radius, float* x, float* y, size_t count)
+{
+	VI s[KERNEL_RANDOM_REGS][4];
+	KERNEL_NAME(LoadRandom)(state, s);
+	V scale = V_SET1(radius);
+
+	size_t i = 0;
+	for (; i + RANDOM_LANES <= count; i += RANDOM_LANES)
+	{
+		for (int r = 0; r < KERNEL_RANDOM_REGS; ++r)
+		{
+			VI u = KERNEL_NAME(RandomNext)(s[r]);
+			VI v = KERNEL_NAME(RandomNext)(s[r]);
+
+			V distance = V_MUL(V_SQRT(KERNEL_NAME(RandomUnit)(u)), scale);
+			V sinA, cosA;
+			KERNEL_NAME(RandomSinCos)(v, sinA, cosA);
+			V_STOREU(x + i + r * KERNEL_WIDTH, V_MUL(distance, cosA));
+			V_STOREU(y + i + r * KERNEL_WIDTH, V_MUL(distance, sinA));
+		}
+	}
+
+	KERNEL_NAME(StoreRandom)(s, state);
+	RandomDiskScalar(state, radius, x + i, y + i, count - i);
+}
+
+#undef KERNEL_RANDOM_REGS
+
+#undef KERNEL_CROSS
+#undef KERNEL_WIDTH
+#undef KERNEL_NAME
+#undef KERNEL_NAME2
+#undef KERNEL_NAME3
@@ -0,0 +1,427 @@
+#include "BatchMath.h"
+
+#include <limits>
+
+#if SIMD_X86
+
+namespace BatchMath
+{
+	// SSE4.1, one lane
+
+	#define KERNEL_SUFFIX SSE4
+	#define KERNEL_TARGET SIMD_TARGET_SSE4
+	#define KERNEL_LANES 1
+	#define V __m128
+	#define V_SET1(f) _mm_set1_ps(f)
+	#define V_ADD(a, b) _mm_add_ps(a, b)
+	#define V_SUB(a, b) _mm_sub_ps(a, b)
+	#define V_MUL(a, b) _mm_mul_ps(a, b)
+	#define V_DIV(a, b) _mm_div_ps(a, b)
+	#define V_MADD(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+	#define V_LOADU(p) _mm_loadu_ps(p)
+	#define V_STOREU(p, v) _mm_storeu_ps(p, v)
+	#define V_PERMUTE(v, imm) _mm_shuffle_ps(v, v, imm)
+	#define V_SHUFFLE(a, b, imm) _mm_shuffle_ps(a, b, imm)
+	#define V_BLEND(a, b, imm) _mm_blend_ps(a, b, imm)
+	#define V_UNPACKLO(a, b) _mm_unpacklo_ps(a, b)
+	#define V_UNPACKHI(a, b) _mm_unpackhi_ps(a, b)
+	#define V_BROADCAST4(p) _mm_loadu_ps(p)
+	#define V_LOADLANES(p, stride) _mm_loadu_ps(p)
+	#define V_STORELANES(p, stride, v) _mm_storeu_ps(p, v)
+	#define V_LOADLANESP(p0, p1, p2, p3) _mm_loadu_ps(p0)
+
+	#define M __m128
+	#define VI __m128i
+	#define V_SQRT(a) _mm_sqrt_ps(a)
+	#define V_MIN(a, b) _mm_min_ps(a, b)
+	#define V_MAX(a, b) _mm_max_ps(a, b)
+	#define V_AND(a, b) _mm_and_ps(a, b)
+	#define V_XOR(a, b) _mm_xor_ps(a, b)
+	#define V_ROUND(a) _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+	#define V_FLOOR(a) _mm_floor_ps(a)
+	#define V_CMPLT(a, b) _mm_cmplt_ps(a, b)
+	#define V_SELECT(m, a, b) _mm_blendv_ps(a, b, m)
+	#define V_TOINT(a) _mm_cvtps_epi32(a)
+	#define V_FROMBITS(i) _mm_castsi128_ps(i)
+	#define VI_SET1(i) _mm_set1_epi32(i)
+	#define VI_ADD(a, b) _mm_add_epi32(a, b)
+	#define VI_AND(a, b) _mm_and_si128(a, b)
+	#define VI_SLLI(a, n) _mm_slli_epi32(a, n)
+	#define VI_TEST(a, bit) _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, _mm_set1_epi32(bit)), _mm_set1_epi32(bit)))
+	#define V_FROMINT(i) _mm_cvtepi32_ps(i)
+	#define VI_LOADU16(p) _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(p)))
+	#define KERNEL_F16C 0
+	#define V_TRUNC(a) _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+	#define V_TOBITS(v) _mm_castps_si128(v)
+	#define VI_OR(a, b) _mm_or_si128(a, b)
+	#define VI_SUB(a, b) _mm_sub_epi32(a, b)
+	#define VI_SRLI(a, n) _mm_srli_epi32(a, n)
+	#define VI_SRAI(a, n) _mm_srai_epi32(a, n)
+	#define VI_MIN(a, b) _mm_min_epi32(a, b)
+	#define VI_CMPEQ(a, b) _mm_castsi128_ps(_mm_cmpeq_epi32(a, b))
+	#define VI_CMPGT(a, b) _mm_castsi128_ps(_mm_cmpgt_epi32(a, b))
+	#define VI_SELECT(m, a, b) _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), m))
+	#define VI_LOADU(p) _mm_loadu_si128((const __m128i*)(p))
+	#define VI_STOREU(p, v) _mm_storeu_si128((__m128i*)(p), v)
+	#define VI_STOREU16(p, v) _mm_storel_epi64((__m128i*)(p), _mm_packus_epi32(v, v))
+	#define M_ANY(m) (_mm_movemask_ps(m) != 0)
+	#define VI_XOR(a, b) _mm_xor_si128(a, b)
+	#define VI_MULLO(a, b) _mm_mullo_epi32(a, b)
+
+	#include "BatchMathKernels.inl"
+
+	#undef KERNEL_SUFFIX
+	#undef KERNEL_TARGET
+	#undef KERNEL_LANES
+	#undef V
+	#undef V_SET1
+	#undef V_ADD
+	#undef V_SUB
+	#undef V_MUL
+	#undef V_DIV
+	#undef V_MADD
+	#undef V_LOADU
+	#undef V_STOREU
+	#undef V_PERMUTE
+	#undef V_SHUFFLE
+	#undef V_BLEND
+	#undef V_UNPACKLO
+	#undef V_UNPACKHI
+	#undef V_BROADCAST4
+	#undef V_LOADLANES
+	#undef V_STORELANES
+	#undef V_LOADLANESP
+	#undef M
+	#undef VI
+	#undef V_SQRT
+	#undef V_MIN
+	#undef V_MAX
+	#undef V_AND
+	#undef V_XOR
+	#undef V_ROUND
+	#undef V_FLOOR
+	#undef V_CMPLT
+	#undef V_SELECT
+	#undef V_TOINT
+	#undef V_FROMBITS
+	#undef VI_SET1
+	#undef VI_ADD
+	#undef VI_AND
+	#undef VI_SLLI
+	#undef VI_TEST
+	#undef V_FROMINT
+	#undef VI_LOADU16
+	#undef KERNEL_F16C
+	#undef V_TRUNC
+	#undef V_TOBITS
+	#undef VI_OR
+	#undef VI_SUB
+	#undef VI_SRLI
+	#undef VI_SRAI
+	#undef VI_MIN
+	#undef VI_CMPEQ
+	#undef VI_CMPGT
+	#undef VI_SELECT
+	#undef VI_LOADU
+	#undef VI_STOREU
+	#undef VI_STOREU16
+	#undef M_ANY
+	#undef VI_XOR
+	#undef VI_MULLO
+
+	// AVX2 + FMA, two lanes
+
+	static inline SIMD_TARGET_AVX2 __m256 LoadLanesAVX2(const float* p, size_t stride)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + stride), 1);
+	}
+
+	static inline SIMD_TARGET_AVX2 __m256 LoadLanesAVX2(const float* p0, const float* p1)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p0)), _mm_loadu_ps(p1), 1);
+	}
+
+	static inline SIMD_TARGET_AVX2 void StoreLanesAVX2(float* p, size_t stride, __m256 v)
+	{
+		_mm_storeu_ps(p, _mm256_castps256_ps128(v));
+		_mm_storeu_ps(p + stride, _mm256_extractf128_ps(v, 1));
+	}
+
+	#define KERNEL_SUFFIX AVX2
+	#define KERNEL_TARGET SIMD_TARGET_AVX2
+	#define KERNEL_LANES 2
+	#define V __m256
+	#define V_SET1(f) _mm256_set1_ps(f)
+	#define V_ADD(a, b) _mm256_add_ps(a, b)
+	#define V_SUB(a, b) _mm256_sub_ps(a, b)
+	#define V_MUL(a, b) _mm256_mul_ps(a, b)
+	#define V_DIV(a, b) _mm256_div_ps(a, b)
+	#define V_MADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+	#define V_LOADU(p) _mm256_loadu_ps(p)
+	#define V_STOREU(p, v) _mm256_storeu_ps(p, v)
+	#define V_PERMUTE(v, imm) _mm256_permute_ps(v, imm)
+	#define V_SHUFFLE(a, b, imm) _mm256_shuffle_ps(a, b, imm)
+	#define V_BLEND(a, b, imm) _mm256_blend_ps(a, b, (imm) | ((imm) << 4))
+	#define V_UNPACKLO(a, b) _mm256_unpacklo_ps(a, b)
+	#define V_UNPACKHI(a, b) _mm256_unpackhi_ps(a, b)
+	#define V_BROADCAST4(p) _mm256_broadcast_ps((const __m128*)(p))
+	#define V_LOADLANES(p, stride) LoadLanesAVX2(p, stride)
+	#define V_STORELANES(p, stride, v) StoreLanesAVX2(p, stride, v)
+	#define V_LOADLANESP(p0, p1, p2, p3) LoadLanesAVX2(p0, p1)
+
+	#define M __m256
+	#define VI __m256i
+	#define V_SQRT(a) _mm256_sqrt_ps(a)
+	#define V_MIN(a, b) _mm256_min_ps(a, b)
+	#define V_MAX(a, b) _mm256_max_ps(a, b)
+	#define V_AND(a, b) _mm256_and_ps(a, b)
+	#define V_XOR(a, b) _mm256_xor_ps(a, b)
+	#define V_ROUND(a) _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+	#define V_FLOOR(a) _mm256_floor_ps(a)
+	#define V_CMPLT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+	#define V_SELECT(m, a, b) _mm256_blendv_ps(a, b, m)
+	#define V_TOINT(a) _mm256_cvtps_epi32(a)
+	#define V_FROMBITS(i) _mm256_castsi256_ps(i)
+	#define VI_SET1(i) _mm256_set1_epi32(i)
+	#define VI_ADD(a, b) _mm256_add_epi32(a, b)
+	#define VI_AND(a, b) _mm256_and_si256(a, b)
+	#define VI_SLLI(a, n) _mm256_slli_epi32(a, n)
+	#define VI_TEST(a, bit) _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, _mm256_set1_epi32(bit)), _mm256_set1_epi32(bit)))
+	#define V_FROMINT(i) _mm256_cvtepi32_ps(i)
+	#define VI_LOADU16(p) _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p)))
+	#define KERNEL_F16C 1
+	#define V_TRUNC(a) _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+	#define V_TOBITS(v) _mm256_castps_si256(v)
+	#define VI_OR(a, b) _mm256_or_si256(a, b)
+	#define VI_SUB(a, b) _mm256_sub_epi32(a, b)
+	#define VI_SRLI(a, n) _mm256_srli_epi32(a, n)
+	#define VI_SRAI(a, n) _mm256_srai_epi32(a, n)
+	#define VI_MIN(a, b) _mm256_min_epi32(a, b)
+	#define VI_CMPEQ(a, b) _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))
+	#define VI_CMPGT(a, b) _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))
+	#define VI_SELECT(m, a, b) _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), m))
+	#define VI_LOADU(p) _mm256_loadu_si256((const __m256i*)(p))
+	#define VI_STOREU(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+	#define VI_STOREU16(p, v) _mm_storeu_si128((__m128i*)(p), _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08)))
+	#define M_ANY(m) (_mm256_movemask_ps(m) != 0)
+	#define VI_XOR(a, b) _mm256_xor_si256(a, b)
+	#define VI_MULLO(a, b) _mm256_mullo_epi32(a, b)
+	#define V_LOADHALF(p) _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(p)))
+	#define V_STOREHALF(p, v) _mm_storeu_si128((__m128i*)(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT))
+
+	#include "BatchMathKernels.inl"
+
+	#undef KERNEL_SUFFIX
+	#undef KERNEL_TARGET
+	#undef KERNEL_LANES
+	#undef V
+	#undef V_SET1
+	#undef V_ADD
+	#undef V_SUB
+	#undef V_MUL
+	#undef V_DIV
+	#undef V_MADD
+	#undef V_LOADU
+	#undef V_STOREU
+	#undef V_PERMUTE
+	#undef V_SHUFFLE
+	#undef V_BLEND
+	#undef V_UNPACKLO
+	#undef V_UNPACKHI
+	#undef V_BROADCAST4
+	#undef V_LOADLANES
+	#undef V_STORELANES
+	#undef V_LOADLANESP
+	#undef M
+	#undef VI
+	#undef V_SQRT
+	#undef V_MIN
+	#undef V_MAX
+	#undef V_AND
+	#undef V_XOR
+	#undef V_ROUND
+	#undef V_FLOOR
+	#undef V_CMPLT
+	#undef V_SELECT
+	#undef V_TOINT
+	#undef V_FROMBITS
+	#undef VI_SET1
+	#undef VI_ADD
+	#undef VI_AND
+	#undef VI_SLLI
+	#undef VI_TEST
+	#undef V_FROMINT
+	#undef VI_LOADU16
+	#undef KERNEL_F16C
+	#undef V_TRUNC
+	#undef V_TOBITS
+	#undef VI_OR
+	#undef VI_SUB
+	#undef VI_SRLI
+	#undef VI_SRAI
+	#undef VI_MIN
+	#undef VI_CMPEQ
+	#undef VI_CMPGT
+	#undef VI_SELECT
+	#undef VI_LOADU
+	#undef VI_STOREU
+	#undef VI_STOREU16
+	#undef M_ANY
+	#undef VI_XOR
+	#undef VI_MULLO
+	#undef V_LOADHALF
+	#undef V_STOREHALF
+
+	// AVX-512F, four lanes
+
+	static inline SIMD_TARGET_AVX512 __m512 LoadLanesAVX512(const float* p, size_t stride)
+	{
+		__m512 v = _mm512_castps128_ps512(_mm_loadu_ps(p));
+		v = _mm512_insertf32x4(v, _mm_loadu_ps(p + stride), 1);
+		v = _mm512_insertf32x4(v, _mm_loadu_ps(p + 2 * stride), 2);
+		return _mm512_insertf32x4(v, _mm_loadu_ps(p + 3 * stride), 3);
+	}
+
+	static inline SIMD_TARGET_AVX512 __m512 LoadLanesAVX512(const float* p0, const float* p1, const float* p2, const float* p3)
+	{
+		__m512 v = _mm512_castps128_ps512(_mm_loadu_ps(p0));
+		v = _mm512_insertf32x4(v, _mm_loadu_ps(p1), 1);
+		v = _mm512_insertf32x4(v, _mm_loadu_ps(p2), 2);
+		return _mm512_insertf32x4(v, _mm_loadu_ps(p3), 3);
+	}
+
+	static inline SIMD_TARGET_AVX512 void StoreLanesAVX512(float* p, size_t stride, __m512 v)
+	{
+		_mm_storeu_ps(p, _mm512_castps512_ps128(v));
+		_mm_storeu_ps(p + stride, _mm512_extractf32x4_ps(v, 1));
+		_mm_storeu_ps(p + 2 * stride, _mm512_extractf32x4_ps(v, 2));
+		_mm_storeu_ps(p + 3 * stride, _mm512_extractf32x4_ps(v, 3));
+	}
+
+	#define KERNEL_SUFFIX AVX512
+	#define KERNEL_TARGET SIMD_TARGET_AVX512
+	#define KERNEL_LANES 4
+	#define V __m512
+	#define V_SET1(f) _mm512_set1_ps(f)
+	#define V_ADD(a, b) _mm512_add_ps(a, b)
+	#define V_SUB(a, b) _mm512_sub_ps(a, b)
+	#define V_MUL(a, b) _mm512_mul_ps(a, b)
+	#define V_DIV(a, b) _mm512_div_ps(a, b)
+	#define V_MADD(a, b, c) _mm512_fmadd_ps(a, b, c)
+	#define V_LOADU(p) _mm512_loadu_ps(p)
+	#define V_STOREU(p, v) _mm512_storeu_ps(p, v)
+	#define V_PERMUTE(v, imm) _mm512_permute_ps(v, imm)
+	#define V_SHUFFLE(a, b, imm) _mm512_shuffle_ps(a, b, imm)
+	#define V_BLEND(a, b, imm) _mm512_mask_blend_ps((__mmask16)((imm) * 0x1111), a, b)
+	#define V_UNPACKLO(a, b) _mm512_unpacklo_ps(a, b)
+	#define V_UNPACKHI(a, b) _mm512_unpackhi_ps(a, b)
+	#define V_BROADCAST4(p) _mm512_broadcast_f32x4(_mm_loadu_ps(p))
+	#define V_LOADLANES(p, stride) LoadLanesAVX512(p, stride)
+	#define V_STORELANES(p, stride, v) StoreLanesAVX512(p, stride, v)
+	#define V_LOADLANESP(p0, p1, p2, p3) LoadLanesAVX512(p0, p1, p2, p3)
+
+	#define M __mmask16
+	#define VI __m512i
+	#define V_SQRT(a) _mm512_sqrt_ps(a)
+	#define V_MIN(a, b) _mm512_min_ps(a, b)
+	#define V_MAX(a, b) _mm512_max_ps(a, b)
+	#define V_AND(a, b) _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+	#define V_XOR(a, b) _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+	#define V_ROUND(a) _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+	#define V_FLOOR(a) _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)
+	#define V_CMPLT(a, b) _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)
+	#define V_SELECT(m, a, b) _mm512_mask_blend_ps(m, a, b)
+	#define V_TOINT(a) _mm512_cvtps_epi32(a)
+	#define V_FROMBITS(i) _mm512_castsi512_ps(i)
+	#define VI_SET1(i) _mm512_set1_epi32(i)
+	#define VI_ADD(a, b) _mm512_add_epi32(a, b)
+	#define VI_AND(a, b) _mm512_and_si512(a, b)
+	#define VI_SLLI(a, n) _mm512_slli_epi32(a, n)
+	#define VI_TEST(a, bit) _mm512_test_epi32_mask(a, _mm512_set1_epi32(bit))
+	#define V_FROMINT(i) _mm512_cvtepi32_ps(i)
+	#define VI_LOADU16(p) _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(p)))
+	#define KERNEL_F16C 1
+	#define V_TRUNC(a) _mm512_roundscale_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+	#define V_TOBITS(v) _mm512_castps_si512(v)
+	#define VI_OR(a, b) _mm512_or_si512(a, b)
+	#define VI_SUB(a, b) _mm512_sub_epi32(a, b)
+	#define VI_SRLI(a, n) _mm512_srli_epi32(a, n)
+	#define VI_SRAI(a, n) _mm512_srai_epi32(a, n)
+	#define VI_MIN(a, b) _mm512_min_epi32(a, b)
+	#define VI_CMPEQ(a, b) _mm512_cmpeq_epi32_mask(a, b)
+	#define VI_CMPGT(a, b) _mm512_cmpgt_epi32_mask(a, b)
+	#define VI_SELECT(m, a, b) _mm512_mask_blend_epi32(m, a, b)
+	#define VI_LOADU(p) _mm512_loadu_si512(p)
+	#define VI_STOREU(p, v) _mm512_storeu_si512(p, v)
+	#define VI_STOREU16(p, v) _mm256_storeu_si256((__m256i*)(p), _mm512_cvtepi32_epi16(v))
+	#define M_ANY(m) ((m) != 0)
+	#define VI_XOR(a, b) _mm512_xor_si512(a, b)
+	#define VI_MULLO(a, b) _mm512_mullo_epi32(a, b)
+	#define V_LOADHALF(p) _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(p)))
+	#define V_STOREHALF(p, v) _mm256_storeu_si256((__m256i*)(p), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT))
+
+	#include "BatchMathKernels.inl"
+
+	#undef KERNEL_SUFFIX
+	#undef KERNEL_TARGET
+	#undef KERNEL_LANES
+	#undef V
+	#undef V_SET1
+	#undef V_ADD
+	#undef V_SUB
+	#undef V_MUL
+	#undef V_DIV
+	#undef V_MADD
+	#undef V_LOADU
+	#undef V_STOREU
+	#undef V_PERMUTE
+	#undef V_SHUFFLE
+	#undef V_BLEND
+	#undef V_UNPACKLO
+	#undef V_UNPACKHI
+	#undef V_BROADCAST4
+	#undef V_LOADLANES
+	#undef V_STORELANES
+	#undef V_LOADLANESP
+	#undef M
+	#undef VI
+	#undef V_SQRT
+	#undef V_MIN
+	#undef V_MAX
+	#undef V_AND
+	#undef V_XOR
+	#undef V_ROUND
+	#undef V_FLOOR
+	#undef V_CMPLT
+	#undef V_SELECT
+	#undef V_TOINT
+	#undef V_FROMBITS
+	#undef VI_SET1
+	#undef VI_ADD
+	#undef VI_AND
+	#undef VI_SLLI
+	#undef VI_TEST
+	#undef V_FROMINT
+	#undef VI_LOADU16
+	#undef KERNEL_F16C
+	#undef V_TRUNC
+	#undef V_TOBITS
+	#undef VI_OR
+	#undef VI_SUB
+	#undef VI_SRLI
+	#undef VI_SRAI
+	#undef VI_MIN
+	#undef VI_CMPEQ
+	#undef VI_CMPGT
+	#undef VI_SELECT
+	#undef VI_LOADU
+	#undef VI_STOREU
+	#undef VI_STOREU16
+	#undef M_ANY
+	#undef VI_XOR
+	#undef VI_MULLO
+	#undef V_LOADHALF
+	#undef V_STOREHALF
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+/**	Tiny timing helpers for the --bench mode
+ *
+ *	Measure runs the body a few times and keeps the fastest run, which is the
+ *	most repeatable number on a machine that is doing other things too.
+ */
+
+namespace Benchmark
+{
+	template <typename Body>
+	double Measure(Body body, int repeats = 5)
+	{
+		double best = 1e30;
+		for (int i = 0; i < repeats; ++i)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			body();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (seconds < best)
+				best = seconds;
+		}
+		return best;
+	}
+
+	// Keeps the optimiser from dropping results nobody reads
+	template <typename T>
+	void Consume(const T& value)
+	{
+		static volatile unsigned char sink;
+		sink = sink + *(const volatile unsigned char*)&value;
+	}
+
+	inline void Report(const char* name, double seconds, double items, const char* unit = "M items/s")
+	{
+		printf("  %-36s %9.3f ms  %10.2f %s\n", name, seconds * 1000.0, items / seconds * 1e-6, unit);
+	}
+}
@@ -0,0 +1,1413 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/random.hpp>
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm/gtx/intersect.hpp>
+
+#include "Benchmark.h"
+#include "BatchMath.h"
+#include "CompressedClip.h"
+#include "ConstTransform.h"
+#include "HalfFloat.h"
+#include "JobSystem.h"
+#include "Noise.h"
+#include "Random.h"
+#include "Skeleton.h"
+#include "SpatialHash.h"
+#include "Transform.h"
+
+namespace
+{
+	// Distance in representable floats between the result and the correctly rounded reference
+	double UlpError(float value, double reference)
+	{
+		float rounded = (float)reference;
+		int a, b;
+		memcpy(&a, &value, sizeof(a));
+		memcpy(&b, &rounded, sizeof(b));
+		long long orderedA = a < 0 ? (long long)INT_MIN - a : a;
+		long long orderedB = b < 0 ? (long long)INT_MIN - b : b;
+		return (double)(orderedA > orderedB ? orderedA - orderedB : orderedB - orderedA);
+	}
+
+	// Elements that differ in any bit
+	template <typename T>
+	size_t CountDifferent(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		size_t different = 0;
+		for (size_t i = 0; i < a.size(); ++i)
+			different += memcmp(&a[i], &b[i], sizeof(T)) != 0;
+		return different;
+	}
+
+	float MaxDifference(const ConstMat4& a, const glm::mat4& b)
+	{
+		float difference = 0.f;
+		for (int c = 0; c < 4; ++c)
+			for (int r = 0; r < 4; ++r)
+				difference = std::max(difference, std::fabs(a.m[c][r] - b[c][r]));
+		return difference;
+	}
+
+	float Random(unsigned& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) * (1.f / 16777216.f) * 2.f - 1.f;
+	}
+
+	// Stand-in for captured motion: a moving root, every joint rotating on a few
+	// harmonics of the loop, one in four joints still, two joints squashing
+	AnimationClip BuildMotionClip(int jointCount, int keyCount)
+	{
+		const float twoPi = 6.28318531f;
+		unsigned state = 7u;
+		AnimationClip clip(jointCount, keyCount, 30.f);
+
+		std::vector<glm::vec3> axes(jointCount);
+		std::vector<float> amplitudes(jointCount), phases(jointCount);
+		for (int j = 0; j < jointCount; ++j)
+		{
+			axes[j] = glm::normalize(glm::vec3(Random(state), Random(state), Random(state)) + glm::vec3(0.f, 0.f, 0.1f));
+			amplitudes[j] = j % 4 == 3 ? 0.f : 0.2f + 0.3f * std::fabs(Random(state));
+			phases[j] = twoPi * Random(state);
+		}
+
+		for (int k = 0; k < keyCount; ++k)
+		{
+			float phase = twoPi * k / keyCount;
+			for (int j = 0; j < jointCount; ++j)
+			{
+				float angle = amplitudes[j] * (std::sin(phase + phases[j]) + 0.3f * std::sin(3.f * phase + 2.f * phases[j]));
+				glm::vec3 translation = j == 0 ? glm::vec3(std::cos(phase), 0.05f * std::sin(2.f * phase), std::sin(phase))
+					: glm::vec3(0.f, 0.1f, 0.f);
+				float squash = j == 5 || j == 9 ? 1.f + 0.1f * std::sin(2.f * phase) : 1.f;
+				clip.SetKey(k, j, translation, Transform::AxisAngle(axes[j], angle), glm::vec3(1.f / std::sqrt(squash), squash, 1.f / std::sqrt(squash)));
+			}
+		}
+		return clip;
+	}
+}
+
+void RunBatchMathBenchmarks()
+{
+	const size_t count = 1 << 20;
+	const size_t matrixCount = 1 << 18;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	unsigned seed = 1;
+	glm::mat4 m = glm::rotate(glm::translate(glm::mat4(1.f), glm::vec3(1.f, 2.f, 3.f)), 0.5f, glm::vec3(0.f, 1.f, 0.f));
+
+	std::vector<glm::vec3> points(count), outPoints(count);
+	std::vector<glm::vec4> vectors(count), outVectors(count);
+	std::vector<float> x(count), y(count), z(count), outX(count), outY(count), outZ(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		points[i] = glm::vec3(Random(seed), Random(seed), Random(seed));
+		vectors[i] = glm::vec4(points[i], 1.f);
+		x[i] = points[i].x;
+		y[i] = points[i].y;
+		z[i] = points[i].z;
+	}
+
+	std::vector<glm::mat4> a(matrixCount), b(matrixCount), outMatrices(matrixCount);
+	std::vector<glm::vec3> translations(matrixCount), scales(matrixCount);
+	std::vector<glm::quat> rotations(matrixCount);
+	std::vector<Affine3x4> affineA(matrixCount), affineB(matrixCount), outAffines(matrixCount);
+	std::vector<glm::mat4> models(matrixCount);
+	std::vector<glm::mat3> normals(matrixCount);
+	for (size_t i = 0; i < matrixCount; ++i)
+	{
+		translations[i] = glm::vec3(Random(seed), Random(seed), Random(seed));
+		scales[i] = glm::vec3(1.f + Random(seed) * 0.5f);
+		rotations[i] = glm::angleAxis(Random(seed) * 3.f, glm::normalize(glm::vec3(Random(seed), Random(seed), 1.f)));
+		a[i] = glm::translate(glm::mat4(1.f), translations[i]);
+		b[i] = glm::mat4_cast(rotations[i]);
+		affineA[i] = Transform::ToAffine(a[i]);
+		affineB[i] = Transform::ToAffine(b[i]);
+		models[i] = Transform::ComposeTRS(translations[i], rotations[i], scales[i]);
+	}
+
+	printf("\nBatch transforms (%u points, %u matrices, host %s, dispatched %s)\n", (unsigned)count, (unsigned)matrixCount,
+		SimdLevelName(hostLevel), SimdLevelName(BatchMath::GetActiveLevel()));
+
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			outPoints[i] = glm::vec3(m * glm::vec4(points[i], 1.f));
+	});
+	Benchmark::Consume(outPoints[count / 2]);
+	Benchmark::Report("points, GLM per element", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			outVectors[i] = m * vectors[i];
+	});
+	Benchmark::Consume(outVectors[count / 2]);
+	Benchmark::Report("vec4, GLM per element", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < matrixCount; ++i)
+			outMatrices[i] = a[i] * b[i];
+	});
+	Benchmark::Consume(outMatrices[matrixCount / 2]);
+	Benchmark::Report("mat4 multiply, GLM per element", seconds, (double)matrixCount);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < matrixCount; ++i)
+			outMatrices[i] = glm::translate(glm::mat4(1.f), translations[i]) * glm::mat4_cast(rotations[i]) * glm::scale(glm::mat4(1.f), scales[i]);
+	});
+	Benchmark::Consume(outMatrices[matrixCount / 2]);
+	Benchmark::Report("TRS, GLM per element", seconds, (double)matrixCount);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < matrixCount; ++i)
+			outMatrices[i] = glm::inverse(a[i]);
+	});
+	Benchmark::Consume(outMatrices[matrixCount / 2]);
+	Benchmark::Report("mat4 inverse, GLM per element", seconds, (double)matrixCount);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < matrixCount; ++i)
+			outMatrices[i] = glm::affineInverse(models[i]);
+	});
+	Benchmark::Consume(outMatrices[matrixCount / 2]);
+	Benchmark::Report("affine inverse, GLM per element", seconds, (double)matrixCount);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < matrixCount; ++i)
+			normals[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+	});
+	Benchmark::Consume(normals[matrixCount / 2]);
+	Benchmark::Report("normal matrix, GLM per element", seconds, (double)matrixCount);
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		const char* level = SimdLevelName(kernels->level);
+
+		seconds = Benchmark::Measure([&] { kernels->transformPoints(m, points.data(), outPoints.data(), count); });
+		snprintf(name, sizeof(name), "points AoS, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->transformPointsSoA(m, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count); });
+		snprintf(name, sizeof(name), "points SoA, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->transformVectors(m, vectors.data(), outVectors.data(), count); });
+		snprintf(name, sizeof(name), "vec4 AoS, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->multiplyMatrices(a.data(), b.data(), outMatrices.data(), matrixCount); });
+		snprintf(name, sizeof(name), "mat4 multiply, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->composeTRS(translations.data(), rotations.data(), scales.data(), outMatrices.data(), matrixCount); });
+		snprintf(name, sizeof(name), "TRS, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->invertMatrices(a.data(), outMatrices.data(), matrixCount); });
+		snprintf(name, sizeof(name), "mat4 inverse, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->composeAffine(translations.data(), rotations.data(), scales.data(), outAffines.data(), matrixCount); });
+		snprintf(name, sizeof(name), "TRS to affine, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->multiplyAffine(affineA.data(), affineB.data(), outAffines.data(), matrixCount); });
+		snprintf(name, sizeof(name), "affine multiply, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->invertAffine(affineA.data(), outAffines.data(), matrixCount); });
+		snprintf(name, sizeof(name), "affine inverse, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->invertRigid(affineA.data(), outAffines.data(), matrixCount); });
+		snprintf(name, sizeof(name), "rigid inverse, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+
+		seconds = Benchmark::Measure([&] { kernels->normalMatrices(models.data(), normals.data(), matrixCount); });
+		snprintf(name, sizeof(name), "normal matrix, %s", level);
+		Benchmark::Report(name, seconds, (double)matrixCount);
+	}
+
+	Benchmark::Consume(outPoints[count / 2]);
+	Benchmark::Consume(outX[count / 2]);
+	Benchmark::Consume(outMatrices[matrixCount / 2]);
+	Benchmark::Consume(outAffines[matrixCount / 2]);
+	Benchmark::Consume(normals[matrixCount / 2]);
+}
+
+void RunTransformBenchmarks()
+{
+	const size_t count = 1 << 18;
+
+	unsigned seed = 7;
+	std::vector<glm::vec3> translations(count), scales(count);
+	std::vector<float> angles(count);
+	std::vector<glm::mat4> models(count);
+	std::vector<Affine3x4> affines(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		translations[i] = glm::vec3(Random(seed), Random(seed), Random(seed));
+		scales[i] = glm::vec3(1.f + Random(seed) * 0.5f);
+		angles[i] = Random(seed) * 3.f;
+	}
+	const glm::vec3 axis(0.f, 1.f, 0.f);
+
+	printf("\nPer-object model matrices (%u objects)\n", (unsigned)count);
+
+	// What main.cpp used to do every frame
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::mat4 model = glm::mat4(1.f);
+			model = glm::translate(model, translations[i]);
+			model = glm::rotate(model, angles[i], axis);
+			models[i] = glm::scale(model, scales[i]);
+		}
+	});
+	Benchmark::Consume(models[count / 2]);
+	Benchmark::Report("translate -> rotate -> scale", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			models[i] = Transform::ComposeTRS(translations[i], axis, angles[i], scales[i]);
+	});
+	Benchmark::Consume(models[count / 2]);
+	Benchmark::Report("ComposeTRS, axis-angle", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			affines[i] = Transform::ComposeAffine(translations[i], axis, angles[i], scales[i]);
+	});
+	Benchmark::Consume(affines[count / 2]);
+	Benchmark::Report("ComposeAffine, axis-angle", seconds, (double)count);
+
+	// The compile-time builders against the glm functions they stand in for, on random parameters
+	const int checks = 4096;
+	float perspectiveError = 0.f, orthoError = 0.f, lookAtError = 0.f, trsError = 0.f;
+	for (int i = 0; i < checks; ++i)
+	{
+		float fovy = 0.2f + (Random(seed) + 1.f) * 1.3f, aspect = 0.5f + Random(seed) + 1.f;
+		float zNear = 0.01f + (Random(seed) + 1.f), zFar = zNear + 1.f + (Random(seed) + 1.f) * 500.f;
+		perspectiveError = std::max(perspectiveError, MaxDifference(ConstTransform::Perspective(fovy, aspect, zNear, zFar),
+			glm::perspective(fovy, aspect, zNear, zFar)));
+
+		float left = Random(seed) * 100.f, bottom = Random(seed) * 100.f;
+		float right = left + 1.f + (Random(seed) + 1.f) * 100.f, top = bottom + 1.f + (Random(seed) + 1.f) * 100.f;
+		orthoError = std::max(orthoError, MaxDifference(ConstTransform::Ortho(left, right, bottom, top, zNear, zFar),
+			glm::ortho(left, right, bottom, top, zNear, zFar)));
+
+		glm::vec3 eye(Random(seed) * 10.f, Random(seed) * 10.f, Random(seed) * 10.f);
+		glm::vec3 center = eye + glm::vec3(Random(seed), Random(seed) * 0.5f, Random(seed) + 2.f);
+		lookAtError = std::max(lookAtError, MaxDifference(ConstTransform::LookAt(ConstVec3{ eye.x, eye.y, eye.z },
+			ConstVec3{ center.x, center.y, center.z }, ConstVec3{ 0.f, 1.f, 0.f }), glm::lookAt(eye, center, glm::vec3(0.f, 1.f, 0.f))));
+
+		const glm::vec3& t = translations[i];
+		const glm::vec3& scale = scales[i];
+		glm::vec3 rotationAxis(Random(seed), Random(seed), Random(seed) + 2.f);
+		glm::mat4 reference = glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), t), angles[i], rotationAxis), scale);
+		trsError = std::max(trsError, MaxDifference(ConstTransform::ComposeTRS(ConstVec3{ t.x, t.y, t.z },
+			ConstVec3{ rotationAxis.x, rotationAxis.y, rotationAxis.z }, angles[i], ConstVec3{ scale.x, scale.y, scale.z }), reference));
+	}
+	printf("  ConstTransform against glm (%d random cases), max absolute difference: perspective %.2e, ortho %.2e, lookAt %.2e, translate -> rotate -> scale %.2e\n",
+		checks, perspectiveError, orthoError, lookAtError, trsError);
+}
+
+void RunTrigBenchmarks()
+{
+	const size_t count = 1 << 22;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	std::vector<float> angles(count), sines(count), cosines(count);
+	std::vector<float> y(count), x(count), cosArgs(count), logArgs(count), out(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		angles[i] = -8192.f + 16384.f * (float)i / (float)count;
+		float theta = -FastTrig::PI + 2.f * FastTrig::PI * (float)i / (float)count;
+		float radius = std::ldexp(1.f, (int)(i % 41) - 20);
+		y[i] = radius * std::sin(theta);
+		x[i] = radius * std::cos(theta);
+		cosArgs[i] = -1.f + 2.f * (float)i / (float)(count - 1);
+		logArgs[i] = std::ldexp(1.f + (float)(i / 252) / (float)(count / 252 + 1), (int)(i % 252) - 125);
+	}
+
+	// Accuracy sweep against double precision. sin/cos report ulp away from their
+	// zeros and absolute error everywhere, where the ulp count is meaningless.
+	printf("\nTrig accuracy (%u samples, sincos |x| <= 8192, atan2 all angles over 2^-20..2^20, acos -1..1, log 2^-125..2^127)\n",
+		(unsigned)count);
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+
+		kernels->sinCos(angles.data(), sines.data(), cosines.data(), count);
+		double sinUlp = 0.0, cosUlp = 0.0, absolute = 0.0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			double s = std::sin((double)angles[i]), c = std::cos((double)angles[i]);
+			if (std::fabs(s) > 1.0 / 1024.0)
+				sinUlp = std::max(sinUlp, UlpError(sines[i], s));
+			if (std::fabs(c) > 1.0 / 1024.0)
+				cosUlp = std::max(cosUlp, UlpError(cosines[i], c));
+			absolute = std::max(absolute, std::max(std::fabs(sines[i] - s), std::fabs(cosines[i] - c)));
+		}
+
+		kernels->atan2(y.data(), x.data(), out.data(), count);
+		double atanUlp = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			atanUlp = std::max(atanUlp, UlpError(out[i], std::atan2((double)y[i], (double)x[i])));
+
+		kernels->acos(cosArgs.data(), out.data(), count);
+		double acosUlp = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			acosUlp = std::max(acosUlp, UlpError(out[i], std::acos((double)cosArgs[i])));
+
+		kernels->log(logArgs.data(), out.data(), count);
+		double logUlp = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			logUlp = std::max(logUlp, UlpError(out[i], std::log((double)logArgs[i])));
+
+		printf("  %-8s sin %.0f ulp, cos %.0f ulp, abs %.2e, atan2 %.0f ulp, acos %.0f ulp, log %.0f ulp\n",
+			SimdLevelName(kernels->level), sinUlp, cosUlp, absolute, atanUlp, acosUlp, logUlp);
+	}
+
+	printf("\nTrig throughput\n");
+
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			sines[i] = std::sin(angles[i]);
+			cosines[i] = std::cos(angles[i]);
+		}
+	});
+	Benchmark::Consume(sines[count / 2]);
+	Benchmark::Report("sin + cos, std", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			out[i] = std::atan2(y[i], x[i]);
+	});
+	Benchmark::Consume(out[count / 2]);
+	Benchmark::Report("atan2, std", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			out[i] = std::acos(cosArgs[i]);
+	});
+	Benchmark::Consume(out[count / 2]);
+	Benchmark::Report("acos, std", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			out[i] = std::log(logArgs[i]);
+	});
+	Benchmark::Consume(out[count / 2]);
+	Benchmark::Report("log, std", seconds, (double)count);
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		const char* level = SimdLevelName(kernels->level);
+
+		seconds = Benchmark::Measure([&] { kernels->sinCos(angles.data(), sines.data(), cosines.data(), count); });
+		snprintf(name, sizeof(name), "sincos, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->atan2(y.data(), x.data(), out.data(), count); });
+		snprintf(name, sizeof(name), "atan2, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->acos(cosArgs.data(), out.data(), count); });
+		snprintf(name, sizeof(name), "acos, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->log(logArgs.data(), out.data(), count); });
+		snprintf(name, sizeof(name), "log, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+	}
+
+	Benchmark::Consume(sines[count / 2]);
+	Benchmark::Consume(out[count / 2]);
+}
+
+void RunQuatBenchmarks()
+{
+	const size_t count = 1 << 18;
+	const int poseCount = 4;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	unsigned seed = 11;
+	std::vector<glm::quat> a(count), b(count), outQuats(count);
+	std::vector<glm::mat4> matrices(count);
+	std::vector<float> t(count);
+	std::vector<float> components[poseCount + 1][4];
+	BatchMath::QuatSoA poses[poseCount], out;
+	for (int p = 0; p <= poseCount; ++p)
+		for (int c = 0; c < 4; ++c)
+			components[p][c].resize(count);
+	for (int p = 0; p <= poseCount; ++p)
+	{
+		BatchMath::QuatSoA soa = { components[p][0].data(), components[p][1].data(), components[p][2].data(), components[p][3].data() };
+		if (p < poseCount)
+			poses[p] = soa;
+		else
+			out = soa;
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		t[i] = 0.5f + 0.5f * Random(seed);
+		for (int p = 0; p < poseCount; ++p)
+		{
+			glm::quat q = glm::normalize(glm::quat(Random(seed), Random(seed), Random(seed), Random(seed)));
+			poses[p].x[i] = q.x;
+			poses[p].y[i] = q.y;
+			poses[p].z[i] = q.z;
+			poses[p].w[i] = q.w;
+			if (p == 0)
+				a[i] = q;
+			else if (p == 1)
+				b[i] = q;
+		}
+	}
+	const float weights[poseCount] = { 0.4f, 0.3f, 0.2f, 0.1f };
+
+	// Accuracy of the approximate slerp: angle of the rotation between it and glm::slerp,
+	// in double, over t evenly spread across [0, 1]
+	std::vector<float> sweep(count);
+	for (size_t i = 0; i < count; ++i)
+		sweep[i] = (float)(i % 1025) / 1024.f;
+	auto rotationError = [](const glm::quat& q, const glm::quat& reference)
+	{
+		glm::dquat d = glm::conjugate(glm::normalize(glm::dquat(reference))) * glm::normalize(glm::dquat(q));
+		return 2.0 * std::atan2(glm::length(glm::dvec3(d.x, d.y, d.z)), std::fabs(d.w));
+	};
+
+	printf("\nApproximate slerp accuracy (%u samples, t 0..1, against glm::slerp, documented bound 8e-4 rad)\n", (unsigned)count);
+	double scalarError = 0.0;
+	for (size_t i = 0; i < count; ++i)
+		scalarError = std::max(scalarError, rotationError(Transform::FastSlerp(a[i], b[i], sweep[i]), glm::slerp(a[i], b[i], sweep[i])));
+	printf("  %-8s max %.2e rad (%.3f degrees)\n", "FastSlerp", scalarError, glm::degrees(scalarError));
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+
+		kernels->slerpQuats(poses[0], poses[1], sweep.data(), out, count);
+		double error = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			error = std::max(error, rotationError(glm::quat(out.w[i], out.x[i], out.y[i], out.z[i]), glm::slerp(a[i], b[i], sweep[i])));
+		printf("  %-8s max %.2e rad (%.3f degrees)\n", SimdLevelName(kernels->level), error, glm::degrees(error));
+	}
+
+	printf("\nQuaternion blends (%u joints)\n", (unsigned)count);
+
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			outQuats[i] = glm::normalize(glm::mix(a[i], glm::dot(a[i], b[i]) < 0.f ? -b[i] : b[i], t[i]));
+	});
+	Benchmark::Consume(outQuats[count / 2]);
+	Benchmark::Report("nlerp, GLM per element", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			outQuats[i] = glm::slerp(a[i], b[i], t[i]);
+	});
+	Benchmark::Consume(outQuats[count / 2]);
+	Benchmark::Report("slerp, GLM per element", seconds, (double)count);
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			matrices[i] = glm::mat4_cast(a[i]);
+	});
+	Benchmark::Consume(matrices[count / 2]);
+	Benchmark::Report("to mat4, GLM per element", seconds, (double)count);
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		const char* level = SimdLevelName(kernels->level);
+
+		seconds = Benchmark::Measure([&] { kernels->nlerpQuats(poses[0], poses[1], t.data(), out, count); });
+		snprintf(name, sizeof(name), "nlerp, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->slerpQuats(poses[0], poses[1], t.data(), out, count); });
+		snprintf(name, sizeof(name), "approximate slerp, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->blendQuats(poses, weights, poseCount, out, count); });
+		snprintf(name, sizeof(name), "%d-way blend, %s", poseCount, level);
+		Benchmark::Report(name, seconds, (double)count);
+
+		seconds = Benchmark::Measure([&] { kernels->quatsToMatrices(poses[0], matrices.data(), count); });
+		snprintf(name, sizeof(name), "to mat4, %s", level);
+		Benchmark::Report(name, seconds, (double)count);
+	}
+
+	Benchmark::Consume(out.x[count / 2]);
+	Benchmark::Consume(matrices[count / 2]);
+}
+
+void RunSkinningBenchmarks()
+{
+	const int characters = 256;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	// Same character as the in-app crowd
+	Skeleton skeleton;
+	AnimationClip clip;
+	std::vector<SkinnedVertex> vertices;
+	std::vector<unsigned> indices;
+	BuildTentacle(16, 48, 16, skeleton, clip, vertices, indices);
+	int jointCount = skeleton.GetJointCount();
+	size_t vertexCount = vertices.size();
+
+	std::vector<Affine3x4> palettes(characters * jointCount);
+	std::vector<glm::dualquat> dualQuats(jointCount);
+	std::vector<SkinnedPoint> skinned(characters * vertexCount);
+	PoseScratch scratch(jointCount);
+	Affine3x4 placement = Transform::ComposeAffine(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+
+	printf("\nSkinning (%d characters, %d joints, %u vertices each, one thread)\n", characters, jointCount, (unsigned)vertexCount);
+
+	// Report prints items / s * 1e-6, so items = characters * 1000 comes out in characters per ms
+	const double perMs = characters * 1000.0;
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		const char* level = SimdLevelName(kernels->level);
+
+		// EvaluatePalette goes through the entry points
+		BatchMath::SelectLevel(kernels->level);
+		double animate = Benchmark::Measure([&] {
+			for (int c = 0; c < characters; ++c)
+				EvaluatePalette(skeleton, clip, c * 0.37f, placement, scratch, &palettes[c * jointCount]);
+		});
+		snprintf(name, sizeof(name), "animate + palette, %s", level);
+		Benchmark::Report(name, animate, perMs, "characters/ms");
+
+		double linear = Benchmark::Measure([&] {
+			for (int c = 0; c < characters; ++c)
+				kernels->skinLinear(&palettes[c * jointCount], vertices.data(), &skinned[c * vertexCount], vertexCount);
+		});
+		snprintf(name, sizeof(name), "linear blend skinning, %s", level);
+		Benchmark::Report(name, linear, perMs, "characters/ms");
+
+		double dualQuat = Benchmark::Measure([&] {
+			for (int c = 0; c < characters; ++c)
+			{
+				for (int j = 0; j < jointCount; ++j)
+					dualQuats[j] = Skinning::ToDualQuat(palettes[c * jointCount + j]);
+				kernels->skinDualQuat(dualQuats.data(), vertices.data(), &skinned[c * vertexCount], vertexCount);
+			}
+		});
+		snprintf(name, sizeof(name), "dual quaternion skinning, %s", level);
+		Benchmark::Report(name, dualQuat, perMs, "characters/ms");
+
+		snprintf(name, sizeof(name), "CPU path (animate + linear), %s", level);
+		Benchmark::Report(name, animate + linear, perMs, "characters/ms");
+		snprintf(name, sizeof(name), "CPU path (animate + dual quat), %s", level);
+		Benchmark::Report(name, animate + dualQuat, perMs, "characters/ms");
+	}
+	BatchMath::SelectLevel(SIMD_AVX512);
+
+	Benchmark::Consume(skinned[skinned.size() / 2]);
+	printf("  The GPU path only animates on the CPU; its vertex shader cost needs a context: run the app\n"
+		"  with USE_SKINNING and SKINNING_PATH = SKINNING_GPU, it prints characters/ms from GL_TIME_ELAPSED queries.\n");
+}
+
+void RunAnimationCompressionBenchmarks()
+{
+	Skeleton skeleton;
+	AnimationClip tentacle;
+	std::vector<SkinnedVertex> vertices;
+	std::vector<unsigned> indices;
+	BuildTentacle(16, 48, 16, skeleton, tentacle, vertices, indices);
+
+	const int clipCount = 2;
+	const char* names[clipCount] = { "tentacle", "motion" };
+	AnimationClip clips[clipCount] = { tentacle, BuildMotionClip(64, 240) };
+	CompressionSettings settings;
+	const int samples = 1000;
+	char name[64];
+
+	printf("\nAnimation compression (bounds %.1e rad, %.1e units, %.1e scale)\n",
+		settings.rotationError, settings.translationError, settings.scaleError);
+
+	for (int i = 0; i < clipCount; ++i)
+	{
+		const AnimationClip& clip = clips[i];
+		CompressedClip compressed(clip, settings);
+		const CompressionError& error = compressed.GetError();
+		int jointCount = clip.GetJointCount();
+
+		printf("  %s: %d joints, %d keys: %u -> %u bytes, %.1fx; %d keys, %d/%d rotations and %d/%d components animated\n",
+			names[i], jointCount, clip.GetKeyCount(), (unsigned)clip.GetSize(), (unsigned)compressed.GetSize(),
+			(double)clip.GetSize() / compressed.GetSize(), compressed.GetKeyCount(), compressed.GetAnimatedRotationCount(),
+			jointCount, compressed.GetAnimatedComponentCount(), 6 * jointCount);
+		printf("  max error %.2e rad, %.2e units, %.2e scale\n", error.rotation, error.translation, error.scale);
+
+		// Times spread over the clip so the blocks touched keep changing
+		PoseScratch scratch(jointCount);
+		float step = clip.GetDuration() * 0.6180339f;
+		SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+		for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+		{
+			const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+			if (!kernels)
+				break;
+			BatchMath::SelectLevel(kernels->level);
+
+			double raw = Benchmark::Measure([&] {
+				for (int s = 0; s < samples; ++s)
+					clip.Sample(s * step, scratch);
+			});
+			double decoded = Benchmark::Measure([&] {
+				for (int s = 0; s < samples; ++s)
+					compressed.Sample(s * step, scratch);
+			});
+
+			// ns per joint sample
+			double perJoint = 1e9 / ((double)samples * jointCount);
+			snprintf(name, sizeof(name), "sample raw, %s", SimdLevelName(kernels->level));
+			printf("  %-36s %9.3f ms  %10.2f ns/joint\n", name, raw * 1000.0, raw * perJoint);
+			snprintf(name, sizeof(name), "sample compressed, %s", SimdLevelName(kernels->level));
+			printf("  %-36s %9.3f ms  %10.2f ns/joint\n", name, decoded * 1000.0, decoded * perJoint);
+		}
+		BatchMath::SelectLevel(SIMD_AVX512);
+	}
+}
+
+void RunNoiseBenchmarks()
+{
+	const int width = 512, height = 512, side = 64;
+	const size_t samples2 = (size_t)width * height, samples3 = (size_t)side * side * side;
+	BatchMath::FbmSettings fbm = { 4, 1.f / 64.f, 2.f, 0.5f };
+	const NoiseType types[2] = { NOISE_PERLIN, NOISE_SIMPLEX };
+	const char* typeNames[2] = { "perlin", "simplex" };
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	std::vector<float> grid2(samples2), grid3(samples3), reference2(samples2), reference3(samples3);
+	printf("\nNoise fBm, %d octaves (%dx%d and %d^3 grids)\n", fbm.octaves, width, height, side);
+
+	for (int t = 0; t < 2; ++t)
+	{
+		// glm::perlin / glm::simplex point by point
+		double glm2 = Benchmark::Measure([&] {
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+					reference2[y * width + x] = Noise::Sample(types[t], fbm, glm::vec2((float)x, (float)y));
+		}, 1);
+		double glm3 = Benchmark::Measure([&] {
+			for (int z = 0; z < side; ++z)
+				for (int y = 0; y < side; ++y)
+					for (int x = 0; x < side; ++x)
+						reference3[(z * side + y) * side + x] = Noise::Sample(types[t], fbm, glm::vec3((float)x, (float)y, (float)z));
+		}, 1);
+		snprintf(name, sizeof(name), "%s 2D, glm per point", typeNames[t]);
+		Benchmark::Report(name, glm2, (double)samples2, "M samples/s");
+		snprintf(name, sizeof(name), "%s 3D, glm per point", typeNames[t]);
+		Benchmark::Report(name, glm3, (double)samples3, "M samples/s");
+
+		for (int k = SIMD_SSE4; k <= hostLevel; ++k)
+		{
+			const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+			if (!kernels)
+				break;
+			BatchMath::SelectLevel(kernels->level);
+
+			double fill2 = Benchmark::Measure([&] {
+				Noise::FillGrid(types[t], fbm, glm::vec2(0.f), glm::vec2(1.f), width, height, grid2.data());
+			});
+			double fill3 = Benchmark::Measure([&] {
+				Noise::FillGrid(types[t], fbm, glm::vec3(0.f), glm::vec3(1.f), side, side, side, grid3.data());
+			});
+
+			float error = 0.f;
+			for (size_t i = 0; i < samples2; ++i)
+				error = std::max(error, std::fabs(grid2[i] - reference2[i]));
+			for (size_t i = 0; i < samples3; ++i)
+				error = std::max(error, std::fabs(grid3[i] - reference3[i]));
+
+			snprintf(name, sizeof(name), "%s 2D grid, %s", typeNames[t], SimdLevelName(kernels->level));
+			Benchmark::Report(name, fill2, (double)samples2, "M samples/s");
+			snprintf(name, sizeof(name), "%s 3D grid, %s", typeNames[t], SimdLevelName(kernels->level));
+			Benchmark::Report(name, fill3, (double)samples3, "M samples/s");
+			printf("  %-36s %.2e\n", "  max difference from glm", error);
+		}
+		BatchMath::SelectLevel(SIMD_AVX512);
+	}
+
+	JobSystem jobs;
+	for (int t = 0; t < 2; ++t)
+	{
+		double fill2 = Benchmark::Measure([&] {
+			Noise::FillGrid(types[t], fbm, glm::vec2(0.f), glm::vec2(1.f), width, height, grid2.data(), &jobs);
+		});
+		snprintf(name, sizeof(name), "%s 2D grid, %u threads", typeNames[t], jobs.GetThreadCount());
+		Benchmark::Report(name, fill2, (double)samples2, "M samples/s");
+	}
+	Benchmark::Consume(grid2[samples2 / 2]);
+	Benchmark::Consume(grid3[samples3 / 2]);
+}
+
+void RunIntersectionBenchmarks()
+{
+	const size_t count = 1 << 16;
+	const float tMax = 10.f, miss = std::numeric_limits<float>::infinity();
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+	unsigned state = 17;
+
+	// Small triangles and boxes scattered through a cube, rays from a shell around it aimed at the middle
+	std::vector<float> triangleData[9], rayData[10], boxData[6];
+	for (size_t i = 0; i < count; ++i)
+	{
+		glm::vec3 centre(Random(state), Random(state), Random(state));
+		for (int c = 0; c < 3; ++c)
+		{
+			glm::vec3 corner = centre + 0.3f * glm::vec3(Random(state), Random(state), Random(state));
+			for (int a = 0; a < 3; ++a)
+				triangleData[c * 3 + a].push_back(corner[a]);
+		}
+
+		glm::vec3 extent = 0.05f + 0.1f * glm::abs(glm::vec3(Random(state), Random(state), Random(state)));
+		glm::vec3 boxCentre(Random(state), Random(state), Random(state));
+		for (int a = 0; a < 3; ++a)
+		{
+			boxData[a].push_back(boxCentre[a] - extent[a]);
+			boxData[3 + a].push_back(boxCentre[a] + extent[a]);
+		}
+
+		glm::vec3 origin = 3.f * glm::normalize(glm::vec3(Random(state), Random(state), Random(state)) + glm::vec3(0.f, 0.f, 1e-3f));
+		glm::vec3 direction = glm::normalize(0.3f * glm::vec3(Random(state), Random(state), Random(state)) - origin);
+		for (int a = 0; a < 3; ++a)
+		{
+			rayData[a].push_back(origin[a]);
+			rayData[3 + a].push_back(direction[a]);
+			rayData[6 + a].push_back(1.f / direction[a]);
+		}
+		rayData[9].push_back(tMax);
+	}
+
+	std::vector<float>* td = triangleData;
+	std::vector<float>* rd = rayData;
+	std::vector<float>* bd = boxData;
+	BatchMath::TriangleSoA triangles = { td[0].data(), td[1].data(), td[2].data(), td[3].data(), td[4].data(),
+		td[5].data(), td[6].data(), td[7].data(), td[8].data() };
+	BatchMath::RaySoA rays = { rd[0].data(), rd[1].data(), rd[2].data(), rd[3].data(), rd[4].data(), rd[5].data(),
+		rd[6].data(), rd[7].data(), rd[8].data(), rd[9].data() };
+	BatchMath::BoxSoA boxes = { bd[0].data(), bd[1].data(), bd[2].data(), bd[3].data(), bd[4].data(), bd[5].data() };
+
+	// Ray 0 against every triangle, every ray against triangle 0 (or box 0)
+	glm::vec3 origin(rays.ox[0], rays.oy[0], rays.oz[0]), direction(rays.dx[0], rays.dy[0], rays.dz[0]);
+	glm::vec3 invDirection(rays.invDx[0], rays.invDy[0], rays.invDz[0]);
+	glm::vec3 v0(triangles.x0[0], triangles.y0[0], triangles.z0[0]);
+	glm::vec3 v1(triangles.x1[0], triangles.y1[0], triangles.z1[0]);
+	glm::vec3 v2(triangles.x2[0], triangles.y2[0], triangles.z2[0]);
+	glm::vec3 boxMin(boxes.minX[0], boxes.minY[0], boxes.minZ[0]), boxMax(boxes.maxX[0], boxes.maxY[0], boxes.maxZ[0]);
+
+	std::vector<float> t(count), u(count), v(count), manyReference(count), packetReference(count);
+	printf("\nRay intersection (%d triangles, boxes and rays)\n", (int)count);
+
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::vec2 bary;
+			float distance;
+			glm::vec3 a(triangles.x0[i], triangles.y0[i], triangles.z0[i]);
+			glm::vec3 b(triangles.x1[i], triangles.y1[i], triangles.z1[i]);
+			glm::vec3 c(triangles.x2[i], triangles.y2[i], triangles.z2[i]);
+			bool hit = glm::intersectRayTriangle(origin, direction, a, b, c, bary, distance);
+			manyReference[i] = hit && distance >= 0.f && distance <= tMax ? distance : miss;
+		}
+	});
+	Benchmark::Report("ray vs triangles, glm per pair", seconds, (double)count, "M tests/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::vec2 bary;
+			float distance;
+			glm::vec3 o(rays.ox[i], rays.oy[i], rays.oz[i]), d(rays.dx[i], rays.dy[i], rays.dz[i]);
+			bool hit = glm::intersectRayTriangle(o, d, v0, v1, v2, bary, distance);
+			packetReference[i] = hit && distance >= 0.f && distance <= tMax ? distance : miss;
+		}
+	});
+	Benchmark::Report("rays vs triangle, glm per ray", seconds, (double)count, "M rays/s");
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		BatchMath::SelectLevel(kernels->level);
+		const char* levelName = SimdLevelName(kernels->level);
+
+		// Hits that disagree with glm (grazing edges under FMA) and the largest distance error of the rest
+		int mismatches = 0;
+		float error = 0.f;
+
+		seconds = Benchmark::Measure([&] {
+			BatchMath::IntersectRayTriangles(origin, direction, tMax, triangles, t.data(), u.data(), v.data(), count);
+		});
+		snprintf(name, sizeof(name), "ray vs triangles, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M tests/s");
+		for (size_t i = 0; i < count; ++i)
+		{
+			if ((t[i] == miss) != (manyReference[i] == miss))
+				++mismatches;
+			else if (t[i] != miss)
+				error = std::max(error, std::fabs(t[i] - manyReference[i]));
+		}
+
+		seconds = Benchmark::Measure([&] {
+			BatchMath::IntersectRaysTriangle(rays, v0, v1, v2, t.data(), u.data(), v.data(), count);
+		});
+		snprintf(name, sizeof(name), "rays vs triangle, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M rays/s");
+		for (size_t i = 0; i < count; ++i)
+		{
+			if ((t[i] == miss) != (packetReference[i] == miss))
+				++mismatches;
+			else if (t[i] != miss)
+				error = std::max(error, std::fabs(t[i] - packetReference[i]));
+		}
+		printf("  %-36s %d, max distance difference %.2e\n", "  hits disagreeing with glm", mismatches, error);
+
+		seconds = Benchmark::Measure([&] {
+			BatchMath::IntersectRayBoxes(origin, invDirection, tMax, boxes, t.data(), count);
+		});
+		snprintf(name, sizeof(name), "ray vs boxes, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M tests/s");
+
+		seconds = Benchmark::Measure([&] {
+			BatchMath::IntersectRaysBox(rays, boxMin, boxMax, t.data(), count);
+		});
+		snprintf(name, sizeof(name), "rays vs box, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M rays/s");
+	}
+	BatchMath::SelectLevel(SIMD_AVX512);
+
+	Benchmark::Consume(t[count / 2]);
+	Benchmark::Consume(u[count / 2]);
+}
+
+void RunPackingBenchmarks()
+{
+	const size_t count = 1 << 20;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+	unsigned state = 23;
+
+	// Vertex-like attributes in [-1.2, 1.2], with exact half ties, half subnormals, Inf and NaN mixed in
+	std::vector<float> values(count * 4);
+	for (size_t i = 0; i < values.size(); ++i)
+		values[i] = 1.2f * Random(state);
+	for (size_t i = 0; i < values.size(); i += 97)
+	{
+		unsigned bits;
+		float scale = std::ldexp(1.f, -(int)(i % 23));
+		values[i] *= scale;
+		memcpy(&bits, &values[i], sizeof(bits));
+		bits = (bits & ~0x1FFFu) | 0x1000u;
+		memcpy(&values[i], &bits, sizeof(bits));
+	}
+	values[1] = std::numeric_limits<float>::infinity();
+	values[2] = -std::numeric_limits<float>::quiet_NaN();
+	const glm::vec4* vec4s = (const glm::vec4*)values.data();
+	const glm::vec3* vec3s = (const glm::vec3*)values.data();
+
+	std::vector<uint16_t> halves(count), halvesReference(count), snorms(count), snormsReference(count);
+	std::vector<uint32_t> words(count), wordsReference(count), smallFloats(count), smallFloatsReference(count);
+	std::vector<float> floats(count), floatsReference(count);
+	std::vector<glm::vec4> vectors4(count), vectors4Reference(count);
+	std::vector<glm::vec3> vectors3(count), vectors3Reference(count);
+	printf("\nPacking (%d values or vectors)\n", (int)count);
+
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			halvesReference[i] = glm::packHalf1x16(values[i]);
+	});
+	Benchmark::Report("packHalf1x16, glm per value", seconds, (double)count, "M values/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			floatsReference[i] = glm::unpackHalf1x16(halvesReference[i]);
+	});
+	Benchmark::Report("unpackHalf1x16, glm per value", seconds, (double)count, "M values/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			snormsReference[i] = glm::packSnorm1x16(values[i]);
+	});
+	Benchmark::Report("packSnorm1x16, glm per value", seconds, (double)count, "M values/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			wordsReference[i] = glm::packSnorm3x10_1x2(vec4s[i]);
+	});
+	Benchmark::Report("packSnorm3x10_1x2, glm per vector", seconds, (double)count, "M vectors/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			vectors4Reference[i] = glm::unpackSnorm3x10_1x2(wordsReference[i]);
+	});
+	Benchmark::Report("unpackSnorm3x10_1x2, glm per vector", seconds, (double)count, "M vectors/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			smallFloatsReference[i] = glm::packF2x11_1x10(vec3s[i]);
+	});
+	Benchmark::Report("packF2x11_1x10, glm per vector", seconds, (double)count, "M vectors/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			vectors3Reference[i] = glm::unpackF2x11_1x10(smallFloatsReference[i]);
+	});
+	Benchmark::Report("unpackF2x11_1x10, glm per vector", seconds, (double)count, "M vectors/s");
+
+	// One value (or vector) per call through HalfFloat, on each path the host has
+	std::vector<uint64_t> packed4(count / 4);
+	for (int useF16C = 0; useF16C < 2; ++useF16C)
+	{
+		if (HalfFloat::SelectF16C(useF16C != 0) != (useF16C != 0))
+			break;
+		const char* path = useF16C ? "F16C" : "software";
+
+		seconds = Benchmark::Measure([&] {
+			for (size_t i = 0; i < count; ++i)
+				halves[i] = HalfFloat::FloatToHalf(values[i]);
+		});
+		snprintf(name, sizeof(name), "HalfFloat::FloatToHalf, %s", path);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+		seconds = Benchmark::Measure([&] {
+			for (size_t i = 0; i < count; ++i)
+				floats[i] = HalfFloat::HalfToFloat(halvesReference[i]);
+		});
+		snprintf(name, sizeof(name), "HalfFloat::HalfToFloat, %s", path);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+		seconds = Benchmark::Measure([&] {
+			for (size_t i = 0; i < count / 4; ++i)
+				packed4[i] = HalfFloat::PackHalf4x16(vec4s[i]);
+		});
+		snprintf(name, sizeof(name), "HalfFloat::PackHalf4x16, %s", path);
+		Benchmark::Report(name, seconds, (double)count / 4, "M vectors/s");
+
+		// Every half decodes the same, every float above encodes the same
+		size_t mismatches = CountDifferent(halves, halvesReference) + CountDifferent(floats, floatsReference);
+		mismatches += memcmp(packed4.data(), halvesReference.data(), packed4.size() * sizeof(uint64_t)) != 0;
+		for (unsigned h = 0; h < 0x10000; ++h)
+		{
+			float a = HalfFloat::HalfToFloat((uint16_t)h), b = glm::unpackHalf1x16((uint16_t)h);
+			mismatches += memcmp(&a, &b, sizeof(float)) != 0;
+		}
+		printf("  %-36s %d\n", "  outputs differing from glm", (int)mismatches);
+	}
+	HalfFloat::SelectF16C(true);
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		BatchMath::SelectLevel(kernels->level);
+		const char* levelName = SimdLevelName(kernels->level);
+
+		// Outputs that differ from glm in any bit, over every function
+		size_t mismatches = 0;
+
+		seconds = Benchmark::Measure([&] { BatchMath::PackHalf(values.data(), halves.data(), count); });
+		snprintf(name, sizeof(name), "PackHalf, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+		mismatches += CountDifferent(halves, halvesReference);
+
+		seconds = Benchmark::Measure([&] { BatchMath::UnpackHalf(halvesReference.data(), floats.data(), count); });
+		snprintf(name, sizeof(name), "UnpackHalf, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+		mismatches += CountDifferent(floats, floatsReference);
+
+		seconds = Benchmark::Measure([&] { BatchMath::PackSnorm16(values.data(), snorms.data(), count); });
+		snprintf(name, sizeof(name), "PackSnorm16, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+		seconds = Benchmark::Measure([&] { BatchMath::PackSnorm3x10_1x2(vec4s, words.data(), count); });
+		snprintf(name, sizeof(name), "PackSnorm3x10_1x2, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M vectors/s");
+
+		seconds = Benchmark::Measure([&] { BatchMath::UnpackSnorm3x10_1x2(wordsReference.data(), vectors4.data(), count); });
+		snprintf(name, sizeof(name), "UnpackSnorm3x10_1x2, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M vectors/s");
+		mismatches += CountDifferent(vectors4, vectors4Reference);
+
+		seconds = Benchmark::Measure([&] { BatchMath::PackF2x11_1x10(vec3s, smallFloats.data(), count); });
+		snprintf(name, sizeof(name), "PackF2x11_1x10, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M vectors/s");
+		mismatches += CountDifferent(smallFloats, smallFloatsReference);
+
+		seconds = Benchmark::Measure([&] { BatchMath::UnpackF2x11_1x10(smallFloatsReference.data(), vectors3.data(), count); });
+		snprintf(name, sizeof(name), "UnpackF2x11_1x10, %s", levelName);
+		Benchmark::Report(name, seconds, (double)count, "M vectors/s");
+		mismatches += CountDifferent(vectors3, vectors3Reference);
+
+		// The snorm forms leave NaN to the implementation, so only compare where the input is a number
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (values[i] == values[i] && snorms[i] != snormsReference[i])
+				++mismatches;
+			if (!glm::any(glm::isnan(vec4s[i])) && words[i] != wordsReference[i])
+				++mismatches;
+		}
+		printf("  %-36s %d\n", "  outputs differing from glm", (int)mismatches);
+	}
+	BatchMath::SelectLevel(SIMD_AVX512);
+
+	Benchmark::Consume(halves[count / 2]);
+	Benchmark::Consume(floats[count / 2]);
+	Benchmark::Consume(vectors3[count / 2]);
+}
+
+void RunSpatialHashBenchmarks()
+{
+	const size_t count = 1 << 20, queryCount = 1 << 16, checks = 64;
+	const float extent = 50.f, cellSize = 1.f, radius = 1.f;
+	const size_t k = 8;
+	const double rebuildTarget = 0.001;		// Seconds for a million points, across the job threads
+	unsigned state = 29;
+
+	// About one point per cell, the worst case for the scatter
+	std::vector<glm::vec3> points(count), queries(queryCount);
+	for (size_t i = 0; i < count; ++i)
+		points[i] = extent * glm::vec3(Random(state), Random(state), Random(state));
+	for (size_t i = 0; i < queryCount; ++i)
+		queries[i] = extent * glm::vec3(Random(state), Random(state), Random(state));
+
+	printf("\nSpatial hash (%u points, cell %.1f, radius %.1f, k %u)\n", (unsigned)count, cellSize, radius, (unsigned)k);
+
+	SpatialHash hash;
+	double seconds = Benchmark::Measure([&] {
+		hash.Build(points.data(), count, cellSize, nullptr);
+	});
+	Benchmark::Report("rebuild, one thread", seconds, (double)count, "M points/s");
+
+	JobSystem jobs;
+	seconds = Benchmark::Measure([&] {
+		hash.Build(points.data(), count, cellSize, &jobs);
+	});
+	char name[64];
+	snprintf(name, sizeof(name), "rebuild, %u threads", jobs.GetThreadCount());
+	Benchmark::Report(name, seconds, (double)count, "M points/s");
+	printf("  %-36s %9.3f ms  %s the %.1f ms target, %.0fk points fit in it\n", "  rebuild vs target", seconds * 1000.0,
+		seconds <= rebuildTarget ? "within" : "MISSES", rebuildTarget * 1000.0, count * rebuildTarget / seconds * 1e-3);
+
+	std::vector<unsigned> found;
+	size_t total = 0;
+	seconds = Benchmark::Measure([&] {
+		total = 0;
+		for (size_t i = 0; i < queryCount; ++i)
+			total += hash.QueryRadius(queries[i], radius, found);
+	});
+	Benchmark::Report("radius query", seconds, (double)queryCount, "M queries/s");
+	printf("  %-36s %.2f\n", "  points per query", (double)total / queryCount);
+
+	unsigned nearest[k];
+	float distances[k];
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < queryCount; ++i)
+			hash.QueryNearest(queries[i], k, std::numeric_limits<float>::infinity(), nearest, distances);
+	});
+	Benchmark::Consume(distances[0]);
+	Benchmark::Report("k nearest query", seconds, (double)queryCount, "M queries/s");
+
+	// Brute force on a few queries
+	size_t wrong = 0;
+	std::vector<float> all(count);
+	for (size_t q = 0; q < checks; ++q)
+	{
+		size_t inRadius = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			all[i] = glm::distance(points[i], queries[q]);
+			inRadius += all[i] <= radius;
+		}
+		std::nth_element(all.begin(), all.begin() + (k - 1), all.end());
+
+		size_t n = hash.QueryNearest(queries[q], k, std::numeric_limits<float>::infinity(), nearest, distances);
+		wrong += hash.QueryRadius(queries[q], radius, found) != inRadius || n != k || distances[k - 1] != all[k - 1];
+	}
+	printf("  %-36s %u of %u\n", "  queries differing from brute force", (unsigned)wrong, (unsigned)checks);
+}
+
+void RunParticleBenchmarks()
+{
+	const size_t count = 1 << 20;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	BatchMath::ParticleEmitter emitter;
+	emitter.position = glm::vec3(0.f, -1.f, -4.f);
+	emitter.extent = glm::vec3(0.05f);
+	emitter.velocity = glm::vec3(0.f, 3.f, 0.f);
+	emitter.spread = glm::vec3(0.6f, 0.5f, 0.6f);
+	emitter.life = 2.f;
+	emitter.lifeVariation = 0.3f;
+
+	BatchMath::ParticleStep step;
+	step.gravity = glm::vec3(0.f, -4.f, 0.f);
+	step.drag = 0.1f;
+	step.dt = 1.f / 60.f;
+
+	// Eight arrays each for the scalar reference and the level under test
+	std::vector<float> reference(8 * count), storage(8 * count);
+	std::vector<glm::vec4> packed(count), packedReference(count);
+	auto soa = [&](std::vector<float>& arrays)
+	{
+		float* base = arrays.data();
+		BatchMath::ParticleSoA result = { base, base + count, base + 2 * count, base + 3 * count,
+			base + 4 * count, base + 5 * count, base + 6 * count, base + 7 * count };
+		return result;
+	};
+	BatchMath::ParticleSoA particles = soa(storage), referenceParticles = soa(reference);
+
+	BatchMath::EmitParticlesScalar(emitter, 0, referenceParticles, count);
+	for (int frame = 0; frame < 30; ++frame)
+		BatchMath::IntegrateParticlesScalar(step, referenceParticles, count);
+	BatchMath::PackParticlesScalar(referenceParticles, packedReference.data(), count);
+
+	printf("\nParticles (%u, SoA, one thread)\n", (unsigned)count);
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		const char* level = SimdLevelName(kernels->level);
+
+		double seconds = Benchmark::Measure([&] {
+			kernels->emitParticles(emitter, 0, particles, count);
+		});
+		snprintf(name, sizeof(name), "emit, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M particles/s");
+
+		size_t dead = 0;
+		seconds = Benchmark::Measure([&] {
+			dead += kernels->integrateParticles(step, particles, count);
+		});
+		Benchmark::Consume(dead);
+		snprintf(name, sizeof(name), "integrate + age + count dead, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M particles/s");
+
+		seconds = Benchmark::Measure([&] {
+			kernels->packParticles(particles, packed.data(), count);
+		});
+		Benchmark::Consume(packed[count / 2]);
+		snprintf(name, sizeof(name), "pack for drawing, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M particles/s");
+
+		// Same 30 frames as the reference
+		kernels->emitParticles(emitter, 0, particles, count);
+		for (int frame = 0; frame < 30; ++frame)
+			kernels->integrateParticles(step, particles, count);
+		kernels->packParticles(particles, packed.data(), count);
+		float difference = 0.f;
+		for (size_t i = 0; i < count; ++i)
+			difference = std::max(difference, glm::length(packed[i] - packedReference[i]));
+		printf("  %-36s %.3g\n", "  max difference after 30 frames", difference);
+	}
+
+	printf("  ParticleSystem spreads these over the job threads; run the app with USE_PARTICLES for the\n"
+		"  full CPU path (with compaction and upload) and the transform feedback path, in M particles/frame.\n");
+}
+
+void RunRandomBenchmarks()
+{
+	const size_t count = 1 << 22;
+	const uint64_t seed = 1234;
+	SimdLevel hostLevel = GetCpuFeatures().BestLevel();
+	char name[64];
+
+	std::vector<float> x(count), y(count), z(count);
+	std::vector<float> referenceX(count), referenceY(count), referenceZ(count);
+	std::vector<uint32_t> bits(count), referenceBits(count);
+
+	printf("\nRandom numbers (%u per fill, one thread)\n", (unsigned)count);
+
+	// gtc/random draws from std::rand one value at a time
+	double seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			x[i] = glm::linearRand(0.f, 1.f);
+	});
+	Benchmark::Consume(x[count / 2]);
+	Benchmark::Report("uniform, glm::linearRand", seconds, (double)count, "M values/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			x[i] = glm::gaussRand(0.f, 1.f);
+	});
+	Benchmark::Consume(x[count / 2]);
+	Benchmark::Report("gaussian, glm::gaussRand", seconds, (double)count, "M values/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::vec3 p = glm::sphericalRand(1.f);
+			x[i] = p.x;
+			y[i] = p.y;
+			z[i] = p.z;
+		}
+	});
+	Benchmark::Consume(z[count / 2]);
+	Benchmark::Report("sphere, glm::sphericalRand", seconds, (double)count, "M points/s");
+
+	seconds = Benchmark::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+		{
+			glm::vec2 p = glm::diskRand(1.f);
+			x[i] = p.x;
+			y[i] = p.y;
+		}
+	});
+	Benchmark::Consume(y[count / 2]);
+	Benchmark::Report("disk, glm::diskRand", seconds, (double)count, "M points/s");
+
+	for (int k = SIMD_SCALAR; k <= hostLevel; ++k)
+	{
+		const BatchMath::Kernels* kernels = BatchMath::GetKernels((SimdLevel)k);
+		if (!kernels)
+			break;
+		const char* level = SimdLevelName(kernels->level);
+		RandomStream stream(seed);
+		BatchMath::RandomState state = stream.GetState();
+
+		seconds = Benchmark::Measure([&] { kernels->randomBits(state, bits.data(), count); });
+		Benchmark::Consume(bits[count / 2]);
+		snprintf(name, sizeof(name), "bits, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+		seconds = Benchmark::Measure([&] { kernels->randomUniform(state, 0.f, 1.f, x.data(), count); });
+		Benchmark::Consume(x[count / 2]);
+		snprintf(name, sizeof(name), "uniform, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+		seconds = Benchmark::Measure([&] { kernels->randomGaussian(state, 0.f, 1.f, x.data(), count); });
+		Benchmark::Consume(x[count / 2]);
+		snprintf(name, sizeof(name), "gaussian, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+		seconds = Benchmark::Measure([&] { kernels->randomSphere(state, 1.f, x.data(), y.data(), z.data(), count); });
+		Benchmark::Consume(z[count / 2]);
+		snprintf(name, sizeof(name), "sphere, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M points/s");
+
+		seconds = Benchmark::Measure([&] { kernels->randomDisk(state, 1.f, x.data(), y.data(), count); });
+		Benchmark::Consume(y[count / 2]);
+		snprintf(name, sizeof(name), "disk, %s", level);
+		Benchmark::Report(name, seconds, (double)count, "M points/s");
+
+		// Same seed against the scalar reference: the bits must match exactly, the rest to FMA rounding
+		state = stream.GetState();
+		BatchMath::RandomState referenceState = stream.GetState();
+		kernels->randomBits(state, bits.data(), count);
+		BatchMath::RandomBitsScalar(referenceState, referenceBits.data(), count);
+		size_t bitsDifferent = CountDifferent(bits, referenceBits);
+
+		kernels->randomGaussian(state, 0.f, 1.f, x.data(), count);
+		BatchMath::RandomGaussianScalar(referenceState, 0.f, 1.f, referenceX.data(), count);
+		float difference = 0.f;
+		double mean = 0.0, squares = 0.0, radius = 0.0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			difference = std::max(difference, std::fabs(x[i] - referenceX[i]));
+			mean += x[i];
+			squares += (double)x[i] * x[i];
+		}
+		mean /= (double)count;
+
+		kernels->randomSphere(state, 1.f, x.data(), y.data(), z.data(), count);
+		BatchMath::RandomSphereScalar(referenceState, 1.f, referenceX.data(), referenceY.data(), referenceZ.data(), count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			difference = std::max(difference, std::max(std::fabs(x[i] - referenceX[i]),
+				std::max(std::fabs(y[i] - referenceY[i]), std::fabs(z[i] - referenceZ[i]))));
+			radius = std::max(radius, std::fabs(std::sqrt((double)x[i] * x[i] + (double)y[i] * y[i] + (double)z[i] * z[i]) - 1.0));
+		}
+		printf("  %-36s %u bits differ, max difference %.3g\n", "  against scalar", (unsigned)bitsDifferent, difference);
+		printf("  %-36s mean %.4f, deviation %.4f, sphere radius error %.2g\n", "  gaussian / sphere", mean,
+			std::sqrt(squares / (double)count - mean * mean), radius);
+	}
+
+	// One stream per job thread, the way callers fill arrays in parallel
+	JobSystem jobs;
+	std::vector<RandomStream> streams;
+	for (unsigned w = 0; w < jobs.GetWorkerSlotCount(); ++w)
+		streams.push_back(RandomStream(seed, w));
+
+	seconds = Benchmark::Measure([&] {
+		jobs.ParallelFor(count, 65536, [&](size_t begin, size_t end, unsigned worker)
+		{
+			streams[worker].Uniform(0.f, 1.f, x.data() + begin, end - begin);
+		});
+	});
+	Benchmark::Consume(x[count / 2]);
+	snprintf(name, sizeof(name), "uniform, %u threads, own streams", jobs.GetThreadCount());
+	Benchmark::Report(name, seconds, (double)count, "M values/s");
+
+	seconds = Benchmark::Measure([&] {
+		jobs.ParallelFor(count, 65536, [&](size_t begin, size_t end, unsigned worker)
+		{
+			streams[worker].Gaussian(0.f, 1.f, x.data() + begin, end - begin);
+		});
+	});
+	Benchmark::Consume(x[count / 2]);
+	snprintf(name, sizeof(name), "gaussian, %u threads, own streams", jobs.GetThreadCount());
+	Benchmark::Report(name, seconds, (double)count, "M values/s");
+}
+
+void RunBenchmarks()
+{
+	RunBatchMathBenchmarks();
+	RunTransformBenchmarks();
+	RunTrigBenchmarks();
+	RunQuatBenchmarks();
+	RunSkinningBenchmarks();
+	RunAnimationCompressionBenchmarks();
+	RunNoiseBenchmarks();
+	RunIntersectionBenchmarks();
+	RunPackingBenchmarks();
+	RunSpatialHashBenchmarks();
+	RunParticleBenchmarks();
+	RunRandomBenchmarks();
+}
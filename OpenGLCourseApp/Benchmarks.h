@@ -0,0 +1,41 @@
+#pragma once
+
+/**	Throughput benchmarks, run with: OpenGLCourseApp --bench
+ *
+ *	No window or GL context is created in this mode.
+ */
+
+void RunBatchMathBenchmarks();
+
+void RunTransformBenchmarks();
+
+// Includes the accuracy sweep behind the error bounds in FastTrig.h
+void RunTrigBenchmarks();
+
+void RunQuatBenchmarks();
+
+// Characters per millisecond for the CPU side of each skinning path
+void RunSkinningBenchmarks();
+
+// Size, error and per-joint sampling cost of CompressedClip against the raw clip
+void RunAnimationCompressionBenchmarks();
+
+// Grid fills against glm::perlin / glm::simplex per point
+void RunNoiseBenchmarks();
+
+// Rays per second for the packet and one-ray-many-primitives tests, against glm::intersectRayTriangle
+void RunIntersectionBenchmarks();
+
+// Array packing against the gtc/packing functions per value, with a bit-exactness check
+void RunPackingBenchmarks();
+
+// Rebuild time of a million point grid, single and multithreaded, and radius / k nearest queries
+void RunSpatialHashBenchmarks();
+
+// Emit, integrate and pack throughput of the particle kernels, the CPU side of ParticleSystem
+void RunParticleBenchmarks();
+
+// Bulk fills of RandomStream against the gtc/random functions per value, with a check against the scalar reference
+void RunRandomBenchmarks();
+
+void RunBenchmarks();
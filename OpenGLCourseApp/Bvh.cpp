@@ -0,0 +1,235 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	const int BINS = 16;
+
+	float HalfArea(const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 d = boxMax - boxMin;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	struct Bin
+	{
+		glm::vec3 boxMin, boxMax;
+		int count;
+	};
+}
+
+Bvh::Bvh()
+{
+}
+
+void Bvh::Build(const glm::vec3* corners, size_t triangleCount)
+{
+	nodes.clear();
+	order.resize(triangleCount);
+	if (!triangleCount)
+	{
+		v0.clear();
+		v1.clear();
+		v2.clear();
+		return;
+	}
+
+	std::vector<glm::vec3> centroids(triangleCount), boxMins(triangleCount), boxMaxs(triangleCount);
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		const glm::vec3* c = corners + i * 3;
+		boxMins[i] = glm::min(c[0], glm::min(c[1], c[2]));
+		boxMaxs[i] = glm::max(c[0], glm::max(c[1], c[2]));
+		centroids[i] = (c[0] + c[1] + c[2]) * (1.f / 3.f);
+		order[i] = (int)i;
+	}
+
+	// A binary tree has at most 2n - 1 nodes
+	nodes.reserve(triangleCount * 2);
+	nodes.resize(1);
+	Subdivide(0, 0, (int)triangleCount, 0, centroids, boxMins, boxMaxs);
+
+	v0.resize(triangleCount);
+	v1.resize(triangleCount);
+	v2.resize(triangleCount);
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		const glm::vec3* c = corners + (size_t)order[i] * 3;
+		v0[i] = c[0];
+		v1[i] = c[1];
+		v2[i] = c[2];
+	}
+}
+
+void Bvh::Subdivide(int node, int first, int count, int depth, const std::vector<glm::vec3>& centroids,
+	const std::vector<glm::vec3>& boxMins, const std::vector<glm::vec3>& boxMaxs)
+{
+	glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	for (int i = first; i < first + count; ++i)
+	{
+		int t = order[i];
+		boxMin = glm::min(boxMin, boxMins[t]);
+		boxMax = glm::max(boxMax, boxMaxs[t]);
+		centroidMin = glm::min(centroidMin, centroids[t]);
+		centroidMax = glm::max(centroidMax, centroids[t]);
+	}
+
+	nodes[node].boxMin = boxMin;
+	nodes[node].boxMax = boxMax;
+	nodes[node].first = first;
+	nodes[node].count = count;
+	nodes[node].axis = 0;
+
+	if (count <= 1 || depth >= MAX_DEPTH)
+		return;
+
+	// Cheapest split between bins: left count * left area + right count * right area
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestSplit = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.f)
+			continue;
+
+		Bin bins[BINS];
+		for (int b = 0; b < BINS; ++b)
+		{
+			bins[b].boxMin = glm::vec3(FLT_MAX);
+			bins[b].boxMax = glm::vec3(-FLT_MAX);
+			bins[b].count = 0;
+		}
+
+		float scale = BINS / extent;
+		for (int i = first; i < first + count; ++i)
+		{
+			int t = order[i];
+			int b = std::min(BINS - 1, (int)((centroids[t][axis] - centroidMin[axis]) * scale));
+			bins[b].boxMin = glm::min(bins[b].boxMin, boxMins[t]);
+			bins[b].boxMax = glm::max(bins[b].boxMax, boxMaxs[t]);
+			++bins[b].count;
+		}
+
+		// Sweep from the left, then from the right adding the costs
+		float leftArea[BINS - 1];
+		int leftCount[BINS - 1];
+		glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+		int sweepCount = 0;
+		for (int b = 0; b < BINS - 1; ++b)
+		{
+			sweepMin = glm::min(sweepMin, bins[b].boxMin);
+			sweepMax = glm::max(sweepMax, bins[b].boxMax);
+			sweepCount += bins[b].count;
+			leftArea[b] = sweepCount ? HalfArea(sweepMin, sweepMax) : 0.f;
+			leftCount[b] = sweepCount;
+		}
+
+		sweepMin = glm::vec3(FLT_MAX);
+		sweepMax = glm::vec3(-FLT_MAX);
+		sweepCount = 0;
+		for (int b = BINS - 1; b > 0; --b)
+		{
+			sweepMin = glm::min(sweepMin, bins[b].boxMin);
+			sweepMax = glm::max(sweepMax, bins[b].boxMax);
+			sweepCount += bins[b].count;
+			if (!sweepCount || !leftCount[b - 1])
+				continue;
+
+			float cost = leftCount[b - 1] * leftArea[b - 1] + sweepCount * HalfArea(sweepMin, sweepMax);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b - 1;
+			}
+		}
+	}
+
+	// All centroids in one point, or splitting costs more than testing everything here
+	if (bestAxis < 0 || (bestCost >= count * HalfArea(boxMin, boxMax) && count <= MAX_LEAF))
+		return;
+
+	float scale = BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+	float splitMin = centroidMin[bestAxis];
+	int* middle = std::partition(&order[first], &order[first] + count, [&](int t)
+	{
+		return std::min(BINS - 1, (int)((centroids[t][bestAxis] - splitMin) * scale)) <= bestSplit;
+	});
+	int leftCount = (int)(middle - &order[first]);
+
+	int left = (int)nodes.size();
+	nodes.resize(nodes.size() + 2);
+	nodes[node].first = left;
+	nodes[node].count = 0;
+	nodes[node].axis = bestAxis;
+
+	Subdivide(left, first, leftCount, depth + 1, centroids, boxMins, boxMaxs);
+	Subdivide(left + 1, first + leftCount, count - leftCount, depth + 1, centroids, boxMins, boxMaxs);
+}
+
+void Bvh::Intersect(const BatchMath::RaySoA& rays, size_t count, BvhHit* hits) const
+{
+	// The scratch below holds one packet, more rays go through as consecutive packets
+	if (count > MAX_PACKET)
+	{
+		for (size_t i = 0; i < count; i += MAX_PACKET)
+			Intersect(rays.Offset(i), std::min<size_t>(count - i, MAX_PACKET), hits + i);
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		hits[i].triangle = -1;
+	if (nodes.empty() || !count)
+		return;
+
+	float tNear[MAX_PACKET], t[MAX_PACKET], u[MAX_PACKET], v[MAX_PACKET];
+	const float miss = std::numeric_limits<float>::infinity();
+
+	// The packet's summed direction picks which child goes first
+	glm::vec3 direction(0.f);
+	for (size_t i = 0; i < count; ++i)
+		direction += glm::vec3(rays.dx[i], rays.dy[i], rays.dz[i]);
+
+	int stack[MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& node = nodes[stack[--top]];
+
+		// Also rejects nodes behind every ray's closest hit so far
+		BatchMath::IntersectRaysBox(rays, node.boxMin, node.boxMax, tNear, count);
+		bool reached = false;
+		for (size_t i = 0; i < count && !reached; ++i)
+			reached = tNear[i] != miss;
+		if (!reached)
+			continue;
+
+		if (node.count)
+		{
+			for (int k = node.first; k < node.first + node.count; ++k)
+			{
+				BatchMath::IntersectRaysTriangle(rays, v0[k], v1[k], v2[k], t, u, v, count);
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (t[i] < rays.tMax[i])
+					{
+						rays.tMax[i] = t[i];
+						hits[i].triangle = order[k];
+						hits[i].u = u[i];
+						hits[i].v = v[i];
+					}
+				}
+			}
+			continue;
+		}
+
+		bool leftFirst = direction[node.axis] >= 0.f;
+		stack[top++] = leftFirst ? node.first + 1 : node.first;
+		stack[top++] = leftFirst ? node.first : node.first + 1;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BatchMath.h"
+
+/**	Bounding volume hierarchy over a triangle soup, for ray queries on the CPU
+ *
+ *	Built top down with the surface area heuristic over 16 centroid bins per
+ *	axis; a node becomes a leaf when no split is cheaper than intersecting all of
+ *	its triangles (at most MAX_LEAF), or at MAX_DEPTH. Triangles are reordered so
+ *	each leaf is a contiguous range.
+ *
+ *	Intersect traces a packet of rays at once: every node box goes through
+ *	BatchMath::IntersectRaysBox and every leaf triangle through
+ *	IntersectRaysTriangle, so the whole packet is tested in SIMD registers and a
+ *	node is skipped only when no ray of the packet reaches it. The rays' tMax
+ *	shrinks to the closest hit as the traversal goes, which culls nodes behind it;
+ *	a ray with tMax < 0 takes no part.
+ */
+
+// Closest hit of each ray in a packet, triangle -1 where there is none
+struct BvhHit
+{
+	int triangle;
+	float u, v;		// Barycentrics of corners 1 and 2
+};
+
+class Bvh
+{
+public:
+	static const int MAX_LEAF = 8;
+	static const int MAX_DEPTH = 48;
+	static const int MAX_PACKET = 64;		// Rays traced together, Intersect splits larger counts
+
+	Bvh();
+
+	// corners holds three points per triangle
+	void Build(const glm::vec3* corners, size_t triangleCount);
+
+	size_t GetTriangleCount() const { return order.size(); }
+	size_t GetNodeCount() const { return nodes.size(); }
+
+	// Source index of the triangle at position i of the built order
+	int GetSourceIndex(int i) const { return order[i]; }
+
+	// Triangle ids in hits are source indices. Shortens rays.tMax to each hit
+	void Intersect(const BatchMath::RaySoA& rays, size_t count, BvhHit* hits) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 boxMin;
+		int first;			// Leaf: first triangle, inner: left child (the right one follows it)
+		glm::vec3 boxMax;
+		int count;			// Triangles, 0 for inner nodes
+		int axis;			// Split axis, to visit the nearer child first
+	};
+
+	void Subdivide(int node, int first, int count, int depth, const std::vector<glm::vec3>& centroids,
+		const std::vector<glm::vec3>& boxMins, const std::vector<glm::vec3>& boxMaxs);
+
+	std::vector<Node> nodes;
+	std::vector<int> order;
+	std::vector<glm::vec3> v0, v1, v2;		// In built order
+};
@@ -0,0 +1,69 @@
+#include "Camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	const float MAX_PITCH = 1.55f;			// Just short of straight up, where lookAt degenerates
+	const double MAX_SAMPLE_STEP = 0.1;		// Seconds; a stall doesn't throw the camera across the scene
+}
+
+glm::vec3 CameraState::Front() const
+{
+	float cosPitch = std::cos(pitch);
+	return glm::vec3(std::sin(yaw) * cosPitch, std::sin(pitch), -std::cos(yaw) * cosPitch);
+}
+
+glm::mat4 CameraState::View() const
+{
+	return glm::lookAt(position, position + Front(), glm::vec3(0.f, 1.f, 0.f));
+}
+
+Camera::Camera(const glm::vec3& position, float yaw, float pitch, float move, float turn)
+	: moveSpeed(move), turnSpeed(turn), lastCursorX(0.0), lastCursorY(0.0), turning(false)
+{
+	state.position = position;
+	state.yaw = yaw;
+	state.pitch = pitch;
+	state.sampleTime = 0;
+}
+
+void Camera::Sample(GLFWwindow* window)
+{
+	uint64_t now = glfwGetTimerValue();
+	double elapsed = state.sampleTime ? (double)(now - state.sampleTime) / (double)glfwGetTimerFrequency() : 0.0;
+	float step = (float)std::min(elapsed, MAX_SAMPLE_STEP) * moveSpeed;
+	state.sampleTime = now;
+
+	double cursorX, cursorY;
+	glfwGetCursorPos(window, &cursorX, &cursorY);
+	bool held = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+	if (held && turning)
+	{
+		state.yaw += (float)(cursorX - lastCursorX) * turnSpeed;
+		state.pitch = std::max(-MAX_PITCH, std::min(MAX_PITCH, state.pitch - (float)(cursorY - lastCursorY) * turnSpeed));
+	}
+	turning = held;
+	lastCursorX = cursorX;
+	lastCursorY = cursorY;
+
+	glm::vec3 front = state.Front();
+	glm::vec3 right = glm::normalize(glm::cross(front, glm::vec3(0.f, 1.f, 0.f)));
+	glm::vec3 move(0.f);
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		move += front;
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		move -= front;
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		move += right;
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		move -= right;
+	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+		move.y += 1.f;
+	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+		move.y -= 1.f;
+	state.position += move * step;
+}
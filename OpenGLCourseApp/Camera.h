@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+/**	Fly camera driven straight from the GLFW input state
+ *
+ *	W / S move along the view direction, A / D sideways, E / Q up and down; the
+ *	cursor turns the camera while the right mouse button is held. Sample reads the
+ *	keys and cursor as glfwPollEvents last left them and moves by the time since
+ *	the previous sample, so sampling more than once a frame only makes the result
+ *	fresher. Sample and glfwPollEvents belong on the main thread.
+ *
+ *	Yaw is measured from -Z towards +X, so the default camera at the origin gives
+ *	exactly the identity view.
+ */
+
+// One sample of the camera, cheap to copy between threads
+struct CameraState
+{
+	glm::vec3 position;
+	float yaw, pitch;			// Radians
+	uint64_t sampleTime;		// glfwGetTimerValue when the input was read
+
+	glm::vec3 Front() const;
+	glm::mat4 View() const;
+};
+
+class Camera
+{
+public:
+	Camera(const glm::vec3& position = glm::vec3(0.f), float yaw = 0.f, float pitch = 0.f,
+		float moveSpeed = 2.f, float turnSpeed = 0.003f);
+
+	void Sample(GLFWwindow* window);
+
+	const CameraState& GetState() const { return state; }
+
+private:
+	CameraState state;
+	float moveSpeed;			// Units per second
+	float turnSpeed;			// Radians per pixel of cursor movement
+	double lastCursorX, lastCursorY;
+	bool turning;
+};
@@ -0,0 +1,435 @@
+#include "ClipmapTerrain.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ShaderUtil.h"
+
+// Patch vertices are whole cells; the patch's instance places it, heights come from the level's layer
+static const char* cTerrainVertexShader = "\n\
+#version 330\n\
+layout (location = 0) in vec2 cell;\n\
+layout (location = 1) in vec4 placement;\n\
+layout (location = 2) in ivec2 texel;\n\
+\n\
+out vec3 vPos;\n\
+\n\
+uniform mat4 projection;\n\
+uniform mat4 view;\n\
+uniform sampler2DArray heights;\n\
+uniform int resolution;\n\
+uniform int levelCount;\n\
+uniform float viewerHeight;\n\
+uniform float morphStart;\n\
+uniform float morphWidth;\n\
+\n\
+void main()\n\
+{\n\
+	ivec2 index = texel + ivec2(cell);\n\
+	int level = int(placement.w);\n\
+	float height = texelFetch(heights, ivec3(index & (resolution - 1), level), 0).r;\n\
+	vec2 xz = placement.xy + cell * placement.z;\n\
+\n\
+	// Towards the outer edge, blend into the next level so the two meet without cracks.\n\
+	// Filtering halfway between its texels gives the coarse edge under odd grid points\n\
+	if (level + 1 < levelCount)\n\
+	{\n\
+		vec2 distance = abs(xz) / placement.z;\n\
+		float alpha = clamp((max(distance.x, distance.y) - morphStart) / morphWidth, 0.0, 1.0);\n\
+		vec2 uv = (vec2(index) * 0.5 + 0.5) / float(resolution);\n\
+		height = mix(height, texture(heights, vec3(uv, float(level + 1))).r, alpha);\n\
+	}\n\
+\n\
+	vPos = vec3(xz.x, height - viewerHeight, xz.y);\n\
+	gl_Position = projection * view * vec4(vPos, 1.0);\n\
+}";
+
+// Flat shaded from the screen space derivatives, rock on the slopes
+static const char* cTerrainFragmentShader = "\n\
+#version 330\n\
+in vec3 vPos;\n\
+out vec4 colour;\n\
+\n\
+void main()\n\
+{\n\
+	vec3 normal = normalize(cross(dFdx(vPos), dFdy(vPos)));\n\
+	if (normal.y < 0.0)\n\
+		normal = -normal;\n\
+\n\
+	vec3 albedo = mix(vec3(0.25, 0.4, 0.15), vec3(0.45, 0.4, 0.35), smoothstep(0.75, 0.9, 1.0 - normal.y));\n\
+	float light = 0.2 + 0.8 * max(dot(normal, normalize(vec3(0.4, 0.8, 0.3))), 0.0);\n\
+	colour = vec4(albedo * light, 1.0);\n\
+}";
+
+// Non-negative remainder, for toroidal addressing of negative grid points
+static int Wrap(int value, int size)
+{
+	int r = value % size;
+	return r < 0 ? r + size : r;
+}
+
+HeightSource NoiseHeightSource(NoiseType type, const BatchMath::FbmSettings& fbm, float amplitude)
+{
+	return [=](const glm::dvec2& origin, double spacing, int width, int depth, float* out, JobSystem* jobs)
+	{
+		Noise::FillGrid(type, fbm, glm::vec2(origin), glm::vec2((float)spacing), width, depth, out, jobs);
+		for (size_t i = 0, count = (size_t)width * depth; i < count; ++i)
+			out[i] *= amplitude;
+	};
+}
+
+HeightSource HeightmapSource(const std::vector<float>& heights, int width, int depth, float spacing)
+{
+	return [=](const glm::dvec2& origin, double step, int outWidth, int outDepth, float* out, JobSystem*)
+	{
+		for (int z = 0; z < outDepth; ++z)
+		{
+			double v = (origin.y + z * step) / spacing;
+			double row = std::floor(v);
+			float tz = (float)(v - row);
+			const float* row0 = &heights[(size_t)Wrap((int)row, depth) * width];
+			const float* row1 = &heights[(size_t)Wrap((int)row + 1, depth) * width];
+
+			for (int x = 0; x < outWidth; ++x)
+			{
+				double u = (origin.x + x * step) / spacing;
+				double column = std::floor(u);
+				float tx = (float)(u - column);
+				int x0 = Wrap((int)column, width), x1 = Wrap((int)column + 1, width);
+
+				float top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+				float bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+				*out++ = top + (bottom - top) * tz;
+			}
+		}
+	};
+}
+
+ClipmapTerrain::ClipmapTerrain()
+{
+	levelCount = resolution = blockCells = 0;
+	spacing = 0.f;
+	program = vao = vertexBuffer = indexBuffer = instanceBuffer = heightTexture = 0;
+	uniformProjection = uniformView = uniformHeights = uniformResolution = uniformLevelCount = 0;
+	uniformViewerHeight = uniformMorphStart = uniformMorphWidth = 0;
+	for (int i = 0; i < PIECE_COUNT; ++i)
+		meshes[i].indexCount = meshes[i].firstIndex = meshes[i].baseVertex = 0;
+	primed = false;
+	updateSeconds = 0.0;
+	texels = 0;
+	frames = 0;
+}
+
+bool ClipmapTerrain::Init(int levels, int terrainResolution, float gridSpacing, const HeightSource& heightSource)
+{
+	if (levels < 1 || levels > 16 || terrainResolution < 16 || terrainResolution > 1024 ||
+		(terrainResolution & (terrainResolution - 1)) != 0 || !heightSource)
+	{
+		printf("Clipmap terrain needs 1 to 16 levels, a power of two resolution from 16 to 1024 and a height source\n");
+		return false;
+	}
+
+	levelCount = levels;
+	resolution = terrainResolution;
+	blockCells = resolution / 4 - 1;
+	spacing = gridSpacing;
+	source = heightSource;
+	origins.assign(levelCount, glm::ivec2(0));
+	primed = false;
+
+	program = LinkProgram(cTerrainVertexShader, GL_VERTEX_SHADER, cTerrainFragmentShader, GL_FRAGMENT_SHADER);
+	if (!program)
+		return false;
+
+	uniformProjection = glGetUniformLocation(program, "projection");
+	uniformView = glGetUniformLocation(program, "view");
+	uniformHeights = glGetUniformLocation(program, "heights");
+	uniformResolution = glGetUniformLocation(program, "resolution");
+	uniformLevelCount = glGetUniformLocation(program, "levelCount");
+	uniformViewerHeight = glGetUniformLocation(program, "viewerHeight");
+	uniformMorphStart = glGetUniformLocation(program, "morphStart");
+	uniformMorphWidth = glGetUniformLocation(program, "morphWidth");
+
+	int b = blockCells;
+	std::vector<glm::vec2> vertices;
+	std::vector<GLushort> indices;
+	BuildMesh(b, b, vertices, indices, meshes[PIECE_BLOCK]);
+	BuildMesh(2, b, vertices, indices, meshes[PIECE_FIXUP_X]);
+	BuildMesh(b, 2, vertices, indices, meshes[PIECE_FIXUP_Z]);
+	BuildMesh(1, 2 * b + 2, vertices, indices, meshes[PIECE_TRIM_X]);
+	BuildMesh(2 * b + 1, 1, vertices, indices, meshes[PIECE_TRIM_Z]);
+	BuildMesh(2, 2, vertices, indices, meshes[PIECE_CENTRE]);
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), 0);
+	glEnableVertexAttribArray(0);
+
+	// Pointers are set per draw, each mesh's instances start somewhere else
+	glGenBuffers(1, &instanceBuffer);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(1, 1);
+	glVertexAttribDivisor(2, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glGenTextures(1, &heightTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, resolution, resolution, levelCount, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	gpuTimer.Init();
+
+	return true;
+}
+
+void ClipmapTerrain::BuildMesh(int width, int depth, std::vector<glm::vec2>& vertices, std::vector<GLushort>& indices, Mesh& mesh)
+{
+	mesh.baseVertex = (GLint)vertices.size();
+	mesh.firstIndex = (GLsizei)indices.size();
+
+	for (int z = 0; z <= depth; ++z)
+		for (int x = 0; x <= width; ++x)
+			vertices.push_back(glm::vec2((float)x, (float)z));
+
+	for (int z = 0; z < depth; ++z)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			GLushort corner = (GLushort)(z * (width + 1) + x);
+			GLushort below = (GLushort)(corner + width + 1);
+			GLushort quad[] = { corner, below, (GLushort)(corner + 1), (GLushort)(corner + 1), below, (GLushort)(below + 1) };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	mesh.indexCount = (GLsizei)indices.size() - mesh.firstIndex;
+}
+
+void ClipmapTerrain::Update(const glm::dvec3& viewer, JobSystem* jobs)
+{
+	int points = resolution - 1;		// Grid points across a level, the last texel is spare
+
+	for (int level = 0; level < levelCount; ++level)
+	{
+		// Snapped to every other grid point, so each level's corner is a point of the next
+		double levelSpacing = spacing * (double)(1 << level);
+		glm::ivec2 origin(2 * (int)std::floor(viewer.x / (2.0 * levelSpacing)) - 2 * blockCells,
+			2 * (int)std::floor(viewer.z / (2.0 * levelSpacing)) - 2 * blockCells);
+		glm::ivec2 old = origins[level];
+		glm::ivec2 moved = origin - old;
+		origins[level] = origin;
+
+		if (!primed || std::abs(moved.x) >= points || std::abs(moved.y) >= points)
+		{
+			Refresh(level, origin.x, origin.y, points, points, jobs);
+			continue;
+		}
+
+		// Columns that came into view, over the whole new depth
+		if (moved.x > 0)
+			Refresh(level, old.x + points, origin.y, moved.x, points, jobs);
+		else if (moved.x < 0)
+			Refresh(level, origin.x, origin.y, -moved.x, points, jobs);
+
+		// Rows that came into view, over the columns that were already there
+		int keptX = std::max(origin.x, old.x);
+		int keptWidth = points - std::abs(moved.x);
+		if (moved.y > 0)
+			Refresh(level, keptX, old.y + points, keptWidth, moved.y, jobs);
+		else if (moved.y < 0)
+			Refresh(level, keptX, origin.y, keptWidth, -moved.y, jobs);
+	}
+
+	primed = true;
+}
+
+void ClipmapTerrain::Refresh(int level, int x, int z, int width, int depth, JobSystem* jobs)
+{
+	double levelSpacing = spacing * (double)(1 << level);
+	scratch.resize((size_t)width * depth);
+	source(glm::dvec2(x * levelSpacing, z * levelSpacing), levelSpacing, width, depth, &scratch[0], jobs);
+	texels += scratch.size();
+
+	// Up to four pieces where the rectangle wraps around the texture edges
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+	for (int row = 0; row < depth; )
+	{
+		int texelZ = Wrap(z + row, resolution);
+		int rows = std::min(depth - row, resolution - texelZ);
+		for (int column = 0; column < width; )
+		{
+			int texelX = Wrap(x + column, resolution);
+			int columns = std::min(width - column, resolution - texelX);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, texelX, texelZ, level, columns, rows, 1, GL_RED, GL_FLOAT,
+				&scratch[(size_t)row * width + column]);
+			column += columns;
+		}
+		row += rows;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void ClipmapTerrain::AddPiece(Piece piece, int level, int x, int z, const glm::dvec3& viewer)
+{
+	double levelSpacing = spacing * (double)(1 << level);
+	glm::ivec2 corner = origins[level] + glm::ivec2(x, z);
+
+	Instance instance;
+	instance.x = (float)(corner.x * levelSpacing - viewer.x);
+	instance.z = (float)(corner.y * levelSpacing - viewer.z);
+	instance.spacing = (float)levelSpacing;
+	instance.level = (float)level;
+	instance.texelX = Wrap(corner.x, 2 * resolution);
+	instance.texelZ = Wrap(corner.y, 2 * resolution);
+	pieces[piece].push_back(instance);
+}
+
+void ClipmapTerrain::BuildInstances(const glm::dvec3& viewer)
+{
+	for (int i = 0; i < PIECE_COUNT; ++i)
+		pieces[i].clear();
+
+	int b = blockCells;
+	const int starts[4] = { 0, b, 2 * b + 2, 3 * b + 2 };		// Block columns, the fixups fill 2b to 2b + 2
+
+	for (int level = 0; level < levelCount; ++level)
+	{
+		bool finest = level == 0;
+
+		for (int j = 0; j < 4; ++j)
+			for (int i = 0; i < 4; ++i)
+				if (finest || i == 0 || i == 3 || j == 0 || j == 3)
+					AddPiece(PIECE_BLOCK, level, starts[i], starts[j], viewer);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			if (finest || i == 0 || i == 3)
+			{
+				AddPiece(PIECE_FIXUP_X, level, 2 * b, starts[i], viewer);
+				AddPiece(PIECE_FIXUP_Z, level, starts[i], 2 * b, viewer);
+			}
+		}
+
+		if (finest)
+		{
+			AddPiece(PIECE_CENTRE, level, 2 * b, 2 * b, viewer);
+			continue;
+		}
+
+		// The finer level is 2b + 1 cells of this one and sits b or b + 1 in; the trim takes the column
+		// and row it leaves over
+		glm::ivec2 inner = origins[level - 1] / 2 - origins[level];
+		int trimX = inner.x == b ? 3 * b + 1 : b;
+		AddPiece(PIECE_TRIM_X, level, trimX, b, viewer);
+		AddPiece(PIECE_TRIM_Z, level, trimX == b ? b + 1 : b, inner.y == b ? 3 * b + 1 : b, viewer);
+	}
+
+	instances.clear();
+	for (int i = 0; i < PIECE_COUNT; ++i)
+		instances.insert(instances.end(), pieces[i].begin(), pieces[i].end());
+}
+
+void ClipmapTerrain::Draw(const glm::dvec3& viewer, const glm::mat4& projection, const glm::mat4& view, JobSystem* jobs)
+{
+	if (!program)
+		return;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+	Update(viewer, jobs);
+
+	BuildInstances(viewer);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), &instances[0], GL_STREAM_DRAW);
+
+	updateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	gpuTimer.Begin();
+
+	float morphWidth = (4 * blockCells + 2) / 10.f;
+	glUseProgram(program);
+	glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+	glUniform1i(uniformHeights, 0);
+	glUniform1i(uniformResolution, resolution);
+	glUniform1i(uniformLevelCount, levelCount);
+	glUniform1f(uniformViewerHeight, (float)viewer.y);
+	glUniform1f(uniformMorphStart, 2 * blockCells - morphWidth);
+	glUniform1f(uniformMorphWidth, morphWidth);
+
+	glBindVertexArray(vao);
+
+	// GL 3.3 has no base instance, so the instance pointers move to each mesh's range instead
+	size_t first = 0;
+	for (int i = 0; i < PIECE_COUNT; ++i)
+	{
+		if (pieces[i].empty())
+			continue;
+
+		const char* base = (const char*)(first * sizeof(Instance));
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), base + offsetof(Instance, x));
+		glVertexAttribIPointer(2, 2, GL_INT, sizeof(Instance), base + offsetof(Instance, texelX));
+
+		const Mesh& mesh = meshes[i];
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT,
+			(const void*)(mesh.firstIndex * sizeof(GLushort)), (GLsizei)pieces[i].size(), mesh.baseVertex);
+		first += pieces[i].size();
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glUseProgram(0);
+
+	gpuTimer.End();
+	++frames;
+}
+
+TerrainTimings ClipmapTerrain::TakeTimings()
+{
+	TerrainTimings timings;
+	timings.updateMs = frames ? updateSeconds * 1000.0 / frames : 0.0;
+	timings.texelsPerFrame = frames ? (double)texels / frames : 0.0;
+	timings.gpuMs = gpuTimer.Collect();
+	timings.frames = frames;
+
+	updateSeconds = 0.0;
+	texels = 0;
+	frames = 0;
+	return timings;
+}
+
+ClipmapTerrain::~ClipmapTerrain()
+{
+	if (!program)
+		return;		// Init never got a context
+
+	GLuint buffers[] = { vertexBuffer, indexBuffer, instanceBuffer };
+	glDeleteBuffers(3, buffers);
+	glDeleteTextures(1, &heightTexture);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteProgram(program);
+}
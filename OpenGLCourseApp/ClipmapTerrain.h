@@ -0,0 +1,143 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "BatchMath.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+#include "Noise.h"
+
+/**	Geometry clipmap terrain (Losasso & Hoppe, laid out as in GPU Gems 2 ch. 2)
+ *
+ *	levels nested square grids follow the viewer, level l with a grid spacing of
+ *	spacing * 2^l. Each level keeps its heights in one layer of an R32F texture
+ *	array, resolution texels a side, addressed toroidally: world grid point (x, z)
+ *	of a level lives in texel (x, z) modulo resolution. When the viewer crosses a
+ *	grid line only the rows and columns that came into view are generated by the
+ *	HeightSource and uploaded, everything else stays where it is.
+ *
+ *	A level is 4b + 2 cells across (b = resolution / 4 - 1). Levels past the first
+ *	are a ring around the next finer one, built from a handful of shared patch
+ *	meshes:
+ *
+ *		block		b x b cells, 12 per ring (all 16 in the finest level)
+ *		fixup		2 x b gaps between the blocks in the middle of each side
+ *		trim		an L of 1 cell wide strips, on whichever side the finer level
+ *					left free this frame
+ *		centre		2 x 2 cells, finest level only
+ *
+ *	Every patch of every level goes into one instance buffer and each mesh is one
+ *	instanced draw, so the terrain is six draws and a few strip uploads per frame
+ *	however large the world is. The vertex shader fetches heights and, near the
+ *	outer edge of a level, blends towards the next coarser one so rings meet
+ *	without cracks. Positions are relative to the viewer, which is kept in double
+ *	precision on the CPU.
+ *
+ *	Works on a GL 3.3 core context.
+ */
+
+// width * depth heights, sample (x, z) for world (origin.x + x * spacing, origin.y + z * spacing), row major.
+// Called on the GL thread; may use jobs
+typedef std::function<void(const glm::dvec2& origin, double spacing, int width, int depth, float* out, JobSystem* jobs)> HeightSource;
+
+// fBm noise scaled by amplitude, generated with Noise::FillGrid
+HeightSource NoiseHeightSource(NoiseType type, const BatchMath::FbmSettings& fbm, float amplitude);
+
+// Bilinear samples of a heightmap repeated over the world, heights[z * width + x] spacing apart.
+// Stands in for streamed tiles: a pager only has to fill the requested rectangle the same way
+HeightSource HeightmapSource(const std::vector<float>& heights, int width, int depth, float spacing);
+
+// Per-frame averages since the last TakeTimings
+struct TerrainTimings
+{
+	double updateMs;			// Generating and uploading strips
+	double texelsPerFrame;		// Heights generated
+	double gpuMs;				// Draws, from GL_TIME_ELAPSED queries
+	unsigned frames;
+};
+
+class ClipmapTerrain
+{
+public:
+	ClipmapTerrain();
+
+	// resolution is a power of two from 16 to 1024
+	bool Init(int levels, int resolution, float spacing, const HeightSource& source);
+
+	int GetLevelCount() const { return levelCount; }
+	int GetResolution() const { return resolution; }
+
+	// Side of the outermost level in world units
+	float GetExtent() const { return spacing * (resolution - 2) * (float)(1 << (levelCount - 1)); }
+
+	// Refreshes what the viewer moved onto, then draws. view is for a camera at the viewer
+	void Draw(const glm::dvec3& viewer, const glm::mat4& projection, const glm::mat4& view, JobSystem* jobs);
+
+	TerrainTimings TakeTimings();
+
+	~ClipmapTerrain();
+
+private:
+	enum Piece
+	{
+		PIECE_BLOCK,
+		PIECE_FIXUP_X,		// 2 cells along x, b along z
+		PIECE_FIXUP_Z,		// b along x, 2 along z
+		PIECE_TRIM_X,		// 1 along x, 2b + 2 along z
+		PIECE_TRIM_Z,		// 2b + 1 along x, 1 along z
+		PIECE_CENTRE,
+		PIECE_COUNT
+	};
+
+	struct Mesh
+	{
+		GLsizei indexCount;
+		GLsizei firstIndex;
+		GLint baseVertex;
+	};
+
+	struct Instance
+	{
+		float x, z;				// Corner relative to the viewer
+		float spacing, level;
+		GLint texelX, texelZ;	// Corner's grid point modulo 2 * resolution
+	};
+
+	static void BuildMesh(int width, int depth, std::vector<glm::vec2>& vertices, std::vector<GLushort>& indices, Mesh& mesh);
+
+	// Level origins for viewer, generating the strips that changed
+	void Update(const glm::dvec3& viewer, JobSystem* jobs);
+
+	// Heights of width * depth grid points from (x, z) of a level, uploaded with wrap around
+	void Refresh(int level, int x, int z, int width, int depth, JobSystem* jobs);
+
+	// Patch at cell (x, z) from the level origin
+	void AddPiece(Piece piece, int level, int x, int z, const glm::dvec3& viewer);
+
+	void BuildInstances(const glm::dvec3& viewer);
+
+	int levelCount, resolution, blockCells;
+	float spacing;
+	HeightSource source;
+
+	GLuint program, vao, vertexBuffer, indexBuffer, instanceBuffer, heightTexture;
+	GLint uniformProjection, uniformView, uniformHeights, uniformResolution, uniformLevelCount,
+		uniformViewerHeight, uniformMorphStart, uniformMorphWidth;
+
+	Mesh meshes[PIECE_COUNT];
+	std::vector<glm::ivec2> origins;		// Grid point of each level's corner, in that level's cells
+	bool primed;							// origins hold what the textures were filled for
+	std::vector<Instance> pieces[PIECE_COUNT];
+	std::vector<Instance> instances;
+	std::vector<float> scratch;
+
+	double updateSeconds;
+	unsigned long long texels;
+	GpuTimer gpuTimer;
+	unsigned frames;
+};
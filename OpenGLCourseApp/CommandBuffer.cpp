@@ -0,0 +1,270 @@
+#include "CommandBuffer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "RenderQueue.h"
+
+LinearAllocator::LinearAllocator(size_t size)
+{
+	blockSize = size;
+	currentBlock = 0;
+	offset = 0;
+}
+
+LinearAllocator::LinearAllocator(LinearAllocator&& other) noexcept
+	: blocks(std::move(other.blocks))
+{
+	blockSize = other.blockSize;
+	currentBlock = other.currentBlock;
+	offset = other.offset;
+	other.currentBlock = 0;
+	other.offset = 0;
+}
+
+void* LinearAllocator::Allocate(size_t size, size_t alignment)
+{
+	if (size + alignment > blockSize)
+	{
+		printf("LinearAllocator: %u bytes do not fit a %u byte block\n", (unsigned)size, (unsigned)blockSize);
+		abort();
+	}
+
+	for (;;)
+	{
+		if (currentBlock == blocks.size())
+		{
+			unsigned char* block = (unsigned char*)malloc(blockSize);
+			if (!block)
+			{
+				printf("LinearAllocator: failed to allocate a %u byte block\n", (unsigned)blockSize);
+				abort();
+			}
+			blocks.push_back(block);
+		}
+
+		size_t base = (size_t)blocks[currentBlock];
+		size_t aligned = (base + offset + alignment - 1) & ~(alignment - 1);
+		if (aligned + size <= base + blockSize)
+		{
+			offset = aligned + size - base;
+			return (void*)aligned;
+		}
+
+		++currentBlock;
+		offset = 0;
+	}
+}
+
+void LinearAllocator::Reset()
+{
+	currentBlock = 0;
+	offset = 0;
+}
+
+LinearAllocator::~LinearAllocator()
+{
+	for (size_t i = 0; i < blocks.size(); ++i)
+		free(blocks[i]);
+}
+
+CommandBuffer::CommandBuffer()
+{
+	last = nullptr;
+}
+
+void CommandBuffer::Reset()
+{
+	memory.Reset();
+	packets.clear();
+	last = nullptr;
+}
+
+void CommandBuffer::BeginPacket(uint64_t key)
+{
+	Packet packet = { key, nullptr };
+	packets.push_back(packet);
+	last = nullptr;
+}
+
+template <typename T> T* CommandBuffer::Push(CommandType type)
+{
+	static_assert(sizeof(T) + alignof(T) <= LinearAllocator::DEFAULT_BLOCK_SIZE, "Command does not fit an allocator block");
+
+	if (packets.empty())
+		BeginPacket(0);
+
+	T* command = (T*)memory.Allocate(sizeof(T), alignof(T));
+	command->header.type = type;
+	command->header.next = nullptr;
+
+	if (last)
+		last->next = &command->header;
+	else
+		packets.back().first = &command->header;
+	last = &command->header;
+
+	return command;
+}
+
+void CommandBuffer::BindProgram(GLuint program)
+{
+	Push<BindProgramCommand>(COMMAND_BIND_PROGRAM)->program = program;
+}
+
+void CommandBuffer::BindMaterial(GLuint material)
+{
+	Push<BindMaterialCommand>(COMMAND_BIND_MATERIAL)->material = material;
+}
+
+void CommandBuffer::BindVertexArray(GLuint VAO, GLuint IBO)
+{
+	BindVertexArrayCommand* command = Push<BindVertexArrayCommand>(COMMAND_BIND_VERTEX_ARRAY);
+	command->VAO = VAO;
+	command->IBO = IBO;
+}
+
+void CommandBuffer::UniformMatrix4(GLint location, const glm::mat4& value)
+{
+	UniformMat4Command* command = Push<UniformMat4Command>(COMMAND_UNIFORM_MAT4);
+	command->location = location;
+	command->value = value;
+}
+
+void CommandBuffer::Uniform4(GLint location, const glm::vec4& value)
+{
+	UniformVec4Command* command = Push<UniformVec4Command>(COMMAND_UNIFORM_VEC4);
+	command->location = location;
+	command->value = value;
+}
+
+void CommandBuffer::SetState(GLenum capability, bool enabled)
+{
+	SetStateCommand* command = Push<SetStateCommand>(COMMAND_SET_STATE);
+	command->capability = capability;
+	command->enabled = enabled;
+}
+
+void CommandBuffer::DrawElements(GLenum mode, GLsizei count, GLuint firstIndex)
+{
+	DrawElementsCommand* command = Push<DrawElementsCommand>(COMMAND_DRAW_ELEMENTS);
+	command->mode = mode;
+	command->count = count;
+	command->firstIndex = firstIndex;
+}
+
+CommandStats CommandBuffer::Replay(std::vector<CommandBuffer>& buffers, JobSystem* jobs,
+	MaterialBinder materialBinder, void* materialUser)
+{
+	CommandStats stats = CommandStats();
+
+	// Merge: one key per packet, the value points back at (buffer, packet)
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> refs;
+	std::vector<const Packet*> flat;
+	for (size_t b = 0; b < buffers.size(); ++b)
+	{
+		for (size_t p = 0; p < buffers[b].packets.size(); ++p)
+		{
+			keys.push_back(buffers[b].packets[p].key);
+			refs.push_back((uint32_t)flat.size());
+			flat.push_back(&buffers[b].packets[p]);
+		}
+	}
+	RenderQueue::RadixSort(keys, refs, jobs, 1u << 16);
+
+	GLuint boundProgram = 0, boundMaterial = 0, boundVAO = 0;
+	bool programValid = false, materialValid = false, vaoValid = false;
+
+	for (size_t i = 0; i < refs.size(); ++i)
+	{
+		++stats.packets;
+
+		for (const CommandHeader* header = flat[refs[i]]->first; header; header = header->next)
+		{
+			switch (header->type)
+			{
+			case COMMAND_BIND_PROGRAM:
+			{
+				const BindProgramCommand* command = (const BindProgramCommand*)header;
+				if (programValid && command->program == boundProgram)
+				{
+					++stats.skippedBinds;
+					break;
+				}
+				glUseProgram(command->program);
+				boundProgram = command->program;
+				programValid = true;
+				++stats.programBinds;
+				break;
+			}
+			case COMMAND_BIND_MATERIAL:
+			{
+				const BindMaterialCommand* command = (const BindMaterialCommand*)header;
+				if (materialValid && command->material == boundMaterial)
+				{
+					++stats.skippedBinds;
+					break;
+				}
+				if (materialBinder)
+					materialBinder(command->material, materialUser);
+				boundMaterial = command->material;
+				materialValid = true;
+				++stats.materialBinds;
+				break;
+			}
+			case COMMAND_BIND_VERTEX_ARRAY:
+			{
+				const BindVertexArrayCommand* command = (const BindVertexArrayCommand*)header;
+				if (vaoValid && command->VAO == boundVAO)
+				{
+					++stats.skippedBinds;
+					break;
+				}
+				glBindVertexArray(command->VAO);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, command->IBO);
+				boundVAO = command->VAO;
+				vaoValid = true;
+				++stats.vertexArrayBinds;
+				break;
+			}
+			case COMMAND_UNIFORM_MAT4:
+			{
+				const UniformMat4Command* command = (const UniformMat4Command*)header;
+				glUniformMatrix4fv(command->location, 1, GL_FALSE, glm::value_ptr(command->value));
+				break;
+			}
+			case COMMAND_UNIFORM_VEC4:
+			{
+				const UniformVec4Command* command = (const UniformVec4Command*)header;
+				glUniform4fv(command->location, 1, glm::value_ptr(command->value));
+				break;
+			}
+			case COMMAND_SET_STATE:
+			{
+				const SetStateCommand* command = (const SetStateCommand*)header;
+				if (command->enabled)
+					glEnable(command->capability);
+				else
+					glDisable(command->capability);
+				break;
+			}
+			case COMMAND_DRAW_ELEMENTS:
+			{
+				const DrawElementsCommand* command = (const DrawElementsCommand*)header;
+				glDrawElements(command->mode, command->count, GL_UNSIGNED_INT, (const void*)(command->firstIndex * sizeof(GLuint)));
+				++stats.draws;
+				break;
+			}
+			}
+		}
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+	return stats;
+}
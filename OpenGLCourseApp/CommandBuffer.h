@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+/**	Engine side command buffers
+ *
+ *	Any thread can record plain-old-data commands into its own CommandBuffer, grouped
+ *	into packets that carry a 64-bit sort key (see RenderQueue::MakeKey). Memory comes
+ *	from a per-buffer linear allocator whose blocks are kept across Reset(), so
+ *	steady-state recording does not touch the heap.
+ *
+ *	Only the GL thread calls Replay: it merges the packets of all buffers by key
+ *	(stable, so equal keys keep their per-buffer recording order) and issues the GL
+ *	calls, dropping binds that would not change anything.
+ */
+
+class LinearAllocator
+{
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	explicit LinearAllocator(size_t blockSize = DEFAULT_BLOCK_SIZE);
+	LinearAllocator(LinearAllocator&& other) noexcept;
+
+	// Never returns null: running out of memory or asking for more than a block aborts
+	void* Allocate(size_t size, size_t alignment);
+	void Reset();		// Keeps the blocks for the next frame
+
+	~LinearAllocator();
+
+private:
+	LinearAllocator(const LinearAllocator&) = delete;
+	LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+	std::vector<unsigned char*> blocks;
+	size_t blockSize;
+	size_t currentBlock;
+	size_t offset;
+};
+
+enum CommandType
+{
+	COMMAND_BIND_PROGRAM,
+	COMMAND_BIND_MATERIAL,
+	COMMAND_BIND_VERTEX_ARRAY,
+	COMMAND_UNIFORM_MAT4,
+	COMMAND_UNIFORM_VEC4,
+	COMMAND_SET_STATE,
+	COMMAND_DRAW_ELEMENTS
+};
+
+struct CommandHeader
+{
+	CommandType type;
+	CommandHeader* next;
+};
+
+struct BindProgramCommand { CommandHeader header; GLuint program; };
+struct BindMaterialCommand { CommandHeader header; GLuint material; };
+struct BindVertexArrayCommand { CommandHeader header; GLuint VAO; GLuint IBO; };
+struct UniformMat4Command { CommandHeader header; GLint location; glm::mat4 value; };
+struct UniformVec4Command { CommandHeader header; GLint location; glm::vec4 value; };
+struct SetStateCommand { CommandHeader header; GLenum capability; bool enabled; };
+struct DrawElementsCommand { CommandHeader header; GLenum mode; GLsizei count; GLuint firstIndex; };
+
+struct CommandStats
+{
+	unsigned packets;
+	unsigned draws;
+	unsigned programBinds;
+	unsigned materialBinds;
+	unsigned vertexArrayBinds;
+	unsigned skippedBinds;
+};
+
+class JobSystem;
+
+class CommandBuffer
+{
+public:
+	CommandBuffer();
+
+	void Reset();
+
+	// Every command until the next BeginPacket belongs to this key
+	void BeginPacket(uint64_t key);
+
+	void BindProgram(GLuint program);
+	void BindMaterial(GLuint material);		// Resolved by the binder passed to Replay
+	void BindVertexArray(GLuint VAO, GLuint IBO);
+	void UniformMatrix4(GLint location, const glm::mat4& value);
+	void Uniform4(GLint location, const glm::vec4& value);
+	void SetState(GLenum capability, bool enabled);
+	void DrawElements(GLenum mode, GLsizei count, GLuint firstIndex);
+
+	size_t GetPacketCount() const { return packets.size(); }
+
+	typedef void (*MaterialBinder)(GLuint material, void* user);
+
+	// GL thread only
+	static CommandStats Replay(std::vector<CommandBuffer>& buffers, JobSystem* jobs = nullptr,
+		MaterialBinder materialBinder = nullptr, void* materialUser = nullptr);
+
+private:
+	struct Packet
+	{
+		uint64_t key;
+		CommandHeader* first;
+	};
+
+	template <typename T> T* Push(CommandType type);
+
+	LinearAllocator memory;
+	std::vector<Packet> packets;
+	CommandHeader* last;
+};
@@ -0,0 +1,298 @@
+#include "CompressedClip.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm/gtx/spline.hpp>
+
+#include "Quantize.h"
+
+// Angle between two rotations; atan2 stays accurate for the tiny angles the bounds are about
+static float RotationError(const glm::quat& a, const glm::quat& b)
+{
+	glm::quat d = glm::conjugate(a) * b;
+	return 2.f * std::atan2(std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z), std::fabs(d.w));
+}
+
+static bool WithinBounds(const CompressionError& error, const CompressionSettings& settings)
+{
+	return error.rotation <= settings.rotationError && error.translation <= settings.translationError &&
+		error.scale <= settings.scaleError;
+}
+
+CompressedClip::CompressedClip()
+	: jointCount(0), sourceKeyCount(1), sampleRate(30.f), keyStride(0)
+{
+	error.rotation = error.translation = error.scale = 0.f;
+}
+
+CompressedClip::CompressedClip(const AnimationClip& clip, const CompressionSettings& settings)
+	: jointCount(clip.GetJointCount()), sourceKeyCount(clip.GetKeyCount()), sampleRate(clip.GetSampleRate()), keyStride(0)
+{
+	error.rotation = error.translation = error.scale = 0.f;
+
+	restRotationX.resize(jointCount);
+	restRotationY.resize(jointCount);
+	restRotationZ.resize(jointCount);
+	restRotationW.resize(jointCount);
+	restTranslations.resize(jointCount);
+	restScales.resize(jointCount);
+
+	// Rotations that never leave the bound around key 0 are rest pose only
+	BatchMath::QuatSoA first = clip.GetRotations(0);
+	for (int j = 0; j < jointCount; ++j)
+	{
+		glm::quat rest(first.w[j], first.x[j], first.y[j], first.z[j]);
+		restRotationX[j] = rest.x;
+		restRotationY[j] = rest.y;
+		restRotationZ[j] = rest.z;
+		restRotationW[j] = rest.w;
+
+		for (int k = 1; k < sourceKeyCount; ++k)
+		{
+			BatchMath::QuatSoA q = clip.GetRotations(k);
+			if (RotationError(rest, glm::quat(q.w[j], q.x[j], q.y[j], q.z[j])) > settings.rotationError)
+			{
+				rotationJoints.push_back((uint32_t)j);
+				break;
+			}
+		}
+	}
+
+	// Components are ranged over the clip; ones narrower than the bound take the middle of the range
+	int scaleFirst = 3 * jointCount;
+	float* restValues[2] = { &restTranslations[0].x, &restScales[0].x };
+	for (int target = 0; target < 2 * scaleFirst; ++target)
+	{
+		bool isScale = target >= scaleFirst;
+		int joint = (target % scaleFirst) / 3, axis = target % 3;
+		float low = 1e30f, high = -1e30f;
+		for (int k = 0; k < sourceKeyCount; ++k)
+		{
+			float v = (isScale ? clip.GetScales(k) : clip.GetTranslations(k))[joint][axis];
+			low = std::min(low, v);
+			high = std::max(high, v);
+		}
+
+		restValues[isScale][target % scaleFirst] = 0.5f * (low + high);
+		if (high - low > 2.f * (isScale ? settings.scaleError : settings.translationError))
+		{
+			componentTargets.push_back((uint32_t)target);
+			componentOffset.push_back(low);
+			componentScale.push_back(Quantize::RangeScale(high - low));
+		}
+	}
+
+	// Every source key quantised, in the final block layout
+	size_t rotationCount = rotationJoints.size(), componentCount = componentTargets.size();
+	keyStride = 3 * rotationCount + componentCount;
+	std::vector<uint16_t> table(sourceKeyCount * keyStride);
+	for (int k = 0; k < sourceKeyCount; ++k)
+	{
+		uint16_t* block = &table[0] + k * keyStride;
+		BatchMath::QuatSoA q = clip.GetRotations(k);
+		for (size_t r = 0; r < rotationCount; ++r)
+		{
+			int j = rotationJoints[r];
+			Quantize::PackQuat48(glm::quat(q.w[j], q.x[j], q.y[j], q.z[j]),
+				block[r], block[rotationCount + r], block[2 * rotationCount + r]);
+		}
+
+		for (size_t c = 0; c < componentCount; ++c)
+		{
+			int target = componentTargets[c];
+			bool isScale = target >= scaleFirst;
+			float v = (isScale ? clip.GetScales(k) : clip.GetTranslations(k))[(target % scaleFirst) / 3][target % 3];
+			float extent = componentScale[c] * 65535.f;
+			block[3 * rotationCount + c] = Quantize::PackRanged(v, componentOffset[c], extent);
+		}
+	}
+
+	// Greedy reduction: drop each key in turn if the whole clip stays within the bounds
+	std::vector<uint32_t> kept(sourceKeyCount), trial;
+	for (int k = 0; k < sourceKeyCount; ++k)
+		kept[k] = (uint32_t)k;
+
+	PoseScratch scratch(jointCount);
+	if (keyStride > 0)
+	{
+		for (int k = 1; k < sourceKeyCount; ++k)
+		{
+			trial.clear();
+			for (size_t i = 0; i < kept.size(); ++i)
+				if (kept[i] != (uint32_t)k)
+					trial.push_back(kept[i]);
+
+			if (WithinBounds(Measure(clip, trial, table, scratch), settings))
+				kept.swap(trial);
+		}
+	}
+	else
+	{
+		kept.resize(1);
+	}
+
+	keys = kept;
+	keyData.resize(keys.size() * keyStride);
+	for (size_t i = 0; i < keys.size() && keyStride > 0; ++i)
+		std::copy(&table[keys[i] * keyStride], &table[keys[i] * keyStride] + keyStride, &keyData[i * keyStride]);
+
+	error = Measure(clip, keys, table, scratch);
+}
+
+size_t CompressedClip::GetSize() const
+{
+	return keyData.size() * sizeof(uint16_t) + (keys.size() + rotationJoints.size() + componentTargets.size()) * sizeof(uint32_t) +
+		(componentOffset.size() + componentScale.size()) * sizeof(float) +
+		(size_t)jointCount * (4 * sizeof(float) + 2 * sizeof(glm::vec3));
+}
+
+void CompressedClip::Locate(const std::vector<uint32_t>& kept, float position, int& span, float& t) const
+{
+	span = (int)(std::upper_bound(kept.begin(), kept.end(), position) - kept.begin()) - 1;
+	float start = kept[span];
+	float end = span + 1 < (int)kept.size() ? kept[span + 1] : (float)sourceKeyCount;
+	t = (position - start) / (end - start);
+}
+
+void CompressedClip::Sample(float time, PoseScratch& scratch) const
+{
+	float position = time * sampleRate;
+	float wrapped = position - std::floor(position / sourceKeyCount) * sourceKeyCount;
+	if (wrapped >= sourceKeyCount)		// wrapped can round up to sourceKeyCount
+		wrapped = 0.f;
+
+	int span;
+	float t;
+	Locate(keys, wrapped, span, t);
+
+	int n = (int)keys.size();
+	const uint16_t* data = keyData.data();
+	const uint16_t* blocks[4] =
+	{
+		data + ((span + n - 1) % n) * keyStride,
+		data + span * keyStride,
+		data + ((span + 1) % n) * keyStride,
+		data + ((span + 2) % n) * keyStride
+	};
+	Decode(blocks, t, scratch);
+}
+
+void CompressedClip::Decode(const uint16_t* const* blocks, float t, PoseScratch& scratch) const
+{
+	size_t rotationCount = rotationJoints.size(), componentCount = componentTargets.size();
+	if ((int)scratch.local.size() < jointCount)
+		scratch.Resize(jointCount);
+	if (scratch.decoded.size() < 20 * rotationCount + componentCount)
+		scratch.decoded.resize(20 * rotationCount + componentCount);
+
+	std::copy(restRotationX.begin(), restRotationX.end(), scratch.rotationX.begin());
+	std::copy(restRotationY.begin(), restRotationY.end(), scratch.rotationY.begin());
+	std::copy(restRotationZ.begin(), restRotationZ.end(), scratch.rotationZ.begin());
+	std::copy(restRotationW.begin(), restRotationW.end(), scratch.rotationW.begin());
+	std::copy(restTranslations.begin(), restTranslations.end(), scratch.translations.begin());
+	std::copy(restScales.begin(), restScales.end(), scratch.scales.begin());
+
+	// Basis weights of the four control points
+	glm::vec4 weights = glm::catmullRom(glm::vec4(1.f, 0.f, 0.f, 0.f), glm::vec4(0.f, 1.f, 0.f, 0.f),
+		glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(0.f, 0.f, 0.f, 1.f), t);
+
+	float* decoded = scratch.decoded.data();
+	if (rotationCount > 0)
+	{
+		// BlendQuats flips every key into the first pose's hemisphere, so that is the start of the span
+		static const int order[4] = { 1, 0, 2, 3 };
+		BatchMath::QuatSoA poses[4];
+		float poseWeights[4];
+		for (int k = 0; k < 4; ++k)
+		{
+			const uint16_t* block = blocks[order[k]];
+			float* x = decoded + 4 * k * rotationCount;
+			BatchMath::QuatSoA q = { x, x + rotationCount, x + 2 * rotationCount, x + 3 * rotationCount };
+			BatchMath::UnpackQuats(block, block + rotationCount, block + 2 * rotationCount, q, rotationCount);
+			poses[k] = q;
+			poseWeights[k] = weights[order[k]];
+		}
+
+		BatchMath::QuatSoA blended = poses[0].Offset(16 * rotationCount);
+		BatchMath::BlendQuats(poses, poseWeights, 4, blended, rotationCount);
+
+		for (size_t r = 0; r < rotationCount; ++r)
+		{
+			int j = rotationJoints[r];
+			scratch.rotationX[j] = blended.x[r];
+			scratch.rotationY[j] = blended.y[r];
+			scratch.rotationZ[j] = blended.z[r];
+			scratch.rotationW[j] = blended.w[r];
+		}
+	}
+
+	if (componentCount > 0)
+	{
+		size_t first = 3 * rotationCount;
+		const uint16_t* components[4] = { blocks[0] + first, blocks[1] + first, blocks[2] + first, blocks[3] + first };
+		float* values = decoded + 20 * rotationCount;
+		BatchMath::BlendQuantized(components, &weights[0], componentOffset.data(), componentScale.data(), values, componentCount);
+
+		float* translations = &scratch.translations[0].x;
+		float* scales = &scratch.scales[0].x;
+		size_t scaleFirst = 3 * jointCount;
+		for (size_t c = 0; c < componentCount; ++c)
+		{
+			size_t target = componentTargets[c];
+			if (target < scaleFirst)
+				translations[target] = values[c];
+			else
+				scales[target - scaleFirst] = values[c];
+		}
+	}
+}
+
+CompressionError CompressedClip::Measure(const AnimationClip& clip, const std::vector<uint32_t>& kept,
+	const std::vector<uint16_t>& table, PoseScratch& scratch) const
+{
+	CompressionError result = { 0.f, 0.f, 0.f };
+	int n = (int)kept.size();
+	const uint16_t* data = table.data();
+
+	for (int k = 0; k < sourceKeyCount; ++k)
+	{
+		int span;
+		float t;
+		Locate(kept, (float)k, span, t);
+		const uint16_t* blocks[4] =
+		{
+			data + kept[(span + n - 1) % n] * keyStride,
+			data + kept[span] * keyStride,
+			data + kept[(span + 1) % n] * keyStride,
+			data + kept[(span + 2) % n] * keyStride
+		};
+		Decode(blocks, t, scratch);
+
+		BatchMath::QuatSoA q = clip.GetRotations(k);
+		const glm::vec3* translations = clip.GetTranslations(k);
+		const glm::vec3* scales = clip.GetScales(k);
+		for (int j = 0; j < jointCount; ++j)
+		{
+			glm::quat source(q.w[j], q.x[j], q.y[j], q.z[j]);
+			glm::quat decoded(scratch.rotationW[j], scratch.rotationX[j], scratch.rotationY[j], scratch.rotationZ[j]);
+			result.rotation = std::max(result.rotation, RotationError(source, decoded));
+
+			glm::vec3 dt = glm::abs(scratch.translations[j] - translations[j]);
+			glm::vec3 ds = glm::abs(scratch.scales[j] - scales[j]);
+			result.translation = std::max(result.translation, std::max(dt.x, std::max(dt.y, dt.z)));
+			result.scale = std::max(result.scale, std::max(ds.x, std::max(ds.y, ds.z)));
+		}
+	}
+	return result;
+}
+
+void EvaluatePalette(const Skeleton& skeleton, const CompressedClip& clip, float time, const Affine3x4& placement,
+	PoseScratch& scratch, Affine3x4* palette)
+{
+	clip.Sample(time, scratch);
+	PoseToPalette(skeleton, placement, scratch, palette);
+}
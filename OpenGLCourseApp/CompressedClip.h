@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Skeleton.h"
+
+/**	Compressed animation clips
+ *
+ *	A CompressedClip holds an AnimationClip in a fraction of the memory:
+ *		- tracks that stay within the error bound of one value over the whole clip
+ *		  (usually every translation and scale but the root's) are stored once,
+ *		  as floats, in a rest pose
+ *		- animated rotations are 48-bit smallest three quaternions (Quantize.h)
+ *		- animated translation and scale components are 16 bits over their own
+ *		  range in the clip
+ *		- keys the interpolation rebuilds within the bounds are dropped. The kept
+ *		  keys are shared by all tracks, so each one is a single contiguous block
+ *
+ *	Between kept keys every track follows a Catmull-Rom spline through the
+ *	neighbouring kept keys: translations and scales take the four keys with the
+ *	spline's basis weights, and rotations are the same weighted sum of the four
+ *	quaternions through BatchMath::BlendQuats. That drops far more keys from smooth
+ *	motion than a lerp would. The bounds are checked against every source key after
+ *	quantisation; GetError reports what was reached.
+ *
+ *	Sampling reads four key blocks and decodes them with BatchMath::UnpackQuats and
+ *	BlendQuantized, then scatters the animated tracks over the rest pose. Key and
+ *	track indices are 32 bits, so clips of any length or joint count are kept.
+ */
+
+struct CompressionSettings
+{
+	float rotationError;		// Radians
+	float translationError;		// Per component, model units
+	float scaleError;			// Per component
+
+	CompressionSettings()
+		: rotationError(0.001f), translationError(0.0005f), scaleError(0.0005f)
+	{
+	}
+};
+
+// Largest error over every joint and source key
+struct CompressionError
+{
+	float rotation, translation, scale;
+};
+
+class CompressedClip
+{
+public:
+	CompressedClip();
+	CompressedClip(const AnimationClip& clip, const CompressionSettings& settings = CompressionSettings());
+
+	int GetJointCount() const { return jointCount; }
+	int GetKeyCount() const { return (int)keys.size(); }
+	int GetSourceKeyCount() const { return sourceKeyCount; }
+	int GetAnimatedRotationCount() const { return (int)rotationJoints.size(); }
+	int GetAnimatedComponentCount() const { return (int)componentTargets.size(); }
+	float GetDuration() const { return sourceKeyCount / sampleRate; }
+	const CompressionError& GetError() const { return error; }
+
+	// Bytes of key data, track tables and rest pose
+	size_t GetSize() const;
+
+	// Local pose of every joint at time, into scratch
+	void Sample(float time, PoseScratch& scratch) const;
+
+private:
+	// Pose between blocks[1] and blocks[2]; blocks[0] and blocks[3] are their neighbours
+	void Decode(const uint16_t* const* blocks, float t, PoseScratch& scratch) const;
+
+	// Kept key index and blend factor for a time in source keys, within [0, sourceKeyCount)
+	void Locate(const std::vector<uint32_t>& kept, float position, int& span, float& t) const;
+
+	// Sample at every source key of clip from a full quantised table, keeping only the kept keys
+	CompressionError Measure(const AnimationClip& clip, const std::vector<uint32_t>& kept, const std::vector<uint16_t>& table,
+		PoseScratch& scratch) const;
+
+	int jointCount, sourceKeyCount;
+	float sampleRate;
+
+	std::vector<uint32_t> keys;					// Source key of each kept key, ascending from 0
+	std::vector<uint16_t> keyData;				// Kept key k at k * keyStride
+	size_t keyStride;							// Rotation words a[], b[], c[], then components[]
+
+	std::vector<uint32_t> rotationJoints;		// Joint of each animated rotation
+	std::vector<uint32_t> componentTargets;		// Float of each animated component: translations, then scales
+	std::vector<float> componentOffset, componentScale;
+
+	std::vector<float> restRotationX, restRotationY, restRotationZ, restRotationW;
+	std::vector<glm::vec3> restTranslations, restScales;
+
+	CompressionError error;
+};
+
+// EvaluatePalette for a compressed clip
+void EvaluatePalette(const Skeleton& skeleton, const CompressedClip& clip, float time, const Affine3x4& placement,
+	PoseScratch& scratch, Affine3x4* palette);
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <limits>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+/**	Compile-time projection, view and transform builders
+ *
+ *	GLM only marks its constructors constexpr while GLM_HAS_CONSTEXPR is set, and
+ *	detail/setup.hpp clears it as soon as any SIMD architecture is enabled
+ *	(GLM_FORCE_INTRINSICS, GLM_FORCE_AVX2, ...). glm::perspective, lookAt and
+ *	ortho then always run at startup, even for matrices that never change.
+ *
+ *	The builders here work on ConstMat4 / ConstVec3, plain aggregates of floats,
+ *	so they are constant expressions whatever GLM is configured with:
+ *
+ *		constexpr ConstMat4 SHADOW_PROJECTION = ConstTransform::Ortho(-20.f, 20.f, -20.f, 20.f, 1.f, 60.f);
+ *		glUniformMatrix4fv(location, 1, GL_FALSE, SHADOW_PROJECTION.Data());
+ *
+ *	Layout and conventions match GLM's defaults (column major, right handed, clip
+ *	z in [-1, 1]), so ToMat4 gives what the glm call would. The trigonometry and
+ *	square roots are series and Newton iterations in double, rounded to float at
+ *	the end, so results agree with GLM's to float rounding (--bench checks them).
+ *	Called at runtime they still work, just slower than GLM, so keep them for
+ *	constants.
+ */
+
+// Column major like glm::mat4, m[column][row]
+struct ConstMat4
+{
+	float m[4][4];
+
+	const float* Data() const { return &m[0][0]; }
+	glm::mat4 ToMat4() const { return glm::make_mat4(&m[0][0]); }
+};
+
+struct ConstVec3
+{
+	float x, y, z;
+};
+
+namespace ConstTransform
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	constexpr ConstVec3 operator-(const ConstVec3& a, const ConstVec3& b) { return ConstVec3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+
+	constexpr float Dot(const ConstVec3& a, const ConstVec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	constexpr ConstVec3 Cross(const ConstVec3& a, const ConstVec3& b)
+	{
+		return ConstVec3{ a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y };
+	}
+
+	// Newton from above, stops once the estimate no longer shrinks. Negative or NaN input gives NaN
+	constexpr double Sqrt(double x)
+	{
+		if (!(x >= 0.0))
+			return std::numeric_limits<double>::quiet_NaN();
+		if (x == 0.0 || x > std::numeric_limits<double>::max())
+			return x;
+
+		double estimate = x > 1.0 ? x : 1.0;
+		for (int i = 0; i < 1100; ++i)
+		{
+			double next = 0.5 * (estimate + x / estimate);
+			if (next >= estimate)
+				break;
+			estimate = next;
+		}
+		return estimate;
+	}
+
+	// Taylor series after reducing x to [-pi, pi]
+	constexpr void SinCos(double x, double& s, double& c)
+	{
+		double turns = x / (2.0 * PI);
+		double whole = (double)(long long)(turns + (turns < 0.0 ? -0.5 : 0.5));
+		double r = x - whole * (2.0 * PI);
+
+		double r2 = r * r;
+		double sinTerm = r, cosTerm = 1.0;
+		s = r;
+		c = 1.0;
+		for (int n = 1; n < 16; ++n)
+		{
+			sinTerm *= -r2 / ((2 * n) * (2 * n + 1));
+			cosTerm *= -r2 / ((2 * n - 1) * (2 * n));
+			s += sinTerm;
+			c += cosTerm;
+		}
+	}
+
+	constexpr ConstVec3 Normalize(const ConstVec3& v)
+	{
+		double invLength = 1.0 / Sqrt((double)v.x * v.x + (double)v.y * v.y + (double)v.z * v.z);
+		return ConstVec3{ (float)(v.x * invLength), (float)(v.y * invLength), (float)(v.z * invLength) };
+	}
+
+	constexpr ConstMat4 Zero()
+	{
+		return ConstMat4{ {
+			{ 0.f, 0.f, 0.f, 0.f },
+			{ 0.f, 0.f, 0.f, 0.f },
+			{ 0.f, 0.f, 0.f, 0.f },
+			{ 0.f, 0.f, 0.f, 0.f } } };
+	}
+
+	constexpr ConstMat4 Identity()
+	{
+		ConstMat4 result = Zero();
+		for (int i = 0; i < 4; ++i)
+			result.m[i][i] = 1.f;
+		return result;
+	}
+
+	constexpr ConstMat4 Multiply(const ConstMat4& a, const ConstMat4& b)
+	{
+		ConstMat4 result = Zero();
+		for (int c = 0; c < 4; ++c)
+			for (int r = 0; r < 4; ++r)
+				result.m[c][r] = a.m[0][r] * b.m[c][0] + a.m[1][r] * b.m[c][1] + a.m[2][r] * b.m[c][2] + a.m[3][r] * b.m[c][3];
+		return result;
+	}
+
+	constexpr ConstMat4 operator*(const ConstMat4& a, const ConstMat4& b) { return Multiply(a, b); }
+
+	constexpr ConstMat4 Transpose(const ConstMat4& a)
+	{
+		ConstMat4 result = Zero();
+		for (int c = 0; c < 4; ++c)
+			for (int r = 0; r < 4; ++r)
+				result.m[c][r] = a.m[r][c];
+		return result;
+	}
+
+	// glm::perspective, fovy in radians
+	constexpr ConstMat4 Perspective(float fovy, float aspect, float zNear, float zFar)
+	{
+		double s = 0.0, c = 0.0;
+		SinCos(fovy * 0.5, s, c);
+		float tanHalfFovy = (float)(s / c);
+
+		ConstMat4 result = Zero();
+		result.m[0][0] = 1.f / (aspect * tanHalfFovy);
+		result.m[1][1] = 1.f / tanHalfFovy;
+		result.m[2][2] = -(zFar + zNear) / (zFar - zNear);
+		result.m[2][3] = -1.f;
+		result.m[3][2] = -(2.f * zFar * zNear) / (zFar - zNear);
+		return result;
+	}
+
+	// glm::infinitePerspective
+	constexpr ConstMat4 InfinitePerspective(float fovy, float aspect, float zNear)
+	{
+		double s = 0.0, c = 0.0;
+		SinCos(fovy * 0.5, s, c);
+		float range = (float)(s / c) * zNear;
+		float left = -range * aspect, right = range * aspect;
+
+		ConstMat4 result = Zero();
+		result.m[0][0] = (2.f * zNear) / (right - left);
+		result.m[1][1] = (2.f * zNear) / (range - -range);
+		result.m[2][2] = -1.f;
+		result.m[2][3] = -1.f;
+		result.m[3][2] = -2.f * zNear;
+		return result;
+	}
+
+	// glm::ortho
+	constexpr ConstMat4 Ortho(float left, float right, float bottom, float top, float zNear, float zFar)
+	{
+		ConstMat4 result = Identity();
+		result.m[0][0] = 2.f / (right - left);
+		result.m[1][1] = 2.f / (top - bottom);
+		result.m[2][2] = -2.f / (zFar - zNear);
+		result.m[3][0] = -(right + left) / (right - left);
+		result.m[3][1] = -(top + bottom) / (top - bottom);
+		result.m[3][2] = -(zFar + zNear) / (zFar - zNear);
+		return result;
+	}
+
+	// glm::ortho without depth, for UI in pixels: Ortho(0, width, height, 0) puts y down
+	constexpr ConstMat4 Ortho(float left, float right, float bottom, float top)
+	{
+		ConstMat4 result = Identity();
+		result.m[0][0] = 2.f / (right - left);
+		result.m[1][1] = 2.f / (top - bottom);
+		result.m[2][2] = -1.f;
+		result.m[3][0] = -(right + left) / (right - left);
+		result.m[3][1] = -(top + bottom) / (top - bottom);
+		return result;
+	}
+
+	// glm::lookAt
+	constexpr ConstMat4 LookAt(const ConstVec3& eye, const ConstVec3& center, const ConstVec3& up)
+	{
+		ConstVec3 f = Normalize(center - eye);
+		ConstVec3 s = Normalize(Cross(f, up));
+		ConstVec3 u = Cross(s, f);
+
+		ConstMat4 result = Identity();
+		result.m[0][0] = s.x;
+		result.m[1][0] = s.y;
+		result.m[2][0] = s.z;
+		result.m[0][1] = u.x;
+		result.m[1][1] = u.y;
+		result.m[2][1] = u.z;
+		result.m[0][2] = -f.x;
+		result.m[1][2] = -f.y;
+		result.m[2][2] = -f.z;
+		result.m[3][0] = -Dot(s, eye);
+		result.m[3][1] = -Dot(u, eye);
+		result.m[3][2] = Dot(f, eye);
+		return result;
+	}
+
+	// glm::translate(mat4(1), t)
+	constexpr ConstMat4 Translate(const ConstVec3& t)
+	{
+		ConstMat4 result = Identity();
+		result.m[3][0] = t.x;
+		result.m[3][1] = t.y;
+		result.m[3][2] = t.z;
+		return result;
+	}
+
+	// glm::scale(mat4(1), s)
+	constexpr ConstMat4 Scale(const ConstVec3& s)
+	{
+		ConstMat4 result = Identity();
+		result.m[0][0] = s.x;
+		result.m[1][1] = s.y;
+		result.m[2][2] = s.z;
+		return result;
+	}
+
+	// glm::rotate(mat4(1), angle, axis), the axis is normalised like glm does
+	constexpr ConstMat4 Rotate(float angle, const ConstVec3& axis)
+	{
+		double sd = 0.0, cd = 0.0;
+		SinCos(angle, sd, cd);
+		float s = (float)sd, c = (float)cd;
+		ConstVec3 a = Normalize(axis);
+		ConstVec3 t{ (1.f - c) * a.x, (1.f - c) * a.y, (1.f - c) * a.z };
+
+		ConstMat4 result = Identity();
+		result.m[0][0] = c + t.x * a.x;
+		result.m[0][1] = t.x * a.y + s * a.z;
+		result.m[0][2] = t.x * a.z - s * a.y;
+		result.m[1][0] = t.y * a.x - s * a.z;
+		result.m[1][1] = c + t.y * a.y;
+		result.m[1][2] = t.y * a.z + s * a.x;
+		result.m[2][0] = t.z * a.x + s * a.y;
+		result.m[2][1] = t.z * a.y - s * a.x;
+		result.m[2][2] = c + t.z * a.z;
+		return result;
+	}
+
+	// translate -> rotate -> scale, as Transform::ComposeTRS does for the runtime case
+	constexpr ConstMat4 ComposeTRS(const ConstVec3& t, const ConstVec3& axis, float angle, const ConstVec3& s)
+	{
+		return Translate(t) * Rotate(angle, axis) * Scale(s);
+	}
+}
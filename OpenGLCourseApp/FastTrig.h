@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**	Polynomial sin/cos, atan2, acos and log
+ *
+ *	The scalar versions here and the 4/8/16-wide BatchMath kernels (SinCos, Atan2,
+ *	Acos, Log) evaluate the same polynomials, so results only differ where FMA rounds
+ *	differently. Coefficients are the Cephes single-precision minimax sets.
+ *
+ *	Max error against the correctly rounded result, measured by the accuracy sweep
+ *	in --bench (OpenGLCourseApp --bench) at every SIMD level:
+ *		SinCos	|x| <= 8192			2 ulp where |result| > 1/1024, absolute error
+ *									below 1e-7 everywhere (ulp is meaningless at the zeros)
+ *		Atan2	finite y, x			3 ulp
+ *		Acos	-1 <= x <= 1		1 ulp
+ *		Log		positive normal x	1 ulp
+ *
+ *	Outside those ranges: sin/cos lose accuracy with the range reduction for larger
+ *	|x|, atan2 of infinities and acos of |x| > 1 return NaN. atan2(0, 0) is 0. Log
+ *	reads the exponent straight from the bits, so zero, denormals, negatives,
+ *	infinity and NaN give meaningless finite results instead of -inf / NaN.
+ */
+
+namespace FastTrig
+{
+	const float PI = 3.14159265358979f;
+	const float TWO_PI = 6.28318530717959f;
+	const float HALF_PI = 1.57079632679490f;
+	const float QUARTER_PI = 0.785398163397448f;
+	const float TWO_OVER_PI = 0.636619772367581f;
+
+	// Cody-Waite split of pi/2, the first part has few enough bits that j * PIO2_HI is exact
+	const float PIO2_HI = 1.5703125f;
+	const float PIO2_MID = 4.837512969970703125e-4f;
+	const float PIO2_LO = 7.54978995489188216e-8f;
+
+	// sin(r) = r + r^3 * (S1 + S2 r^2 + S3 r^4), |r| <= pi/4
+	const float SIN_1 = -1.6666654611e-1f;
+	const float SIN_2 = 8.3321608736e-3f;
+	const float SIN_3 = -1.9515295891e-4f;
+
+	// cos(r) = 1 - r^2 / 2 + r^4 * (C1 + C2 r^2 + C3 r^4), |r| <= pi/4
+	const float COS_1 = 4.166664568298827e-2f;
+	const float COS_2 = -1.388731625493765e-3f;
+	const float COS_3 = 2.443315711809948e-5f;
+
+	// atan(a) = a + a^3 * (A1 + A2 a^2 + A3 a^4 + A4 a^6), |a| <= tan(pi/8)
+	const float TAN_PI_8 = 0.414213562373095f;
+	const float ATAN_1 = -3.33329491539e-1f;
+	const float ATAN_2 = 1.99777106478e-1f;
+	const float ATAN_3 = -1.38776856032e-1f;
+	const float ATAN_4 = 8.05374449538e-2f;
+
+	// asin(a) = a + a^3 * (B1 + B2 a^2 + B3 a^4 + B4 a^6 + B5 a^8), |a| <= 0.5
+	const float ASIN_1 = 1.6666752422e-1f;
+	const float ASIN_2 = 7.4953002686e-2f;
+	const float ASIN_3 = 4.5470025998e-2f;
+	const float ASIN_4 = 2.4181311049e-2f;
+	const float ASIN_5 = 4.2163199048e-2f;
+
+	// log(1 + m) = m - m^2 / 2 + m^3 * (L1 + L2 m + ... + L9 m^8), sqrt(1/2) <= 1 + m < sqrt(2)
+	const float SQRT_HALF = 0.707106781186547524f;
+	const float LOG_1 = 3.3333331174e-1f;
+	const float LOG_2 = -2.4999993993e-1f;
+	const float LOG_3 = 2.0000714765e-1f;
+	const float LOG_4 = -1.6668057665e-1f;
+	const float LOG_5 = 1.4249322787e-1f;
+	const float LOG_6 = -1.2420140846e-1f;
+	const float LOG_7 = 1.1676998740e-1f;
+	const float LOG_8 = -1.1514610310e-1f;
+	const float LOG_9 = 7.0376836292e-2f;
+
+	// ln 2 split like pi/2 above, e * LN2_HI is exact
+	const float LN2_HI = 0.693359375f;
+	const float LN2_LO = -2.12194440e-4f;
+
+	inline void SinCos(float x, float& s, float& c)
+	{
+		float j = std::nearbyint(x * TWO_OVER_PI);
+		int quadrant = (int)j;
+		float r = ((x - j * PIO2_HI) - j * PIO2_MID) - j * PIO2_LO;
+		float z = r * r;
+
+		float sinR = ((SIN_3 * z + SIN_2) * z + SIN_1) * z * r + r;
+		float cosR = ((COS_3 * z + COS_2) * z + COS_1) * z * z - 0.5f * z + 1.f;
+
+		s = (quadrant & 1) ? cosR : sinR;
+		c = (quadrant & 1) ? sinR : cosR;
+		if (quadrant & 2)
+			s = -s;
+		if ((quadrant + 1) & 2)
+			c = -c;
+	}
+
+	// atan(a) for 0 <= a <= 1
+	inline float AtanUnit(float a)
+	{
+		bool upper = a > TAN_PI_8;
+		float offset = upper ? QUARTER_PI : 0.f;
+		a = upper ? (a - 1.f) / (a + 1.f) : a;
+
+		float z = a * a;
+		return (((ATAN_4 * z + ATAN_3) * z + ATAN_2) * z + ATAN_1) * z * a + a + offset;
+	}
+
+	inline float Atan2(float y, float x)
+	{
+		float ax = std::fabs(x), ay = std::fabs(y);
+		float hi = ax > ay ? ax : ay;
+		float lo = ax > ay ? ay : ax;
+
+		float r = AtanUnit(hi > 0.f ? lo / hi : 0.f);
+		if (ay > ax)
+			r = HALF_PI - r;
+		if (x < 0.f)
+			r = PI - r;
+		return std::copysign(r, y);
+	}
+
+	inline float Acos(float x)
+	{
+		float ax = std::fabs(x);
+		bool outer = ax > 0.5f;
+
+		// acos(x) = 2 asin(sqrt((1 - |x|) / 2)) away from zero, pi / 2 - asin(x) near it
+		float z = outer ? 0.5f * (1.f - ax) : x * x;
+		float a = outer ? std::sqrt(z) : x;
+		float asinA = ((((ASIN_5 * z + ASIN_4) * z + ASIN_3) * z + ASIN_2) * z + ASIN_1) * z * a + a;
+
+		if (!outer)
+			return HALF_PI - asinA;
+		return x < 0.f ? PI - 2.f * asinA : 2.f * asinA;
+	}
+
+	inline float Log(float x)
+	{
+		// x = 2^e * f with f in [0.5, 1), then f folded into [sqrt(1/2), sqrt(2))
+		uint32_t bits;
+		memcpy(&bits, &x, sizeof(bits));
+		int e = (int)(bits >> 23) - 126;
+		bits = (bits & 0x7FFFFF) | 0x3F000000;
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+
+		if (f < SQRT_HALF)
+		{
+			--e;
+			f += f;
+		}
+		float m = f - 1.f;
+		float z = m * m;
+		float fe = (float)e;
+
+		float poly = (((((((LOG_9 * m + LOG_8) * m + LOG_7) * m + LOG_6) * m + LOG_5) * m + LOG_4) * m + LOG_3) * m + LOG_2) * m + LOG_1;
+		float y = poly * m * z + fe * LN2_LO - 0.5f * z;
+		return (m + y) + fe * LN2_HI;
+	}
+}
@@ -0,0 +1,131 @@
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <GLFW/glfw3.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+	const GLuint64 WAIT_TIMEOUT = 1000000000ull;		// Nanoseconds per glClientWaitSync, retried until the fence signals
+
+	double SecondsSince(uint64_t timerValue)
+	{
+		return (double)(glfwGetTimerValue() - timerValue) / (double)glfwGetTimerFrequency();
+	}
+}
+
+FrameLatency::FrameLatency()
+	: buffer(0), maxQueuedFrames(0), frameIndex(0), inputTime(0), frameInputTime(0),
+	  latencySeconds(0.0), maxLatencySeconds(0.0), frameLatencySeconds(0.0), waitSeconds(0.0), frames(0)
+{
+}
+
+bool FrameLatency::Init(int maxQueued)
+{
+	maxQueuedFrames = std::max(maxQueued, 0);
+	fences.assign(maxQueuedFrames, (GLsync)0);
+
+	glGenBuffers(1, &buffer);
+	if (!buffer)
+	{
+		printf("Error creating the frame constants buffer\n");
+		return false;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, buffer);
+	return true;
+}
+
+void FrameLatency::BindBlock(GLuint program)
+{
+	GLuint block = glGetUniformBlockIndex(program, "FrameConstants");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, FRAME_CONSTANTS_BINDING);
+}
+
+void FrameLatency::WaitForQueue()
+{
+	if (!maxQueuedFrames)
+		return;
+
+	// The slot this frame's fence goes into holds the one from maxQueuedFrames frames ago
+	GLsync& fence = fences[frameIndex % maxQueuedFrames];
+	if (!fence)
+		return;
+
+	uint64_t start = glfwGetTimerValue();
+	GLenum status;
+	do
+	{
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT);
+	} while (status == GL_TIMEOUT_EXPIRED);
+	waitSeconds += SecondsSince(start);
+
+	if (status == GL_WAIT_FAILED)
+		printf("Waiting on a frame fence failed\n");
+
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+void FrameLatency::Latch(const glm::mat4& projection, const glm::mat4& view, uint64_t input, uint64_t frameInput)
+{
+	inputTime = input;
+	frameInputTime = frameInput;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	void* constants = glMapBufferRange(GL_UNIFORM_BUFFER, 0, 2 * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (constants)
+	{
+		memcpy(constants, glm::value_ptr(projection), sizeof(glm::mat4));
+		memcpy((char*)constants + sizeof(glm::mat4), glm::value_ptr(view), sizeof(glm::mat4));
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameLatency::Submitted()
+{
+	double latency = SecondsSince(inputTime);
+	latencySeconds += latency;
+	maxLatencySeconds = std::max(maxLatencySeconds, latency);
+	frameLatencySeconds += SecondsSince(frameInputTime);
+	++frames;
+
+	if (maxQueuedFrames)
+		fences[frameIndex % maxQueuedFrames] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	++frameIndex;
+}
+
+LatencyTimings FrameLatency::TakeTimings()
+{
+	LatencyTimings timings;
+	double toMs = frames ? 1000.0 / frames : 0.0;
+	timings.inputToSubmitMs = latencySeconds * toMs;
+	timings.maxInputToSubmitMs = maxLatencySeconds * 1000.0;
+	timings.frameInputToSubmitMs = frameLatencySeconds * toMs;
+	timings.queueWaitMs = waitSeconds * toMs;
+	timings.frames = frames;
+
+	latencySeconds = maxLatencySeconds = frameLatencySeconds = waitSeconds = 0.0;
+	frames = 0;
+	return timings;
+}
+
+FrameLatency::~FrameLatency()
+{
+	if (!buffer)
+		return;
+
+	for (size_t i = 0; i < fences.size(); ++i)
+		if (fences[i])
+			glDeleteSync(fences[i]);
+	glDeleteBuffers(1, &buffer);
+}
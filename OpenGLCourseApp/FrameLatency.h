@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+/**	Per-frame camera constants, a cap on frames queued to the GPU, and input latency
+ *
+ *	Shaders read the camera from one std140 uniform block at FRAME_CONSTANTS_BINDING:
+ *
+ *		layout (std140) uniform FrameConstants
+ *		{
+ *			mat4 projection;
+ *			mat4 view;
+ *		};
+ *
+ *	Latch writes the block into an orphaned buffer, so the GPU never waits on last
+ *	frame's copy, and belongs as late as possible: after the draws are recorded and
+ *	just before the first is submitted, with the freshest input sample. Recorded
+ *	draws need nothing patched since they read the block when they run. GL 3.3 has
+ *	no way to show the GPU a CPU write made after the draw was issued, so this is
+ *	as late as the constants can go.
+ *
+ *	With maxQueuedFrames > 0 every frame ends with a fence and WaitForQueue blocks
+ *	until at most maxQueuedFrames - 1 earlier frames are still executing. Left
+ *	alone the driver lets the CPU run two or three frames ahead, each adding a
+ *	frame to the input's age; 1 starts a frame only once the GPU has finished the
+ *	previous one.
+ *
+ *	Latency runs from the input sample the view was built from to Submitted, after
+ *	the frame's last GL command and just before SwapBuffers. The age of the sample
+ *	taken at the top of the frame is tracked alongside; the difference is what late
+ *	latching saves. Everything runs on the thread that owns the context.
+ */
+
+const GLuint FRAME_CONSTANTS_BINDING = 0;
+
+// Per-frame averages since the last TakeTimings
+struct LatencyTimings
+{
+	double inputToSubmitMs;			// Age at submit of the input the view was latched from
+	double maxInputToSubmitMs;
+	double frameInputToSubmitMs;	// Age at submit of the top of frame sample
+	double queueWaitMs;				// Blocked in WaitForQueue
+	unsigned frames;
+};
+
+class FrameLatency
+{
+public:
+	FrameLatency();
+
+	// maxQueuedFrames 0 leaves queueing to the driver
+	bool Init(int maxQueuedFrames);
+
+	// Points the program's FrameConstants block at FRAME_CONSTANTS_BINDING, programs without one are left alone
+	static void BindBlock(GLuint program);
+
+	void WaitForQueue();
+
+	// inputTime is the glfwGetTimerValue of the input behind view, frameInputTime that of the top of frame sample
+	void Latch(const glm::mat4& projection, const glm::mat4& view, uint64_t inputTime, uint64_t frameInputTime);
+
+	void Submitted();
+
+	int GetMaxQueuedFrames() const { return maxQueuedFrames; }
+
+	LatencyTimings TakeTimings();
+
+	~FrameLatency();
+
+private:
+	GLuint buffer;
+	int maxQueuedFrames;
+	std::vector<GLsync> fences;		// Ring, one per queued frame
+	unsigned long long frameIndex;
+	uint64_t inputTime, frameInputTime;
+
+	double latencySeconds, maxLatencySeconds, frameLatencySeconds, waitSeconds;
+	unsigned frames;
+};
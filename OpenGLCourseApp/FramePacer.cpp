@@ -0,0 +1,128 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+namespace
+{
+	const double DEFAULT_SPIN_MARGIN = 0.002;		// Seconds, until a few sleeps have been measured
+	const unsigned MAX_SLEEP_SAMPLES = 256;			// Older sleeps weigh less past this, so the margin follows the system
+	const size_t RESERVED_FRAMES = 4096;
+}
+
+FramePacer::FramePacer()
+	: vsync(VSYNC_ON), targetFps(0.0), frequency(1), period(0), deadline(0), lastFrame(0),
+	  sleepMean(0.0), sleepSquares(0.0), sleepCount(0), limiterSeconds(0.0)
+{
+}
+
+void FramePacer::Init(VsyncMode vsyncMode, double fps)
+{
+	vsync = vsyncMode;
+	if (vsync == VSYNC_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+		&& !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+	{
+		printf("Adaptive vsync needs EXT_swap_control_tear, using vsync on\n");
+		vsync = VSYNC_ON;
+	}
+	glfwSwapInterval(vsync == VSYNC_OFF ? 0 : vsync == VSYNC_ON ? 1 : -1);
+
+	targetFps = std::max(fps, 0.0);
+	frequency = glfwGetTimerFrequency();
+	period = targetFps > 0.0 ? (uint64_t)((double)frequency / targetFps + 0.5) : 0;
+	deadline = lastFrame = 0;
+	frameTimes.clear();
+	frameTimes.reserve(RESERVED_FRAMES);
+}
+
+double FramePacer::SpinMargin() const
+{
+	if (sleepCount < 2)
+		return DEFAULT_SPIN_MARGIN;
+	return sleepMean + std::sqrt(sleepSquares / (sleepCount - 1));
+}
+
+void FramePacer::SleepUntil(uint64_t until)
+{
+	for (;;)
+	{
+		uint64_t now = glfwGetTimerValue();
+		if (now >= until || (double)(until - now) / (double)frequency <= SpinMargin())
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		double slept = (double)(glfwGetTimerValue() - now) / (double)frequency;
+
+		if (sleepCount < MAX_SLEEP_SAMPLES)
+			++sleepCount;
+		else
+			sleepSquares *= (double)(sleepCount - 1) / (double)sleepCount;
+		double delta = slept - sleepMean;
+		sleepMean += delta / sleepCount;
+		sleepSquares += delta * (slept - sleepMean);
+	}
+
+	while (glfwGetTimerValue() < until)
+	{
+	}
+}
+
+void FramePacer::Pace()
+{
+	uint64_t now = glfwGetTimerValue();
+	if (period)
+	{
+		deadline += period;
+		if (lastFrame && deadline > now)
+		{
+			SleepUntil(deadline);
+			uint64_t released = glfwGetTimerValue();
+			limiterSeconds += (double)(released - now) / (double)frequency;
+			now = released;
+		}
+
+		// A frame released late (the first, one that ran long, or a sleep the OS overslept)
+		// starts the schedule again from now
+		if (deadline < now)
+			deadline = now;
+	}
+
+	if (lastFrame)
+		frameTimes.push_back((double)(now - lastFrame) / (double)frequency);
+	lastFrame = now;
+}
+
+PacingTimings FramePacer::TakeTimings()
+{
+	PacingTimings timings = {};
+	size_t count = frameTimes.size();
+	timings.frames = (unsigned)count;
+	if (count)
+	{
+		double sum = 0.0, squares = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			sum += frameTimes[i];
+		double mean = sum / count;
+		for (size_t i = 0; i < count; ++i)
+			squares += (frameTimes[i] - mean) * (frameTimes[i] - mean);
+
+		timings.meanMs = mean * 1000.0;
+		timings.deviationMs = std::sqrt(squares / count) * 1000.0;
+		timings.minMs = *std::min_element(frameTimes.begin(), frameTimes.end()) * 1000.0;
+		timings.maxMs = *std::max_element(frameTimes.begin(), frameTimes.end()) * 1000.0;
+
+		std::vector<double>::iterator percentile = frameTimes.begin() + std::min(count - 1, count * 99 / 100);
+		std::nth_element(frameTimes.begin(), percentile, frameTimes.end());
+		timings.percentile99Ms = *percentile * 1000.0;
+		timings.limiterMs = limiterSeconds / count * 1000.0;
+	}
+
+	frameTimes.clear();
+	limiterSeconds = 0.0;
+	return timings;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**	Swap interval and frame limiter, with frame time spread statistics
+ *
+ *	The vsync mode goes to glfwSwapInterval:
+ *
+ *		VSYNC_OFF		- 0, swaps as soon as the frame is done, tears
+ *		VSYNC_ON		- 1, every swap waits for the next vertical blank
+ *		VSYNC_ADAPTIVE	- -1, waits like VSYNC_ON while frames keep up with the
+ *						  refresh and swaps straight away (tearing once) when one
+ *						  misses it, instead of waiting a whole extra refresh.
+ *						  Needs WGL_EXT_swap_control_tear / GLX_EXT_swap_control_tear,
+ *						  falls back to VSYNC_ON without them
+ *
+ *	A target frame rate adds a limiter at the start of every frame: Pace holds the
+ *	frame until its deadline, one period after the last. It belongs before the
+ *	frame samples its input, so the hold doesn't add to the input's age. Sleeping
+ *	alone overshoots by the OS timer granularity (up to a couple of milliseconds,
+ *	more on Windows with the default timer), so Pace sleeps in 1 ms steps only
+ *	while the time left exceeds how long such a sleep has really taken (mean plus
+ *	one deviation, learnt as it runs), then spins on glfwGetTimerValue to the
+ *	deadline. A frame that misses its deadline restarts the schedule from now
+ *	rather than rushing the next ones to catch up. With vsync on the limiter only
+ *	makes sense below the refresh rate.
+ *
+ *	Frame times are measured between consecutive Pace calls, the moments frames are
+ *	released to start. Even pacing shows as a small deviation and a 99th
+ *	percentile close to the mean. Everything runs on the thread that owns the
+ *	context.
+ */
+
+enum VsyncMode
+{
+	VSYNC_OFF,
+	VSYNC_ON,
+	VSYNC_ADAPTIVE
+};
+
+// Since the last TakeTimings
+struct PacingTimings
+{
+	double meanMs;
+	double deviationMs;			// Standard deviation of the frame time
+	double minMs, maxMs;
+	double percentile99Ms;
+	double limiterMs;			// Average per frame held back by the limiter
+	unsigned frames;
+};
+
+class FramePacer
+{
+public:
+	FramePacer();
+
+	// Needs the window's context current. targetFps 0 turns the limiter off
+	void Init(VsyncMode vsyncMode, double targetFps);
+
+	// Mode in effect, after the adaptive fallback
+	VsyncMode GetVsyncMode() const { return vsync; }
+	double GetTargetFps() const { return targetFps; }
+
+	// At the top of the frame, before its input is sampled
+	void Pace();
+
+	PacingTimings TakeTimings();
+
+private:
+	void SleepUntil(uint64_t deadline);
+	double SpinMargin() const;
+
+	VsyncMode vsync;
+	double targetFps;
+	uint64_t frequency, period, deadline, lastFrame;
+
+	// How long a 1 ms sleep really takes (Welford mean and sum of squared deviations)
+	double sleepMean, sleepSquares;
+	unsigned sleepCount;
+
+	std::vector<double> frameTimes;			// Seconds
+	double limiterSeconds;
+};
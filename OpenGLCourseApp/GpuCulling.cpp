@@ -0,0 +1,411 @@
+#include "GpuCulling.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ShaderUtil.h"
+
+// Frustum + Hi-Z test, one invocation per instance
+static const char* cCullShader = "\n\
+#version 450\n\
+layout (local_size_x = 64) in;\n\
+\n\
+struct Instance { vec4 sphere; uvec4 info; };\n\
+struct MeshRange { uint count; uint firstIndex; int baseVertex; uint pad; };\n\
+struct Command { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };\n\
+\n\
+layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };\n\
+layout (std430, binding = 1) readonly buffer Meshes { MeshRange meshes[]; };\n\
+layout (std430, binding = 2) writeonly buffer Commands { Command commands[]; };\n\
+layout (std430, binding = 3) writeonly buffer Visible { uint visibleIndices[]; };\n\
+layout (std430, binding = 4) buffer DrawCount { uint drawCount; };\n\
+\n\
+layout (binding = 0) uniform sampler2D depthPyramid;\n\
+\n\
+uniform uint instanceCount;\n\
+uniform vec4 frustumPlanes[6];\n\
+uniform mat4 viewProj;\n\
+uniform bool useOcclusion;\n\
+uniform vec2 pyramidSize;\n\
+uniform int pyramidLevels;\n\
+\n\
+bool IsOccluded(vec3 centre, float radius)\n\
+{\n\
+	vec3 ndcMin = vec3(1.0);\n\
+	vec3 ndcMax = vec3(-1.0);\n\
+	for (int i = 0; i < 8; ++i)\n\
+	{\n\
+		vec3 corner = centre + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);\n\
+		vec4 clip = viewProj * vec4(corner, 1.0);\n\
+		if (clip.w <= 0.0) return false;	// Crosses the near plane, keep it\n\
+		vec3 ndc = clip.xyz / clip.w;\n\
+		ndcMin = min(ndcMin, ndc);\n\
+		ndcMax = max(ndcMax, ndc);\n\
+	}\n\
+\n\
+	vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);\n\
+	vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);\n\
+	vec2 extent = (uvMax - uvMin) * pyramidSize;\n\
+	float level = clamp(ceil(log2(max(max(extent.x, extent.y), 1.0))), 0.0, float(pyramidLevels - 1));\n\
+\n\
+	// The footprint spans at most 2x2 texels at this level\n\
+	float farthest = textureLod(depthPyramid, uvMin, level).r;\n\
+	farthest = max(farthest, textureLod(depthPyramid, vec2(uvMax.x, uvMin.y), level).r);\n\
+	farthest = max(farthest, textureLod(depthPyramid, vec2(uvMin.x, uvMax.y), level).r);\n\
+	farthest = max(farthest, textureLod(depthPyramid, uvMax, level).r);\n\
+\n\
+	return ndcMin.z * 0.5 + 0.5 > farthest;\n\
+}\n\
+\n\
+void main()\n\
+{\n\
+	uint id = gl_GlobalInvocationID.x;\n\
+	if (id >= instanceCount) return;\n\
+\n\
+	vec4 sphere = instances[id].sphere;\n\
+	for (int i = 0; i < 6; ++i)\n\
+		if (dot(frustumPlanes[i].xyz, sphere.xyz) + frustumPlanes[i].w < -sphere.w) return;\n\
+\n\
+	if (useOcclusion && IsOccluded(sphere.xyz, sphere.w)) return;\n\
+\n\
+	uint slot = atomicAdd(drawCount, 1u);\n\
+	MeshRange mesh = meshes[instances[id].info.x];\n\
+	commands[slot] = Command(mesh.count, 1u, mesh.firstIndex, mesh.baseVertex, slot);\n\
+	visibleIndices[slot] = id;\n\
+}";
+
+// Depth texture -> pyramid level 0
+static const char* cCopyDepthShader = "\n\
+#version 450\n\
+layout (local_size_x = 8, local_size_y = 8) in;\n\
+layout (binding = 0) uniform sampler2D depthTex;\n\
+layout (r32f, binding = 0) writeonly uniform image2D dst;\n\
+\n\
+void main()\n\
+{\n\
+	ivec2 p = ivec2(gl_GlobalInvocationID.xy);\n\
+	if (any(greaterThanEqual(p, imageSize(dst)))) return;\n\
+	imageStore(dst, p, vec4(texelFetch(depthTex, p, 0).r));\n\
+}";
+
+// Max-reduce level srcLevel into srcLevel + 1, odd edges fold in the extra texel
+static const char* cDownsampleShader = "\n\
+#version 450\n\
+layout (local_size_x = 8, local_size_y = 8) in;\n\
+layout (binding = 0) uniform sampler2D pyramid;\n\
+layout (r32f, binding = 0) writeonly uniform image2D dst;\n\
+uniform int srcLevel;\n\
+\n\
+void main()\n\
+{\n\
+	ivec2 p = ivec2(gl_GlobalInvocationID.xy);\n\
+	ivec2 dstSize = imageSize(dst);\n\
+	if (any(greaterThanEqual(p, dstSize))) return;\n\
+\n\
+	ivec2 srcSize = textureSize(pyramid, srcLevel);\n\
+	ivec2 first = p * 2;\n\
+	ivec2 last = min(first + 1 + ivec2(equal(p, dstSize - 1)) * (srcSize & 1), srcSize - 1);\n\
+\n\
+	float farthest = 0.0;\n\
+	for (int y = first.y; y <= last.y; ++y)\n\
+		for (int x = first.x; x <= last.x; ++x)\n\
+			farthest = max(farthest, texelFetch(pyramid, ivec2(x, y), srcLevel).r);\n\
+\n\
+	imageStore(dst, p, vec4(farthest));\n\
+}";
+
+static const char* cDrawVertexShader = "\n\
+#version 450\n\
+layout (location = 0) in vec3 pos;\n\
+layout (location = 1) in uint instanceIndex;\n\
+\n\
+layout (std430, binding = 5) readonly buffer Transforms { mat4 models[]; };\n\
+\n\
+out vec4 vCol;\n\
+\n\
+uniform mat4 projection;\n\
+uniform mat4 view;\n\
+\n\
+void main()\n\
+{\n\
+	gl_Position = projection * view * models[instanceIndex] * vec4(pos, 1.0);\n\
+	vCol = vec4(clamp(pos, 0.0, 1.0), 1.0);\n\
+}";
+
+static const char* cDrawFragmentShader = "\n\
+#version 450\n\
+in vec4 vCol;\n\
+out vec4 colour;\n\
+\n\
+void main()\n\
+{\n\
+	colour = vCol;\n\
+}";
+
+static GLuint CreateStorageBuffer(GLsizeiptr size, GLbitfield flags = GL_DYNAMIC_STORAGE_BIT)
+{
+	GLuint buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, NULL, flags);
+	return buffer;
+}
+
+GpuCulling::GpuCulling()
+{
+	maxInstances = 0;
+	instanceBuffer = meshBuffer = transformBuffer = commandBuffer = visibleBuffer = countBuffer = 0;
+	cullProgram = copyDepthProgram = downsampleProgram = drawProgram = 0;
+	depthTexture = depthFBO = pyramidTexture = 0;
+	pyramidWidth = pyramidHeight = pyramidLevels = 0;
+	pyramidValid = false;
+	occlusionEnabled = true;
+	hasDrawIndirectCount = false;
+	uniformInstanceCount = uniformFrustumPlanes = uniformViewProj = uniformUseOcclusion = 0;
+	uniformPyramidSize = uniformPyramidLevels = uniformSrcLevel = uniformProjection = uniformView = 0;
+}
+
+bool GpuCulling::Init(GLuint maxInstanceCount)
+{
+	if (!GLEW_VERSION_4_5)
+	{
+		printf("\nGPU culling needs OpenGL 4.5!\n");
+		return false;
+	}
+
+	maxInstances = maxInstanceCount;
+	hasDrawIndirectCount = GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters;
+
+	cullProgram = LinkProgram(cCullShader, GL_COMPUTE_SHADER);
+	copyDepthProgram = LinkProgram(cCopyDepthShader, GL_COMPUTE_SHADER);
+	downsampleProgram = LinkProgram(cDownsampleShader, GL_COMPUTE_SHADER);
+	drawProgram = LinkProgram(cDrawVertexShader, GL_VERTEX_SHADER, cDrawFragmentShader, GL_FRAGMENT_SHADER);
+	if (!cullProgram || !copyDepthProgram || !downsampleProgram || !drawProgram)
+		return false;
+
+	uniformInstanceCount = glGetUniformLocation(cullProgram, "instanceCount");
+	uniformFrustumPlanes = glGetUniformLocation(cullProgram, "frustumPlanes");
+	uniformViewProj = glGetUniformLocation(cullProgram, "viewProj");
+	uniformUseOcclusion = glGetUniformLocation(cullProgram, "useOcclusion");
+	uniformPyramidSize = glGetUniformLocation(cullProgram, "pyramidSize");
+	uniformPyramidLevels = glGetUniformLocation(cullProgram, "pyramidLevels");
+	uniformSrcLevel = glGetUniformLocation(downsampleProgram, "srcLevel");
+	uniformProjection = glGetUniformLocation(drawProgram, "projection");
+	uniformView = glGetUniformLocation(drawProgram, "view");
+
+	instanceBuffer = CreateStorageBuffer(maxInstances * sizeof(InstanceData));
+	transformBuffer = CreateStorageBuffer(maxInstances * sizeof(glm::mat4));
+	commandBuffer = CreateStorageBuffer(maxInstances * sizeof(DrawElementsIndirectCommand));
+	visibleBuffer = CreateStorageBuffer(maxInstances * sizeof(GLuint));
+	countBuffer = CreateStorageBuffer(sizeof(GLuint), GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+	return true;
+}
+
+GLuint GpuCulling::AddMesh(GLuint indexCount, GLuint firstIndex, GLint baseVertex)
+{
+	MeshRange range = { indexCount, firstIndex, baseVertex, 0 };
+	meshes.push_back(range);
+	return (GLuint)meshes.size() - 1;
+}
+
+void GpuCulling::AddInstance(GLuint meshId, const glm::mat4& model, const glm::vec3& centre, float radius)
+{
+	if (instances.size() >= maxInstances)
+	{
+		printf("GPU culling instance limit (%u) reached\n", maxInstances);
+		return;
+	}
+
+	InstanceData data;
+	data.sphere = glm::vec4(centre, radius);
+	data.info = glm::uvec4(meshId, 0, 0, 0);
+	instances.push_back(data);
+	transforms.push_back(model);
+}
+
+void GpuCulling::UploadInstances()
+{
+	glNamedBufferSubData(instanceBuffer, 0, instances.size() * sizeof(InstanceData), instances.data());
+	glNamedBufferSubData(transformBuffer, 0, transforms.size() * sizeof(glm::mat4), transforms.data());
+
+	if (meshBuffer)
+		glDeleteBuffers(1, &meshBuffer);
+	meshBuffer = CreateStorageBuffer(std::max<size_t>(meshes.size(), 1) * sizeof(MeshRange));
+	glNamedBufferSubData(meshBuffer, 0, meshes.size() * sizeof(MeshRange), meshes.data());
+}
+
+void GpuCulling::AttachToVAO(GLuint vao)
+{
+	glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+			glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 0, 0);
+			glVertexAttribDivisor(1, 1);		// Advances per draw via baseInstance
+			glEnableVertexAttribArray(1);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void GpuCulling::Cull(const glm::mat4& viewProj)
+{
+	// Gribb-Hartmann plane extraction, normalised so the sphere test is in world units
+	glm::vec4 planes[6];
+	glm::mat4 m = glm::transpose(viewProj);
+	planes[0] = m[3] + m[0];
+	planes[1] = m[3] - m[0];
+	planes[2] = m[3] + m[1];
+	planes[3] = m[3] - m[1];
+	planes[4] = m[3] + m[2];
+	planes[5] = m[3] - m[2];
+	for (int i = 0; i < 6; ++i)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+
+	GLuint zero = 0;
+	glClearNamedBufferData(countBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (!hasDrawIndirectCount)
+		glClearNamedBufferData(commandBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	glUseProgram(cullProgram);
+		glUniform1ui(uniformInstanceCount, (GLuint)instances.size());
+		glUniform4fv(uniformFrustumPlanes, 6, glm::value_ptr(planes[0]));
+		glUniformMatrix4fv(uniformViewProj, 1, GL_FALSE, glm::value_ptr(viewProj));
+		glUniform1i(uniformUseOcclusion, occlusionEnabled && pyramidValid);
+		glUniform2f(uniformPyramidSize, (GLfloat)pyramidWidth, (GLfloat)pyramidHeight);
+		glUniform1i(uniformPyramidLevels, pyramidLevels);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, meshBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, countBuffer);
+		glBindTextureUnit(0, pyramidTexture);
+
+			glDispatchCompute(((GLuint)instances.size() + 63) / 64, 1, 1);
+
+		glBindTextureUnit(0, 0);
+	glUseProgram(0);
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuCulling::Draw(GLuint vao, GLuint ibo, const glm::mat4& projection, const glm::mat4& view)
+{
+	glUseProgram(drawProgram);
+		glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
+		glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, transformBuffer);
+
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+			if (hasDrawIndirectCount)
+			{
+				glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+				if (GLEW_VERSION_4_6)
+					glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, (GLsizei)instances.size(), 0);
+				else
+					glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, (GLsizei)instances.size(), 0);
+				glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+			}
+			else
+			{
+				// Tail commands were cleared to zero instances and cost next to nothing
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)instances.size(), 0);
+			}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+void GpuCulling::ResizePyramid(int width, int height)
+{
+	ClearPyramid();
+
+	pyramidWidth = width;
+	pyramidHeight = height;
+	pyramidLevels = 1 + (int)std::floor(std::log2((float)std::max(width, height)));
+
+	// Blit target, has to match the default framebuffer's DEPTH24_STENCIL8
+	glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+	glTextureStorage2D(depthTexture, 1, GL_DEPTH24_STENCIL8, width, height);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateFramebuffers(1, &depthFBO);
+	glNamedFramebufferTexture(depthFBO, GL_DEPTH_STENCIL_ATTACHMENT, depthTexture, 0);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &pyramidTexture);
+	glTextureStorage2D(pyramidTexture, pyramidLevels, GL_R32F, width, height);
+	glTextureParameteri(pyramidTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(pyramidTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(pyramidTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void GpuCulling::BuildDepthPyramid(int width, int height)
+{
+	if (width != pyramidWidth || height != pyramidHeight)
+		ResizePyramid(width, height);
+
+	glBlitNamedFramebuffer(0, depthFBO, 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	glUseProgram(copyDepthProgram);
+		glBindTextureUnit(0, depthTexture);
+		glBindImageTexture(0, pyramidTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+
+	glUseProgram(downsampleProgram);
+		glBindTextureUnit(0, pyramidTexture);
+		for (int level = 1; level < pyramidLevels; ++level)
+		{
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+			int levelWidth = std::max(width >> level, 1);
+			int levelHeight = std::max(height >> level, 1);
+			glUniform1i(uniformSrcLevel, level - 1);
+			glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+		}
+		glBindTextureUnit(0, 0);
+	glUseProgram(0);
+
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	pyramidValid = true;
+}
+
+GLuint GpuCulling::ReadDrawCount()
+{
+	GLuint count = 0;
+	glGetNamedBufferSubData(countBuffer, 0, sizeof(GLuint), &count);
+	return count;
+}
+
+void GpuCulling::ClearPyramid()
+{
+	if (depthFBO) glDeleteFramebuffers(1, &depthFBO);
+	if (depthTexture) glDeleteTextures(1, &depthTexture);
+	if (pyramidTexture) glDeleteTextures(1, &pyramidTexture);
+	depthFBO = depthTexture = pyramidTexture = 0;
+	pyramidValid = false;
+}
+
+GpuCulling::~GpuCulling()
+{
+	if (!maxInstances)
+		return;		// Init never got a context
+
+	ClearPyramid();
+
+	GLuint buffers[] = { instanceBuffer, meshBuffer, transformBuffer, commandBuffer, visibleBuffer, countBuffer };
+	glDeleteBuffers(6, buffers);
+
+	if (cullProgram) glDeleteProgram(cullProgram);
+	if (copyDepthProgram) glDeleteProgram(copyDepthProgram);
+	if (downsampleProgram) glDeleteProgram(downsampleProgram);
+	if (drawProgram) glDeleteProgram(drawProgram);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+/**	GPU-driven culling (needs a GL 4.5 context, llvmpipe is enough)
+ *
+ *	Per-instance bounding spheres live in an SSBO. A compute shader tests every
+ *	instance against the frustum and against the previous frame's Hi-Z depth
+ *	pyramid, then appends a DrawElementsIndirectCommand for each survivor.
+ *	The compacted buffer is drawn with glMultiDrawElementsIndirectCount when
+ *	ARB_indirect_parameters is present, otherwise with plain glMultiDrawElementsIndirect
+ *	over the whole buffer (culled slots are cleared to instanceCount = 0).
+ *
+ *	Typical frame:
+ *		Cull(viewProj)		- uses the pyramid built at the end of the last frame
+ *		Draw(VAO, ...)
+ *		BuildDepthPyramid()	- grabs the default framebuffer depth for the next frame
+ */
+
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+class GpuCulling
+{
+public:
+	GpuCulling();
+
+	bool Init(GLuint maxInstances);
+
+	// Index range of a mesh inside the bound element buffer, returns the mesh id
+	GLuint AddMesh(GLuint indexCount, GLuint firstIndex, GLint baseVertex);
+	// World space bounding sphere + model matrix of one instance
+	void AddInstance(GLuint meshId, const glm::mat4& model, const glm::vec3& centre, float radius);
+	void UploadInstances();
+
+	// Hooks the visible-index stream (location 1, divisor 1) into a VAO
+	void AttachToVAO(GLuint vao);
+
+	void Cull(const glm::mat4& viewProj);
+	void Draw(GLuint vao, GLuint ibo, const glm::mat4& projection, const glm::mat4& view);
+	void BuildDepthPyramid(int width, int height);
+
+	GLuint ReadDrawCount();		// Stalls, debugging only
+
+	void SetOcclusionEnabled(bool enabled) { occlusionEnabled = enabled; }
+
+	~GpuCulling();
+
+private:
+	struct InstanceData
+	{
+		glm::vec4 sphere;	// xyz centre, w radius
+		glm::uvec4 info;	// x mesh id
+	};
+
+	struct MeshRange
+	{
+		GLuint count;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint pad;
+	};
+
+	void ResizePyramid(int width, int height);
+	void ClearPyramid();
+
+	std::vector<InstanceData> instances;
+	std::vector<glm::mat4> transforms;
+	std::vector<MeshRange> meshes;
+
+	GLuint maxInstances;
+	GLuint instanceBuffer, meshBuffer, transformBuffer, commandBuffer, visibleBuffer, countBuffer;
+	GLuint cullProgram, copyDepthProgram, downsampleProgram, drawProgram;
+	GLuint depthTexture, depthFBO, pyramidTexture;
+	int pyramidWidth, pyramidHeight, pyramidLevels;
+	bool pyramidValid, occlusionEnabled, hasDrawIndirectCount;
+
+	GLint uniformInstanceCount, uniformFrustumPlanes, uniformViewProj, uniformUseOcclusion,
+		uniformPyramidSize, uniformPyramidLevels, uniformSrcLevel, uniformProjection, uniformView;
+};
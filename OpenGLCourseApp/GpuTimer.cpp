@@ -0,0 +1,55 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+	for (unsigned i = 0; i < QUERY_COUNT; ++i)
+		queries[i] = 0;
+	queryFrame = 0;
+	nanoseconds = 0;
+	frames = 0;
+}
+
+void GpuTimer::Init()
+{
+	glGenQueries(QUERY_COUNT, queries);
+}
+
+void GpuTimer::Begin()
+{
+	// Collect the query from QUERY_COUNT frames ago if the GPU is done with it, never wait
+	GLuint query = queries[queryFrame % QUERY_COUNT];
+	if (queryFrame >= QUERY_COUNT)
+	{
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			nanoseconds += elapsed;
+			++frames;
+		}
+	}
+	++queryFrame;
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void GpuTimer::End()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+double GpuTimer::Collect()
+{
+	double milliseconds = frames ? nanoseconds * 1e-6 / frames : 0.0;
+	nanoseconds = 0;
+	frames = 0;
+	return milliseconds;
+}
+
+GpuTimer::~GpuTimer()
+{
+	if (queries[0])
+		glDeleteQueries(QUERY_COUNT, queries);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+
+/**	GPU time of a span of GL commands, averaged over frames
+ *
+ *	A ring of QUERY_COUNT GL_TIME_ELAPSED queries takes turns. Begin first reads
+ *	back the query it is about to reuse, ended QUERY_COUNT frames ago, but only
+ *	when GL_QUERY_RESULT_AVAILABLE says it is done: without a fence capping the
+ *	frames in flight the driver may queue three of them, and asking for an
+ *	unfinished result would stall the CPU. A frame that isn't back yet is left
+ *	out of the average. Spans must not nest, GL has one GL_TIME_ELAPSED query
+ *	active at a time. Needs the context for Init and the destructor.
+ */
+class GpuTimer
+{
+public:
+	static const unsigned QUERY_COUNT = 4;
+
+	GpuTimer();
+
+	void Init();
+
+	void Begin();
+	void End();
+
+	// Average milliseconds of the frames read back since the last Collect
+	double Collect();
+
+	~GpuTimer();
+
+private:
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	GLuint queries[QUERY_COUNT];
+	unsigned queryFrame;
+	GLuint64 nanoseconds;
+	unsigned frames;
+};
@@ -0,0 +1,136 @@
+#include "HalfFloat.h"
+
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
+
+#include "Simd.h"
+
+namespace HalfFloat
+{
+	namespace
+	{
+		struct Converters
+		{
+			uint16_t (*floatToHalf)(float f);
+			float (*halfToFloat)(uint16_t h);
+			uint64_t (*packHalf4x16)(const glm::vec4& v);
+			glm::vec4 (*unpackHalf4x16)(uint64_t packed);
+		};
+
+		uint16_t FloatToHalfSoftware(float f)
+		{
+			return glm::packHalf1x16(f);
+		}
+
+		float HalfToFloatSoftware(uint16_t h)
+		{
+			return glm::unpackHalf1x16(h);
+		}
+
+		uint64_t PackHalf4x16Software(const glm::vec4& v)
+		{
+			return glm::packHalf4x16(v);
+		}
+
+		glm::vec4 UnpackHalf4x16Software(uint64_t packed)
+		{
+			return glm::unpackHalf4x16(packed);
+		}
+
+		const Converters software = { FloatToHalfSoftware, HalfToFloatSoftware, PackHalf4x16Software, UnpackHalf4x16Software };
+
+#if SIMD_X86
+		SIMD_TARGET_F16C uint16_t FloatToHalfF16C(float f)
+		{
+			uint32_t bits;
+			memcpy(&bits, &f, sizeof(bits));
+			uint32_t abs = bits & 0x7FFFFFFF;
+			if (abs > 0x7F800000)
+				return glm::packHalf1x16(f);
+			if (abs < 0x7F800000)
+				bits |= 1;
+
+			__m128i h = _mm_cvtps_ph(_mm_castsi128_ps(_mm_cvtsi32_si128((int)bits)), _MM_FROUND_TO_NEAREST_INT);
+			return (uint16_t)_mm_cvtsi128_si32(h);
+		}
+
+		SIMD_TARGET_F16C float HalfToFloatF16C(uint16_t h)
+		{
+			if ((h & 0x7FFF) > 0x7C00)
+				return glm::unpackHalf1x16(h);
+			return _mm_cvtss_f32(_mm_cvtph_ps(_mm_cvtsi32_si128(h)));
+		}
+
+		SIMD_TARGET_F16C uint64_t PackHalf4x16F16C(const glm::vec4& v)
+		{
+			__m128i bits = _mm_loadu_si128((const __m128i*)&v.x);
+			__m128i abs = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+			if (_mm_movemask_epi8(_mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7F800000))))
+				return glm::packHalf4x16(v);
+
+			__m128i finite = _mm_cmplt_epi32(abs, _mm_set1_epi32(0x7F800000));
+			__m128i nudged = _mm_or_si128(bits, _mm_and_si128(finite, _mm_set1_epi32(1)));
+			uint64_t packed;
+			_mm_storel_epi64((__m128i*)&packed, _mm_cvtps_ph(_mm_castsi128_ps(nudged), _MM_FROUND_TO_NEAREST_INT));
+			return packed;
+		}
+
+		SIMD_TARGET_F16C glm::vec4 UnpackHalf4x16F16C(uint64_t packed)
+		{
+			__m128i h = _mm_loadl_epi64((const __m128i*)&packed);
+			__m128i magnitude = _mm_and_si128(h, _mm_set1_epi16(0x7FFF));
+			if (_mm_movemask_epi8(_mm_cmpgt_epi16(magnitude, _mm_set1_epi16(0x7C00))) & 0xFF)
+				return glm::unpackHalf4x16(packed);
+
+			glm::vec4 v;
+			_mm_storeu_ps(&v.x, _mm_cvtph_ps(h));
+			return v;
+		}
+
+		const Converters f16c = { FloatToHalfF16C, HalfToFloatF16C, PackHalf4x16F16C, UnpackHalf4x16F16C };
+#endif
+
+		const Converters* active = &software;
+
+		struct ResolveAtStartup
+		{
+			ResolveAtStartup() { SelectF16C(true); }
+		} resolveAtStartup;
+	}
+
+	uint16_t FloatToHalf(float f)
+	{
+		return active->floatToHalf(f);
+	}
+
+	float HalfToFloat(uint16_t h)
+	{
+		return active->halfToFloat(h);
+	}
+
+	uint64_t PackHalf4x16(const glm::vec4& v)
+	{
+		return active->packHalf4x16(v);
+	}
+
+	glm::vec4 UnpackHalf4x16(uint64_t packed)
+	{
+		return active->unpackHalf4x16(packed);
+	}
+
+	bool UsesF16C()
+	{
+		return active != &software;
+	}
+
+	bool SelectF16C(bool enable)
+	{
+		active = &software;
+#if SIMD_X86
+		if (enable && GetCpuFeatures().f16c)
+			active = &f16c;
+#endif
+		return UsesF16C();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/**	Single value float <-> half conversion, rounded exactly like gtc/packing
+ *
+ *	GLM converts halves in software (detail::toFloat16 / toFloat32), one branchy
+ *	bit shuffle per value. These functions give the same bits: FloatToHalf is
+ *	glm::packHalf1x16, HalfToFloat glm::unpackHalf1x16, and the 4x16 forms
+ *	convert a whole vector at once. Each goes through an implementation picked
+ *	once at startup, F16C (vcvtps2ph / vcvtph2ps) when the host has it and GLM's
+ *	software path otherwise.
+ *
+ *	F16C rounds ties to even where GLM rounds them away from zero, so a finite
+ *	input gets its lowest bit set first, which lifts an exact tie just past the
+ *	midpoint and moves nothing else across one. F16C also quiets signalling NaNs,
+ *	so NaN inputs take the software path to keep their payload.
+ *
+ *	For whole arrays use BatchMath::PackHalf / UnpackHalf.
+ */
+
+namespace HalfFloat
+{
+	uint16_t FloatToHalf(float f);
+	float HalfToFloat(uint16_t h);
+
+	uint64_t PackHalf4x16(const glm::vec4& v);
+	glm::vec4 UnpackHalf4x16(uint64_t packed);
+
+	inline uint32_t PackHalf2x16(const glm::vec2& v)
+	{
+		return (uint32_t)FloatToHalf(v.x) | (uint32_t)FloatToHalf(v.y) << 16;
+	}
+
+	inline glm::vec2 UnpackHalf2x16(uint32_t packed)
+	{
+		return glm::vec2(HalfToFloat((uint16_t)packed), HalfToFloat((uint16_t)(packed >> 16)));
+	}
+
+	// Whether the F16C path is in use
+	bool UsesF16C();
+
+	// Runs at startup with true. Pass false, before other threads convert, to force the
+	// software path; true only takes F16C if the host has it. Returns UsesF16C()
+	bool SelectF16C(bool enable);
+}
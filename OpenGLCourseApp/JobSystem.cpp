@@ -0,0 +1,150 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+static thread_local bool insideJob = false;
+
+// Set on the background workers, so they find their index without a lookup
+static thread_local const JobSystem* workerSystem = nullptr;
+static thread_local unsigned workerIndex = 0;
+
+JobSystem::JobSystem(unsigned threadCount)
+{
+	body = nullptr;
+	count = grain = 0;
+	nextChunk = 0;
+	busyWorkers = 0;
+	generation = 0;
+	quit = false;
+	submitterCount = 0;
+
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 1; i < threadCount; ++i)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+void JobSystem::ParallelFor(size_t itemCount, size_t grainSize, const RangeFunction& rangeBody)
+{
+	if (itemCount == 0)
+		return;
+
+	unsigned worker = CallerWorker();
+	grainSize = std::max<size_t>(grainSize, 1);
+	if (workers.empty() || insideJob || itemCount <= grainSize)
+	{
+		rangeBody(0, itemCount, worker);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submitLock(submitMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		body = &rangeBody;
+		count = itemCount;
+		grain = grainSize;
+		nextChunk = 0;
+		++generation;
+	}
+	wake.notify_all();
+
+	RunChunks(worker);
+
+	// Every chunk is claimed now, wait for the workers still busy with theirs
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busyWorkers == 0; });
+	body = nullptr;
+}
+
+void JobSystem::ParallelFor(size_t itemCount, size_t grainSize, const std::function<void(size_t begin, size_t end)>& rangeBody)
+{
+	ParallelFor(itemCount, grainSize, RangeFunction([&rangeBody](size_t begin, size_t end, unsigned) { rangeBody(begin, end); }));
+}
+
+unsigned JobSystem::CallerWorker()
+{
+	if (workerSystem == this)
+		return workerIndex;
+
+	std::thread::id self = std::this_thread::get_id();
+	std::lock_guard<std::mutex> lock(submitterMutex);
+	unsigned slot = 0;
+	while (slot < submitterCount && submitters[slot] != self)
+		++slot;
+	if (slot == submitterCount)
+	{
+		assert(submitterCount < MAX_SUBMITTING_THREADS && "More threads call ParallelFor than JobSystem has slots for");
+		if (submitterCount == MAX_SUBMITTING_THREADS)
+			slot = MAX_SUBMITTING_THREADS - 1;
+		else
+			submitters[submitterCount++] = self;
+	}
+
+	// The first submitter is 0, the others follow the background workers
+	return slot == 0 ? 0 : (unsigned)workers.size() + slot;
+}
+
+void JobSystem::RunChunks(unsigned worker)
+{
+	bool nested = insideJob;
+	insideJob = true;
+
+	size_t chunkCount = (count + grain - 1) / grain;
+	for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+	{
+		size_t begin = chunk * grain;
+		(*body)(begin, std::min(begin + grain, count), worker);
+	}
+
+	insideJob = nested;
+}
+
+void JobSystem::WorkerLoop(unsigned worker)
+{
+	workerSystem = this;
+	workerIndex = worker;
+
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seen] { return quit || (generation != seen && body); });
+			if (quit)
+				return;
+			seen = generation;
+			++busyWorkers;
+		}
+
+		RunChunks(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busyWorkers;
+		}
+		done.notify_all();
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void ParallelFor(JobSystem* jobs, size_t count, size_t grain, const JobSystem::RangeFunction& body)
+{
+	if (jobs)
+		jobs->ParallelFor(count, grain, body);
+	else if (count)
+		body(0, count, 0);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**	Small fork-join pool for data parallel loops
+ *
+ *	ParallelFor cuts [0, count) into grain sized chunks that the workers and the
+ *	calling thread pull from a shared counter, and returns once all of them are done.
+ *	Nested calls from inside a body run inline.
+ *
+ *	The worker index passed to the body is stable per thread, so it can pick
+ *	per-thread scratch memory sized by GetWorkerSlotCount(). Background workers are
+ *	1 .. GetThreadCount() - 1. Up to MAX_SUBMITTING_THREADS other threads may call
+ *	ParallelFor, each gets its own index the first time it does: 0 for the first
+ *	(the main thread), GetThreadCount() for the second (the render thread). Calls
+ *	from two submitting threads take turns on the pool; inline runs (small counts,
+ *	nested calls) go ahead at once under the caller's own index. A further
+ *	submitting thread asserts, and in release builds shares the last index.
+ */
+
+class JobSystem
+{
+public:
+	typedef std::function<void(size_t begin, size_t end, unsigned worker)> RangeFunction;
+
+	static const unsigned MAX_SUBMITTING_THREADS = 2;
+
+	explicit JobSystem(unsigned threadCount = 0);		// 0 = hardware threads
+
+	// Caller + background workers
+	unsigned GetThreadCount() const { return (unsigned)workers.size() + 1; }
+	// Distinct worker indices a body can see, the size for per-worker scratch
+	unsigned GetWorkerSlotCount() const { return (unsigned)workers.size() + MAX_SUBMITTING_THREADS; }
+
+	void ParallelFor(size_t count, size_t grain, const RangeFunction& body);
+	void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+	~JobSystem();
+
+private:
+	void WorkerLoop(unsigned worker);
+	void RunChunks(unsigned worker);
+	unsigned CallerWorker();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	std::mutex submitMutex;
+
+	std::mutex submitterMutex;
+	std::thread::id submitters[MAX_SUBMITTING_THREADS];
+	unsigned submitterCount;
+
+	const RangeFunction* body;
+	size_t count, grain;
+	std::atomic<size_t> nextChunk;
+	unsigned busyWorkers;
+	unsigned generation;
+	bool quit;
+};
+
+// jobs->ParallelFor, or the whole range inline as worker 0 when there is no job system
+void ParallelFor(JobSystem* jobs, size_t count, size_t grain, const JobSystem::RangeFunction& body);
@@ -0,0 +1,129 @@
+#include "Noise.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Coordinates per kernel call; three of these live on the stack
+	const size_t CHUNK = 256;
+
+	// Samples per job chunk, enough to hide the hand-off
+	const size_t JOB_SAMPLES = 8192;
+
+	// z is ignored by the 2D noises
+	void Run(NoiseType type, int dimensions, const BatchMath::FbmSettings& fbm, const float* x, const float* y, const float* z,
+		float* out, size_t count)
+	{
+		if (dimensions == 2)
+		{
+			if (type == NOISE_PERLIN)
+				BatchMath::Perlin2(x, y, fbm, out, count);
+			else
+				BatchMath::Simplex2(x, y, fbm, out, count);
+		}
+		else
+		{
+			if (type == NOISE_PERLIN)
+				BatchMath::Perlin3(x, y, z, fbm, out, count);
+			else
+				BatchMath::Simplex3(x, y, z, fbm, out, count);
+		}
+	}
+
+	// Rows are (y, z) pairs, row = z * height + y
+	void FillGridRows(NoiseType type, int dimensions, const BatchMath::FbmSettings& fbm, const glm::vec3& origin,
+		const glm::vec3& spacing, int width, int height, float* out, JobSystem* jobs, size_t rows)
+	{
+		size_t grain = std::max<size_t>(1, JOB_SAMPLES / width);
+		ParallelFor(jobs, rows, grain, [&](size_t begin, size_t end, unsigned)
+		{
+			float x[CHUNK], y[CHUNK], z[CHUNK];
+			for (size_t row = begin; row < end; ++row)
+			{
+				float rowY = origin.y + spacing.y * (float)(row % height);
+				float rowZ = origin.z + spacing.z * (float)(row / height);
+				for (size_t first = 0; first < (size_t)width; first += CHUNK)
+				{
+					size_t count = std::min(CHUNK, width - first);
+					for (size_t i = 0; i < count; ++i)
+					{
+						x[i] = origin.x + spacing.x * (float)(first + i);
+						y[i] = rowY;
+						z[i] = rowZ;
+					}
+					Run(type, dimensions, fbm, x, y, z, out + row * width + first, count);
+				}
+			}
+		});
+	}
+
+	// Points are dimensions floats apart
+	void EvaluatePoints(NoiseType type, int dimensions, const BatchMath::FbmSettings& fbm, const float* points, float* out,
+		size_t count, JobSystem* jobs)
+	{
+		ParallelFor(jobs, (count + CHUNK - 1) / CHUNK, std::max<size_t>(1, JOB_SAMPLES / CHUNK), [&](size_t begin, size_t end, unsigned)
+		{
+			float x[CHUNK], y[CHUNK], z[CHUNK];
+			for (size_t chunk = begin; chunk < end; ++chunk)
+			{
+				size_t first = chunk * CHUNK;
+				size_t chunkCount = std::min(CHUNK, count - first);
+				const float* p = points + first * dimensions;
+				for (size_t i = 0; i < chunkCount; ++i, p += dimensions)
+				{
+					x[i] = p[0];
+					y[i] = p[1];
+					z[i] = dimensions == 3 ? p[2] : 0.f;
+				}
+				Run(type, dimensions, fbm, x, y, z, out + first, chunkCount);
+			}
+		});
+	}
+}
+
+namespace Noise
+{
+	float Sample(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec2& p)
+	{
+		float result;
+		if (type == NOISE_PERLIN)
+			BatchMath::Perlin2Scalar(&p.x, &p.y, fbm, &result, 1);
+		else
+			BatchMath::Simplex2Scalar(&p.x, &p.y, fbm, &result, 1);
+		return result;
+	}
+
+	float Sample(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec3& p)
+	{
+		float result;
+		if (type == NOISE_PERLIN)
+			BatchMath::Perlin3Scalar(&p.x, &p.y, &p.z, fbm, &result, 1);
+		else
+			BatchMath::Simplex3Scalar(&p.x, &p.y, &p.z, fbm, &result, 1);
+		return result;
+	}
+
+	void FillGrid(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec2& origin, const glm::vec2& spacing,
+		int width, int height, float* out, JobSystem* jobs)
+	{
+		FillGridRows(type, 2, fbm, glm::vec3(origin, 0.f), glm::vec3(spacing, 0.f), width, height, out, jobs, height);
+	}
+
+	void FillGrid(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec3& origin, const glm::vec3& spacing,
+		int width, int height, int depth, float* out, JobSystem* jobs)
+	{
+		FillGridRows(type, 3, fbm, origin, spacing, width, height, out, jobs, (size_t)height * depth);
+	}
+
+	void Evaluate(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec2* points, float* out, size_t count,
+		JobSystem* jobs)
+	{
+		EvaluatePoints(type, 2, fbm, &points[0].x, out, count, jobs);
+	}
+
+	void Evaluate(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec3* points, float* out, size_t count,
+		JobSystem* jobs)
+	{
+		EvaluatePoints(type, 3, fbm, &points[0].x, out, count, jobs);
+	}
+}
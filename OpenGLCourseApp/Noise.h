@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "BatchMath.h"
+#include "JobSystem.h"
+
+/**	Batched fBm noise for heightfields, density volumes and procedural textures
+ *
+ *	Thin drivers over BatchMath::Perlin2/3 and Simplex2/3. Grids are cut into rows
+ *	for the job threads; each row is generated and evaluated in chunks of SoA
+ *	coordinates on the stack, so nothing allocates. Grid sample (x, y, z) is taken
+ *	at origin + spacing * (x, y, z) and lands in out[(z * height + y) * width + x].
+ *
+ *	Sample is the scalar reference (glm::perlin / glm::simplex), the batched
+ *	functions agree with it to 1e-4.
+ */
+
+enum NoiseType
+{
+	NOISE_PERLIN,
+	NOISE_SIMPLEX
+};
+
+namespace Noise
+{
+	float Sample(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec2& p);
+	float Sample(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec3& p);
+
+	void FillGrid(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec2& origin, const glm::vec2& spacing,
+		int width, int height, float* out, JobSystem* jobs = nullptr);
+	void FillGrid(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec3& origin, const glm::vec3& spacing,
+		int width, int height, int depth, float* out, JobSystem* jobs = nullptr);
+
+	void Evaluate(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec2* points, float* out, size_t count,
+		JobSystem* jobs = nullptr);
+	void Evaluate(NoiseType type, const BatchMath::FbmSettings& fbm, const glm::vec3* points, float* out, size_t count,
+		JobSystem* jobs = nullptr);
+}
@@ -0,0 +1,492 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ShaderUtil.h"
+
+namespace
+{
+	const size_t CHUNK_SIZE = 16384;		// Particles per Integrate job, and per compaction chunk
+	const size_t EMIT_GRAIN = 16384;
+	const size_t PACK_GRAIN = 16384;
+	const float PARTICLE_SIZE = 0.02f;		// Quad half size at birth, shrinks to half of it by death
+
+	void CopyParticle(const BatchMath::ParticleSoA& p, size_t from, size_t to)
+	{
+		p.x[to] = p.x[from];
+		p.y[to] = p.y[from];
+		p.z[to] = p.z[from];
+		p.vx[to] = p.vx[from];
+		p.vy[to] = p.vy[from];
+		p.vz[to] = p.vz[from];
+		p.age[to] = p.age[from];
+		p.life[to] = p.life[from];
+	}
+}
+
+// One quad per particle, offset in view space so it always faces the camera
+static const char* cParticleVertexShader = "\n\
+#version 330\n\
+layout (location = 0) in vec2 corner;\n\
+layout (location = 1) in vec4 particle;\n\
+\n\
+out vec2 vCorner;\n\
+out float vAge;\n\
+\n\
+uniform mat4 projection;\n\
+uniform mat4 view;\n\
+uniform float size;\n\
+\n\
+void main()\n\
+{\n\
+	vCorner = corner;\n\
+	vAge = particle.w;\n\
+\n\
+	// Not born yet (GPU path): behind the far plane, clipped\n\
+	if (particle.w < 0.0)\n\
+	{\n\
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);\n\
+		return;\n\
+	}\n\
+\n\
+	vec4 centre = view * vec4(particle.xyz, 1.0);\n\
+	gl_Position = projection * (centre + vec4(corner * size * (1.0 - 0.5 * particle.w), 0.0, 0.0));\n\
+}";
+
+// Round, additive, white hot to dull red over the particle's life
+static const char* cParticleFragmentShader = "\n\
+#version 330\n\
+in vec2 vCorner;\n\
+in float vAge;\n\
+out vec4 colour;\n\
+\n\
+void main()\n\
+{\n\
+	float falloff = max(0.0, 1.0 - dot(vCorner, vCorner));\n\
+	vec3 tint = mix(vec3(1.0, 0.85, 0.4), vec3(0.6, 0.1, 0.05), vAge);\n\
+	colour = vec4(tint * falloff * (1.0 - vAge), 1.0);\n\
+}";
+
+// The GPU path's step, one point per particle captured with transform feedback. Same emitter
+// arithmetic and hash as BatchMath::EmitParticles, same integration as IntegrateParticles
+static const char* cParticleUpdateShader = "\n\
+#version 330\n\
+layout (location = 0) in vec4 state;\n\
+layout (location = 1) in vec4 motion;\n\
+\n\
+out vec4 outState;\n\
+out vec4 outMotion;\n\
+\n\
+uniform float dt;\n\
+uniform vec3 gravity;\n\
+uniform float damping;\n\
+uniform uint sequence;\n\
+uniform vec3 emitterPosition;\n\
+uniform vec3 emitterExtent;\n\
+uniform vec3 emitterVelocity;\n\
+uniform vec3 emitterSpread;\n\
+uniform float emitterLife;\n\
+uniform float emitterLifeRange;\n\
+\n\
+uint HashBits(uint x)\n\
+{\n\
+	x ^= x >> 16u;\n\
+	x *= 0x7FEB352Du;\n\
+	x ^= x >> 15u;\n\
+	x *= 0x846CA68Bu;\n\
+	return x ^ (x >> 16u);\n\
+}\n\
+\n\
+float HashSigned(uint key)\n\
+{\n\
+	return float(HashBits(key) >> 8u) * (1.0 / 8388608.0) - 1.0;\n\
+}\n\
+\n\
+void main()\n\
+{\n\
+	// state = (position, age / life), motion = (velocity, 1 / life). Negative ages count down to the first birth\n\
+	float t = state.w + dt * motion.w;\n\
+	if (t >= 1.0 || (state.w < 0.0 && t >= 0.0))\n\
+	{\n\
+		uint key = HashBits(HashBits(sequence) ^ uint(gl_VertexID));\n\
+		vec3 position = vec3(HashSigned(key), HashSigned(key + 1u), HashSigned(key + 2u)) * emitterExtent + emitterPosition;\n\
+		vec3 velocity = vec3(HashSigned(key + 3u), HashSigned(key + 4u), HashSigned(key + 5u)) * emitterSpread + emitterVelocity;\n\
+		float life = HashSigned(key + 6u) * emitterLifeRange + emitterLife;\n\
+		outState = vec4(position, 0.0);\n\
+		outMotion = vec4(velocity, 1.0 / life);\n\
+		return;\n\
+	}\n\
+\n\
+	vec3 velocity = (motion.xyz + gravity * dt) * damping;\n\
+	outState = vec4(state.xyz + velocity * dt, t);\n\
+	outMotion = vec4(velocity, motion.w);\n\
+}";
+
+ParticleSystem::ParticleSystem()
+{
+	path = PARTICLES_CPU;
+	capacity = liveCount = 0;
+	emitter = BatchMath::ParticleEmitter();
+	step = BatchMath::ParticleStep();
+	emitRate = emitCarry = 0.0;
+	sequence = 0;
+	stepPending = false;
+	particles = BatchMath::ParticleSoA();
+	drawProgram = updateProgram = quadBuffer = streamBuffer = 0;
+	stateBuffers[0] = stateBuffers[1] = drawVaos[0] = drawVaos[1] = updateVaos[0] = updateVaos[1] = 0;
+	current = 0;
+	uniformProjection = uniformView = uniformSize = 0;
+	uniformDt = uniformGravity = uniformDamping = uniformSequence = 0;
+	uniformEmitterPosition = uniformEmitterExtent = uniformEmitterVelocity = uniformEmitterSpread = 0;
+	uniformEmitterLife = uniformEmitterLifeRange = 0;
+	cpuSeconds = particlesProcessed = 0.0;
+	frames = 0;
+}
+
+bool ParticleSystem::Init(ParticlePath particlePath, size_t maxParticles, const BatchMath::ParticleEmitter& particleEmitter,
+	const glm::vec3& gravity, float drag)
+{
+	path = particlePath;
+	capacity = maxParticles;
+	emitter = particleEmitter;
+	step.gravity = gravity;
+	step.drag = drag;
+	step.dt = 0.f;
+	emitRate = capacity / (double)emitter.life;
+
+	drawProgram = LinkProgram(cParticleVertexShader, GL_VERTEX_SHADER, cParticleFragmentShader, GL_FRAGMENT_SHADER);
+	if (!drawProgram)
+		return false;
+
+	uniformProjection = glGetUniformLocation(drawProgram, "projection");
+	uniformView = glGetUniformLocation(drawProgram, "view");
+	uniformSize = glGetUniformLocation(drawProgram, "size");
+
+	// Triangle strip, shared by every instance
+	const GLfloat corners[] = { -1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, 1.f };
+	glGenBuffers(1, &quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+	if (path == PARTICLES_CPU)
+	{
+		storage.resize(8 * capacity);
+		float* base = storage.empty() ? NULL : &storage[0];
+		BatchMath::ParticleSoA soa = { base, base + capacity, base + 2 * capacity, base + 3 * capacity,
+			base + 4 * capacity, base + 5 * capacity, base + 6 * capacity, base + 7 * capacity };
+		particles = soa;
+		chunkAlive.resize((capacity + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+		// Packed by Draw every frame
+		glGenBuffers(1, &streamBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+	}
+	else
+	{
+		const char* varyings[] = { "outState", "outMotion" };
+		updateProgram = LinkProgram(cParticleUpdateShader, GL_VERTEX_SHADER, NULL, 0, varyings, 2);
+		if (!updateProgram)
+			return false;
+
+		uniformDt = glGetUniformLocation(updateProgram, "dt");
+		uniformGravity = glGetUniformLocation(updateProgram, "gravity");
+		uniformDamping = glGetUniformLocation(updateProgram, "damping");
+		uniformSequence = glGetUniformLocation(updateProgram, "sequence");
+		uniformEmitterPosition = glGetUniformLocation(updateProgram, "emitterPosition");
+		uniformEmitterExtent = glGetUniformLocation(updateProgram, "emitterExtent");
+		uniformEmitterVelocity = glGetUniformLocation(updateProgram, "emitterVelocity");
+		uniformEmitterSpread = glGetUniformLocation(updateProgram, "emitterSpread");
+		uniformEmitterLife = glGetUniformLocation(updateProgram, "emitterLife");
+		uniformEmitterLifeRange = glGetUniformLocation(updateProgram, "emitterLifeRange");
+
+		// state, motion pairs. Particle i is born after (i + 0.5) / capacity of a mean life
+		std::vector<glm::vec4> initial(2 * capacity);
+		for (size_t i = 0; i < capacity; ++i)
+		{
+			initial[2 * i] = glm::vec4(emitter.position, -(i + 0.5f) / capacity);
+			initial[2 * i + 1] = glm::vec4(0.f, 0.f, 0.f, 1.f / emitter.life);
+		}
+
+		glGenBuffers(2, stateBuffers);
+		for (int b = 0; b < 2; ++b)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[b]);
+			glBufferData(GL_ARRAY_BUFFER, initial.size() * sizeof(glm::vec4), initial.empty() ? NULL : &initial[0], GL_DYNAMIC_COPY);
+		}
+
+		// Reads buffer b, feedback writes the other
+		glGenVertexArrays(2, updateVaos);
+		for (int b = 0; b < 2; ++b)
+		{
+			glBindVertexArray(updateVaos[b]);
+			glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[b]);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (const void*)0);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (const void*)sizeof(glm::vec4));
+			glEnableVertexAttribArray(0);
+			glEnableVertexAttribArray(1);
+		}
+	}
+
+	// Quad corners per vertex, the particle per instance: the streaming buffer, or either state buffer
+	int drawVaoCount = path == PARTICLES_CPU ? 1 : 2;
+	glGenVertexArrays(drawVaoCount, drawVaos);
+	for (int b = 0; b < drawVaoCount; ++b)
+	{
+		glBindVertexArray(drawVaos[b]);
+		glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+		glEnableVertexAttribArray(0);
+
+		if (path == PARTICLES_CPU)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (const void*)0);
+		}
+		else
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[b]);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (const void*)0);
+		}
+		glVertexAttribDivisor(1, 1);
+		glEnableVertexAttribArray(1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	gpuTimer.Init();
+
+	return true;
+}
+
+void ParticleSystem::Emit(size_t count, JobSystem* jobs)
+{
+	BatchMath::ParticleSoA out = particles.Offset(liveCount);
+	ParallelFor(jobs, count, EMIT_GRAIN, [&](size_t begin, size_t end, unsigned)
+	{
+		BatchMath::EmitParticles(emitter, sequence + (uint32_t)begin, out.Offset(begin), end - begin);
+	});
+
+	liveCount += count;
+	sequence += (uint32_t)count;
+}
+
+void ParticleSystem::Integrate(float dt, JobSystem* jobs)
+{
+	step.dt = dt;
+	size_t chunks = (liveCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	ParallelFor(jobs, chunks, 1, [&](size_t begin, size_t end, unsigned)
+	{
+		for (size_t chunk = begin; chunk < end; ++chunk)
+		{
+			size_t first = chunk * CHUNK_SIZE, last = std::min(first + CHUNK_SIZE, liveCount);
+			if (!BatchMath::IntegrateParticles(step, particles.Offset(first), last - first))
+			{
+				chunkAlive[chunk] = last - first;
+				continue;
+			}
+
+			// Survivors slide down over the dead, in order. The copy is unconditional, only the
+			// write position depends on the particle being alive
+			size_t write = first;
+			while (particles.age[write] < particles.life[write])
+				++write;
+			for (size_t read = write + 1; read < last; ++read)
+			{
+				bool alive = particles.age[read] < particles.life[read];
+				CopyParticle(particles, read, write);
+				write += alive;
+			}
+			chunkAlive[chunk] = write - first;
+		}
+	});
+}
+
+void ParticleSystem::FillHoles()
+{
+	size_t chunks = (liveCount + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	size_t alive = 0;
+	for (size_t chunk = 0; chunk < chunks; ++chunk)
+		alive += chunkAlive[chunk];
+
+	// Holes before alive and survivors at or past it are equally many. Holes are filled front
+	// to back from the survivors' runs back to front, a run at a time
+	size_t holeChunk = 0, hole = 0, holeEnd = 0;
+	size_t sourceChunk = chunks, sourceBegin = 0, source = 0;
+	for (;;)
+	{
+		if (hole == holeEnd)
+		{
+			if (holeChunk * CHUNK_SIZE >= alive)
+				break;
+			hole = holeChunk * CHUNK_SIZE + chunkAlive[holeChunk];
+			holeEnd = std::max(hole, std::min((holeChunk + 1) * CHUNK_SIZE, alive));
+			++holeChunk;
+			continue;
+		}
+
+		if (source == sourceBegin)
+		{
+			--sourceChunk;
+			sourceBegin = std::max(sourceChunk * CHUNK_SIZE, alive);
+			source = std::max(sourceBegin, sourceChunk * CHUNK_SIZE + chunkAlive[sourceChunk]);
+			continue;
+		}
+
+		size_t count = std::min(holeEnd - hole, source - sourceBegin);
+		source -= count;
+		MoveParticles(source, hole, count);
+		hole += count;
+	}
+
+	liveCount = alive;
+}
+
+void ParticleSystem::MoveParticles(size_t from, size_t to, size_t count)
+{
+	float* arrays[] = { particles.x, particles.y, particles.z, particles.vx, particles.vy, particles.vz, particles.age, particles.life };
+	for (int a = 0; a < 8; ++a)
+		memcpy(arrays[a] + to, arrays[a] + from, count * sizeof(float));
+}
+
+void ParticleSystem::Update(float dt, JobSystem* jobs)
+{
+	if (path == PARTICLES_GPU)
+	{
+		step.dt = dt;
+		stepPending = true;
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	emitCarry += emitRate * dt;
+	size_t emitCount = (size_t)emitCarry;
+	emitCarry -= (double)emitCount;
+	Emit(std::min(emitCount, capacity - liveCount), jobs);
+
+	Integrate(dt, jobs);
+	FillHoles();
+
+	cpuSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ParticleSystem::StepOnGpu()
+{
+	glUseProgram(updateProgram);
+	glUniform1f(uniformDt, step.dt);
+	glUniform3fv(uniformGravity, 1, glm::value_ptr(step.gravity));
+	glUniform1f(uniformDamping, step.Damping());
+	glUniform1ui(uniformSequence, sequence);
+	glUniform3fv(uniformEmitterPosition, 1, glm::value_ptr(emitter.position));
+	glUniform3fv(uniformEmitterExtent, 1, glm::value_ptr(emitter.extent));
+	glUniform3fv(uniformEmitterVelocity, 1, glm::value_ptr(emitter.velocity));
+	glUniform3fv(uniformEmitterSpread, 1, glm::value_ptr(emitter.spread));
+	glUniform1f(uniformEmitterLife, emitter.life);
+	glUniform1f(uniformEmitterLifeRange, emitter.life * emitter.lifeVariation);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(updateVaos[current]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateBuffers[current ^ 1]);
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)capacity);
+	glEndTransformFeedback();
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	// Every particle may have respawned, each needs its own keys next step
+	sequence += (uint32_t)capacity;
+	current ^= 1;
+	stepPending = false;
+}
+
+void ParticleSystem::Draw(const glm::mat4& projection, const glm::mat4& view, JobSystem* jobs)
+{
+	if (!drawProgram)
+		return;
+
+	size_t count = GetProcessedCount();
+	if (path == PARTICLES_CPU && count)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// Orphan the old contents so the driver never waits for the previous frame's draw
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+		void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(glm::vec4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped)
+		{
+			glm::vec4* out = (glm::vec4*)mapped;
+			ParallelFor(jobs, count, PACK_GRAIN, [&](size_t begin, size_t end, unsigned)
+			{
+				BatchMath::PackParticles(particles.Offset(begin), out + begin, end - begin);
+			});
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		cpuSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	gpuTimer.Begin();
+
+	if (stepPending)
+		StepOnGpu();
+
+	if (count)
+	{
+		glUseProgram(drawProgram);
+		glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
+		glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+		glUniform1f(uniformSize, PARTICLE_SIZE);
+
+		// Additive, so the order doesn't matter; tested against the depth buffer but never written
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		glDepthMask(GL_FALSE);
+
+		glBindVertexArray(drawVaos[path == PARTICLES_CPU ? 0 : current]);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+	gpuTimer.End();
+	particlesProcessed += (double)count;
+	++frames;
+}
+
+ParticleTimings ParticleSystem::TakeTimings()
+{
+	ParticleTimings timings;
+	timings.cpuMs = frames ? cpuSeconds * 1000.0 / frames : 0.0;
+	timings.gpuMs = gpuTimer.Collect();
+	timings.particles = frames ? particlesProcessed / frames : 0.0;
+	timings.frames = frames;
+
+	cpuSeconds = particlesProcessed = 0.0;
+	frames = 0;
+	return timings;
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	if (!drawProgram)
+		return;		// Init never got a context
+
+	GLuint buffers[] = { quadBuffer, streamBuffer, stateBuffers[0], stateBuffers[1] };
+	glDeleteBuffers(4, buffers);
+	glDeleteVertexArrays(2, drawVaos);
+	glDeleteVertexArrays(2, updateVaos);
+	glDeleteProgram(updateProgram);
+	glDeleteProgram(drawProgram);
+}
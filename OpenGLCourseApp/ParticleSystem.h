@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "BatchMath.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+
+/**	One emitter's worth of point particles, drawn as camera facing quads
+ *
+ *	Two paths with the same emitter, physics and look:
+ *
+ *		PARTICLES_CPU	- particles live in SoA arrays (BatchMath::ParticleSoA). Update
+ *						  emits, integrates, ages and kills them with the BatchMath
+ *						  kernels on the job threads, then compacts the survivors to
+ *						  the front of the arrays; Draw packs them into a mapped,
+ *						  orphaned streaming buffer and makes one instanced draw
+ *		PARTICLES_GPU	- the state lives in two buffers that a transform feedback
+ *						  pass ping-pongs between, respawning dead particles in place;
+ *						  the CPU only sets uniforms
+ *
+ *	The CPU path emits capacity / life particles a second, which over a mean life
+ *	fills the capacity; emission past it is dropped. Compaction works per chunk of
+ *	the arrays on the job threads (survivors slide down within their chunk, in
+ *	order), then moves survivors from past the new end into the holes before it,
+ *	so the serial part costs as much as the particles that died, not the ones that
+ *	live. Nothing allocates after Init.
+ *
+ *	The GPU path keeps every particle in the buffers: each one waits a share of a
+ *	life before its first birth, so emission is spread out like the CPU path's,
+ *	and is reborn from the emitter as soon as it dies.
+ *
+ *	Update and Draw both run on the GL thread; Update makes no GL calls. Works on a
+ *	GL 3.3 core context.
+ */
+
+enum ParticlePath
+{
+	PARTICLES_CPU,
+	PARTICLES_GPU
+};
+
+// Per-frame averages since the last TakeTimings
+struct ParticleTimings
+{
+	double cpuMs;			// Update + packing into the streaming buffer, 0 on the GPU path
+	double gpuMs;			// Transform feedback step (GPU path) + draw, from GL_TIME_ELAPSED queries
+	double particles;		// Processed (GetProcessedCount), not live on the GPU path
+	unsigned frames;
+};
+
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+
+	bool Init(ParticlePath particlePath, size_t maxParticles, const BatchMath::ParticleEmitter& particleEmitter,
+		const glm::vec3& gravity, float drag);
+
+	ParticlePath GetPath() const { return path; }
+	size_t GetCapacity() const { return capacity; }
+	// Particles a step simulates and draws: the live ones on the CPU path, every slot on the GPU
+	// path, which keeps the dead and the not yet born in the buffers and can't count the live ones
+	size_t GetProcessedCount() const { return path == PARTICLES_GPU ? capacity : liveCount; }
+
+	// Steps the simulation by dt. On the GPU path the step is only recorded and runs at the start of Draw
+	void Update(float dt, JobSystem* jobs);
+
+	void Draw(const glm::mat4& projection, const glm::mat4& view, JobSystem* jobs);
+
+	ParticleTimings TakeTimings();
+
+	~ParticleSystem();
+
+private:
+	void Emit(size_t count, JobSystem* jobs);
+	void Integrate(float dt, JobSystem* jobs);
+	void FillHoles();
+	void MoveParticles(size_t from, size_t to, size_t count);
+	void StepOnGpu();
+
+	ParticlePath path;
+	size_t capacity, liveCount;
+	BatchMath::ParticleEmitter emitter;
+	BatchMath::ParticleStep step;
+	double emitRate, emitCarry;
+	uint32_t sequence;			// Emitted so far, the key of the next particle's random numbers
+	bool stepPending;			// GPU path: Update ran since the last Draw
+
+	std::vector<float> storage;					// The eight arrays of particles, capacity each
+	BatchMath::ParticleSoA particles;
+	std::vector<size_t> chunkAlive;				// Survivors at the front of each chunk after Integrate
+
+	GLuint drawProgram, updateProgram, quadBuffer, streamBuffer;
+	GLuint stateBuffers[2], drawVaos[2], updateVaos[2];
+	int current;				// stateBuffers / drawVaos index holding the latest state
+	GLint uniformProjection, uniformView, uniformSize;
+	GLint uniformDt, uniformGravity, uniformDamping, uniformSequence;
+	GLint uniformEmitterPosition, uniformEmitterExtent, uniformEmitterVelocity, uniformEmitterSpread;
+	GLint uniformEmitterLife, uniformEmitterLifeRange;
+
+	double cpuSeconds, particlesProcessed;
+	GpuTimer gpuTimer;
+	unsigned frames;
+};
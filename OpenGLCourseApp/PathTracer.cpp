@@ -0,0 +1,375 @@
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	const int TILE = 16;
+	const int PACKET_SIDE = 4;
+	const int PACKET = PACKET_SIDE * PACKET_SIDE;
+	const float TWO_PI = 6.28318531f;
+	const float FAR_AWAY = 1e30f;
+
+	// Integer hash (lowbias32), seeds one stream per pixel and sample
+	unsigned Hash(unsigned x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// xorshift32 step, uniform in [0, 1)
+	float NextFloat(unsigned& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.f / 16777216.f);
+	}
+
+	// Cosine weighted direction around the unit normal n (Duff et al. orthonormal basis)
+	glm::vec3 CosineSample(const glm::vec3& n, unsigned& state)
+	{
+		float phi = TWO_PI * NextFloat(state);
+		float r2 = NextFloat(state);
+		float r = std::sqrt(r2);
+
+		float sign = n.z >= 0.f ? 1.f : -1.f;
+		float a = -1.f / (sign + n.z);
+		float b = n.x * n.y * a;
+		glm::vec3 tangent(1.f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+		glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+
+		return r * std::cos(phi) * tangent + r * std::sin(phi) * bitangent + std::sqrt(std::max(0.f, 1.f - r2)) * n;
+	}
+
+	glm::vec3 Sky(const glm::vec3& direction)
+	{
+		if (direction.y < 0.f)
+			return glm::vec3(0.25f, 0.22f, 0.2f);
+		return glm::mix(glm::vec3(0.9f, 0.9f, 0.95f), glm::vec3(0.35f, 0.55f, 0.9f), direction.y);
+	}
+
+	// The packet's rays, RaySoA points into these
+	struct PacketRays
+	{
+		float ox[PACKET], oy[PACKET], oz[PACKET];
+		float dx[PACKET], dy[PACKET], dz[PACKET];
+		float invDx[PACKET], invDy[PACKET], invDz[PACKET];
+		float tMax[PACKET];
+
+		BatchMath::RaySoA SoA()
+		{
+			BatchMath::RaySoA rays = { ox, oy, oz, dx, dy, dz, invDx, invDy, invDz, tMax };
+			return rays;
+		}
+
+		void Set(int i, const glm::vec3& origin, const glm::vec3& direction, float distance)
+		{
+			ox[i] = origin.x;
+			oy[i] = origin.y;
+			oz[i] = origin.z;
+			dx[i] = direction.x;
+			dy[i] = direction.y;
+			dz[i] = direction.z;
+			invDx[i] = 1.f / direction.x;
+			invDy[i] = 1.f / direction.y;
+			invDz[i] = 1.f / direction.z;
+			tMax[i] = distance;
+		}
+	};
+}
+
+bool TraceImage::WritePPM(const char* path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		printf("Could not write '%s'\n", path);
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<unsigned char> bytes(pixels.size() * 3);
+	for (size_t i = 0; i < pixels.size(); ++i)
+		for (int c = 0; c < 3; ++c)
+			bytes[i * 3 + c] = (unsigned char)(glm::clamp(pixels[i][c], 0.f, 1.f) * 255.f + 0.5f);
+	file.write((const char*)bytes.data(), bytes.size());
+	return (bool)file;
+}
+
+bool TraceImage::ReadPPM(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string magic;
+	int maxValue = 0;
+	file >> magic >> width >> height >> maxValue;
+	file.get();		// The single whitespace before the data
+	if (!file || magic != "P6" || maxValue != 255 || width <= 0 || height <= 0)
+	{
+		printf("'%s' is not an 8-bit binary PPM\n", path);
+		width = height = 0;
+		pixels.clear();
+		return false;
+	}
+
+	std::vector<unsigned char> bytes((size_t)width * height * 3);
+	file.read((char*)bytes.data(), bytes.size());
+	pixels.resize((size_t)width * height);
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i] = glm::vec3(bytes[i * 3], bytes[i * 3 + 1], bytes[i * 3 + 2]) * (1.f / 255.f);
+	return (bool)file;
+}
+
+ImageDifference CompareImages(const TraceImage& a, const TraceImage& b, float threshold)
+{
+	ImageDifference difference = { 0.f, 0.f, 0 };
+	if (a.width != b.width || a.height != b.height)
+	{
+		printf("Cannot compare a %dx%d image with a %dx%d one\n", a.width, a.height, b.width, b.height);
+		difference.rms = difference.maxError = 1.f;
+		difference.differingPixels = std::max(a.width * a.height, b.width * b.height);
+		return difference;
+	}
+
+	double sum = 0.0;
+	for (size_t i = 0; i < a.pixels.size(); ++i)
+	{
+		glm::vec3 error = glm::abs(a.pixels[i] - b.pixels[i]);
+		float largest = std::max(error.x, std::max(error.y, error.z));
+		sum += glm::dot(error, error);
+		difference.maxError = std::max(difference.maxError, largest);
+		if (largest > threshold)
+			++difference.differingPixels;
+	}
+
+	difference.rms = a.pixels.empty() ? 0.f : (float)std::sqrt(sum / (a.pixels.size() * 3.0));
+	return difference;
+}
+
+PathTracer::PathTracer()
+{
+}
+
+void PathTracer::SetMesh(GLuint vao, const glm::vec3* positions, const glm::vec3* vertexColours, size_t vertexCount,
+	const unsigned* indices, size_t indexCount)
+{
+	Mesh* mesh = nullptr;
+	for (size_t i = 0; i < meshes.size(); ++i)
+		if (meshes[i].vao == vao)
+			mesh = &meshes[i];
+
+	if (!mesh)
+	{
+		meshes.push_back(Mesh());
+		mesh = &meshes.back();
+		mesh->vao = vao;
+	}
+
+	mesh->positions.assign(positions, positions + vertexCount);
+	mesh->colours.assign(vertexColours, vertexColours + vertexCount);
+	mesh->indices.assign(indices, indices + indexCount);
+}
+
+void PathTracer::BuildScene(const FrameData& frame)
+{
+	corners.clear();
+	colours.clear();
+	normals.clear();
+
+	std::vector<glm::vec3> world;
+	for (size_t d = 0; d < frame.draws.size(); ++d)
+	{
+		const DrawItem& draw = frame.draws[d];
+		if (draw.pass != RENDER_PASS_MAIN)
+			continue;
+
+		const Mesh* mesh = nullptr;
+		for (size_t i = 0; i < meshes.size(); ++i)
+			if (meshes[i].vao == draw.VAO)
+				mesh = &meshes[i];
+		if (!mesh || mesh->positions.empty())
+			continue;
+
+		world.resize(mesh->positions.size());
+		BatchMath::TransformPoints(draw.model, mesh->positions.data(), world.data(), world.size());
+
+		// Same index range as glDrawElements from offset 0
+		size_t indexCount = std::min((size_t)draw.indexCount, mesh->indices.size()) / 3 * 3;
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				corners.push_back(world[mesh->indices[i + c]]);
+				colours.push_back(mesh->colours[mesh->indices[i + c]]);
+			}
+			const glm::vec3* p = &corners[corners.size() - 3];
+			glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+			float length = glm::length(n);
+			normals.push_back(length > 0.f ? n / length : glm::vec3(0.f, 1.f, 0.f));
+		}
+	}
+
+	bvh.Build(corners.data(), normals.size());
+}
+
+TraceStats PathTracer::Render(const FrameData& frame, const TraceSettings& settings, JobSystem* jobs, TraceImage& image)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	BuildScene(frame);
+
+	image.width = frame.width;
+	image.height = frame.height;
+	image.pixels.assign((size_t)frame.width * frame.height, glm::vec3(0.f));
+
+	glm::mat4 inverseViewProjection = glm::inverse(frame.projection * frame.view);
+	int tilesX = (frame.width + TILE - 1) / TILE, tilesY = (frame.height + TILE - 1) / TILE;
+
+	std::atomic<unsigned long long> rays(0);
+	JobSystem::RangeFunction body = [&](size_t begin, size_t end, unsigned)
+	{
+		unsigned long long traced = 0;
+		for (size_t tile = begin; tile < end; ++tile)
+			traced += TraceTile((int)(tile % tilesX) * TILE, (int)(tile / tilesX) * TILE, inverseViewProjection, settings, image);
+		rays += traced;
+	};
+
+	ParallelFor(jobs, (size_t)tilesX * tilesY, 1, body);
+
+	int samples = settings.mode == TRACE_PATH ? std::max(1, settings.samplesPerPixel) : 1;
+
+	TraceStats stats;
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stats.samples = (unsigned long long)frame.width * frame.height * samples;
+	stats.rays = rays;
+	stats.threads = jobs ? jobs->GetThreadCount() : 1;
+	stats.triangles = bvh.GetTriangleCount();
+	stats.nodes = bvh.GetNodeCount();
+	return stats;
+}
+
+unsigned long long PathTracer::TraceTile(int tileX, int tileY, const glm::mat4& inverseViewProjection,
+	const TraceSettings& settings, TraceImage& image) const
+{
+	bool path = settings.mode == TRACE_PATH;
+	int samples = path ? std::max(1, settings.samplesPerPixel) : 1;
+	unsigned long long traced = 0;
+
+	PacketRays packet;
+	BatchMath::RaySoA rays = packet.SoA();
+	BvhHit hits[PACKET];
+	glm::vec3 throughput[PACKET], radiance[PACKET], sum[PACKET];
+	unsigned random[PACKET];
+	bool active[PACKET];
+
+	for (int packetY = tileY; packetY < std::min(tileY + TILE, image.height); packetY += PACKET_SIDE)
+	{
+		for (int packetX = tileX; packetX < std::min(tileX + TILE, image.width); packetX += PACKET_SIDE)
+		{
+			for (int i = 0; i < PACKET; ++i)
+				sum[i] = glm::vec3(0.f);
+
+			for (int s = 0; s < samples; ++s)
+			{
+				// Camera rays from the near to the far plane, pixels off the image sit out
+				for (int i = 0; i < PACKET; ++i)
+				{
+					int x = packetX + i % PACKET_SIDE, y = packetY + i / PACKET_SIDE;
+					active[i] = x < image.width && y < image.height;
+					throughput[i] = glm::vec3(1.f);
+					radiance[i] = glm::vec3(0.f);
+					random[i] = Hash(Hash((unsigned)(y * image.width + x)) ^ (unsigned)s) | 1u;
+					if (!active[i])
+					{
+						packet.tMax[i] = -1.f;
+						continue;
+					}
+
+					float jitterX = path ? NextFloat(random[i]) : 0.5f, jitterY = path ? NextFloat(random[i]) : 0.5f;
+					glm::vec2 ndc((x + jitterX) / image.width * 2.f - 1.f, 1.f - (y + jitterY) / image.height * 2.f);
+					glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.f, 1.f);
+					glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.f, 1.f);
+					glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+					glm::vec3 span = glm::vec3(farPoint) / farPoint.w - origin;
+					float length = glm::length(span);
+					packet.Set(i, origin, span / length, length);
+				}
+
+				for (int bounce = 0; ; ++bounce)
+				{
+					bvh.Intersect(rays, PACKET, hits);
+
+					bool any = false;
+					for (int i = 0; i < PACKET; ++i)
+					{
+						if (!active[i])
+							continue;
+						++traced;
+
+						glm::vec3 direction(packet.dx[i], packet.dy[i], packet.dz[i]);
+						const BvhHit& hit = hits[i];
+						if (hit.triangle < 0)
+						{
+							if (path)
+								radiance[i] += throughput[i] * Sky(direction);
+							active[i] = false;
+							packet.tMax[i] = -1.f;
+							continue;
+						}
+
+						const glm::vec3* c = &colours[(size_t)hit.triangle * 3];
+						glm::vec3 albedo = (1.f - hit.u - hit.v) * c[0] + hit.u * c[1] + hit.v * c[2];
+						if (!path || bounce >= settings.maxBounces)
+						{
+							if (!path)
+								radiance[i] = albedo;
+							active[i] = false;
+							packet.tMax[i] = -1.f;
+							continue;
+						}
+
+						throughput[i] *= albedo;
+						glm::vec3 normal = normals[hit.triangle];
+						if (glm::dot(normal, direction) > 0.f)
+							normal = -normal;
+
+						// Intersect left tMax at the hit
+						glm::vec3 position = glm::vec3(packet.ox[i], packet.oy[i], packet.oz[i]) + direction * packet.tMax[i];
+						packet.Set(i, position + normal * 1e-4f, CosineSample(normal, random[i]), FAR_AWAY);
+						any = true;
+					}
+
+					if (!any)
+						break;
+				}
+
+				for (int i = 0; i < PACKET; ++i)
+					sum[i] += radiance[i];
+			}
+
+			for (int i = 0; i < PACKET; ++i)
+			{
+				int x = packetX + i % PACKET_SIDE, y = packetY + i / PACKET_SIDE;
+				if (x >= image.width || y >= image.height)
+					continue;
+
+				glm::vec3 value = sum[i] / (float)samples;
+				if (path)
+					value = glm::pow(value, glm::vec3(1.f / 2.2f));
+				image.pixels[(size_t)y * image.width + x] = value;
+			}
+		}
+	}
+
+	return traced;
+}
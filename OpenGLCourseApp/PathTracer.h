@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "JobSystem.h"
+#include "RenderThread.h"
+
+/**	CPU reference renderer for a FrameData, no GL context needed
+ *
+ *	Render flattens the frame's main pass draws into world space triangles (each
+ *	draw's registered mesh through its model matrix), builds a Bvh over them and
+ *	traces the image in 16x16 pixel tiles spread over the job threads. Each tile
+ *	goes as 4x4 pixel packets through Bvh::Intersect, bounce after bounce, until
+ *	every path in the packet has ended.
+ *
+ *	Two modes:
+ *		TRACE_ALBEDO	- one ray through each pixel centre, the interpolated vertex
+ *						  colour at the first hit and the clear colour (black)
+ *						  elsewhere. That is what the main shader rasterises, so
+ *						  this is the ground truth for image diffs of the GL path
+ *		TRACE_PATH		- jittered samples, diffuse bounces (albedo = vertex colour,
+ *						  cosine weighted) lit by a sky gradient, gamma encoded
+ *
+ *	Images are display values, rows top to bottom.
+ */
+
+enum TraceMode
+{
+	TRACE_ALBEDO,
+	TRACE_PATH
+};
+
+struct TraceSettings
+{
+	TraceMode mode;
+	int samplesPerPixel;		// TRACE_PATH only
+	int maxBounces;
+
+	TraceSettings()
+		: mode(TRACE_PATH), samplesPerPixel(16), maxBounces(4)
+	{
+	}
+};
+
+struct TraceStats
+{
+	double seconds;					// Scene build + trace
+	unsigned long long samples;		// Pixel samples
+	unsigned long long rays;		// Path segments
+	unsigned threads;
+	size_t triangles, nodes;
+
+	double SamplesPerSecondPerCore() const { return seconds > 0.0 ? samples / seconds / threads : 0.0; }
+};
+
+struct TraceImage
+{
+	int width, height;
+	std::vector<glm::vec3> pixels;
+
+	TraceImage() : width(0), height(0) {}
+
+	// Binary PPM, clamped to [0, 1] and rounded to 8 bits
+	bool WritePPM(const char* path) const;
+	bool ReadPPM(const char* path);
+};
+
+// Per channel, over images of the same size
+struct ImageDifference
+{
+	float rms;
+	float maxError;
+	int differingPixels;		// Any channel off by more than the threshold
+};
+
+ImageDifference CompareImages(const TraceImage& a, const TraceImage& b, float threshold = 2.f / 255.f);
+
+class PathTracer
+{
+public:
+	PathTracer();
+
+	// Geometry for the draws that use vao. The handle is only a key: without a context,
+	// pass the one the draws carry (0 when nothing was created)
+	void SetMesh(GLuint vao, const glm::vec3* positions, const glm::vec3* colours, size_t vertexCount,
+		const unsigned* indices, size_t indexCount);
+
+	// Camera from frame.projection * frame.view, size from frame.width / height
+	TraceStats Render(const FrameData& frame, const TraceSettings& settings, JobSystem* jobs, TraceImage& image);
+
+private:
+	struct Mesh
+	{
+		GLuint vao;
+		std::vector<glm::vec3> positions, colours;
+		std::vector<unsigned> indices;
+	};
+
+	void BuildScene(const FrameData& frame);
+
+	// Pixels [x, x + 16) x [y, y + 16), returns the path segments traced
+	unsigned long long TraceTile(int x, int y, const glm::mat4& inverseViewProjection, const TraceSettings& settings,
+		TraceImage& image) const;
+
+	std::vector<Mesh> meshes;
+
+	// Scene of the last Render, three of each per triangle but the normals
+	std::vector<glm::vec3> corners, colours, normals;
+	Bvh bvh;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/**	Fixed point encodings for animation data
+ *
+ *	Quaternions use "smallest three" in 48 bits: q and -q are the same rotation,
+ *	so the largest component is made positive and dropped, and the other three
+ *	(each within +-1/sqrt(2)) are stored in 15 bits. The dropped component's
+ *	index goes in the top bits of the first two words:
+ *
+ *		a = x0 | (index & 1) << 15
+ *		b = x1 | (index >> 1) << 15
+ *		c = x2
+ *
+ *	where x0..x2 are the remaining components in x, y, z, w order. The largest
+ *	component is rebuilt as sqrt(1 - x0^2 - x1^2 - x2^2); the result is within
+ *	1e-4 rad of the input.
+ *
+ *	Ranged values are 16 bits spread evenly over [offset, offset + extent].
+ *
+ *	BatchMath::UnpackQuats and BlendQuantized decode whole arrays of both.
+ */
+
+namespace Quantize
+{
+	const float QUAT48_RANGE = 0.707106781f;				// Largest stored component
+	const float QUAT48_STEP = 2.f * QUAT48_RANGE / 32767.f;
+
+	inline uint16_t PackQuat15(float v)
+	{
+		float q = std::floor((v + QUAT48_RANGE) / QUAT48_STEP + 0.5f);
+		return (uint16_t)(q < 0.f ? 0.f : (q > 32767.f ? 32767.f : q));
+	}
+
+	inline void PackQuat48(const glm::quat& q, uint16_t& a, uint16_t& b, uint16_t& c)
+	{
+		float v[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+		for (int i = 1; i < 4; ++i)
+			if (std::fabs(v[i]) > std::fabs(v[largest]))
+				largest = i;
+
+		float sign = v[largest] < 0.f ? -1.f : 1.f;
+		uint16_t packed[3];
+		for (int i = 0, n = 0; i < 4; ++i)
+			if (i != largest)
+				packed[n++] = PackQuat15(v[i] * sign);
+
+		a = (uint16_t)(packed[0] | (largest & 1) << 15);
+		b = (uint16_t)(packed[1] | (largest >> 1) << 15);
+		c = packed[2];
+	}
+
+	inline glm::quat UnpackQuat48(uint16_t a, uint16_t b, uint16_t c)
+	{
+		float x0 = (a & 0x7FFF) * QUAT48_STEP - QUAT48_RANGE;
+		float x1 = (b & 0x7FFF) * QUAT48_STEP - QUAT48_RANGE;
+		float x2 = c * QUAT48_STEP - QUAT48_RANGE;
+		float d = 1.f - x0 * x0 - x1 * x1 - x2 * x2;
+		float largest = std::sqrt(d > 0.f ? d : 0.f);
+
+		// glm::quat takes w first
+		switch ((a >> 15) | (b >> 15) << 1)
+		{
+		case 0:		return glm::quat(x2, largest, x0, x1);
+		case 1:		return glm::quat(x2, x0, largest, x1);
+		case 2:		return glm::quat(x2, x0, x1, largest);
+		default:	return glm::quat(largest, x0, x1, x2);
+		}
+	}
+
+	inline float RangeScale(float extent)
+	{
+		return extent / 65535.f;
+	}
+
+	inline uint16_t PackRanged(float v, float offset, float extent)
+	{
+		if (extent <= 0.f)
+			return 0;
+		float q = std::floor((v - offset) / RangeScale(extent) + 0.5f);
+		return (uint16_t)(q < 0.f ? 0.f : (q > 65535.f ? 65535.f : q));
+	}
+
+	inline float UnpackRanged(uint16_t q, float offset, float extent)
+	{
+		return offset + q * RangeScale(extent);
+	}
+}
@@ -0,0 +1,80 @@
+#include "Random.h"
+
+namespace
+{
+	// xoshiro128 jump polynomials: 2^64 and 2^96 steps
+	const uint32_t JUMP[4] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+	const uint32_t LONG_JUMP[4] = { 0xb523952e, 0x0b6f099f, 0xccf5a0ef, 0x1c580662 };
+
+	uint64_t SplitMix64(uint64_t& x)
+	{
+		uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	uint32_t Rotl(uint32_t x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	void Step(uint32_t s[4])
+	{
+		uint32_t t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = Rotl(s[3], 11);
+	}
+
+	void Jump(uint32_t s[4], const uint32_t polynomial[4])
+	{
+		uint32_t jumped[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int b = 0; b < 32; ++b)
+			{
+				if (polynomial[i] & (1u << b))
+				{
+					for (int w = 0; w < 4; ++w)
+						jumped[w] ^= s[w];
+				}
+				Step(s);
+			}
+		}
+		for (int w = 0; w < 4; ++w)
+			s[w] = jumped[w];
+	}
+}
+
+RandomStream::RandomStream(uint64_t seed, uint64_t stream)
+{
+	Seed(seed, stream);
+}
+
+void RandomStream::Seed(uint64_t seed, uint64_t stream)
+{
+	uint64_t mix = seed;
+	uint64_t a = SplitMix64(mix), b = SplitMix64(mix);
+	uint32_t s[4] = { (uint32_t)a, (uint32_t)(a >> 32), (uint32_t)b, (uint32_t)(b >> 32) };
+
+	// All zero is the one state xoshiro never leaves
+	if (!(s[0] | s[1] | s[2] | s[3]))
+		s[0] = 1;
+
+	for (uint64_t n = 0; n < stream; ++n)
+		Jump(s, LONG_JUMP);
+
+	for (int j = 0; j < BatchMath::RANDOM_LANES; ++j)
+	{
+		if (j)
+			Jump(s, JUMP);
+		for (int w = 0; w < 4; ++w)
+			state.s[w][j] = s[w];
+	}
+
+	buffered = BatchMath::RANDOM_LANES;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "BatchMath.h"
+
+/**	Seeded stream of random numbers, filled in bulk by the BatchMath random kernels
+ *
+ *	A stream is BatchMath::RANDOM_LANES xoshiro128** generators (period 2^128 - 1
+ *	each) run side by side. The seed goes through SplitMix64 into the first
+ *	generator; each of the others is the one before it jumped ahead 2^64 steps,
+ *	and stream n starts 2^96 steps past stream n - 1, so no two lanes of any two
+ *	streams of a seed overlap within 2^64 numbers each. Constructing stream n
+ *	costs n long jumps.
+ *
+ *	Not thread safe; give each job thread its own stream, indexed by the worker
+ *	argument of the job (RandomStream(seed, worker)). The same seed and stream
+ *	give the same numbers at every SIMD level, to FMA rounding.
+ *
+ *	The fills are meant for arrays. Each call uses whole steps of the generators
+ *	(RANDOM_LANES numbers, twice that for Gaussian), so splitting one fill in two
+ *	calls can give different numbers. Next hands out single values from a
+ *	buffered fill, for code that draws one at a time.
+ */
+
+class RandomStream
+{
+public:
+	explicit RandomStream(uint64_t seed = 0, uint64_t stream = 0);
+
+	void Seed(uint64_t seed, uint64_t stream = 0);
+
+	void Bits(uint32_t* out, size_t count) { BatchMath::RandomBits(state, out, count); }
+
+	// [low, high)
+	void Uniform(float low, float high, float* out, size_t count) { BatchMath::RandomUniform(state, low, high, out, count); }
+
+	void Gaussian(float mean, float deviation, float* out, size_t count) { BatchMath::RandomGaussian(state, mean, deviation, out, count); }
+
+	// Points on the sphere, as glm::sphericalRand
+	void Sphere(float radius, float* x, float* y, float* z, size_t count) { BatchMath::RandomSphere(state, radius, x, y, z, count); }
+
+	// Points inside the disk, as glm::diskRand
+	void Disk(float radius, float* x, float* y, size_t count) { BatchMath::RandomDisk(state, radius, x, y, count); }
+
+	// One value in [0, 1)
+	float Next()
+	{
+		if (buffered == BatchMath::RANDOM_LANES)
+		{
+			Uniform(0.f, 1.f, buffer, BatchMath::RANDOM_LANES);
+			buffered = 0;
+		}
+		return buffer[buffered++];
+	}
+
+	const BatchMath::RandomState& GetState() const { return state; }
+
+private:
+	BatchMath::RandomState state;
+	float buffer[BatchMath::RANDOM_LANES];
+	int buffered;
+};
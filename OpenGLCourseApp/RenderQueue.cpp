@@ -0,0 +1,279 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "JobSystem.h"
+
+static const int DEPTH_BITS = 24;
+static const int VAO_BITS = 12;
+static const int MATERIAL_BITS = 12;
+static const int PROGRAM_BITS = 10;
+
+static inline uint64_t Field(uint64_t value, int bits)
+{
+	return value & ((uint64_t(1) << bits) - 1);
+}
+
+RenderQueue::RenderQueue()
+{
+	nearPlane = 0.1f;
+	farPlane = 100.f;
+	materialBinder = nullptr;
+	materialUser = nullptr;
+	sortedStats = RenderStats();
+}
+
+void RenderQueue::SetDepthRange(float nearZ, float farZ)
+{
+	nearPlane = nearZ;
+	farPlane = farZ;
+}
+
+void RenderQueue::SetMaterialBinder(MaterialBinder binder, void* user)
+{
+	materialBinder = binder;
+	materialUser = user;
+}
+
+void RenderQueue::Clear()
+{
+	items.clear();
+	keys.clear();
+	order.clear();
+}
+
+void RenderQueue::Submit(const DrawItem& item)
+{
+	order.push_back((uint32_t)items.size());
+	keys.push_back(MakeKey(item, nearPlane, farPlane));
+	items.push_back(item);
+}
+
+uint64_t RenderQueue::MakeKey(const DrawItem& item, float nearZ, float farZ)
+{
+	float t = glm::clamp((item.viewDepth - nearZ) / (farZ - nearZ), 0.f, 1.f);
+	uint64_t depth = (uint64_t)(t * float((1 << DEPTH_BITS) - 1));
+
+	uint64_t state = Field(item.program, PROGRAM_BITS);
+	state = (state << MATERIAL_BITS) | Field(item.material, MATERIAL_BITS);
+	state = (state << VAO_BITS) | Field(item.VAO, VAO_BITS);
+
+	uint64_t key = Field(item.pass, 4);
+	key = (key << 1) | (item.translucent ? 1 : 0);
+
+	if (item.translucent)
+	{
+		// Back to front first, state only breaks ties
+		key = (key << DEPTH_BITS) | (((uint64_t(1) << DEPTH_BITS) - 1) - depth);
+		key = (key << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS)) | state;
+	}
+	else
+	{
+		key = (key << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS)) | state;
+		key = (key << DEPTH_BITS) | depth;
+	}
+
+	return key;
+}
+
+void RenderQueue::RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, JobSystem* jobs, size_t parallelThreshold)
+{
+	size_t count = keys.size();
+	if (count < 2)
+		return;
+
+	// Bytes that are equal across all keys would be identity passes, skip them
+	uint64_t differing = 0;
+	for (size_t i = 1; i < count; ++i)
+		differing |= keys[i] ^ keys[0];
+
+	size_t chunkCount = 1;
+	if (jobs && count >= parallelThreshold)
+		chunkCount = jobs->GetThreadCount();
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	std::vector<uint64_t> keyScratch(count);
+	std::vector<uint32_t> valueScratch(count);
+	std::vector<size_t> offsets(256 * chunkCount);
+
+	uint64_t* srcKeys = keys.data();
+	uint32_t* srcValues = values.data();
+	uint64_t* dstKeys = keyScratch.data();
+	uint32_t* dstValues = valueScratch.data();
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		if (((differing >> shift) & 0xFF) == 0)
+			continue;
+
+		// Histogram per chunk
+		auto histogram = [&](size_t chunk, size_t end, unsigned)
+		{
+			for (; chunk < end; ++chunk)
+			{
+				size_t* counts = &offsets[chunk * 256];
+				std::fill(counts, counts + 256, 0);
+				size_t last = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < last; ++i)
+					++counts[(srcKeys[i] >> shift) & 0xFF];
+			}
+		};
+
+		// Exclusive prefix over (bucket, chunk) keeps the sort stable
+		auto scatter = [&](size_t chunk, size_t end, unsigned)
+		{
+			for (; chunk < end; ++chunk)
+			{
+				size_t* next = &offsets[chunk * 256];
+				size_t last = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < last; ++i)
+				{
+					size_t slot = next[(srcKeys[i] >> shift) & 0xFF]++;
+					dstKeys[slot] = srcKeys[i];
+					dstValues[slot] = srcValues[i];
+				}
+			}
+		};
+
+		if (chunkCount > 1)
+			jobs->ParallelFor(chunkCount, 1, JobSystem::RangeFunction(histogram));
+		else
+			histogram(0, 1, 0);
+
+		size_t sum = 0;
+		for (size_t bucket = 0; bucket < 256; ++bucket)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				size_t bucketCount = offsets[chunk * 256 + bucket];
+				offsets[chunk * 256 + bucket] = sum;
+				sum += bucketCount;
+			}
+		}
+
+		if (chunkCount > 1)
+			jobs->ParallelFor(chunkCount, 1, JobSystem::RangeFunction(scatter));
+		else
+			scatter(0, 1, 0);
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+	}
+
+	if (srcKeys != keys.data())
+	{
+		std::copy(srcKeys, srcKeys + count, keys.data());
+		std::copy(srcValues, srcValues + count, values.data());
+	}
+}
+
+void RenderQueue::Sort(JobSystem* jobs, size_t parallelThreshold)
+{
+	RadixSort(keys, order, jobs, parallelThreshold);
+}
+
+void RenderQueue::Execute()
+{
+	sortedStats = CountStateChanges(items, order.data());
+
+	GLuint boundProgram = 0, boundMaterial = 0, boundVAO = 0;
+	bool first = true;
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const DrawItem& item = items[order[i]];
+
+		if (first || item.program != boundProgram)
+		{
+			glUseProgram(item.program);
+			boundProgram = item.program;
+		}
+
+		if ((first || item.material != boundMaterial) && materialBinder)
+		{
+			materialBinder(item.material, materialUser);
+			boundMaterial = item.material;
+		}
+
+		if (first || item.VAO != boundVAO)
+		{
+			glBindVertexArray(item.VAO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, item.IBO);
+			boundVAO = item.VAO;
+		}
+		first = false;
+
+		// Params: model location; amount; transpose; pointer to the value;
+		glUniformMatrix4fv(item.uniformModel, 1, GL_FALSE, glm::value_ptr(item.model));
+		glDrawElements(GL_TRIANGLES, item.indexCount, GL_UNSIGNED_INT, 0);
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+void RenderQueue::ExecuteRecorded(JobSystem* jobs)
+{
+	unsigned slotCount = jobs ? jobs->GetWorkerSlotCount() : 1;
+	if (recorders.size() < slotCount)
+		recorders.resize(slotCount);
+	for (size_t i = 0; i < recorders.size(); ++i)
+		recorders[i].Reset();
+
+	// keys[i] always belongs to items[order[i]], sorted or not
+	auto record = [this](size_t begin, size_t end, unsigned worker)
+	{
+		CommandBuffer& buffer = recorders[worker];
+		for (size_t i = begin; i < end; ++i)
+		{
+			const DrawItem& item = items[order[i]];
+			buffer.BeginPacket(keys[i]);
+			buffer.BindProgram(item.program);
+			buffer.BindMaterial(item.material);
+			buffer.BindVertexArray(item.VAO, item.IBO);
+			buffer.UniformMatrix4(item.uniformModel, item.model);
+			buffer.DrawElements(GL_TRIANGLES, item.indexCount, 0);
+		}
+	};
+
+	ParallelFor(jobs, items.size(), 256, record);
+
+	CommandStats replayed = CommandBuffer::Replay(recorders, jobs, materialBinder, materialUser);
+	sortedStats.draws = replayed.draws;
+	sortedStats.programChanges = replayed.programBinds;
+	sortedStats.materialChanges = replayed.materialBinds;
+	sortedStats.vaoChanges = replayed.vertexArrayBinds;
+}
+
+RenderStats RenderQueue::GetUnsortedStats() const
+{
+	std::vector<uint32_t> submitted(items.size());
+	for (size_t i = 0; i < submitted.size(); ++i)
+		submitted[i] = (uint32_t)i;
+
+	return CountStateChanges(items, submitted.data());
+}
+
+RenderStats RenderQueue::CountStateChanges(const std::vector<DrawItem>& items, const uint32_t* order)
+{
+	RenderStats stats = RenderStats();
+	stats.draws = (unsigned)items.size();
+
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		const DrawItem& item = items[order[i]];
+		const DrawItem* previous = i ? &items[order[i - 1]] : nullptr;
+
+		if (!previous || item.program != previous->program) ++stats.programChanges;
+		if (!previous || item.material != previous->material) ++stats.materialChanges;
+		if (!previous || item.VAO != previous->VAO) ++stats.vaoChanges;
+	}
+
+	return stats;
+}
+
+RenderQueue::~RenderQueue()
+{
+}
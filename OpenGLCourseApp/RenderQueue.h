@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "CommandBuffer.h"
+
+class JobSystem;
+
+/**	Sorted draw submission
+ *
+ *	Every draw is packed into one 64-bit key, most significant bits first:
+ *
+ *		opaque:			pass(4) | 0 | program(10) | material(12) | VAO(12) | depth(24)
+ *		translucent:	pass(4) | 1 | inverted depth(24) | program(10) | material(12) | VAO(12)
+ *
+ *	so a plain ascending sort groups opaque draws by state and runs them front to
+ *	back, while translucent ones stay back to front. Object names are truncated to
+ *	their field width, a clash only costs an extra state change, never a wrong draw.
+ */
+
+enum RenderPass
+{
+	RENDER_PASS_SHADOW = 0,
+	RENDER_PASS_MAIN = 1,
+	RENDER_PASS_UI = 15
+};
+
+struct DrawItem
+{
+	GLuint program;
+	GLuint material;
+	GLuint VAO;
+	GLuint IBO;
+	GLsizei indexCount;
+	GLint uniformModel;
+	glm::mat4 model;
+	float viewDepth;		// Distance along the view direction
+	unsigned char pass;
+	bool translucent;
+};
+
+struct RenderStats
+{
+	unsigned draws;
+	unsigned programChanges;
+	unsigned materialChanges;
+	unsigned vaoChanges;
+
+	unsigned StateChanges() const { return programChanges + materialChanges + vaoChanges; }
+};
+
+class RenderQueue
+{
+public:
+	typedef void (*MaterialBinder)(GLuint material, void* user);
+
+	RenderQueue();
+
+	void SetDepthRange(float nearPlane, float farPlane);
+	void SetMaterialBinder(MaterialBinder binder, void* user);
+
+	void Clear();
+	void Submit(const DrawItem& item);
+
+	// Queue at or above this size is sorted across the job threads
+	void Sort(JobSystem* jobs = nullptr, size_t parallelThreshold = 1u << 16);
+	void Execute();
+	// Job threads record the queue into per-thread command buffers, the GL thread
+	// merges them by key and replays, so Sort() is optional before this
+	void ExecuteRecorded(JobSystem* jobs);
+
+	// State changes the same draws cost in submission order vs sorted order
+	RenderStats GetUnsortedStats() const;
+	RenderStats GetSortedStats() const { return sortedStats; }
+
+	static uint64_t MakeKey(const DrawItem& item, float nearPlane, float farPlane);
+	// Stable LSD radix sort of keys, values (item indices) follow their keys
+	static void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, JobSystem* jobs, size_t parallelThreshold);
+
+	~RenderQueue();
+
+private:
+	static RenderStats CountStateChanges(const std::vector<DrawItem>& items, const uint32_t* order);
+
+	std::vector<DrawItem> items;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+	std::vector<CommandBuffer> recorders;
+
+	float nearPlane, farPlane;
+	MaterialBinder materialBinder;
+	void* materialUser;
+	RenderStats sortedStats;
+};
@@ -0,0 +1,186 @@
+#include "RenderThread.h"
+
+#include <chrono>
+#include <cstdio>
+
+OverlapTimer::OverlapTimer()
+{
+	busy[0] = busy[1] = false;
+	busySince[0] = busySince[1] = 0.0;
+	busyTotal[0] = busyTotal[1] = 0.0;
+	overlapSince = overlapTotal = 0.0;
+	windowStart = Now();
+	frames = 0;
+}
+
+double OverlapTimer::Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void OverlapTimer::Begin(Thread which)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	double now = Now();
+
+	busy[which] = true;
+	busySince[which] = now;
+	if (busy[0] && busy[1])
+		overlapSince = now;
+}
+
+void OverlapTimer::End(Thread which)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	double now = Now();
+
+	if (!busy[which])
+		return;
+	if (busy[0] && busy[1])
+		overlapTotal += now - overlapSince;
+
+	busy[which] = false;
+	busyTotal[which] += now - busySince[which];
+}
+
+void OverlapTimer::FrameDone()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	++frames;
+}
+
+OverlapTimer::Report OverlapTimer::TakeReport()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	double now = Now();
+
+	// Close the open intervals at the report boundary
+	Report report;
+	for (int i = 0; i < 2; ++i)
+	{
+		report.busy[i] = busyTotal[i] + (busy[i] ? now - busySince[i] : 0.0);
+		busyTotal[i] = 0.0;
+		busySince[i] = now;
+	}
+	report.overlap = overlapTotal + (busy[0] && busy[1] ? now - overlapSince : 0.0);
+	report.wall = now - windowStart;
+	report.frames = frames;
+
+	overlapTotal = 0.0;
+	overlapSince = now;
+	windowStart = now;
+	frames = 0;
+
+	return report;
+}
+
+RenderThread::RenderThread()
+{
+	window = nullptr;
+	render = nullptr;
+	user = nullptr;
+	running = false;
+}
+
+bool RenderThread::Start(GLFWwindow* theWindow, int frameLatency, RenderFunction renderFunction, void* userData)
+{
+	if (running)
+		return false;
+
+	if (frameLatency < 2 || frameLatency > 4)
+	{
+		printf("Frame latency %d out of range, using 2\n", frameLatency);
+		frameLatency = 2;
+	}
+
+	window = theWindow;
+	render = renderFunction;
+	user = userData;
+
+	frames.resize(frameLatency);
+	for (size_t i = 0; i < frames.size(); ++i)
+		freeFrames.TryPush(&frames[i]);
+
+	glfwMakeContextCurrent(NULL);
+
+	running = true;
+	thread = std::thread(&RenderThread::Run, this);
+	return true;
+}
+
+FrameData* RenderThread::AcquireFrame()
+{
+	FrameData* frame = nullptr;
+	if (freeFrames.TryPop(frame))
+		return frame;
+
+	// The pusher notifies under the same mutex, so a push after the failed pop can't be missed
+	std::unique_lock<std::mutex> lock(signalMutex);
+	frameFreed.wait(lock, [this, &frame] { return freeFrames.TryPop(frame); });
+	return frame;
+}
+
+void RenderThread::SubmitFrame(FrameData* frame)
+{
+	// Never fails, there are only as many frames as queue slots
+	readyFrames.TryPush(frame);
+
+	std::lock_guard<std::mutex> lock(signalMutex);
+	frameReady.notify_one();
+}
+
+void RenderThread::Run()
+{
+	glfwMakeContextCurrent(window);
+
+	FrameData* frame = nullptr;
+	while (running)
+	{
+		if (!readyFrames.TryPop(frame))
+		{
+			std::unique_lock<std::mutex> lock(signalMutex);
+			frameReady.wait(lock, [this, &frame] { return !running || readyFrames.TryPop(frame); });
+			if (!running)
+				break;
+		}
+
+		timer.Begin(OverlapTimer::RENDER);
+			render(*frame, user);
+			glfwSwapBuffers(window);
+		timer.End(OverlapTimer::RENDER);
+		timer.FrameDone();
+
+		freeFrames.TryPush(frame);
+		{
+			std::lock_guard<std::mutex> lock(signalMutex);
+			frameFreed.notify_one();
+		}
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+void RenderThread::Stop()
+{
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(signalMutex);
+		running = false;
+	}
+	frameReady.notify_one();
+	thread.join();
+
+	// Whatever was still queued is dropped, the slots go back to the free list
+	FrameData* frame = nullptr;
+	while (readyFrames.TryPop(frame))
+		freeFrames.TryPush(frame);
+
+	glfwMakeContextCurrent(window);
+}
+
+RenderThread::~RenderThread()
+{
+	Stop();
+}
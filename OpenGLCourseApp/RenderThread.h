@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "RenderQueue.h"
+#include "SpscQueue.h"
+#include "Transform.h"
+
+/**	Everything the render side needs from one simulated frame
+ *
+ *	Slots are recycled, so the vectors keep their capacity between frames.
+ */
+struct FrameData
+{
+	unsigned long long frameIndex;
+	glm::mat4 projection;
+	glm::mat4 view;
+	uint64_t inputTime;		// glfwGetTimerValue of the camera sample behind view
+	int width, height;
+	std::vector<DrawItem> draws;
+	std::vector<Affine3x4> skinPalettes;		// Every skinned character's joints, back to back
+	glm::dvec3 terrainViewer;
+};
+
+/**	Measures how long the simulation and render threads are busy, and for how
+ *	long both are busy at the same time.
+ */
+class OverlapTimer
+{
+public:
+	enum Thread
+	{
+		SIMULATION = 0,
+		RENDER = 1
+	};
+
+	struct Report
+	{
+		double wall;		// Seconds since the last report
+		double busy[2];
+		double overlap;
+		unsigned frames;
+	};
+
+	OverlapTimer();
+
+	void Begin(Thread thread);
+	void End(Thread thread);
+	void FrameDone();
+
+	Report TakeReport();		// Resets the counters
+
+private:
+	static double Now();
+
+	std::mutex mutex;
+	bool busy[2];
+	double busySince[2];
+	double busyTotal[2];
+	double overlapSince;
+	double overlapTotal;
+	double windowStart;
+	unsigned frames;
+};
+
+/**	Owns the GL context on its own thread
+ *
+ *	The main thread simulates frame N+1 into a free FrameData while this thread
+ *	renders frame N. Frames travel through lock-free SPSC queues, the number of
+ *	slots (2 = double, 3 = triple buffering) is the frame latency and caps how far
+ *	the simulation may run ahead. A side that finds its queue empty sleeps on a
+ *	condition variable until the other side pushes. glfwPollEvents stays on the
+ *	main thread.
+ */
+class RenderThread
+{
+public:
+	typedef void (*RenderFunction)(const FrameData& frame, void* user);
+
+	RenderThread();
+
+	// Releases the context from the calling thread and hands it to the render thread
+	bool Start(GLFWwindow* window, int frameLatency, RenderFunction render, void* user);
+	// Hands the context back to the calling thread
+	void Stop();
+
+	// Blocks while every slot is still queued or being rendered
+	FrameData* AcquireFrame();
+	void SubmitFrame(FrameData* frame);
+
+	bool IsRunning() const { return running; }
+	OverlapTimer& GetTimer() { return timer; }
+
+	~RenderThread();
+
+private:
+	void Run();
+
+	GLFWwindow* window;
+	RenderFunction render;
+	void* user;
+
+	std::vector<FrameData> frames;
+	SpscQueue<FrameData*> readyFrames;
+	SpscQueue<FrameData*> freeFrames;
+
+	// Only for sleeping on an empty queue, the queues themselves stay lock-free
+	std::mutex signalMutex;
+	std::condition_variable frameFreed;
+	std::condition_variable frameReady;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	OverlapTimer timer;
+};
@@ -0,0 +1,59 @@
+#include "ShaderUtil.h"
+
+#include <cstdio>
+
+bool AttachShader(GLuint program, const char* code, GLenum type)
+{
+	GLuint theShader = glCreateShader(type);
+	glShaderSource(theShader, 1, &code, NULL);
+	glCompileShader(theShader);
+
+	GLint result = 0;
+	GLchar eLog[1024] = { 0 };
+	glGetShaderiv(theShader, GL_COMPILE_STATUS, &result);
+	if (!result)
+	{
+		glGetShaderInfoLog(theShader, sizeof(eLog), NULL, eLog);
+		printf("Error compiling the %d shader: '%s'\n", type, eLog);
+		glDeleteShader(theShader);
+		return false;
+	}
+
+	glAttachShader(program, theShader);
+	glDeleteShader(theShader);		// Freed with the program
+	return true;
+}
+
+GLuint LinkProgram(const char* first, GLenum firstType, const char* second, GLenum secondType,
+	const char* const* varyings, GLsizei varyingCount)
+{
+	GLuint program = glCreateProgram();
+	if (!program)
+	{
+		printf("\nError creating shader!\n");
+		return 0;
+	}
+
+	if (!AttachShader(program, first, firstType) || (second && !AttachShader(program, second, secondType)))
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	if (varyingCount)
+		glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+
+	GLint result = 0;
+	GLchar eLog[1024] = { 0 };
+	glLinkProgram(program);
+	glGetProgramiv(program, GL_LINK_STATUS, &result);
+	if (!result)
+	{
+		glGetProgramInfoLog(program, sizeof(eLog), NULL, eLog);
+		printf("Error linking program: '%s'\n", eLog);
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <GL/glew.h>
+
+/**	Shader program helpers shared by the GL subsystems
+ *
+ *	LinkProgram compiles one or two stages from source and links them, printing
+ *	the compile or link log and returning 0 on failure. A single vertex stage with
+ *	varyings links for transform feedback, the varyings captured interleaved into
+ *	one buffer.
+ */
+
+// Compiles code and attaches it to program, the shader object goes with the program
+bool AttachShader(GLuint program, const char* code, GLenum type);
+
+GLuint LinkProgram(const char* first, GLenum firstType, const char* second = NULL, GLenum secondType = 0,
+	const char* const* varyings = NULL, GLsizei varyingCount = 0);
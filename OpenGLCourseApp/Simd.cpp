@@ -0,0 +1,93 @@
+#include "Simd.h"
+
+#if SIMD_X86 && defined(_MSC_VER) && !defined(__clang__)
+	#include <intrin.h>
+#elif SIMD_X86
+	#include <cpuid.h>
+#endif
+
+#if SIMD_X86
+static void Cpuid(int leaf, int subLeaf, unsigned regs[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuidex(info, leaf, subLeaf);
+	for (int i = 0; i < 4; ++i)
+		regs[i] = (unsigned)info[i];
+#else
+	__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long ReadXcr0()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	return _xgetbv(0);
+#else
+	unsigned lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+static CpuFeatures DetectCpuFeatures()
+{
+	CpuFeatures features = CpuFeatures();
+
+#if SIMD_X86
+	unsigned regs[4];
+	Cpuid(0, 0, regs);
+	unsigned maxLeaf = regs[0];
+
+	Cpuid(1, 0, regs);
+	features.sse41 = (regs[2] & (1u << 19)) != 0;
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	bool fma = (regs[2] & (1u << 12)) != 0;
+	bool f16c = (regs[2] & (1u << 29)) != 0;
+
+	// The OS has to save YMM (bits 1-2) and ZMM (bits 5-7) state for us
+	unsigned long long xcr0 = osxsave ? ReadXcr0() : 0;
+	bool ymmState = (xcr0 & 0x06) == 0x06;
+	bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+	features.avx = avx && ymmState;
+	features.fma = fma && features.avx;
+	features.f16c = f16c && features.avx;
+
+	if (maxLeaf >= 7)
+	{
+		Cpuid(7, 0, regs);
+		features.avx2 = features.avx && (regs[1] & (1u << 5)) != 0;
+		features.avx512f = zmmState && (regs[1] & (1u << 16)) != 0;
+	}
+#endif
+
+	return features;
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
+
+SimdLevel CpuFeatures::BestLevel() const
+{
+	if (avx512f && avx2 && fma && f16c) return SIMD_AVX512;
+	if (avx2 && fma && f16c) return SIMD_AVX2;
+	if (sse41) return SIMD_SSE4;
+	return SIMD_SCALAR;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_SSE4: return "SSE4.1";
+	case SIMD_AVX2: return "AVX2";
+	case SIMD_AVX512: return "AVX-512";
+	default: return "scalar";
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/**	x86 SIMD helpers shared by the batch kernels
+ *
+ *	Kernels for instruction sets above the build's baseline are compiled per
+ *	function (SIMD_TARGET_*) rather than per file, so inline GLM code pulled into
+ *	the same translation unit never gets built with AVX by accident. They may only
+ *	be called after GetCpuFeatures() says the host has them.
+ */
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define SIMD_X86 1
+	#include <immintrin.h>
+#else
+	#define SIMD_X86 0
+#endif
+
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+	#define SIMD_TARGET_SSE4 __attribute__((target("sse4.1")))
+	#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+	#define SIMD_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+	#define SIMD_TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+	// MSVC lets any function use any intrinsic
+	#define SIMD_TARGET_SSE4
+	#define SIMD_TARGET_AVX2
+	#define SIMD_TARGET_AVX512
+	#define SIMD_TARGET_F16C
+#endif
+
+enum SimdLevel
+{
+	SIMD_SCALAR = 0,
+	SIMD_SSE4 = 1,
+	SIMD_AVX2 = 2,		// Includes FMA and F16C
+	SIMD_AVX512 = 3
+};
+
+struct CpuFeatures
+{
+	bool sse41;
+	bool avx;
+	bool avx2;
+	bool fma;
+	bool f16c;
+	bool avx512f;
+
+	SimdLevel BestLevel() const;
+};
+
+// Detected on first use, OS support for the wider registers included
+const CpuFeatures& GetCpuFeatures();
+
+const char* SimdLevelName(SimdLevel level);
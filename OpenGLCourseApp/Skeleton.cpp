@@ -0,0 +1,205 @@
+#include "Skeleton.h"
+
+#include <cmath>
+
+Skeleton::Skeleton()
+{
+}
+
+int Skeleton::AddJoint(int parent, const Affine3x4& bindPose)
+{
+	parents.push_back(parent);
+	inverseBind.push_back(Transform::InverseAffine(bindPose));
+	return (int)parents.size() - 1;
+}
+
+void Skeleton::LocalToModel(const Affine3x4& placement, const Affine3x4* local, Affine3x4* model) const
+{
+	// Each step depends on the parent's result, so this stays scalar
+	for (size_t j = 0; j < parents.size(); ++j)
+	{
+		int parent = parents[j];
+		model[j] = Transform::Multiply(parent < 0 ? placement : model[parent], local[j]);
+	}
+}
+
+void Skeleton::ModelToPalette(const Affine3x4* model, Affine3x4* palette) const
+{
+	BatchMath::MultiplyAffine(model, &inverseBind[0], palette, parents.size());
+}
+
+AnimationClip::AnimationClip()
+	: jointCount(0), keyCount(1), sampleRate(30.f)
+{
+}
+
+AnimationClip::AnimationClip(int jointCount, int keyCount, float sampleRate)
+	: jointCount(jointCount), keyCount(keyCount), sampleRate(sampleRate)
+{
+	size_t size = (size_t)jointCount * keyCount;
+	rotationX.assign(size, 0.f);
+	rotationY.assign(size, 0.f);
+	rotationZ.assign(size, 0.f);
+	rotationW.assign(size, 1.f);
+	translations.assign(size, glm::vec3(0.f));
+	scales.assign(size, glm::vec3(1.f));
+}
+
+void AnimationClip::SetKey(int key, int joint, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	size_t i = (size_t)key * jointCount + joint;
+	rotationX[i] = rotation.x;
+	rotationY[i] = rotation.y;
+	rotationZ[i] = rotation.z;
+	rotationW[i] = rotation.w;
+	translations[i] = translation;
+	scales[i] = scale;
+}
+
+void AnimationClip::Locate(float time, int& keyA, int& keyB, float& t) const
+{
+	float position = time * sampleRate;
+	float wrapped = position - std::floor(position / keyCount) * keyCount;
+
+	keyA = (int)wrapped;
+	if (keyA >= keyCount)		// wrapped can round up to keyCount
+		keyA = 0;
+	keyB = keyA + 1 < keyCount ? keyA + 1 : 0;
+	t = wrapped - (float)(int)wrapped;
+}
+
+size_t AnimationClip::GetSize() const
+{
+	return (size_t)jointCount * keyCount * (4 * sizeof(float) + 2 * sizeof(glm::vec3));
+}
+
+void AnimationClip::Sample(float time, PoseScratch& scratch) const
+{
+	if ((int)scratch.local.size() < jointCount)
+		scratch.Resize(jointCount);
+
+	int keyA, keyB;
+	float t;
+	Locate(time, keyA, keyB, t);
+
+	for (int j = 0; j < jointCount; ++j)
+		scratch.blend[j] = t;
+
+	BatchMath::QuatSoA rotations = { &scratch.rotationX[0], &scratch.rotationY[0], &scratch.rotationZ[0], &scratch.rotationW[0] };
+	BatchMath::NlerpQuats(GetRotations(keyA), GetRotations(keyB), &scratch.blend[0], rotations, jointCount);
+
+	const glm::vec3* translationA = GetTranslations(keyA);
+	const glm::vec3* translationB = GetTranslations(keyB);
+	const glm::vec3* scaleA = GetScales(keyA);
+	const glm::vec3* scaleB = GetScales(keyB);
+	for (int j = 0; j < jointCount; ++j)
+	{
+		scratch.translations[j] = translationA[j] + (translationB[j] - translationA[j]) * t;
+		scratch.scales[j] = scaleA[j] + (scaleB[j] - scaleA[j]) * t;
+	}
+}
+
+BatchMath::QuatSoA AnimationClip::GetRotations(int key) const
+{
+	size_t i = (size_t)key * jointCount;
+	BatchMath::QuatSoA q = { (float*)&rotationX[i], (float*)&rotationY[i], (float*)&rotationZ[i], (float*)&rotationW[i] };
+	return q;
+}
+
+PoseScratch::PoseScratch(int jointCount)
+{
+	Resize(jointCount);
+}
+
+void PoseScratch::Resize(int jointCount)
+{
+	blend.resize(jointCount);
+	rotationX.resize(jointCount);
+	rotationY.resize(jointCount);
+	rotationZ.resize(jointCount);
+	rotationW.resize(jointCount);
+	translations.resize(jointCount);
+	scales.resize(jointCount);
+	local.resize(jointCount);
+	model.resize(jointCount);
+}
+
+void PoseToPalette(const Skeleton& skeleton, const Affine3x4& placement, PoseScratch& scratch, Affine3x4* palette)
+{
+	int jointCount = skeleton.GetJointCount();
+	BatchMath::QuatSoA rotations = { &scratch.rotationX[0], &scratch.rotationY[0], &scratch.rotationZ[0], &scratch.rotationW[0] };
+	BatchMath::ComposeAffineSoA(&scratch.translations[0], rotations, &scratch.scales[0], &scratch.local[0], jointCount);
+	skeleton.LocalToModel(placement, &scratch.local[0], &scratch.model[0]);
+	skeleton.ModelToPalette(&scratch.model[0], palette);
+}
+
+void EvaluatePalette(const Skeleton& skeleton, const AnimationClip& clip, float time, const Affine3x4& placement,
+	PoseScratch& scratch, Affine3x4* palette)
+{
+	clip.Sample(time, scratch);
+	PoseToPalette(skeleton, placement, scratch, palette);
+}
+
+void BuildTentacle(int jointCount, int rings, int segments, Skeleton& skeleton, AnimationClip& clip,
+	std::vector<SkinnedVertex>& vertices, std::vector<unsigned>& indices)
+{
+	const float height = 2.f, baseRadius = 0.18f;
+	const float boneLength = height / jointCount;
+	const int keyCount = 60;
+	const float sampleRate = 30.f, twoPi = 6.28318531f;
+
+	skeleton = Skeleton();
+	for (int j = 0; j < jointCount; ++j)
+	{
+		Affine3x4 bind = Transform::ComposeAffine(glm::vec3(0.f, j * boneLength, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+		skeleton.AddJoint(j - 1, bind);
+	}
+
+	// Waves travel up the chain; the clip loops because both angles are periodic in keyCount
+	clip = AnimationClip(jointCount, keyCount, sampleRate);
+	for (int k = 0; k < keyCount; ++k)
+	{
+		float phase = twoPi * k / keyCount;
+		for (int j = 0; j < jointCount; ++j)
+		{
+			glm::quat bend = Transform::AxisAngle(glm::vec3(0.f, 0.f, 1.f), 0.25f * std::sin(phase + 0.5f * j));
+			glm::quat sway = Transform::AxisAngle(glm::vec3(1.f, 0.f, 0.f), 0.15f * std::cos(phase + 0.3f * j));
+			glm::vec3 offset(0.f, j > 0 ? boneLength : 0.f, 0.f);
+			clip.SetKey(k, j, offset, bend * sway, glm::vec3(1.f));
+		}
+	}
+
+	vertices.clear();
+	for (int r = 0; r <= rings; ++r)
+	{
+		float y = height * r / rings;
+		float radius = baseRadius * (1.f - 0.7f * y / height);
+
+		float along = y / boneLength;
+		int joint = (int)along < jointCount - 1 ? (int)along : jointCount - 1;
+		float t = joint < jointCount - 1 ? along - joint : 0.f;
+
+		for (int s = 0; s < segments; ++s)
+		{
+			float angle = twoPi * s / segments;
+			SkinnedVertex v;
+			v.normal = glm::vec3(std::cos(angle), 0.f, std::sin(angle));
+			v.position = glm::vec3(v.normal.x * radius, y, v.normal.z * radius);
+			v.joints = glm::u8vec4(joint, joint < jointCount - 1 ? joint + 1 : joint, 0, 0);
+			v.weights = glm::vec4(1.f - t, t, 0.f, 0.f);
+			vertices.push_back(v);
+		}
+	}
+
+	indices.clear();
+	for (int r = 0; r < rings; ++r)
+	{
+		for (int s = 0; s < segments; ++s)
+		{
+			unsigned a = r * segments + s, b = r * segments + (s + 1) % segments;
+			unsigned c = a + segments, d = b + segments;
+			unsigned quad[] = { a, c, b, b, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "BatchMath.h"
+#include "Skinning.h"
+#include "Transform.h"
+
+/**	Joint hierarchies and keyframed clips
+ *
+ *	Joints are stored parents first (parents[j] < j, -1 for a root), so the
+ *	local-to-model walk is one pass over the array with no recursion.
+ *
+ *	A clip holds keys at a fixed rate for every joint. Sampling locates the two
+ *	keys around the time once per character and blends all joints together: the
+ *	rotations with one BatchMath::NlerpQuats call on the clip's QuatSoA streams,
+ *	then ComposeAffineSoA builds the local transforms. Keys are dense enough for
+ *	nlerp to be indistinguishable from slerp. CompressedClip is the compact form
+ *	to ship; both sample into the same PoseScratch.
+ *
+ *	The skinning palette is placement * model[j] * inverseBind[j], ready for
+ *	Skinning / BatchMath::SkinLinear or for upload to the GPU.
+ */
+
+class Skeleton
+{
+public:
+	Skeleton();
+
+	// Parents must be added first; the bind pose is given in model space
+	int AddJoint(int parent, const Affine3x4& bindPose);
+
+	int GetJointCount() const { return (int)parents.size(); }
+	int GetParent(int joint) const { return parents[joint]; }
+
+	// model[j] = placement * model[parents[j]] * local[j]
+	void LocalToModel(const Affine3x4& placement, const Affine3x4* local, Affine3x4* model) const;
+	void ModelToPalette(const Affine3x4* model, Affine3x4* palette) const;
+
+private:
+	std::vector<int> parents;
+	std::vector<Affine3x4> inverseBind;
+};
+
+class PoseScratch;
+
+// Looping, uniformly sampled clip
+class AnimationClip
+{
+public:
+	AnimationClip();
+	AnimationClip(int jointCount, int keyCount, float sampleRate);
+
+	// Key times are key / sampleRate; the last key blends back into key 0
+	void SetKey(int key, int joint, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+
+	int GetJointCount() const { return jointCount; }
+	int GetKeyCount() const { return keyCount; }
+	float GetSampleRate() const { return sampleRate; }
+	float GetDuration() const { return keyCount / sampleRate; }
+
+	// Bytes of key data
+	size_t GetSize() const;
+
+	// Keys either side of time (wrapped into the clip) and the blend factor between them
+	void Locate(float time, int& keyA, int& keyB, float& t) const;
+
+	// Local pose of every joint at time, into scratch
+	void Sample(float time, PoseScratch& scratch) const;
+
+	BatchMath::QuatSoA GetRotations(int key) const;
+	const glm::vec3* GetTranslations(int key) const { return &translations[key * jointCount]; }
+	const glm::vec3* GetScales(int key) const { return &scales[key * jointCount]; }
+
+private:
+	int jointCount, keyCount;
+	float sampleRate;
+
+	// [key * jointCount + joint]
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<glm::vec3> translations, scales;
+};
+
+// Working memory for EvaluatePalette, one per thread
+class PoseScratch
+{
+public:
+	explicit PoseScratch(int jointCount = 0);
+
+	void Resize(int jointCount);
+
+private:
+	friend class AnimationClip;
+	friend class CompressedClip;
+	friend void PoseToPalette(const Skeleton& skeleton, const Affine3x4& placement, PoseScratch& scratch, Affine3x4* palette);
+
+	std::vector<float> blend, rotationX, rotationY, rotationZ, rotationW;
+	std::vector<glm::vec3> translations, scales;
+	std::vector<Affine3x4> local, model;
+	std::vector<float> decoded;		// CompressedClip's working set
+};
+
+// Turns the pose a clip sampled into scratch into skeleton.GetJointCount() palette matrices
+void PoseToPalette(const Skeleton& skeleton, const Affine3x4& placement, PoseScratch& scratch, Affine3x4* palette);
+
+// Samples the clip and writes skeleton.GetJointCount() palette matrices. Does not allocate
+// once the scratch is sized.
+void EvaluatePalette(const Skeleton& skeleton, const AnimationClip& clip, float time, const Affine3x4& placement,
+	PoseScratch& scratch, Affine3x4* palette);
+
+// Procedural test character: a tapered tube along +y over a chain of joints, with a
+// looping sway clip. Every vertex is bound to the two nearest joints.
+void BuildTentacle(int jointCount, int rings, int segments, Skeleton& skeleton, AnimationClip& clip,
+	std::vector<SkinnedVertex>& vertices, std::vector<unsigned>& indices);
@@ -0,0 +1,300 @@
+#include "SkinnedCrowd.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "BatchMath.h"
+#include "ShaderUtil.h"
+
+// Linear blend skinning from the palette texture buffer, one instance per character
+static const char* cGpuSkinningVertexShader = "\n\
+#version 330\n\
+layout (location = 0) in vec3 pos;\n\
+layout (location = 1) in vec3 normal;\n\
+layout (location = 2) in uvec4 joints;\n\
+layout (location = 3) in vec4 weights;\n\
+\n\
+out vec4 vCol;\n\
+\n\
+uniform mat4 projection;\n\
+uniform mat4 view;\n\
+uniform samplerBuffer palette;\n\
+uniform int jointCount;\n\
+\n\
+void main()\n\
+{\n\
+	int first = gl_InstanceID * jointCount;\n\
+	vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);\n\
+	for (int i = 0; i < 4; ++i)\n\
+	{\n\
+		int texel = (first + int(joints[i])) * 3;\n\
+		row0 += weights[i] * texelFetch(palette, texel);\n\
+		row1 += weights[i] * texelFetch(palette, texel + 1);\n\
+		row2 += weights[i] * texelFetch(palette, texel + 2);\n\
+	}\n\
+\n\
+	vec4 p = vec4(pos, 1.0);\n\
+	vec3 n = vec3(dot(row0.xyz, normal), dot(row1.xyz, normal), dot(row2.xyz, normal));\n\
+	gl_Position = projection * view * vec4(dot(row0, p), dot(row1, p), dot(row2, p), 1.0);\n\
+	vCol = vec4(0.5 + 0.5 * normalize(n), 1.0);\n\
+}";
+
+// Already skinned SkinnedPoint stream
+static const char* cCpuSkinningVertexShader = "\n\
+#version 330\n\
+layout (location = 0) in vec4 pos;\n\
+layout (location = 1) in vec4 normal;\n\
+\n\
+out vec4 vCol;\n\
+\n\
+uniform mat4 projection;\n\
+uniform mat4 view;\n\
+\n\
+void main()\n\
+{\n\
+	gl_Position = projection * view * pos;\n\
+	vCol = vec4(0.5 + 0.5 * normalize(normal.xyz), 1.0);\n\
+}";
+
+static const char* cSkinningFragmentShader = "\n\
+#version 330\n\
+in vec4 vCol;\n\
+out vec4 colour;\n\
+\n\
+void main()\n\
+{\n\
+	colour = vCol;\n\
+}";
+
+SkinnedCrowd::SkinnedCrowd()
+{
+	path = SKINNING_GPU;
+	characterCount = 0;
+	program = vao = meshBuffer = indexBuffer = streamBuffer = paletteBuffer = paletteTexture = 0;
+	indexCount = 0;
+	uniformProjection = uniformView = uniformPalette = uniformJointCount = 0;
+	cpuSeconds = 0.0;
+	frames = 0;
+}
+
+bool SkinnedCrowd::Init(SkinningPath skinningPath, int characters)
+{
+	path = skinningPath;
+	characterCount = characters;
+
+	// Only the compressed clip is kept
+	AnimationClip source;
+	std::vector<unsigned> indices;
+	BuildTentacle(16, 48, 16, skeleton, source, vertices, indices);
+	clip = CompressedClip(source);
+	indexCount = (GLsizei)indices.size();
+
+	// Square grid in front of the camera, each character at its own point in the clip
+	int side = (int)std::ceil(std::sqrt((float)characters));
+	for (int c = 0; c < characters; ++c)
+	{
+		glm::vec3 position(((c % side) - 0.5f * (side - 1)) * 0.8f, -1.5f, -5.f - (c / side) * 0.8f);
+		placements.push_back(Transform::ComposeAffine(position, glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f)));
+		phases.push_back(c * 0.37f);
+
+		drawCounts.push_back(indexCount);
+		drawOffsets.push_back(NULL);
+		drawBaseVertices.push_back((GLint)(c * vertices.size()));
+	}
+
+	program = LinkProgram(path == SKINNING_GPU ? cGpuSkinningVertexShader : cCpuSkinningVertexShader, GL_VERTEX_SHADER,
+		cSkinningFragmentShader, GL_FRAGMENT_SHADER);
+	if (!program)
+		return false;
+
+	uniformProjection = glGetUniformLocation(program, "projection");
+	uniformView = glGetUniformLocation(program, "view");
+	uniformPalette = glGetUniformLocation(program, "palette");
+	uniformJointCount = glGetUniformLocation(program, "jointCount");
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), &indices[0], GL_STATIC_DRAW);
+
+	if (path == SKINNING_GPU)
+	{
+		// Bind pose mesh, skinned per instance in the shader
+		glGenBuffers(1, &meshBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SkinnedVertex), &vertices[0], GL_STATIC_DRAW);
+
+		GLsizei stride = sizeof(SkinnedVertex);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(SkinnedVertex, position));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(SkinnedVertex, normal));
+		glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, stride, (const void*)offsetof(SkinnedVertex, joints));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (const void*)offsetof(SkinnedVertex, weights));
+		for (GLuint i = 0; i < 4; ++i)
+			glEnableVertexAttribArray(i);
+
+		glGenBuffers(1, &paletteBuffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, characters * GetJointCount() * sizeof(Affine3x4), NULL, GL_STREAM_DRAW);
+
+		glGenTextures(1, &paletteTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+	else
+	{
+		// Filled every frame, every character's copy of the mesh back to back
+		glGenBuffers(1, &streamBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+		glBufferData(GL_ARRAY_BUFFER, characters * vertices.size() * sizeof(SkinnedPoint), NULL, GL_STREAM_DRAW);
+
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedPoint), (const void*)offsetof(SkinnedPoint, position));
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedPoint), (const void*)offsetof(SkinnedPoint, normal));
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	gpuTimer.Init();
+
+	return true;
+}
+
+void SkinnedCrowd::Animate(float time, Affine3x4* palettes, JobSystem* jobs)
+{
+	int jointCount = GetJointCount();
+	unsigned slots = jobs ? jobs->GetWorkerSlotCount() : 1;
+	if (poseScratch.size() < slots)
+		poseScratch.resize(slots, PoseScratch(jointCount));
+
+	JobSystem::RangeFunction body = [&](size_t begin, size_t end, unsigned worker)
+	{
+		for (size_t c = begin; c < end; ++c)
+			EvaluatePalette(skeleton, clip, time + phases[c], placements[c], poseScratch[worker], palettes + c * jointCount);
+	};
+
+	ParallelFor(jobs, characterCount, 16, body);
+}
+
+void SkinnedCrowd::SkinCharacters(const Affine3x4* palettes, SkinnedPoint* out, JobSystem* jobs)
+{
+	int jointCount = GetJointCount();
+	size_t vertexCount = vertices.size();
+	unsigned slots = jobs ? jobs->GetWorkerSlotCount() : 1;
+	if (dualQuatScratch.size() < slots)
+		dualQuatScratch.resize(slots, std::vector<glm::dualquat>(jointCount));
+
+	JobSystem::RangeFunction body = [&](size_t begin, size_t end, unsigned worker)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			const Affine3x4* palette = palettes + c * jointCount;
+			if (path == SKINNING_CPU_DUAL_QUAT)
+			{
+				std::vector<glm::dualquat>& dualQuats = dualQuatScratch[worker];
+				for (int j = 0; j < jointCount; ++j)
+					dualQuats[j] = Skinning::ToDualQuat(palette[j]);
+				BatchMath::SkinDualQuat(&dualQuats[0], &vertices[0], out + c * vertexCount, vertexCount);
+			}
+			else
+			{
+				BatchMath::SkinLinear(palette, &vertices[0], out + c * vertexCount, vertexCount);
+			}
+		}
+	};
+
+	ParallelFor(jobs, characterCount, 4, body);
+}
+
+void SkinnedCrowd::Draw(const Affine3x4* palettes, const glm::mat4& projection, const glm::mat4& view, JobSystem* jobs)
+{
+	if (!program)
+		return;
+
+	if (path != SKINNING_GPU)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// Orphan the old contents so the driver never waits for the previous frame's draw
+		glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+		GLsizeiptr size = characterCount * vertices.size() * sizeof(SkinnedPoint);
+		void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped)
+		{
+			SkinCharacters(palettes, (SkinnedPoint*)mapped, jobs);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		cpuSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	gpuTimer.Begin();
+
+	glUseProgram(program);
+	glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+	if (path == SKINNING_GPU)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, characterCount * GetJointCount() * sizeof(Affine3x4), palettes, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+		glUniform1i(uniformPalette, 0);
+		glUniform1i(uniformJointCount, GetJointCount());
+
+		glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, characterCount);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	else
+	{
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, &drawCounts[0], GL_UNSIGNED_INT, (void* const*)&drawOffsets[0],
+			characterCount, &drawBaseVertices[0]);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+
+	gpuTimer.End();
+	++frames;
+}
+
+SkinningTimings SkinnedCrowd::TakeTimings()
+{
+	SkinningTimings timings;
+	timings.cpuMs = frames ? cpuSeconds * 1000.0 / frames : 0.0;
+	timings.gpuMs = gpuTimer.Collect();
+	timings.frames = frames;
+
+	cpuSeconds = 0.0;
+	frames = 0;
+	return timings;
+}
+
+SkinnedCrowd::~SkinnedCrowd()
+{
+	if (!program)
+		return;		// Init never got a context
+
+	GLuint buffers[] = { meshBuffer, indexBuffer, streamBuffer, paletteBuffer };
+	glDeleteBuffers(4, buffers);
+	glDeleteTextures(1, &paletteTexture);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteProgram(program);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "CompressedClip.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+
+/**	A grid of animated, skinned characters (BuildTentacle, swaying on a looping clip)
+ *
+ *	Animate runs on the simulation side and only touches CPU memory: every
+ *	character samples the (compressed) clip at its own phase and writes its
+ *	joint palette.
+ *	Draw runs on the GL thread and takes one of three paths:
+ *
+ *		SKINNING_GPU			- the palettes of all characters go into a texture buffer
+ *								  (3 RGBA32F texels per joint) and one instanced draw
+ *								  skins in the vertex shader
+ *		SKINNING_CPU_LINEAR		- BatchMath::SkinLinear on the job threads, straight into
+ *		SKINNING_CPU_DUAL_QUAT	  a mapped, orphaned streaming buffer (or SkinDualQuat)
+ *								  that one glMultiDrawElementsBaseVertex draws
+ *
+ *	All of it works on a GL 3.3 core context.
+ */
+
+enum SkinningPath
+{
+	SKINNING_GPU,
+	SKINNING_CPU_LINEAR,
+	SKINNING_CPU_DUAL_QUAT
+};
+
+// Per-frame averages since the last TakeTimings
+struct SkinningTimings
+{
+	double cpuMs;		// Skinning into the streaming buffer, 0 on the GPU path
+	double gpuMs;		// Palette upload + draw, from GL_TIME_ELAPSED queries
+	unsigned frames;
+};
+
+class SkinnedCrowd
+{
+public:
+	SkinnedCrowd();
+
+	bool Init(SkinningPath skinningPath, int characters);
+
+	SkinningPath GetPath() const { return path; }
+	int GetCharacterCount() const { return characterCount; }
+	int GetJointCount() const { return skeleton.GetJointCount(); }
+
+	// GetCharacterCount() * GetJointCount() palette matrices, no GL calls
+	void Animate(float time, Affine3x4* palettes, JobSystem* jobs);
+
+	void Draw(const Affine3x4* palettes, const glm::mat4& projection, const glm::mat4& view, JobSystem* jobs);
+
+	SkinningTimings TakeTimings();
+
+	~SkinnedCrowd();
+
+private:
+	void SkinCharacters(const Affine3x4* palettes, SkinnedPoint* out, JobSystem* jobs);
+
+	SkinningPath path;
+	int characterCount;
+
+	Skeleton skeleton;
+	CompressedClip clip;
+	std::vector<SkinnedVertex> vertices;
+	std::vector<Affine3x4> placements;
+	std::vector<float> phases;
+
+	// Per job thread
+	std::vector<PoseScratch> poseScratch;
+	std::vector<std::vector<glm::dualquat> > dualQuatScratch;
+
+	// glMultiDrawElementsBaseVertex arguments, one entry per character
+	std::vector<GLsizei> drawCounts;
+	std::vector<const void*> drawOffsets;
+	std::vector<GLint> drawBaseVertices;
+
+	GLuint program, vao, meshBuffer, indexBuffer, streamBuffer, paletteBuffer, paletteTexture;
+	GLsizei indexCount;
+	GLint uniformProjection, uniformView, uniformPalette, uniformJointCount;
+
+	double cpuSeconds;
+	GpuTimer gpuTimer;
+	unsigned frames;
+};
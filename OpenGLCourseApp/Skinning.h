@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include "Transform.h"
+
+/**	Per-vertex skinning maths
+ *
+ *	A skinned vertex is bound to up to four joints. Its position is moved by the
+ *	weighted joints of a palette, where palette[j] = model space pose of joint j *
+ *	inverse bind matrix of joint j. Weights should sum to one; unused influences
+ *	have weight 0 and any valid joint index.
+ *
+ *	Linear blend skinning averages the palette matrices. It is cheap and handles
+ *	scale, but twisting joints collapse the volume ("candy wrapper"). Dual
+ *	quaternion skinning blends rigid transforms instead and keeps the volume; the
+ *	palette must then be free of scale and shear.
+ *
+ *	These are the scalar references, BatchMath::SkinLinear / SkinDualQuat run whole
+ *	vertex arrays.
+ */
+
+// Bind pose vertex, 44 bytes. The GPU skinning path reads the same layout.
+struct SkinnedVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::u8vec4 joints;
+	glm::vec4 weights;
+};
+
+// Skinned result. w is 1 for the position and 0 for the normal, so both are
+// whole 16 byte stores and can go straight into a vertex buffer.
+struct SkinnedPoint
+{
+	glm::vec4 position;
+	glm::vec4 normal;
+};
+
+namespace Skinning
+{
+	inline SkinnedPoint SkinLinear(const Affine3x4* palette, const SkinnedVertex& v)
+	{
+		glm::vec4 rows[3] = { glm::vec4(0.f), glm::vec4(0.f), glm::vec4(0.f) };
+		for (int i = 0; i < 4; ++i)
+		{
+			const Affine3x4& m = palette[v.joints[i]];
+			for (int r = 0; r < 3; ++r)
+				rows[r] += m.rows[r] * v.weights[i];
+		}
+
+		// Normals use the blended matrix itself, exact for rotation and uniform scale
+		glm::vec4 p(v.position, 1.f), n(v.normal, 0.f);
+		SkinnedPoint result;
+		result.position = glm::vec4(glm::dot(rows[0], p), glm::dot(rows[1], p), glm::dot(rows[2], p), 1.f);
+		result.normal = glm::vec4(glm::dot(rows[0], n), glm::dot(rows[1], n), glm::dot(rows[2], n), 0.f);
+		return result;
+	}
+
+	// Rotation and translation of a rigid palette matrix
+	inline glm::dualquat ToDualQuat(const Affine3x4& a)
+	{
+		return glm::dualquat_cast(glm::mat3x4(a.rows[0], a.rows[1], a.rows[2]));
+	}
+
+	inline SkinnedPoint SkinDualQuat(const glm::dualquat* palette, const SkinnedVertex& v)
+	{
+		// Flip influences into the hemisphere of the first one, so the blend takes
+		// the short way round
+		const glm::dualquat& first = palette[v.joints[0]];
+		glm::dualquat blended(glm::quat(0.f, 0.f, 0.f, 0.f), glm::quat(0.f, 0.f, 0.f, 0.f));
+		for (int i = 0; i < 4; ++i)
+		{
+			const glm::dualquat& q = palette[v.joints[i]];
+			float weight = glm::dot(first.real, q.real) < 0.f ? -v.weights[i] : v.weights[i];
+			blended.real += q.real * weight;
+			blended.dual += q.dual * weight;
+		}
+		blended = glm::normalize(blended);
+
+		SkinnedPoint result;
+		result.position = glm::vec4(blended * v.position, 1.f);
+		result.normal = glm::vec4(blended.real * v.normal, 0.f);
+		return result;
+	}
+}
@@ -0,0 +1,268 @@
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace
+{
+	const size_t MIN_BUCKETS = 64;
+	const int MIN_BUCKET_BITS = 6;
+	const int MAX_DIGIT_BITS = 11;				// Radix histograms stay within L1
+	const size_t PARALLEL_THRESHOLD = 65536;	// Points below this are built on the calling thread
+}
+
+SpatialHash::SpatialHash()
+	: cellSize(1.f), inverseCellSize(1.f), bucketShift(64 - MIN_BUCKET_BITS), minCell(0), maxCell(-1)
+{
+	bucketStart.assign(MIN_BUCKETS + 1, 0);
+}
+
+void SpatialHash::Build(const glm::vec3* points, size_t count, float size, JobSystem* jobs)
+{
+	cellSize = size;
+	inverseCellSize = 1.f / size;
+
+	// At least one bucket per point
+	size_t buckets = MIN_BUCKETS;
+	int bits = MIN_BUCKET_BITS;
+	while (buckets < count)
+	{
+		buckets <<= 1;
+		++bits;
+	}
+	bucketShift = 64 - bits;
+
+	// Fewest radix passes over the bucket bits, with equal digits
+	int passes = (bits + MAX_DIGIT_BITS - 1) / MAX_DIGIT_BITS;
+	int digitBits = (bits + passes - 1) / passes;
+	size_t digits = (size_t)1 << digitBits;
+
+	// One chunk of the points per thread, each with its own histogram
+	size_t chunkCount = jobs && count >= PARALLEL_THRESHOLD ? jobs->GetThreadCount() : 1;
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	unsigned slots = jobs ? jobs->GetWorkerSlotCount() : 1;
+	cellKeys.resize(count);
+	keyScratch.resize(count);
+	offsets.resize(digits * chunkCount);
+	bucketStart.resize(buckets + 1);
+	sortedPoints.resize(count);
+	sortedIndices.resize(count);
+	workerMin.assign(slots, glm::ivec3(INT_MAX));
+	workerMax.assign(slots, glm::ivec3(INT_MIN));
+
+	// Bucket and index of every point, in one pass, with the histogram of the first digit
+	uint64_t digitMask = digits - 1;
+	uint64_t* keys = cellKeys.data();
+	unsigned* histograms = offsets.data();
+	ParallelFor(jobs, chunkCount, 1, [&](size_t chunk, size_t end, unsigned worker)
+	{
+		glm::ivec3 low = workerMin[worker], high = workerMax[worker];
+		for (; chunk < end; ++chunk)
+		{
+			unsigned* counts = histograms + chunk * digits;
+			std::fill(counts, counts + digits, 0);
+			for (size_t i = chunk * chunkSize, last = std::min(count, i + chunkSize); i < last; ++i)
+			{
+				glm::ivec3 cell = CellOf(points[i]);
+				low = glm::min(low, cell);
+				high = glm::max(high, cell);
+
+				uint64_t key = (uint64_t)BucketOf(cell) << 32 | i;
+				keys[i] = key;
+				++counts[(key >> 32) & digitMask];
+			}
+		}
+		workerMin[worker] = low;
+		workerMax[worker] = high;
+	});
+
+	minCell = glm::ivec3(INT_MAX);
+	maxCell = glm::ivec3(INT_MIN);
+	for (unsigned w = 0; w < slots; ++w)
+	{
+		minCell = glm::min(minCell, workerMin[w]);
+		maxCell = glm::max(maxCell, workerMax[w]);
+	}
+
+	// Stable LSD radix sort of the keys by bucket, as RenderQueue::RadixSort
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		int shift = 32 + pass * digitBits;
+		const uint64_t* src = keys;
+		uint64_t* dst = keyScratch.data();
+
+		if (pass > 0)
+		{
+			ParallelFor(jobs, chunkCount, 1, [&](size_t chunk, size_t end, unsigned)
+			{
+				for (; chunk < end; ++chunk)
+				{
+					unsigned* counts = histograms + chunk * digits;
+					std::fill(counts, counts + digits, 0);
+					for (size_t i = chunk * chunkSize, last = std::min(count, i + chunkSize); i < last; ++i)
+						++counts[(src[i] >> shift) & digitMask];
+				}
+			});
+		}
+
+		// Exclusive prefix over (digit, chunk) keeps the sort stable
+		unsigned sum = 0;
+		for (size_t digit = 0; digit < digits; ++digit)
+		{
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				unsigned digitCount = histograms[chunk * digits + digit];
+				histograms[chunk * digits + digit] = sum;
+				sum += digitCount;
+			}
+		}
+
+		ParallelFor(jobs, chunkCount, 1, [&](size_t chunk, size_t end, unsigned)
+		{
+			for (; chunk < end; ++chunk)
+			{
+				unsigned* next = histograms + chunk * digits;
+				for (size_t i = chunk * chunkSize, last = std::min(count, i + chunkSize); i < last; ++i)
+					dst[next[(src[i] >> shift) & digitMask]++] = src[i];
+			}
+		});
+
+		cellKeys.swap(keyScratch);
+		keys = dst;
+	}
+
+	// Runs of equal buckets: each bucket starts at the first key at or past it. Every bucket
+	// is written once, by the chunk holding that key, then the points are gathered
+	unsigned* starts = bucketStart.data();
+	glm::vec3* gathered = sortedPoints.data();
+	unsigned* indices = sortedIndices.data();
+	ParallelFor(jobs, chunkCount, 1, [&](size_t chunk, size_t end, unsigned)
+	{
+		for (; chunk < end; ++chunk)
+		{
+			size_t i = chunk * chunkSize, last = std::min(count, i + chunkSize);
+			size_t bucket = i > 0 ? (size_t)(keys[i - 1] >> 32) + 1 : 0;
+			for (; i < last; ++i)
+			{
+				uint64_t key = keys[i];
+				for (size_t keyBucket = (size_t)(key >> 32); bucket <= keyBucket; ++bucket)
+					starts[bucket] = (unsigned)i;
+
+				unsigned index = (unsigned)key;
+				gathered[i] = points[index];
+				indices[i] = index;
+			}
+		}
+	});
+
+	for (size_t bucket = count > 0 ? (size_t)(keys[count - 1] >> 32) + 1 : 0; bucket <= buckets; ++bucket)
+		starts[bucket] = (unsigned)count;
+}
+
+template <typename Visitor>
+void SpatialHash::VisitCell(const glm::ivec3& cell, const glm::vec3& center, float radiusSquared, Visitor& visit) const
+{
+	// Closest point of the cell's cube, so buckets out of reach are never touched
+	glm::vec3 cellLow = glm::vec3(cell) * cellSize;
+	glm::vec3 gap = glm::max(glm::max(cellLow - center, center - (cellLow + cellSize)), glm::vec3(0.f));
+	if (glm::dot(gap, gap) > radiusSquared)
+		return;
+
+	unsigned bucket = BucketOf(cell);
+	for (unsigned i = bucketStart[bucket], end = bucketStart[bucket + 1]; i < end; ++i)
+	{
+		glm::vec3 d = sortedPoints[i] - center;
+		float distanceSquared = glm::dot(d, d);
+
+		// Other cells sharing the bucket are skipped by the cell test
+		if (distanceSquared <= radiusSquared && CellOf(sortedPoints[i]) == cell)
+			visit(sortedIndices[i], distanceSquared);
+	}
+}
+
+size_t SpatialHash::QueryRadius(const glm::vec3& center, float radius, std::vector<unsigned>& out) const
+{
+	out.clear();
+	glm::ivec3 low = glm::max(CellOf(center - radius), minCell);
+	glm::ivec3 high = glm::min(CellOf(center + radius), maxCell);
+
+	auto visit = [&](unsigned index, float)
+	{
+		out.push_back(index);
+	};
+	for (int z = low.z; z <= high.z; ++z)
+		for (int y = low.y; y <= high.y; ++y)
+			for (int x = low.x; x <= high.x; ++x)
+				VisitCell(glm::ivec3(x, y, z), center, radius * radius, visit);
+	return out.size();
+}
+
+size_t SpatialHash::QueryNearest(const glm::vec3& center, size_t k, float maxDistance, unsigned* outIndices, float* outDistances) const
+{
+	if (!k || minCell.x > maxCell.x)
+		return 0;
+
+	// outDistances holds squared distances, sorted, until the end
+	size_t found = 0;
+	float maxSquared = maxDistance * maxDistance;
+	auto searchRadiusSquared = [&]()
+	{
+		return found == k ? outDistances[k - 1] : maxSquared;
+	};
+	auto visit = [&](unsigned index, float distanceSquared)
+	{
+		if (found == k && distanceSquared >= outDistances[k - 1])
+			return;
+
+		size_t at = found < k ? found++ : k - 1;
+		for (; at > 0 && outDistances[at - 1] > distanceSquared; --at)
+		{
+			outDistances[at] = outDistances[at - 1];
+			outIndices[at] = outIndices[at - 1];
+		}
+		outDistances[at] = distanceSquared;
+		outIndices[at] = index;
+	};
+
+	// Shells of cells around the centre's, one cell further out each time. Cells further away
+	// than the k-th nearest so far are skipped
+	glm::ivec3 home = CellOf(center);
+	for (int ring = 0; ; ++ring)
+	{
+		glm::ivec3 low = glm::max(home - ring, minCell), high = glm::min(home + ring, maxCell);
+		for (int z = low.z; z <= high.z; ++z)
+		{
+			for (int y = low.y; y <= high.y; ++y)
+			{
+				if (std::abs(z - home.z) == ring || std::abs(y - home.y) == ring)
+				{
+					for (int x = low.x; x <= high.x; ++x)
+						VisitCell(glm::ivec3(x, y, z), center, searchRadiusSquared(), visit);
+				}
+				else
+				{
+					// Rows through the inside of the shell only touch its two x faces
+					if (home.x - ring >= low.x)
+						VisitCell(glm::ivec3(home.x - ring, y, z), center, searchRadiusSquared(), visit);
+					if (home.x + ring <= high.x)
+						VisitCell(glm::ivec3(home.x + ring, y, z), center, searchRadiusSquared(), visit);
+				}
+			}
+		}
+
+		// Every point not visited yet is outside the shell's cube
+		if (glm::all(glm::lessThanEqual(home - ring, minCell)) && glm::all(glm::greaterThanEqual(home + ring, maxCell)))
+			break;
+
+		glm::vec3 cubeLow = glm::vec3(home - ring) * cellSize, cubeHigh = glm::vec3(home + ring + 1) * cellSize;
+		glm::vec3 inside = glm::min(center - cubeLow, cubeHigh - center);
+		float covered = std::max(0.f, std::min(inside.x, std::min(inside.y, inside.z)));
+		if (covered * covered >= searchRadiusSquared())
+			break;
+	}
+
+	for (size_t i = 0; i < found; ++i)
+		outDistances[i] = std::sqrt(outDistances[i]);
+	return found;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+/**	Uniform grid over a point set, hashed into a fixed table, for neighbour queries
+ *
+ *	Space is cut into cubes of cellSize. A point's cell (floor(p / cellSize)) is
+ *	hashed the way gtx/hash.hpp hashes an ivec3, hash_combine over the three
+ *	coordinates, and folded into a power of two table with a Fibonacci multiply.
+ *	The table has at least one bucket per point, so it never fills up and empty
+ *	space costs nothing.
+ *
+ *	Build sorts the points by bucket, with no per-cell allocation and no atomics:
+ *		1. one streaming pass writes every point's key, its bucket over its index,
+ *		   and counts the first radix digit
+ *		2. a stable LSD radix sort of the keys, in digits of up to 11 bits, each
+ *		   pass with a histogram per chunk of the points so threads share nothing
+ *		3. the bucket starts taken from the runs of equal buckets in the sorted
+ *		   keys, in the same pass that gathers the points into bucket order
+ *	Each pass is spread over the job threads. Points within a bucket keep their
+ *	input order whatever the thread count.
+ *
+ *	Cells that hash to the same bucket share it. Queries test each point against
+ *	the cell they asked for, so a point is never reported twice, and skip cells
+ *	whose cube is out of reach without touching their bucket. QueryNearest grows
+ *	shells of cells around the centre until the k-th nearest point found is
+ *	closer than anything outside them.
+ *
+ *	Rebuild every frame for moving points; the arrays keep their capacity.
+ */
+
+class SpatialHash
+{
+public:
+	SpatialHash();
+
+	// cellSize should be about the typical query radius
+	void Build(const glm::vec3* points, size_t count, float cellSize, JobSystem* jobs);
+
+	size_t GetPointCount() const { return sortedIndices.size(); }
+	size_t GetBucketCount() const { return bucketStart.empty() ? 0 : bucketStart.size() - 1; }
+	float GetCellSize() const { return cellSize; }
+
+	// Cell holding p, and that cell's bucket
+	glm::ivec3 CellOf(const glm::vec3& p) const
+	{
+		return glm::ivec3(FloorToInt(p.x * inverseCellSize), FloorToInt(p.y * inverseCellSize), FloorToInt(p.z * inverseCellSize));
+	}
+
+	unsigned BucketOf(const glm::ivec3& cell) const
+	{
+		// std::hash<glm::ivec3> of gtx/hash.hpp where std::hash<int> is the identity, in 64 bits on every target
+		unsigned long long seed = 0;
+		seed ^= (unsigned long long)(long long)cell.x + 0x9e3779b9ull + (seed << 6) + (seed >> 2);
+		seed ^= (unsigned long long)(long long)cell.y + 0x9e3779b9ull + (seed << 6) + (seed >> 2);
+		seed ^= (unsigned long long)(long long)cell.z + 0x9e3779b9ull + (seed << 6) + (seed >> 2);
+		return (unsigned)((seed * 0x9E3779B97F4A7C15ull) >> bucketShift);
+	}
+
+	// Indices of the points within radius of center (distance <= radius), in no particular order.
+	// out is cleared first; returns its size
+	size_t QueryRadius(const glm::vec3& center, float radius, std::vector<unsigned>& out) const;
+
+	// Up to k nearest points no further than maxDistance (infinity for no limit), nearest first.
+	// Returns how many were found
+	size_t QueryNearest(const glm::vec3& center, size_t k, float maxDistance, unsigned* outIndices, float* outDistances) const;
+
+private:
+	// floor without the libm call: truncate, then step down where that rounded up
+	static int FloorToInt(float x)
+	{
+		int truncated = (int)x;
+		return truncated - (x < (float)truncated);
+	}
+
+	// Calls visit(index, distanceSquared) for the points of cell that are within radiusSquared of center
+	template <typename Visitor>
+	void VisitCell(const glm::ivec3& cell, const glm::vec3& center, float radiusSquared, Visitor& visit) const;
+
+	float cellSize, inverseCellSize;
+	unsigned bucketShift;
+	glm::ivec3 minCell, maxCell;		// Over all points
+
+	std::vector<uint64_t> cellKeys, keyScratch;			// Bucket << 32 | point index, sorted by bucket
+	std::vector<unsigned> offsets;						// Radix histogram per chunk
+	std::vector<unsigned> bucketStart;					// Bucket count + 1 entries
+	std::vector<glm::ivec3> workerMin, workerMax;		// Cell bounds per job thread
+
+	// In bucket order
+	std::vector<glm::vec3> sortedPoints;
+	std::vector<unsigned> sortedIndices;
+};
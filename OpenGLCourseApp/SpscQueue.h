@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**	Bounded lock-free queue for exactly one producer and one consumer thread
+ *
+ *	head is only written by the consumer, tail only by the producer, padded apart
+ *	so they do not share a cache line. Capacity is rounded up to a power of two.
+ */
+
+template <typename T>
+class SpscQueue
+{
+public:
+	explicit SpscQueue(size_t capacity = 16)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		slots.resize(size);
+		mask = size - 1;
+		head = 0;
+		tail = 0;
+	}
+
+	bool TryPush(const T& value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask)
+			return false;		// Full
+
+		slots[t & mask] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(T& value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;		// Empty
+
+		value = slots[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	std::vector<T> slots;
+	size_t mask;
+	char padHead[64];
+	std::atomic<size_t> head;
+	char padTail[64];
+	std::atomic<size_t> tail;
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "FastTrig.h"
+
+/**	Direct transform builders
+ *
+ *	translate(mat4(1)) -> rotate -> scale costs three general 4x4 multiplies, and
+ *	rotate renormalises its axis every call. These write the rotation-scale terms
+ *	and the translation straight into the result instead, giving the same matrix as
+ *		glm::translate(glm::mat4(1.f), t) * glm::mat4_cast(r) * glm::scale(glm::mat4(1.f), s)
+ *
+ *	Quaternions and axes must be unit length. The batched versions live in BatchMath.
+ *
+ *	The inverses skip the general 4x4 cofactor expansion: an affine inverse only
+ *	needs the 3x3 one, and a rigid transform (rotation and translation, no scale)
+ *	just transposes its rotation. Singular input gives inf/NaN like glm::inverse.
+ */
+
+// Affine transform as the top three rows of a mat4, row-major. Each row is the
+// linear part followed by the translation. The layout is what
+// glUniformMatrix4x3fv(location, count, GL_TRUE, &rows[0].x) expects for a GLSL mat4x3.
+struct Affine3x4
+{
+	glm::vec4 rows[3];
+};
+
+namespace Transform
+{
+	inline glm::quat AxisAngle(const glm::vec3& axis, float angle)
+	{
+		float s, c;
+		FastTrig::SinCos(angle * 0.5f, s, c);
+		return glm::quat(c, axis.x * s, axis.y * s, axis.z * s);
+	}
+
+	// Shortest-path normalised lerp
+	inline glm::quat Nlerp(const glm::quat& a, const glm::quat& b, float t)
+	{
+		float sign = glm::dot(a, b) < 0.f ? -1.f : 1.f;
+		return glm::normalize(a + (b * sign - a) * t);
+	}
+
+	// Cubic correction of t that makes an nlerp follow the slerp angle; the
+	// coefficients are a fit over |cos(angle between a and b)|
+	const float SLERP_A0 = 1.0904f, SLERP_A1 = -3.2452f, SLERP_A2 = 3.55645f, SLERP_A3 = -1.43519f;
+	const float SLERP_B0 = 0.848013f, SLERP_B1 = -1.06021f, SLERP_B2 = 0.215638f;
+
+	inline float SlerpCorrection(float absCos, float t)
+	{
+		float a = SLERP_A0 + absCos * (SLERP_A1 + absCos * (SLERP_A2 + absCos * SLERP_A3));
+		float b = SLERP_B0 + absCos * (SLERP_B1 + absCos * SLERP_B2);
+		float centred = t - 0.5f;
+		float k = a * centred * centred + b;
+		return t + t * centred * (t - 1.f) * k;
+	}
+
+	// Rotates to within 8e-4 rad of glm::slerp (4e-4 on the quaternion arc)
+	inline glm::quat FastSlerp(const glm::quat& a, const glm::quat& b, float t)
+	{
+		return Nlerp(a, b, SlerpCorrection(std::fabs(glm::dot(a, b)), t));
+	}
+
+	inline glm::mat4 ComposeTRS(const glm::vec3& t, const glm::quat& r, const glm::vec3& s)
+	{
+		float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+		float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+		float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+
+		glm::mat4 m;
+		m[0] = glm::vec4((1.f - 2.f * (yy + zz)) * s.x, 2.f * (xy + wz) * s.x, 2.f * (xz - wy) * s.x, 0.f);
+		m[1] = glm::vec4(2.f * (xy - wz) * s.y, (1.f - 2.f * (xx + zz)) * s.y, 2.f * (yz + wx) * s.y, 0.f);
+		m[2] = glm::vec4(2.f * (xz + wy) * s.z, 2.f * (yz - wx) * s.z, (1.f - 2.f * (xx + yy)) * s.z, 0.f);
+		m[3] = glm::vec4(t, 1.f);
+		return m;
+	}
+
+	inline glm::mat4 ComposeTRS(const glm::vec3& t, const glm::vec3& axis, float angle, const glm::vec3& s)
+	{
+		return ComposeTRS(t, AxisAngle(axis, angle), s);
+	}
+
+	inline Affine3x4 ComposeAffine(const glm::vec3& t, const glm::quat& r, const glm::vec3& s)
+	{
+		float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+		float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+		float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+
+		Affine3x4 a;
+		a.rows[0] = glm::vec4((1.f - 2.f * (yy + zz)) * s.x, 2.f * (xy - wz) * s.y, 2.f * (xz + wy) * s.z, t.x);
+		a.rows[1] = glm::vec4(2.f * (xy + wz) * s.x, (1.f - 2.f * (xx + zz)) * s.y, 2.f * (yz - wx) * s.z, t.y);
+		a.rows[2] = glm::vec4(2.f * (xz - wy) * s.x, 2.f * (yz + wx) * s.y, (1.f - 2.f * (xx + yy)) * s.z, t.z);
+		return a;
+	}
+
+	inline Affine3x4 ComposeAffine(const glm::vec3& t, const glm::vec3& axis, float angle, const glm::vec3& s)
+	{
+		return ComposeAffine(t, AxisAngle(axis, angle), s);
+	}
+
+	// a * b, the implicit bottom row (0, 0, 0, 1) is never multiplied
+	inline Affine3x4 Multiply(const Affine3x4& a, const Affine3x4& b)
+	{
+		Affine3x4 result;
+		for (int r = 0; r < 3; ++r)
+		{
+			result.rows[r] = a.rows[r].x * b.rows[0] + a.rows[r].y * b.rows[1] + a.rows[r].z * b.rows[2];
+			result.rows[r].w += a.rows[r].w;
+		}
+		return result;
+	}
+
+	inline glm::vec3 TransformPoint(const Affine3x4& a, const glm::vec3& p)
+	{
+		glm::vec4 v(p, 1.f);
+		return glm::vec3(glm::dot(a.rows[0], v), glm::dot(a.rows[1], v), glm::dot(a.rows[2], v));
+	}
+
+	inline glm::vec3 Column(const Affine3x4& a, int c)
+	{
+		return glm::vec3(a.rows[0][c], a.rows[1][c], a.rows[2][c]);
+	}
+
+	inline Affine3x4 InverseAffine(const Affine3x4& a)
+	{
+		glm::vec3 c0 = Column(a, 0), c1 = Column(a, 1), c2 = Column(a, 2), t = Column(a, 3);
+
+		// Rows of the inverse are the cross products of the columns over the determinant
+		glm::vec3 r0 = glm::cross(c1, c2), r1 = glm::cross(c2, c0), r2 = glm::cross(c0, c1);
+		float invDet = 1.f / glm::dot(c0, r0);
+		r0 *= invDet;
+		r1 *= invDet;
+		r2 *= invDet;
+
+		Affine3x4 result;
+		result.rows[0] = glm::vec4(r0, -glm::dot(r0, t));
+		result.rows[1] = glm::vec4(r1, -glm::dot(r1, t));
+		result.rows[2] = glm::vec4(r2, -glm::dot(r2, t));
+		return result;
+	}
+
+	// Only valid without scale or shear
+	inline Affine3x4 InverseRigid(const Affine3x4& a)
+	{
+		glm::vec3 c0 = Column(a, 0), c1 = Column(a, 1), c2 = Column(a, 2), t = Column(a, 3);
+
+		Affine3x4 result;
+		result.rows[0] = glm::vec4(c0, -glm::dot(c0, t));
+		result.rows[1] = glm::vec4(c1, -glm::dot(c1, t));
+		result.rows[2] = glm::vec4(c2, -glm::dot(c2, t));
+		return result;
+	}
+
+	// transpose(inverse(mat3(m))), for transforming normals
+	inline glm::mat3 NormalMatrix(const glm::vec3& c0, const glm::vec3& c1, const glm::vec3& c2)
+	{
+		glm::vec3 n0 = glm::cross(c1, c2), n1 = glm::cross(c2, c0), n2 = glm::cross(c0, c1);
+		float invDet = 1.f / glm::dot(c0, n0);
+		return glm::mat3(n0 * invDet, n1 * invDet, n2 * invDet);
+	}
+
+	inline glm::mat3 NormalMatrix(const glm::mat4& m)
+	{
+		return NormalMatrix(glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2]));
+	}
+
+	inline glm::mat3 NormalMatrix(const Affine3x4& a)
+	{
+		return NormalMatrix(Column(a, 0), Column(a, 1), Column(a, 2));
+	}
+
+	inline glm::mat4 ToMat4(const Affine3x4& a)
+	{
+		return glm::transpose(glm::mat4(a.rows[0], a.rows[1], a.rows[2], glm::vec4(0.f, 0.f, 0.f, 1.f)));
+	}
+
+	// Drops the bottom row, which must be (0, 0, 0, 1)
+	inline Affine3x4 ToAffine(const glm::mat4& m)
+	{
+		Affine3x4 a;
+		for (int r = 0; r < 3; ++r)
+			a.rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+		return a;
+	}
+}
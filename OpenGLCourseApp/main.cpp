@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <mutex>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,6 +12,21 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Benchmarks.h"
+#include "Camera.h"
+#include "ClipmapTerrain.h"
+#include "ConstTransform.h"
+#include "FrameLatency.h"
+#include "FramePacer.h"
+#include "GpuCulling.h"
+#include "JobSystem.h"
+#include "ParticleSystem.h"
+#include "PathTracer.h"
+#include "RenderQueue.h"
+#include "RenderThread.h"
+#include "SkinnedCrowd.h"
+#include "Transform.h"
+
 
 /**		Note to self!
  *	Identity matrices cannot be initialized: glm::mat4 model;
@@ -27,7 +45,11 @@
 const GLint WIDTH = 1000, HEIGHT = 750;
 const float TO_RADIANS = 3.14159265f / 180.f;
 
-GLuint VAO, VBO, IBO, shader, uniformModel, uniformProjection;
+// Projection for the WIDTH x HEIGHT window, folded at compile time. The windowed loop builds
+// its own from the framebuffer size, which can differ on high DPI screens
+constexpr ConstMat4 WINDOW_PROJECTION = ConstTransform::Perspective(45.f, (float)WIDTH / (float)HEIGHT, 0.1f, 100.f);
+
+GLuint VAO, VBO, IBO, shader, uniformModel;
 
 bool direction = true;
 float triOffset = 0.f;
@@ -41,6 +63,75 @@ float curSize = 0.4f;
 float maxSize = 0.8f;
 float minSize = 0.1f;
 
+// GPU-driven culling of a pyramid field, needs a GL 4.5 context (llvmpipe will do)
+const bool USE_GPU_CULLING = false;
+const int CULL_GRID_SIZE = 64;
+GpuCulling* gpuCulling = nullptr;
+
+// Draws go through a sorted queue, state change counts are printed every few seconds
+// With RECORD_IN_PARALLEL the job threads build the GL command stream and this thread only replays it
+const bool RECORD_IN_PARALLEL = true;
+JobSystem jobSystem;
+RenderQueue renderQueue;
+const double STATS_INTERVAL = 5.0;
+double lastStatsTime = 0.0;
+
+// With USE_RENDER_THREAD the GL context lives on its own thread and renders frame N while
+// this thread simulates N+1. FRAME_LATENCY is the number of frame slots (2 double, 3 triple buffered)
+const bool USE_RENDER_THREAD = false;
+const int FRAME_LATENCY = 2;
+RenderThread renderThread;
+unsigned long long frameCounter = 0;
+
+// Camera input is sampled at the top of every frame. With USE_LATE_LATCH RenderFrame samples it
+// again just before the first draw and patches that view into the FrameConstants block, and the
+// GPU may only have MAX_QUEUED_FRAMES frames queued (fences, instead of the driver's two or three).
+// Input to submit latency is printed with the stats
+const bool USE_LATE_LATCH = false;
+const int MAX_QUEUED_FRAMES = 1;
+Camera camera;
+std::mutex cameraMutex;
+CameraState publishedCamera;		// Latest main thread sample, what the render thread latches
+glm::mat4 latchedView(1.f);			// What the last RenderFrame drew with, frame.view unless late latched
+FrameLatency* frameLatency = nullptr;
+
+// Frame pacing: VSYNC_MODE goes to glfwSwapInterval (adaptive falls back to on without
+// EXT_swap_control_tear), TARGET_FPS > 0 adds a sleep + spin limiter ahead of every frame's input.
+// The spread of frame times is printed with the stats
+const VsyncMode VSYNC_MODE = VSYNC_ON;
+const double TARGET_FPS = 0.0;
+FramePacer framePacer;
+
+// Animated crowd of skinned characters; SKINNING_PATH picks vertex shader skinning from a
+// palette texture buffer or SIMD skinning on the job threads into a streaming buffer
+const bool USE_SKINNING = false;
+const SkinningPath SKINNING_PATH = SKINNING_GPU;
+const int SKINNED_CHARACTERS = 256;
+SkinnedCrowd* skinnedCrowd = nullptr;
+float animationTime = 0.f;
+
+// Fountain of particles; PARTICLE_PATH picks SIMD simulation on the job threads drawn from a
+// streaming buffer, or a transform feedback step that keeps everything on the GPU
+const bool USE_PARTICLES = false;
+const ParticlePath PARTICLE_PATH = PARTICLES_CPU;
+const int MAX_PARTICLES = 1 << 20;
+ParticleSystem* particles = nullptr;
+
+// Geometry clipmap terrain flown over by terrainViewer; each frame only the heightmap strips the
+// viewer moved onto are generated (fBm noise) and uploaded
+const bool USE_TERRAIN = false;
+const int TERRAIN_LEVELS = 5;
+const int TERRAIN_RESOLUTION = 128;
+const float TERRAIN_SPACING = 0.125f;
+ClipmapTerrain* terrain = nullptr;
+glm::dvec3 terrainViewer(0.0, 10.0, 0.0);
+
+// CPU path tracer: "--trace [file.ppm]" renders the first frame without a window or GL context.
+// With COMPARE_WITH_TRACER the first rasterised frame is diffed against the tracer's TRACE_ALBEDO
+// image, which only matches while the pyramid is all there is to draw
+const bool COMPARE_WITH_TRACER = false;
+const int TRACE_SAMPLES = 64;
+
 // Vertex Shader
 static const char* vShader = "												\n\
 # version 330																\n\
@@ -50,11 +141,16 @@ layout (location = 0) in vec3 pos;											\n\
 out vec4 vCol;																\n\
 																			\n\
 uniform mat4 model;															\n\
-uniform mat4 projection;													\n\
+																			\n\
+layout (std140) uniform FrameConstants										\n\
+{																			\n\
+	mat4 projection;														\n\
+	mat4 view;																\n\
+};																			\n\
 																			\n\
 void main()																	\n\
 {																			\n\
-	gl_Position = projection * model * vec4(pos, 1.0); 						\n\
+	gl_Position = projection * view * model * vec4(pos, 1.0); 				\n\
 	vCol = vec4(clamp(pos, 0.f, 1.0f), 1.0f);								\n\
 }";
 
@@ -72,21 +168,25 @@ void main()																	\n\
 }";
 
 
+// Pyramid, shared by the GL buffers and the path tracer
+const unsigned int pyramidIndices[] = {
+	0, 3, 1,
+	1, 3, 2,
+	2, 3, 0,
+	0, 1, 2
+};
+
+const GLfloat pyramidVertices[] = {	// index: 
+	-1.f, -1.f, 0.f,	// 0
+	0.f, -1.f, 1.f,		// 1
+	1.f, -1.f, 0.f,		// 2
+	0.f, 1.f, 0.f		// 3
+};
+
 void CreateTriangle()
 {
-	unsigned int indices[] = {
-		0, 3, 1,
-		1, 3, 2,
-		2, 3, 0,
-		0, 1, 2
-	};
-
-	GLfloat vertices[] = {	// index: 
-		-1.f, -1.f, 0.f,	// 0
-		0.f, -1.f, 1.f,		// 1
-		1.f, -1.f, 0.f,		// 2
-		0.f, 1.f, 0.f		// 3
-	};
+	const unsigned int* indices = pyramidIndices;
+	const GLfloat* vertices = pyramidVertices;
 
 	
 	glGenVertexArrays(1, &VAO);	// Params: Amount of arrays; Where to store the values and pass it by reference.
@@ -94,13 +194,13 @@ void CreateTriangle()
 
 	glGenBuffers(1, &IBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(pyramidIndices), indices, GL_STATIC_DRAW);
 
 		glGenBuffers(1, &VBO);		// Params: Amount of arrays; values stored and pass by reference
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);		// Params: Which buffer, choose enum and in this case array buffer; The buffer to bind (VBO)
 
 			// glBufferData params: target buffer; size of the data; actual array; static or dynamic draw
-			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidVertices), vertices, GL_STATIC_DRAW);
 
 			// glVertextAttribPointer params: index; amount of vertices; type of the values; normalize or not; stride value or not; offset where the data starts
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
@@ -181,11 +281,383 @@ void CompileShaders()
 	}
 
 	uniformModel = glGetUniformLocation(shader, "model");
-	uniformProjection = glGetUniformLocation(shader, "projection");
+	FrameLatency::BindBlock(shader);
+}
+
+void CreateCullingField()
+{
+	gpuCulling = new GpuCulling();
+	if (!gpuCulling->Init(CULL_GRID_SIZE * CULL_GRID_SIZE))
+	{
+		delete gpuCulling;
+		gpuCulling = nullptr;
+		return;
+	}
+
+	GLuint pyramid = gpuCulling->AddMesh(12, 0, 0);
+
+	// Pyramids spread out behind the spinning one, most end up hidden or off screen
+	for (int z = 0; z < CULL_GRID_SIZE; ++z)
+	{
+		for (int x = 0; x < CULL_GRID_SIZE; ++x)
+		{
+			glm::vec3 position((x - CULL_GRID_SIZE / 2) * 1.5f, -1.5f, -4.f - z * 1.5f);
+			glm::mat4 model = glm::translate(glm::mat4(1.f), position);
+			model = glm::scale(model, glm::vec3(0.5f));
+
+			// Unit pyramid fits in a sphere of radius sqrt(2) around the origin
+			gpuCulling->AddInstance(pyramid, model, position, 0.5f * 1.4143f);
+		}
+	}
+
+	gpuCulling->UploadInstances();
+	gpuCulling->AttachToVAO(VAO);
+}
+
+void CreateSkinnedCrowd()
+{
+	skinnedCrowd = new SkinnedCrowd();
+	if (!skinnedCrowd->Init(SKINNING_PATH, SKINNED_CHARACTERS))
+	{
+		delete skinnedCrowd;
+		skinnedCrowd = nullptr;
+	}
+}
+
+void CreateParticles()
+{
+	BatchMath::ParticleEmitter emitter;
+	emitter.position = glm::vec3(0.f, -1.f, -4.f);
+	emitter.extent = glm::vec3(0.05f);
+	emitter.velocity = glm::vec3(0.f, 3.f, 0.f);
+	emitter.spread = glm::vec3(0.6f, 0.5f, 0.6f);
+	emitter.life = 2.f;
+	emitter.lifeVariation = 0.3f;
+
+	particles = new ParticleSystem();
+	if (!particles->Init(PARTICLE_PATH, MAX_PARTICLES, emitter, glm::vec3(0.f, -4.f, 0.f), 0.1f))
+	{
+		delete particles;
+		particles = nullptr;
+	}
+}
+
+void CreateTerrain()
+{
+	BatchMath::FbmSettings fbm;
+	fbm.octaves = 6;
+	fbm.frequency = 0.02f;
+	fbm.lacunarity = 2.f;
+	fbm.gain = 0.5f;
+
+	terrain = new ClipmapTerrain();
+	if (!terrain->Init(TERRAIN_LEVELS, TERRAIN_RESOLUTION, TERRAIN_SPACING, NoiseHeightSource(NOISE_SIMPLEX, fbm, 6.f)))
+	{
+		delete terrain;
+		terrain = nullptr;
+	}
+}
+
+// Colours as the vertex shader makes them, clamp(pos, 0, 1)
+void AddTraceMeshes(PathTracer& tracer)
+{
+	const size_t vertexCount = sizeof(pyramidVertices) / sizeof(pyramidVertices[0]) / 3;
+	glm::vec3 positions[vertexCount], colours[vertexCount];
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		positions[i] = glm::vec3(pyramidVertices[i * 3], pyramidVertices[i * 3 + 1], pyramidVertices[i * 3 + 2]);
+		colours[i] = glm::clamp(positions[i], 0.f, 1.f);
+	}
+
+	tracer.SetMesh(VAO, positions, colours, vertexCount, pyramidIndices, sizeof(pyramidIndices) / sizeof(pyramidIndices[0]));
+}
+
+void UpdateSimulation()
+{
+	animationTime += 1.f / 60.f;
+
+	// Forward at 6 units a second, weaving from side to side
+	terrainViewer.x += 0.05 * std::sin(animationTime * 0.3);
+	terrainViewer.z -= 0.1;
+
+	if (direction) 
+		triOffset += triIncrement;
+	else
+		triOffset -= triIncrement;
+
+	if (abs(triOffset) >= triMaxOffset)
+		direction = !direction;
+
+	curAngle += 0.1f;
+	if (curAngle >= 360) curAngle -= 360;
+
+
+	if (sizeDirection)
+		curSize += 0.001f;
+	else
+		curSize -= 0.001f;
+
+	if (curSize >= maxSize || curSize <= minSize)
+		sizeDirection = !sizeDirection;
+}
+
+/** Snapshot of the simulation for the render side, nothing in here touches GL */
+void BuildFrame(FrameData& frame, const glm::mat4& projection, int width, int height)
+{
+	frame.frameIndex = ++frameCounter;
+	frame.projection = projection;
+	frame.view = camera.GetState().View();
+	frame.inputTime = camera.GetState().sampleTime;
+	frame.width = width;
+	frame.height = height;
+	frame.draws.clear();
+	frame.terrainViewer = terrainViewer;
+
+	// Same as translate -> rotate -> scale, without the three 4x4 multiplies
+	glm::mat4 model = Transform::ComposeTRS(glm::vec3(0.f, 0.f, -2.5f), glm::vec3(0.f, 1.f, 0.f), curAngle * TO_RADIANS, glm::vec3(0.4f, 0.4f, 1.f));
+
+	DrawItem pyramid;
+	pyramid.program = shader;
+	pyramid.material = 0;
+	pyramid.VAO = VAO;
+	pyramid.IBO = IBO;
+	pyramid.indexCount = 12;
+	pyramid.uniformModel = (GLint)uniformModel;
+	pyramid.model = model;
+	pyramid.viewDepth = 2.5f;
+	pyramid.pass = RENDER_PASS_MAIN;
+	pyramid.translucent = false;
+	frame.draws.push_back(pyramid);
+
+	if (skinnedCrowd)
+	{
+		frame.skinPalettes.resize(skinnedCrowd->GetCharacterCount() * skinnedCrowd->GetJointCount());
+		skinnedCrowd->Animate(animationTime, &frame.skinPalettes[0], &jobSystem);
+	}
+}
+
+/** Newest camera sample. The main thread polls again; the render thread takes the main thread's
+ *	last sample, which is already ahead of the frame being drawn */
+CameraState LatchCamera(GLFWwindow* window)
+{
+	if (window)
+	{
+		glfwPollEvents();
+		camera.Sample(window);
+		return camera.GetState();
+	}
+
+	std::lock_guard<std::mutex> lock(cameraMutex);
+	return publishedCamera;
+}
+
+/** Runs on whichever thread owns the context, the caller swaps buffers. user is the window
+ *	when this thread may poll input */
+void RenderFrame(const FrameData& frame, void* user)
+{
+	// The serial loop holds the frame before it polls, the render thread before it latches
+	if (!user)
+		framePacer.Pace();
+
+	// Clear window
+	glClearColor(0.f, 0.f, 0.f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	renderQueue.Clear();
+	for (size_t i = 0; i < frame.draws.size(); ++i)
+		renderQueue.Submit(frame.draws[i]);
+
+	// Camera constants go in last, after waiting out the queue cap so the input is as fresh as it gets
+	frameLatency->WaitForQueue();
+	glm::mat4 view = frame.view;
+	uint64_t inputTime = frame.inputTime;
+	if (USE_LATE_LATCH)
+	{
+		CameraState latest = LatchCamera((GLFWwindow*)user);
+		view = latest.View();
+		inputTime = latest.sampleTime;
+	}
+	frameLatency->Latch(frame.projection, view, inputTime, frame.inputTime);
+	latchedView = view;
+
+	if (RECORD_IN_PARALLEL)
+	{
+		renderQueue.ExecuteRecorded(&jobSystem);
+	}
+	else
+	{
+		renderQueue.Sort(&jobSystem);
+		renderQueue.Execute();
+	}
+
+	if (glfwGetTime() - lastStatsTime >= STATS_INTERVAL)
+	{
+		RenderStats unsorted = renderQueue.GetUnsortedStats();
+		RenderStats sorted = renderQueue.GetSortedStats();
+		printf("Draws: %u, state changes per frame: %u unsorted -> %u sorted (program %u, material %u, VAO %u)\n",
+			sorted.draws, unsorted.StateChanges(), sorted.StateChanges(),
+			sorted.programChanges, sorted.materialChanges, sorted.vaoChanges);
+
+		if (skinnedCrowd)
+		{
+			static const char* pathNames[] = { "GPU palette", "CPU linear blend", "CPU dual quaternion" };
+			SkinningTimings timings = skinnedCrowd->TakeTimings();
+			double totalMs = timings.cpuMs + timings.gpuMs;
+			printf("Skinning (%s): %d characters, CPU %.3f ms + GPU %.3f ms per frame, %.1f characters/ms\n",
+				pathNames[skinnedCrowd->GetPath()], skinnedCrowd->GetCharacterCount(), timings.cpuMs, timings.gpuMs,
+				totalMs > 0.0 ? skinnedCrowd->GetCharacterCount() / totalMs : 0.0);
+		}
+
+		if (terrain)
+		{
+			TerrainTimings timings = terrain->TakeTimings();
+			printf("Terrain: %d levels of %d^2, %.0f heights refreshed + %.3f ms CPU, GPU %.3f ms per frame\n",
+				terrain->GetLevelCount(), terrain->GetResolution(), timings.texelsPerFrame, timings.updateMs, timings.gpuMs);
+		}
+
+		if (particles)
+		{
+			static const char* pathNames[] = { "CPU SIMD", "GPU transform feedback" };
+			ParticleTimings timings = particles->TakeTimings();
+			double totalMs = timings.cpuMs + timings.gpuMs;
+			printf("Particles (%s): %.3f M processed per frame, CPU %.3f ms + GPU %.3f ms per frame, %.1f M particles/s\n",
+				pathNames[particles->GetPath()], timings.particles * 1e-6, timings.cpuMs, timings.gpuMs,
+				totalMs > 0.0 ? timings.particles / totalMs * 1e-3 : 0.0);
+		}
+
+		LatencyTimings latency = frameLatency->TakeTimings();
+		if (USE_LATE_LATCH)
+			printf("Input to submit: %.3f ms latched (max %.3f ms), %.3f ms from the top of frame sample, at most %d queued frames, %.3f ms waiting on them\n",
+				latency.inputToSubmitMs, latency.maxInputToSubmitMs, latency.frameInputToSubmitMs, frameLatency->GetMaxQueuedFrames(), latency.queueWaitMs);
+		else
+			printf("Input to submit: %.3f ms (max %.3f ms), no late latch\n", latency.inputToSubmitMs, latency.maxInputToSubmitMs);
+
+		static const char* vsyncNames[] = { "off", "on", "adaptive" };
+		PacingTimings pacing = framePacer.TakeTimings();
+		char limit[32] = "no limit";
+		if (framePacer.GetTargetFps() > 0.0)
+			snprintf(limit, sizeof(limit), "limit %.0f fps", framePacer.GetTargetFps());
+		printf("Frame time (vsync %s, %s): %.3f ms mean, %.3f ms deviation, %.3f - %.3f ms, 99th percentile %.3f ms, limiter %.3f ms per frame\n",
+			vsyncNames[framePacer.GetVsyncMode()], limit, pacing.meanMs, pacing.deviationMs, pacing.minMs, pacing.maxMs,
+			pacing.percentile99Ms, pacing.limiterMs);
+
+		lastStatsTime = glfwGetTime();
+	}
+
+	if (terrain)
+		terrain->Draw(frame.terrainViewer, frame.projection, view, &jobSystem);
+
+	if (skinnedCrowd && !frame.skinPalettes.empty())
+		skinnedCrowd->Draw(&frame.skinPalettes[0], frame.projection, view, &jobSystem);
+
+	if (gpuCulling)
+	{
+		gpuCulling->Cull(frame.projection * view);
+		gpuCulling->Draw(VAO, IBO, frame.projection, view);
+		gpuCulling->BuildDepthPyramid(frame.width, frame.height);	// Occluders for the next frame
+	}
+
+	// Blended, after everything opaque
+	if (particles)
+	{
+		particles->Update(1.f / 60.f, &jobSystem);
+		particles->Draw(frame.projection, view, &jobSystem);
+	}
+
+	frameLatency->Submitted();
+}
+
+void PrintTraceStats(const TraceStats& stats)
+{
+	printf("Traced %llu samples (%llu rays) over %zu triangles / %zu BVH nodes in %.3f s: %.3f M samples/s per core on %u threads\n",
+		stats.samples, stats.rays, stats.triangles, stats.nodes, stats.seconds, stats.SamplesPerSecondPerCore() * 1e-6, stats.threads);
 }
 
-int main()
+/** The frame the window would show first, path traced into a PPM */
+void TraceFrame(const char* path)
 {
+	glm::mat4 projection = WINDOW_PROJECTION.ToMat4();
+	FrameData frame;
+	UpdateSimulation();
+	BuildFrame(frame, projection, WIDTH, HEIGHT);
+
+	PathTracer tracer;
+	AddTraceMeshes(tracer);
+
+	TraceSettings settings;
+	settings.samplesPerPixel = TRACE_SAMPLES;
+	TraceImage image;
+	PrintTraceStats(tracer.Render(frame, settings, &jobSystem, image));
+	if (image.WritePPM(path))
+		printf("Wrote %s\n", path);
+}
+
+/** Reads back what RenderFrame just drew and diffs it against the traced reference, seen from the
+ *	view RenderFrame latched */
+void CompareWithTracer(const FrameData& drawn)
+{
+	if (terrain || skinnedCrowd || particles || gpuCulling)
+	{
+		printf("Raster vs traced reference skipped, the tracer only knows the pyramid draws\n");
+		return;
+	}
+
+	FrameData frame = drawn;
+	frame.view = latchedView;
+
+	TraceImage raster;
+	raster.width = frame.width;
+	raster.height = frame.height;
+	raster.pixels.resize((size_t)frame.width * frame.height);
+
+	// GL rows go bottom up
+	std::vector<glm::vec3> readBack(raster.pixels.size());
+	glReadPixels(0, 0, frame.width, frame.height, GL_RGB, GL_FLOAT, &readBack[0]);
+	for (int y = 0; y < frame.height; ++y)
+		std::copy(&readBack[(size_t)(frame.height - 1 - y) * frame.width], &readBack[(size_t)(frame.height - y) * frame.width],
+			&raster.pixels[(size_t)y * frame.width]);
+
+	PathTracer tracer;
+	AddTraceMeshes(tracer);
+
+	TraceSettings settings;
+	settings.mode = TRACE_ALBEDO;
+	TraceImage reference;
+	PrintTraceStats(tracer.Render(frame, settings, &jobSystem, reference));
+
+	ImageDifference difference = CompareImages(raster, reference);
+	printf("Raster vs traced reference: RMS %.4f, max %.4f, %d of %d pixels differ\n", difference.rms, difference.maxError,
+		difference.differingPixels, frame.width * frame.height);
+	raster.WritePPM("raster.ppm");
+	reference.WritePPM("reference.ppm");
+}
+
+void PrintTimingReport()
+{
+	OverlapTimer::Report report = renderThread.GetTimer().TakeReport();
+	if (!report.frames)
+		return;
+
+	double toMs = 1000.0 / report.frames;
+	printf("Frame: %.3f ms, simulation %.3f ms, render %.3f ms, overlapped %.3f ms (%.0f%% of render)\n",
+		report.wall * toMs, report.busy[OverlapTimer::SIMULATION] * toMs, report.busy[OverlapTimer::RENDER] * toMs,
+		report.overlap * toMs, report.busy[OverlapTimer::RENDER] > 0.0 ? 100.0 * report.overlap / report.busy[OverlapTimer::RENDER] : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+	{
+		RunBenchmarks();
+		return 0;
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--trace") == 0)
+	{
+		TraceFrame(argc > 2 ? argv[2] : "trace.ppm");
+		return 0;
+	}
+
 	// Initialize GLFW
 	if(!glfwInit())
 	{
@@ -196,8 +668,8 @@ int main()
 
 	// Setup GLFW window properties
 	// OpenGL version
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, USE_GPU_CULLING ? 4 : 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, USE_GPU_CULLING ? 5 : 3);
 	// Core profile = No Backwards Compability
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	// Allow forward compability
@@ -238,60 +710,86 @@ int main()
 	CreateTriangle();
 	CompileShaders();
 
-	glm::mat4 projection = glm::perspective(45.f, (GLfloat)bufferWidth / (GLfloat)bufferHeight, 0.1f, 100.f);
+	frameLatency = new FrameLatency();
+	frameLatency->Init(USE_LATE_LATCH ? MAX_QUEUED_FRAMES : 0);
+	framePacer.Init(VSYNC_MODE, TARGET_FPS);
 
-	// Loop until window closed
-	while(!glfwWindowShouldClose(mainWindow))
-	{
-		// Get + Handle user input events
-		glfwPollEvents();
-
-		if (direction) 
-			triOffset += triIncrement;
-		else
-			triOffset -= triIncrement;
+	glm::mat4 projection = glm::perspective(45.f, (GLfloat)bufferWidth / (GLfloat)bufferHeight, 0.1f, 100.f);
 
-		if (abs(triOffset) >= triMaxOffset)
-			direction = !direction;
+	if (USE_GPU_CULLING)
+		CreateCullingField();
 
-		curAngle += 0.1f;
-		if (curAngle >= 360) curAngle -= 360;
+	if (USE_SKINNING)
+		CreateSkinnedCrowd();
 
+	if (USE_TERRAIN)
+		CreateTerrain();
 
-		if (sizeDirection)
-			curSize += 0.001f;
-		else
-			curSize -= 0.001f;
+	if (USE_PARTICLES)
+		CreateParticles();
 
-		if (curSize >= maxSize || curSize <= minSize)
-			sizeDirection = !sizeDirection;
+	renderQueue.SetDepthRange(0.1f, 100.f);
+	lastStatsTime = glfwGetTime();
+	double lastTimingTime = glfwGetTime();
 
-		// Clear window
-		glClearColor(0.f, 0.f, 0.f, 1.f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	FrameData serialFrame;
 
-		glUseProgram(shader);
+	if (USE_RENDER_THREAD)
+		renderThread.Start(mainWindow, FRAME_LATENCY, RenderFrame, nullptr);
 
-		glm::mat4 model = glm::mat4(1.f);
-		model = glm::translate(model, glm::vec3(0.f, 0.f, -2.5f));
-		model = glm::rotate(model, curAngle * TO_RADIANS, glm::vec3(0.f, 1.f, 0.f));
-		model = glm::scale(model, glm::vec3(0.4f, 0.4f, 1.f));
-				
-		// Params: model location; amount; transpose; pointer to the value;
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
+	OverlapTimer& timer = renderThread.GetTimer();
 
-			glBindVertexArray(VAO);
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+	// Loop until window closed
+	while(!glfwWindowShouldClose(mainWindow))
+	{
+		if (!renderThread.IsRunning())
+			framePacer.Pace();
 
-					glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+		// Get + Handle user input events
+		glfwPollEvents();
+		camera.Sample(mainWindow);
+		{
+			std::lock_guard<std::mutex> lock(cameraMutex);
+			publishedCamera = camera.GetState();
+		}
+
+		// Waits here when the render thread is FRAME_LATENCY frames behind
+		FrameData* frame = renderThread.IsRunning() ? renderThread.AcquireFrame() : &serialFrame;
+
+		timer.Begin(OverlapTimer::SIMULATION);
+			UpdateSimulation();
+			BuildFrame(*frame, projection, bufferWidth, bufferHeight);
+		timer.End(OverlapTimer::SIMULATION);
+
+		if (renderThread.IsRunning())
+		{
+			renderThread.SubmitFrame(frame);
+		}
+		else
+		{
+			timer.Begin(OverlapTimer::RENDER);
+				RenderFrame(*frame, mainWindow);
+				if (COMPARE_WITH_TRACER && frame->frameIndex == 1)
+					CompareWithTracer(*frame);
+				glfwSwapBuffers(mainWindow);
+			timer.End(OverlapTimer::RENDER);
+			timer.FrameDone();
+		}
+
+		if (glfwGetTime() - lastTimingTime >= STATS_INTERVAL)
+		{
+			PrintTimingReport();
+			lastTimingTime = glfwGetTime();
+		}
+	}
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
-		glUseProgram(0);
+	renderThread.Stop();
 
-		glfwSwapBuffers(mainWindow);
-	}
+	delete gpuCulling;
+	delete skinnedCrowd;
+	delete terrain;
+	delete particles;
+	delete frameLatency;
 
 	return 0;
 }
\ No newline at end of file